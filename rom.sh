@@ -19,9 +19,16 @@ then
     # riscv32-unknown-elf-gcc "$targetcfiles" "$includecfiles" -I "$includedirectory" -T "$linkerfile" -nostdlib -nodefaultlibs -fno-exceptions -nostartfiles -o "$targetdirectory/$targetfilename.o"
     riscv32-unknown-elf-gcc "$targetcfiles" "$includecfiles" -I "$includedirectory" -T "$linkerfile" -fno-exceptions -nostartfiles -o "$targetdirectory/$targetfilename.o"
     # riscv32-unknown-elf-objcopy -I elf32-little -O binary -j .text "$targetdirectory/$targetfilename.o" "$targetdirectory/$targetfilename.tmp"
-    riscv32-unknown-elf-objcopy -I elf32-little -O binary "$targetdirectory/$targetfilename.o" "$targetdirectory/$targetfilename.tmp"
+    # SDRAM code is far away from ROM, dump it on its own else the binary spans the gap
+    riscv32-unknown-elf-objcopy -I elf32-little -O binary -R .sdram_text "$targetdirectory/$targetfilename.o" "$targetdirectory/$targetfilename.tmp"
     od -v --endian=little -tx4 -An -w4 "$targetdirectory/$targetfilename.tmp" > "$targetdirectory/$targetfilename.txt"
     echo "ROM assembly dumped: $targetdirectory/$targetfilename.txt"
+    riscv32-unknown-elf-objcopy -I elf32-little -O binary -j .sdram_text "$targetdirectory/$targetfilename.o" "$targetdirectory/$targetfilename.sdram.tmp"
+    od -v --endian=little -tx4 -An -w4 "$targetdirectory/$targetfilename.sdram.tmp" > "$targetdirectory/$targetfilename.sdram.txt"
+    if [ -s "$targetdirectory/$targetfilename.sdram.txt" ]
+    then
+        echo "SDRAM code dumped: $targetdirectory/$targetfilename.sdram.txt"
+    fi
     # rm "$targetdirectory/$targetfilename.o"
     # rm "$targetdirectory/$targetfilename.tmp"
     if [ ! -z "$2" ]
@@ -33,6 +40,10 @@ then
         else
             cp "$targetdirectory/$targetfilename.txt" "${2}/rom.txt"
             echo "ROM assembly copied: ${2}/rom.txt"
+            cp "$targetdirectory/$targetfilename.sdram.txt" "${2}/sdram.txt"
+            echo "SDRAM code copied: ${2}/sdram.txt (run harness with SDRAMFILE set to it)"
+            cp "$targetdirectory/$targetfilename.o" "${2}/rom.elf"
+            echo "ELF copied: ${2}/rom.elf (ROMFILE for the harness / socemu, has ROM + SDRAM code + symbols)"
         fi
     fi
 else
@@ -0,0 +1,93 @@
+// Icache refill / branch prediction test, the work runs from SDRAM
+// No CSR or SYSTEM related instrs. Meant for the CPU harness with +cosim (make vrlt_regress), every retired
+// instr is checked against the ISS. GPIO out ends at 0x02000000 when the result is the expected one, 0xff000000 else
+// (EXPECT_GPIO line below, vrlt_regress checks it)
+//  - work_a / b / c are 2K aligned: same set of the 4K 2 way icache, called in turn so one of them always
+//    evicts another, every call refills
+//  - branches on an LFSR (half taken at random), loops with changing trip counts, indirect calls picked by
+//    data: mispredicts, some while a refill is going on
+// Expected value: same C built for the host (uint32_t only)
+// EXPECT_GPIO 02000000
+
+#include <stdint.h>
+#include "addr.h"
+#include "reset.h"
+
+#define ROUNDS   16
+#define EXPECTED 0x9D732C7F
+
+// Same icache set
+#define SDRAM_TEXT_SET SDRAM_TEXT __attribute__ ((aligned(2048), noinline))
+
+typedef uint32_t (*op_t)(uint32_t, uint32_t);
+
+static void marker(uint32_t m)
+{
+    *addr_gpio_out = m << 24;
+}
+
+static inline __attribute__ ((always_inline)) uint32_t lfsr(uint32_t x)
+{
+    return (x >> 1) ^ (-(x & 1u) & 0xd0000001u);
+}
+
+SDRAM_TEXT __attribute__ ((noinline)) static uint32_t op_add(uint32_t a, uint32_t b) { return a + b; }
+SDRAM_TEXT __attribute__ ((noinline)) static uint32_t op_sub(uint32_t a, uint32_t b) { return a - b; }
+SDRAM_TEXT __attribute__ ((noinline)) static uint32_t op_xor(uint32_t a, uint32_t b) { return a ^ b; }
+SDRAM_TEXT __attribute__ ((noinline)) static uint32_t op_rot(uint32_t a, uint32_t b)
+{
+    return (a << (b & 31)) | (a >> ((32 - b) & 31));
+}
+
+static op_t s_ops[4] = {op_add, op_sub, op_xor, op_rot};
+
+// Data dependent branches
+SDRAM_TEXT_SET uint32_t work_a(uint32_t x)
+{
+    uint32_t acc = 0;
+    for (int i = 0; i < 16; i++) {
+        x = lfsr(x);
+        if (x & 1)
+            acc += x;
+        else
+            acc ^= x >> 3;
+        if ((x & 6) == 6)
+            acc = (acc << 1) | (acc >> 31);
+    }
+    return acc ^ x;
+}
+
+// Nested loops, inner trip count changes every time: loop exits mispredict
+SDRAM_TEXT_SET uint32_t work_b(uint32_t x)
+{
+    uint32_t acc = x;
+    for (uint32_t i = 0; i < 4; i++)
+        for (uint32_t j = 0; j <= ((x >> (i * 2)) & 3); j++)
+            acc += (i << 3) - i + j;
+    return acc;
+}
+
+// Indirect calls, jalr target picked by data
+SDRAM_TEXT_SET uint32_t work_c(uint32_t x)
+{
+    uint32_t acc = x;
+    for (int i = 0; i < 8; i++) {
+        x = lfsr(x);
+        acc = s_ops[x & 3](acc, x);
+    }
+    return acc;
+}
+
+int main()
+{
+    uint32_t x = 0xace1u, sum = 0;
+    marker(1);
+    for (int r = 0; r < ROUNDS; r++) {
+        sum += work_a(x);
+        sum ^= work_b(sum);
+        sum += work_c(sum ^ x);
+        x = lfsr(x);
+    }
+    marker((sum == EXPECTED) ? 2 : 0xff);
+    while(1);
+}
@@ -9,4 +9,23 @@ uint32_t * addr_hdmi_frame_buffer = (uint32_t *)0x40000000; // 640 480
 uint32_t * addr_hdmi_status_1     = (uint32_t *)0x40009600; // others
 uint32_t * addr_hdmi_status_2     = (uint32_t *)0x40009604; // x, y coords. 16 bits
 
+// Perf counters, word access only. Write PERF_CTRL_CLEAR to zero them (keeps running), PERF_CTRL_STOP to freeze,
+// PERF_CTRL_RUN to go on, bits can be or-ed (PERF_CTRL_CLEAR | PERF_CTRL_STOP). Read ctrl: 1 while running
+// Counters wrap at 32 bits (~107 s at 40 MHz)
+uint32_t * addr_perf_ctrl         = (uint32_t *)0xffffff80;
+uint32_t * addr_perf_counters     = (uint32_t *)0xffffff84; // addr_perf_counters[PERF_*]
+#define PERF_CTRL_RUN          0x1
+#define PERF_CTRL_CLEAR        0x2
+#define PERF_CTRL_STOP         0x4
+#define PERF_CYCLES            0
+#define PERF_INSTRET           1 // instrs leaving mem stage
+#define PERF_STALL_DECODE      2 // operand not ready (load pending)
+#define PERF_STALL_EXEC        3 // bubble behind a mem access that may wait
+#define PERF_STALL_MEM         4 // mem access waiting for the LSU
+#define PERF_STALL_FETCH       5 // icache miss
+#define PERF_MISPREDICT        6
+#define PERF_DCACHE_HIT        7
+#define PERF_DCACHE_MISS       8
+#define PERF_SDRAM_REFRESH     9 // cycles a SDRAM request is held up by refresh
+
 #endif
\ No newline at end of file
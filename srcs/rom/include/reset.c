@@ -2,19 +2,24 @@
 
 int main(void); // declare main
 
+// In ROM (.rodata), always 0 on hw. Verilator harness sets it when it already put .data / .bss in RAM from the ELF
+const volatile unsigned _data_preloaded = 0;
+
 void reset_handler(void)
 {
     // copy over data from rom
     volatile unsigned *src, *dest;
-    for (src = &_data_loadaddr, dest = &_data;
-		dest < &_edata;
-		src++, dest++) {
-		*dest = *src;
-	}
-
-	while (dest < &_ebss) {
-		*dest++ = 0;
-	}
+    if (!_data_preloaded) {
+        for (src = &_data_loadaddr, dest = &_data;
+            dest < &_edata;
+            src++, dest++) {
+            *dest = *src;
+        }
+
+        while (dest < &_ebss) {
+            *dest++ = 0;
+        }
+    }
 
     // call main
     (void)main();
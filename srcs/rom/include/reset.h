@@ -14,8 +14,14 @@ extern vector_table_t vector_table;
 
 extern unsigned _data_loadaddr, _data, _edata, _ebss, _stack;
 
+// Set by the simulation loader only, skips the .data copy / .bss clear (reset.c)
+extern const volatile unsigned _data_preloaded;
+
 extern void reset_handler(void);
 
+// Put a function in SDRAM instead of the 2K ROM, fetched through icache
+#define SDRAM_TEXT __attribute__ ((section(".sdram_text")))
+
 // section .reset to put this into reset section (linker)
 // naked to remove epilogue, prologue (might not work on some arch???)
 extern void __attribute__ ((section(".reset"), naked)) _reset_handler(void);
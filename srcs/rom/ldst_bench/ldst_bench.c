@@ -0,0 +1,107 @@
+// Load / store microbenchmark, dcache hit path
+// No CSR or SYSTEM related instrs: phases are marked on GPIO out (LEDs),
+// run the CPU harness with +gpio_marks to get the cycles between marker changes.
+// On hardware read the perf counters (addr.h) around a phase instead.
+// Every phase is BENCH_ITER rounds of 16 accesses to one 64 bytes block in RAM, hits after warm up
+//  1: same loop with nops, subtract it to get the cost per access
+//  2: back to back loads
+//  3: back to back stores
+//  4: store then load of the same word
+//  5: load-use chain, each load feeds the next address
+//  6: done
+
+#include <stdint.h>
+#include "addr.h"
+#include "reset.h"
+
+#define BENCH_ITER 64
+
+static uint32_t s_buf[16] __attribute__ ((aligned(64)));
+
+static void marker(uint32_t m)
+{
+    *addr_gpio_out = m << 24;
+}
+
+// 16 times the same asm line, offsets stay in one block
+#define X16(s) s s s s s s s s s s s s s s s s
+
+static void bench_empty(uint32_t n)
+{
+    asm volatile (
+        "1:\n"
+        X16("nop\n")
+        "addi %0, %0, -1\n"
+        "bnez %0, 1b\n"
+        : "+r"(n) : : "memory");
+}
+
+static void bench_load(uint32_t *p, uint32_t n)
+{
+    asm volatile (
+        "1:\n"
+        "lw t0, 0(%1)\n"  "lw t1, 4(%1)\n"  "lw t2, 8(%1)\n"  "lw t3, 12(%1)\n"
+        "lw t0, 16(%1)\n" "lw t1, 20(%1)\n" "lw t2, 24(%1)\n" "lw t3, 28(%1)\n"
+        "lw t0, 32(%1)\n" "lw t1, 36(%1)\n" "lw t2, 40(%1)\n" "lw t3, 44(%1)\n"
+        "lw t0, 48(%1)\n" "lw t1, 52(%1)\n" "lw t2, 56(%1)\n" "lw t3, 60(%1)\n"
+        "addi %0, %0, -1\n"
+        "bnez %0, 1b\n"
+        : "+r"(n) : "r"(p) : "t0", "t1", "t2", "t3", "memory");
+}
+
+static void bench_store(uint32_t *p, uint32_t n)
+{
+    asm volatile (
+        "1:\n"
+        "sw %0, 0(%1)\n"  "sw %0, 4(%1)\n"  "sw %0, 8(%1)\n"  "sw %0, 12(%1)\n"
+        "sw %0, 16(%1)\n" "sw %0, 20(%1)\n" "sw %0, 24(%1)\n" "sw %0, 28(%1)\n"
+        "sw %0, 32(%1)\n" "sw %0, 36(%1)\n" "sw %0, 40(%1)\n" "sw %0, 44(%1)\n"
+        "sw %0, 48(%1)\n" "sw %0, 52(%1)\n" "sw %0, 56(%1)\n" "sw %0, 60(%1)\n"
+        "addi %0, %0, -1\n"
+        "bnez %0, 1b\n"
+        : "+r"(n) : "r"(p) : "memory");
+}
+
+static void bench_store_load(uint32_t *p, uint32_t n)
+{
+    asm volatile (
+        "1:\n"
+        X16("sw %0, 0(%1)\n" "lw t0, 0(%1)\n")
+        "addi %0, %0, -1\n"
+        "bnez %0, 1b\n"
+        : "+r"(n) : "r"(p) : "t0", "memory");
+}
+
+// s_buf[i] holds its own address, so t0 keeps pointing at the block
+static void bench_load_use(uint32_t *p, uint32_t n)
+{
+    asm volatile (
+        "mv t0, %1\n"
+        "1:\n"
+        X16("lw t0, 0(t0)\n")
+        "addi %0, %0, -1\n"
+        "bnez %0, 1b\n"
+        : "+r"(n) : "r"(p) : "t0", "memory");
+}
+
+int main()
+{
+    // Warm up, block in dcache
+    for (int i = 0; i < 16; i++)
+        s_buf[i] = (uint32_t)&s_buf[i];
+
+    marker(1);
+    bench_empty(BENCH_ITER);
+    marker(2);
+    bench_load(s_buf, BENCH_ITER);
+    marker(3);
+    bench_store(s_buf, BENCH_ITER);
+    marker(4);
+    bench_store_load(s_buf, BENCH_ITER);
+    // stores wrote the iteration count in s_buf[0], put the pointer back
+    s_buf[0] = (uint32_t)&s_buf[0];
+    marker(5);
+    bench_load_use(s_buf, BENCH_ITER);
+    marker(6);
+    while(1);
+}
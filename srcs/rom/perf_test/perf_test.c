@@ -0,0 +1,93 @@
+// Perf counters test (PerfCountersWB.sv through addr.h): clear, start, stop and readback from code
+// No CSR or SYSTEM related instrs. Meant for the CPU harness with +cosim (make vrlt_regress), counter loads are
+// MMIO, the ISS takes what the pipeline read. GPIO out ends at 0x02000000 when every check passes,
+// 0xf<n>000000 on the first failing check n. Runs on tools/socemu too (cycles == instret there)
+//  1: clear alone keeps counting
+//  2: instret over a known loop, cycles >= instret
+//  3: stop freezes every counter
+//  4: clear while stopped stays stopped, counters 0
+//  5: start goes on from 0
+// EXPECT_GPIO 02000000
+
+#include <stdint.h>
+#include "addr.h"
+#include "reset.h"
+
+#define LOOP_ITER 1000
+// Instrs retired around the loop between the ctrl write landing and the stop write landing
+#define LOOP_SLACK 32
+
+static void marker(uint32_t m)
+{
+    *addr_gpio_out = m << 24;
+}
+
+// 2 instrs per round
+static void spin(uint32_t n)
+{
+    asm volatile (
+        "1:\n"
+        "addi %0, %0, -1\n"
+        "bnez %0, 1b\n"
+        : "+r"(n) : : "memory");
+}
+
+static uint32_t perf(int i)
+{
+    return addr_perf_counters[i];
+}
+
+// Ctrl write, then a read back: the load waits for the store to land, counting state is settled after it
+static uint32_t ctrl(uint32_t bits)
+{
+    *addr_perf_ctrl = bits;
+    return *addr_perf_ctrl;
+}
+
+static uint32_t check(void)
+{
+    // 1
+    if (ctrl(PERF_CTRL_RUN | PERF_CTRL_CLEAR) != 1)
+        return 1;
+    spin(16);
+    if ((ctrl(PERF_CTRL_CLEAR) != 1) || (perf(PERF_CYCLES) == 0))
+        return 1;
+    // 2
+    ctrl(PERF_CTRL_CLEAR);
+    spin(LOOP_ITER);
+    ctrl(PERF_CTRL_STOP);
+    uint32_t instret = perf(PERF_INSTRET);
+    uint32_t cycles  = perf(PERF_CYCLES);
+    if ((instret < 2 * LOOP_ITER) || (instret > 2 * LOOP_ITER + LOOP_SLACK) || (cycles < instret))
+        return 2;
+    // 3
+    spin(LOOP_ITER);
+    if ((perf(PERF_INSTRET) != instret) || (perf(PERF_CYCLES) != cycles) || (*addr_perf_ctrl != 0))
+        return 3;
+    // 4
+    if (ctrl(PERF_CTRL_CLEAR) != 0)
+        return 4;
+    spin(LOOP_ITER);
+    for (int i = 0; i <= PERF_SDRAM_REFRESH; i++)
+        if (perf(i))
+            return 4;
+    // 5
+    if (ctrl(PERF_CTRL_RUN) != 1)
+        return 5;
+    spin(LOOP_ITER);
+    ctrl(PERF_CTRL_STOP);
+    instret = perf(PERF_INSTRET);
+    if ((instret < 2 * LOOP_ITER) || (instret > 2 * LOOP_ITER + LOOP_SLACK) || (perf(PERF_CYCLES) < instret))
+        return 5;
+    return 0;
+}
+
+int main()
+{
+    marker(1);
+    uint32_t failed = check();
+    // Back to the reset state, running
+    ctrl(PERF_CTRL_RUN | PERF_CTRL_CLEAR);
+    marker(failed ? (0xf0 | failed) : 2);
+    while(1);
+}
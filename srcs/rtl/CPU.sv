@@ -51,6 +51,8 @@ module CPU (
     logic [1:0] m_mux_final_result_src;
     logic [1:0] w_mux_final_result_src;
     logic       mux_pc_src;
+    logic       e_branch;
+    logic       e_jump;
     logic [3:0] alu_control;
     logic [1:0] mask_type;
     logic       ext_type;
@@ -76,8 +78,18 @@ module CPU (
     logic [4:0] w_rd;
     logic [4:0] d_rs1;
     logic [4:0] d_rs2;
+    logic [4:0] d_rd;
+    logic       f_miss;
     logic [4:0] e_rd;
     logic       m_ack;
+    logic       m_hit;
+    logic       lsu_busy;
+    logic       lsu_ret;
+    logic [4:0] lsu_ret_rd;
+    logic       redirect;
+    logic       e_pred_taken;
+    logic       e_pred_target_match;
+    logic [3:0] perf_stall;
 
     // Hazard - Both
     logic       de_clr;
@@ -100,6 +112,8 @@ module CPU (
         .o_en_datamem_write(en_datamem_write),
         .o_w_mux_final_result_src(w_mux_final_result_src),
         .o_mux_pc_src(mux_pc_src),
+        .o_e_branch(e_branch),
+        .o_e_jump(e_jump),
         .o_alu_control(alu_control),
         .o_mask_type(mask_type),
         .o_ext_type(ext_type),
@@ -119,6 +133,8 @@ module CPU (
         .i_clk(i_clk),
         .i_rst(i_rst),
         .i_mux_pc_src(mux_pc_src),
+        .i_e_branch(e_branch),
+        .i_e_jump(e_jump),
         .i_en_regfile_write(en_regfile_write),
         .i_mux_immext_src(mux_immext_src),
         .i_mux_pc_adder_src(mux_pc_adder_src),
@@ -143,14 +159,24 @@ module CPU (
         .i_em_en(~em_stall),
         .i_mw_clr(mw_clr),
         .i_de_clr(de_clr),
+        .i_redirect(redirect),
         .o_e_rs1(e_rs1),
         .o_e_rs2(e_rs2),
         .o_m_rd(m_rd),
         .o_w_rd(w_rd),
         .o_d_rs1(d_rs1),
         .o_d_rs2(d_rs2),
+        .o_f_miss(f_miss),
+        .o_d_rd(d_rd),
         .o_e_rd(e_rd),
-        .o_m_ack(m_ack)
+        .o_m_ack(m_ack),
+        .o_m_hit(m_hit),
+        .o_lsu_busy(lsu_busy),
+        .o_lsu_ret(lsu_ret),
+        .o_lsu_ret_rd(lsu_ret_rd),
+        .o_e_pred_taken(e_pred_taken),
+        .o_e_pred_target_match(e_pred_target_match),
+        .i_perf_stall(perf_stall)
 `ifndef BRAM_AS_RAM
         ,
         .i_ram_clk(i_ram_clk),
@@ -194,19 +220,30 @@ module CPU (
         .o_data_mux_alu_forward_src_b(mux_alu_forward_src_b),
         .i_data_d_rs1(d_rs1),
         .i_data_d_rs2(d_rs2),
+        .i_data_f_miss(f_miss),
+        .i_data_d_rd(d_rd),
         .i_data_e_rd(e_rd),
         .i_data_m_bus_ack(m_ack),
+        .i_data_m_hit(m_hit),
+        .i_data_lsu_busy(lsu_busy),
+        .i_data_lsu_ret(lsu_ret),
+        .i_data_lsu_ret_rd(lsu_ret_rd),
         .i_ctrl_e_mux_final_result_src(e_mux_final_result_src),
         .i_ctrl_d_mux_alu_src_a(d_mux_alu_src_a),
         .i_ctrl_d_mux_alu_src_b(d_mux_alu_src_b),
         .i_ctrl_e_en_datamem_access(e_en_datamem_access),
+        .i_ctrl_m_en_datamem_access(en_datamem_access),
         .o_data_f_stall(f_stall),
         .o_data_fd_stall(fd_stall),
         .o_em_stall(em_stall),
         .o_mw_flush(mw_clr),
         .o_de_flush(de_clr),
         .i_ctrl_e_mux_pc_src(mux_pc_src),
-        .o_data_fd_flush(fd_clr) 
+        .i_data_e_pred_taken(e_pred_taken),
+        .i_data_e_pred_target_match(e_pred_target_match),
+        .o_data_redirect(redirect),
+        .o_data_fd_flush(fd_clr),
+        .o_perf_stall(perf_stall)
     );
 
 endmodule
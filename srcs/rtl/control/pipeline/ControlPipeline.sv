@@ -17,6 +17,9 @@ module ControlPipeline (
     output logic [1:0] o_w_mux_final_result_src,
     // See branchDecoder
     output logic       o_mux_pc_src,
+    // Exec instr kind, for branch predictor update
+    output logic       o_e_branch,
+    output logic       o_e_jump,
     // See aluDecoder
     output logic [3:0] o_alu_control,
     // See dataMaskDecoder
@@ -126,6 +129,9 @@ module ControlPipeline (
         .o_jump(d_jump)
     );
 
+    assign o_e_branch = e_branch;
+    assign o_e_jump   = e_jump;
+
     // Taken out of control block due to pipelining
     BranchDecoder branchDecoder (
         .alu_flags(i_alu_flags),
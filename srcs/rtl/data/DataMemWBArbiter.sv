@@ -74,6 +74,8 @@ module DataMemWBArbiter #(
         end
     end
     
+    // Ownership only moves when the owner drops cyc. A pipelined master keeps cyc high until
+    // its last outstanding ack, so acks always go back to whoever sent the requests
     // Generate if does not work with non-parameter
     // also not work with break
     // https://stackoverflow.com/questions/63463776/the-generate-if-condition-must-be-a-constant-expression
@@ -1,5 +1,10 @@
 // Address check will be done at interconnect, not here
-module DataMemWBMaster (
+// Wishbone B4 pipelined: a new request can go out every cycle while earlier ones wait for their ack,
+// up to WB_O_MAX_OUTSTANDING in flight. Acks come back in order, so mem side just counts them.
+// WB_O_MAX_OUTSTANDING = 1 is the old behaviour, one request then wait for ack.
+module DataMemWBMaster #(
+    parameter WB_O_MAX_OUTSTANDING = 16
+) (
     input  logic        i_clk,
     input  logic        i_rst,
     // Interconnect
@@ -18,10 +23,13 @@ module DataMemWBMaster (
     input  logic        i_wb_ack,
     input  logic        i_wb_err,
     // Mem Interface
+    // A request is taken on every cycle i_mem_en is high and o_mem_stall is low,
+    // so en is a 1 cycle pulse per request (held only while stalled), NOT held until ack
     input  logic        i_mem_en,
     input  logic        i_mem_we,
     input  logic [31:0] i_mem_addr, i_mem_wd,
     input  logic [1:0]  i_mem_mask_type,  // 00: byte, 01: halfword, 10: word
+    output logic        o_mem_stall,
     output logic        o_mem_ack,
     output logic        o_mem_err,
     output logic [31:0] o_mem_rd
@@ -34,6 +42,8 @@ module DataMemWBMaster (
     // output logic        o_wb_lock
 );
 
+    localparam INFLIGHTWIDTH = $clog2(WB_O_MAX_OUTSTANDING + 1);
+
     // ==============================================================
 
     // sel decode
@@ -44,45 +54,28 @@ module DataMemWBMaster (
 
     // ==============================================================
 
-    /* Master state machine:
-     * - IDLE: setup cyc and stb, initiate request
-     * - REQUEST: wait until stall is low -> means client accept
-     * - WAIT: wait until ack? if wait then what is the point of pipelined mode
+    /* No state machine anymore, stb / addr / data / we / sel is a 1 entry request register:
+     * - loaded from mem side when it is free or being taken by the slave this cycle
+     * - emptied (stb low) when the slave take it (stb & ~stall) and nothing new comes in
+     * _inflight counts requests taken by the slave still waiting for ack,
+     * cyc stays high until the last of them is acked.
      */
-    typedef enum logic [1:0] {IDLE, REQUEST, WAIT} _bus_master_state_t;
-    _bus_master_state_t _state;
+    logic [INFLIGHTWIDTH - 1 : 0] _inflight, _inflight_next;
+    logic _accept;  // slave takes the request on the bus this cycle
+    logic _new_req; // mem side request taken this cycle
 
-    always_ff @(posedge i_clk) begin : wb_state_machine
-        // WB spec demands synchronous reset
-        // Also reset bus interface on error?
-        if (~i_rst | i_wb_err)
-            _state <= IDLE;
-        else begin
-            case (_state)
-                IDLE: begin
-                    if (i_mem_en)
-                        _state <= REQUEST;
-                end
-                REQUEST: begin
-                    if (!i_wb_stall) begin
-                        if (i_wb_ack)
-                            _state <= IDLE;
-                        else
-                            // in normal pipelined you dont change to wait
-                            // as master does not matter much, only send 1 request then w8 for ack
-                            // also stay in request state until you want to quit
-                            _state <= WAIT;
-                    end
-                end
-                WAIT: begin
-                    if (i_wb_ack)
-                        _state <= IDLE;
-                end
-                default: begin
-                    _state <= IDLE;
-                end 
-            endcase
-        end
+    assign _accept  = o_wb_stb & ~i_wb_stall;
+    assign _new_req = i_mem_en & ~o_mem_stall;
+
+    // Ack not counted here, keeps stall off the slave ack path. Costs 1 cycle when at max
+    assign o_mem_stall = (o_wb_stb & i_wb_stall) | ((_inflight + o_wb_stb) >= WB_O_MAX_OUTSTANDING);
+
+    always_comb begin : inflight_next
+        case ({_accept, i_wb_ack})
+            2'b10:   _inflight_next = _inflight + 1;
+            2'b01:   _inflight_next = _inflight - 1;
+            default: _inflight_next = _inflight;
+        endcase
     end
 
     // ==============================================================
@@ -90,52 +83,32 @@ module DataMemWBMaster (
     // These 2 signals facilitates control
     always_ff @(posedge i_clk) begin : wb_strobe
         // WB spec demands synchronous reset
-        // Also reset bus interface on error?
+        // Also reset bus interface on error, requests still in flight are dropped
         if (~i_rst | i_wb_err) begin
             // Only cyc and stb must be negated, all others undefined
-            o_wb_cyc <= 1'b0;
-            o_wb_stb <= 1'b0;
-            // what else
+            o_wb_cyc  <= 1'b0;
+            o_wb_stb  <= 1'b0;
+            _inflight <=  'h0;
         end
         else begin
-            case (_state)
-                IDLE: begin
-                    if (i_mem_en) begin
-                        o_wb_cyc <= 1'b1;
-                        o_wb_stb <= 1'b1;
-                    end
-                end
-                REQUEST: begin
-                    if (!i_wb_stall) begin
-                        o_wb_stb <= 1'b0; // Only 1 access then change state to wait / idle
-                        if (i_wb_ack)     // if access is combinational
-                            o_wb_cyc <= 1'b0;
-                    end
-                end
-                WAIT: begin
-                    if (i_wb_ack)
-                        o_wb_cyc <= 1'b0;
-                end
-                default: begin /* do nothing */ end
-            endcase
+            _inflight <= _inflight_next;
+            if (_new_req)
+                o_wb_stb <= 1'b1;
+            else if (_accept)
+                o_wb_stb <= 1'b0;
+            o_wb_cyc <= _new_req | (o_wb_stb & ~_accept) | (_inflight_next != 'h0);
         end
     end
 
     // ==============================================================
 
-    // Have to change when support multi cycle r/w
     always @(posedge i_clk) begin : wb_on_new_req
-        case (_state)
-        IDLE: begin
-            if (i_mem_en) begin
-                o_wb_we   <= i_mem_we;
-                o_wb_data <= i_mem_wd;
-                o_wb_addr <= i_mem_addr;
-                o_wb_sel  <= _sel; 
-            end
+        if (_new_req) begin
+            o_wb_we   <= i_mem_we;
+            o_wb_data <= i_mem_wd;
+            o_wb_addr <= i_mem_addr;
+            o_wb_sel  <= _sel; 
         end
-        default: begin /* do nothing */ end
-        endcase
     end
 
     // ==============================================================
@@ -21,14 +21,13 @@ module InstrMemory #(
     // Memory initialization, yosys can synthesize readmem, but can't handle DPI-C
     // So stick with static name, verilator exe need to be run from make dir
 `ifdef VERILATOR
-    // Redefined error, so create a wrapper then call from it
-    // Provide ROMFILE as env when running verilator binary
-    import "DPI-C" function string fetchenv(input string env_name);
-    string ROMFILE;
+    // Harness loads the firmware (env ROMFILE, ELF or rom.txt) and hands the words over,
+    // no hex parsing here. Word idx = ROM_START_ADDR + idx * 4
+    import "DPI-C" function int romImageWord(input int idx);
     initial begin
-        ROMFILE = fetchenv("ROMFILE");
-        $readmemh(ROMFILE,ROM);
-    end 
+        for (int i = 0; i <= ARRAYSIZE; i++)
+            ROM[i] = romImageWord(i);
+    end
 `else
     /*
     import "DPI-C" function string getenv(input string env_name);
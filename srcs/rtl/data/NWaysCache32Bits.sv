@@ -0,0 +1,825 @@
+/* N ways cache data sructure, N = 1 (direct mapped), 2, 4, 8
+ * a set = [[valid1][dirty1][tag1][block1] | ... | [validN][dirtyN][tagN][blockN] | [PLRU tree]]
+ * ...
+ * Address resolution
+ * [tag_addr][set_addr][[data_unit_addr][byte_addr]]
+ * [[data_unit_addr][byte_addr]] = CACHE_DATA_ADDR_WIDTH_BIT
+ * data_unit = 4 bytes data block
+ * ...
+ * Metadata:
+ *  - Tags of a whole set are one word in a BRAM (the big part, N * tag bits per set)
+ *  - Valid / dirty / PLRU bits stay in flops: small, need rst, and get updated on every hit
+ *  - Tag BRAM reads on the edge BEFORE the request shows up, addr from i_m_next_addr (what the master will
+ *    most likely present next cycle), so hit is still known in the cycle the request is here.
+ *    If the set looked up is not the one of the request (guess wrong, or tags were just written) the request
+ *    is stalled one cycle and looked up again from i_m_addr
+ * ...
+ * Replacement: tree PLRU, N - 1 bits per set. Node i has children 2i + 1 (bit = 0) and 2i + 2 (bit = 1),
+ * bits point to the side to replace, an access flips the bits on its path away from it.
+ * Invalid ways are filled first. Direct mapped has no tree, the victim is the block of the set
+ * ...
+ * Slave side is pipelined, en is high for 1 cycle per request (longer only when stalled),
+ * acks come back in order. A miss streams the whole block through it, see miss states
+ * ...
+ * Miss path:
+ *  - Refill is critical word first: requests start at the missed word and wrap around the block,
+ *    master is acked as soon as that word is back, rest of the block streams in behind it
+ *  - A dirty victim is copied into the write-back buffer (cache mem -> flops, 1 word / cycle),
+ *    refill starts right after, the buffer drains on the bus once the refill is done while hits go on
+ *  - Cache still only takes a new request in IDLE, and a miss waits there until the buffer is empty
+ * ...
+ * Master side handshake is the same as the slave side: request is taken on the cycle en is high and
+ * o_m_stall is low, master must not hold it after that. Ack comes later, in order.
+ * A hit drives cache mem straight from the request, so it is taken and acked on the next cycle
+ * (o_m_hit tells the master that), one hit per cycle back to back
+ */
+
+module NWaysCache32Bits #(
+    parameter   CACHE_O_CAPACITY_BYTE     = 8192, // divisible by block size
+    parameter   CACHE_O_BLOCK_SIZE_BYTE   = 64,   // divisible by 32
+    parameter   CACHE_O_WAYS              = 2,    // 1, 2, 4, 8. At least 4 sets
+
+    localparam  CACHE_BLOCK_PER_SET       = CACHE_O_WAYS,
+    localparam  CACHE_N_BLOCK             = CACHE_O_CAPACITY_BYTE / CACHE_O_BLOCK_SIZE_BYTE, // default: 128
+    localparam  CACHE_N_SET               = CACHE_N_BLOCK / CACHE_BLOCK_PER_SET,             // default: 64
+    localparam  CACHE_N_DWORD             = CACHE_O_BLOCK_SIZE_BYTE / 4,                     // default: 16
+
+    // For a given addr when access the cache from CPU side, addr decodes to:
+    // [ADDR] = [TAG][SET ADDR][DATA ADDR]
+    // [DATA ADDR] = [DWORD ADDR] + 2 bit byte addressing
+    localparam  CACHE_DATA_ADDR_WIDTH_BIT = $clog2(CACHE_O_BLOCK_SIZE_BYTE - 1), // default: 6
+    localparam  CACHE_DWORD_ADDR_WIDTH_BIT= $clog2(CACHE_N_DWORD - 1),           // default: 4
+    localparam  CACHE_SET_ADDR_WIDTH_BIT  = $clog2(CACHE_N_SET - 1),             // default: 6
+    // Hard to expand with arbitrary width, so lock to 32 bits
+    localparam  CACHE_TAG_WIDTH_BIT       = 32 - CACHE_DATA_ADDR_WIDTH_BIT - CACHE_SET_ADDR_WIDTH_BIT, // default: 20
+
+    // PLRU tree depth, 0 when direct mapped. Way index is at least 1 bit wide
+    localparam  CACHE_PLRU_LEVELS         = $clog2(CACHE_BLOCK_PER_SET),                     // default: 1
+    localparam  CACHE_WAY_WIDTH_BIT       = (CACHE_PLRU_LEVELS > 0) ? CACHE_PLRU_LEVELS : 1, // default: 1
+    localparam  CACHE_PLRU_WIDTH_BIT      = (CACHE_BLOCK_PER_SET > 1) ? CACHE_BLOCK_PER_SET - 1 : 1,
+    localparam  CACHE_SET_TAGS_WIDTH_BIT  = CACHE_BLOCK_PER_SET * CACHE_TAG_WIDTH_BIT     // default: 40
+) (
+    input  logic        i_clk,
+    input  logic        i_rst,
+    // ==================================================
+    // Memory interface from master
+    input  logic        i_m_en,
+    input  logic        i_m_we,
+    input  logic [31:0] i_m_addr,
+    input  logic [31:0] i_m_data,
+    input  logic [1:0]  i_m_mask_type,  // 00: byte, 01: halfword, 10: word
+    input  logic [31:0] i_m_next_addr,  // guess of next cycle i_m_addr, tags are looked up with it
+    output logic        o_m_stall,      // request not taken, hold en
+    output logic        o_m_hit,        // request taken and will be acked next cycle
+    output logic        o_m_miss,       // request taken, refill started (perf counters)
+    output logic        o_m_ack,
+    output logic        o_m_err,
+    output logic [31:0] o_m_data,
+
+    // ==================================================
+    // Memory interface to slave bus
+    output logic        o_s_en,
+    output logic        o_s_we,
+    output logic [31:0] o_s_addr,
+    output logic [31:0] o_s_data,
+    output logic [1:0]  o_s_mask_type,  // 00: byte, 01: halfword, 10: word
+    input  logic        i_s_stall,      // request not taken, hold en
+    input  logic        i_s_ack,
+    input  logic        i_s_err,
+    input  logic [31:0] i_s_data,
+    output logic        o_s_busy        // bus in use by cache (refill / drain), master can be acked before it ends
+);
+
+    // Small metadata, flops
+    logic                                _cache_metadata_valid_bit    [CACHE_N_SET - 1 : 0][CACHE_BLOCK_PER_SET - 1 : 0];
+    logic                                _cache_metadata_dirty_bit    [CACHE_N_SET - 1 : 0][CACHE_BLOCK_PER_SET - 1 : 0];
+    logic [CACHE_PLRU_WIDTH_BIT - 1 : 0] _cache_metadata_set_plru     [CACHE_N_SET - 1 : 0];
+
+    // Tags, BRAM, one word per set: [tagN]...[tag1], see cache_tag_lookup
+    logic                                    _cache_tag_i_we;
+    logic [CACHE_SET_ADDR_WIDTH_BIT - 1 : 0] _cache_tag_i_addr;
+    logic [CACHE_SET_TAGS_WIDTH_BIT - 1 : 0] _cache_tag_i_data;
+    logic [CACHE_SET_TAGS_WIDTH_BIT - 1 : 0] _cache_tag_o_data;
+
+    BRAMVarWidth #(
+        .WIDTH_BITS(CACHE_SET_TAGS_WIDTH_BIT),
+        .SIZE_BITS(CACHE_SET_TAGS_WIDTH_BIT * CACHE_N_SET)
+    ) _cache_tag (
+        .i_clk (i_clk),
+        .i_en  (1'b1),
+        .i_we  (_cache_tag_i_we),
+        .i_addr(_cache_tag_i_addr),
+        .i_wd  (_cache_tag_i_data),
+        .o_rd  (_cache_tag_o_data)
+    );
+
+    // To access data in this implementation set addr = {set, block/way, byte_addr}
+    // This cache bus is only 32 bits, there is no parallel reading / writing to different
+    // cache block, one BRAM for all ways
+
+    logic [31:0] _cache_data_i_addr;
+    logic        _cache_data_i_en;
+    logic        _cache_data_i_we;
+    logic [1:0]  _cache_data_i_mask;
+    logic [31:0] _cache_data_i_data;
+    logic [31:0] _cache_data_o_data;
+    logic        _cache_data_o_ack;
+    logic        _cache_data_o_err;
+
+    // ADDR to access internal cache data is a little different compare to main input addr:
+    // [CACHE ADDR] = [SET ADDR][BLOCK ADDR / WAY][DATA ADDR]
+    // [SET ADDR], [DATA ADDR] are the same as the main addr
+    // [BLOCK ADDR / WAY] is log2(N) bits, none when direct mapped so it is added instead of concatenated
+
+    logic [CACHE_SET_ADDR_WIDTH_BIT  - 1 : 0] _cache_data_addr_set;
+    logic [CACHE_WAY_WIDTH_BIT       - 1 : 0] _cache_data_addr_block;
+    logic [CACHE_DATA_ADDR_WIDTH_BIT - 1 : 0] _cache_data_addr_byte;
+
+    assign _cache_data_i_addr = (((32'(_cache_data_addr_set) * CACHE_BLOCK_PER_SET) + 32'(_cache_data_addr_block))
+                                 << CACHE_DATA_ADDR_WIDTH_BIT) | 32'(_cache_data_addr_byte);
+
+    // Miss path drives cache mem from registers (copy reads, fill writes), see cache_backing_mem_input
+    // a hit drives it straight from the request, see cache_backing_mem_input_mux
+    logic [CACHE_SET_ADDR_WIDTH_BIT  - 1 : 0] _miss_mem_addr_set;
+    logic [CACHE_WAY_WIDTH_BIT       - 1 : 0] _miss_mem_addr_block;
+    logic [CACHE_DATA_ADDR_WIDTH_BIT - 1 : 0] _miss_mem_addr_byte;
+    logic                                     _miss_mem_en;
+    logic                                     _miss_mem_we;
+    logic [1:0]                               _miss_mem_mask;
+    logic [31:0]                              _miss_mem_data;
+
+    BRAMArray32Bits #(
+        .SIZE_BYTE(CACHE_O_CAPACITY_BYTE)
+    ) _cache_data (
+        .i_clk      (i_clk),
+        .i_addr     (_cache_data_i_addr),
+        .i_en       (_cache_data_i_en),
+        .i_we       (_cache_data_i_we),
+        .i_mask_type(_cache_data_i_mask),
+        .i_data     (_cache_data_i_data),
+        .o_data     (_cache_data_o_data),
+        .o_ack      (_cache_data_o_ack),
+        .o_err      (_cache_data_o_err)
+    );
+
+    // ==================================================================================
+    // Tree PLRU
+    // Way to replace: follow the bits from the root
+    function automatic logic [CACHE_WAY_WIDTH_BIT - 1 : 0] plru_victim(input logic [CACHE_PLRU_WIDTH_BIT - 1 : 0] tree);
+        int node;
+        node        = 0;
+        plru_victim = 'h0;
+        for (int l = 0; l < CACHE_PLRU_LEVELS; l++) begin
+            plru_victim[CACHE_PLRU_LEVELS - 1 - l] = tree[node];
+            node = 2 * node + 1 + int'(tree[node]);
+        end
+    endfunction
+
+    // Way accessed: bits on its path point to the other side
+    function automatic logic [CACHE_PLRU_WIDTH_BIT - 1 : 0] plru_touch(input logic [CACHE_PLRU_WIDTH_BIT - 1 : 0] tree,
+                                                                       input logic [CACHE_WAY_WIDTH_BIT  - 1 : 0] way);
+        int node;
+        node       = 0;
+        plru_touch = tree;
+        for (int l = 0; l < CACHE_PLRU_LEVELS; l++) begin
+            plru_touch[node] = ~way[CACHE_PLRU_LEVELS - 1 - l];
+            node = 2 * node + 1 + int'(way[CACHE_PLRU_LEVELS - 1 - l]);
+        end
+    endfunction
+
+    // ==================================================================================
+    // Addr decomposition
+    logic [CACHE_TAG_WIDTH_BIT        - 1 : 0]  i_m_tag;
+    logic [CACHE_SET_ADDR_WIDTH_BIT   - 1 : 0]  i_m_addr_set;
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0]  i_m_addr_word;
+    logic [1:0]                                 i_m_addr_byte;
+    assign {i_m_tag, i_m_addr_set, i_m_addr_word, i_m_addr_byte} = i_m_addr;
+
+    logic [CACHE_SET_ADDR_WIDTH_BIT   - 1 : 0]  i_m_next_addr_set;
+    assign i_m_next_addr_set = i_m_next_addr[CACHE_DATA_ADDR_WIDTH_BIT +: CACHE_SET_ADDR_WIDTH_BIT];
+
+    // ==================================================================================
+    // Signals from inputs
+
+    // Tags out of BRAM are for the request set, else stall and look up again
+    logic                                    _lookup_valid;    // no tag write on the last edge
+    logic [CACHE_SET_ADDR_WIDTH_BIT - 1 : 0] _lookup_addr_set; // set read on the last edge
+    logic                                    i_lookup_ready;
+    assign i_lookup_ready = _lookup_valid & (_lookup_addr_set == i_m_addr_set);
+
+    // Cache hit signals, N ways
+    // Case of ~hit will need to & with i_m_en to confirm that enable is high
+    logic                               i_hit;
+    logic [CACHE_WAY_WIDTH_BIT - 1 : 0] i_hit_way;
+    always_comb begin : hit_way
+        i_hit     = 1'b0;
+        i_hit_way = 'h0;
+        // Hit for a given way: valid & tag matches
+        for (int w = 0; w < CACHE_BLOCK_PER_SET; w++) begin
+            if (_cache_metadata_valid_bit[i_m_addr_set][w] &
+                (i_m_tag == _cache_tag_o_data[w * CACHE_TAG_WIDTH_BIT +: CACHE_TAG_WIDTH_BIT])) begin
+                i_hit     = 1'b1;
+                i_hit_way = CACHE_WAY_WIDTH_BIT'(w);
+            end
+        end
+    end
+
+    // Victim: first invalid way, PLRU one when the set is full
+    // Direct mapped: always way 0, PLRU functions would index bit -1 of the way, keep them out
+    logic [CACHE_WAY_WIDTH_BIT - 1 : 0] i_victim;
+    generate
+        if (CACHE_BLOCK_PER_SET == 1) begin : victim_way_direct
+            assign i_victim = 'h0;
+        end
+        else begin : victim_way_plru
+            always_comb begin : victim_way
+                i_victim = plru_victim(_cache_metadata_set_plru[i_m_addr_set]);
+                for (int w = CACHE_BLOCK_PER_SET - 1; w >= 0; w--) begin
+                    if (~_cache_metadata_valid_bit[i_m_addr_set][w])
+                        i_victim = CACHE_WAY_WIDTH_BIT'(w);
+                end
+            end
+        end
+    endgenerate
+
+    // ==================================================================================
+    // STATE MACHINE
+    typedef enum logic [1:0] {   // Wait for request, hits are served here
+                                STATE_IDLE, // 00
+                                // Error on R/W external bus landed here
+                                STATE_ERR, // 01
+                                // ==============================
+                                // Miss states
+                                // Victim dirty: copy old block into write-back buffer, one word per cycle
+                                STATE_MISS_COPY, // 10
+                                // Read new block, all requests back to back, each ack written into cache mem
+                                // master acked on the first (critical) one
+                                STATE_MISS_FILL  // 11
+                            } _state_t;
+    _state_t _state;
+
+    // ==================================================================================
+    // Write-back buffer, one block
+    // Filled in STATE_MISS_COPY, drained with posted writes when the bus is not used by a refill.
+    // No miss is taken while it holds a block, so a refill never reads stale data from memory
+    // and refill / drain never share the bus
+    logic [31:0]                               _wbuf_data [CACHE_N_DWORD - 1 : 0];
+    logic [CACHE_TAG_WIDTH_BIT      - 1 : 0]   _wbuf_tag;
+    logic [CACHE_SET_ADDR_WIDTH_BIT - 1 : 0]   _wbuf_addr_set;
+    logic                                      _wbuf_valid;    // holds a block not written back yet
+    logic                                      _wbuf_draining; // its writes are on the bus
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _wbuf_req_cnt;
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _wbuf_ack_cnt;
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _wbuf_req_cnt_p1;
+    logic                                      _wbuf_req_last, _wbuf_ack_last;
+    logic                                      _wbuf_drain_start;
+
+    assign _wbuf_req_cnt_p1  = _wbuf_req_cnt + 1;
+    assign _wbuf_req_last    = &_wbuf_req_cnt;
+    assign _wbuf_ack_last    = &_wbuf_ack_cnt;
+    // Refill done (or never started), bus is free
+    assign _wbuf_drain_start = _wbuf_valid & ~_wbuf_draining &
+                               (_state != STATE_MISS_FILL) & (_state != STATE_ERR);
+
+    // Request taken in IDLE with its tags looked up: hits always, misses only with an empty buffer
+    logic  _m_take, _m_take_hit;
+    assign _m_take     = i_m_en & (_state == STATE_IDLE) & i_lookup_ready & (i_hit | ~_wbuf_valid);
+    assign _m_take_hit = _m_take & i_hit;
+    assign o_m_stall   = ~_m_take;
+    assign o_m_hit     = _m_take_hit;
+    assign o_m_miss    = _m_take & ~i_hit;
+
+    // Miss counters, see cache_miss_counters
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_req_cnt; // next word to request from slave
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_ack_cnt; // next word to be acked
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_req_cnt_p1;
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_ack_cnt_p1;
+    logic                                      _miss_req_last, _miss_ack_last;
+    logic                                      _miss_fill_done; // last word of new block written into cache mem
+
+    assign _miss_req_cnt_p1 = _miss_req_cnt + 1;
+    assign _miss_ack_cnt_p1 = _miss_ack_cnt + 1;
+    assign _miss_req_last   = &_miss_req_cnt;
+    assign _miss_ack_last   = &_miss_ack_cnt;
+
+    // Critical word first: counters are offsets from the missed word, wrap around the block
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_req_word_p1;
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_ack_word;
+    logic                                      _miss_ack_critical;
+
+    // Slave took the request this cycle
+    logic _s_accept;
+    assign _s_accept = o_s_en & ~i_s_stall;
+
+    // Block to be replaced needs write back
+    logic  i_victim_dirty;
+    assign i_victim_dirty = _cache_metadata_valid_bit[i_m_addr_set][i_victim] &
+                            _cache_metadata_dirty_bit[i_m_addr_set][i_victim];
+
+    // Fill done and last cache mem write went through, back to IDLE
+    // master already got its ack with the critical word
+    logic  _miss_done;
+    assign _miss_done = _miss_fill_done & ~_miss_mem_en;
+
+    assign o_s_busy = o_s_en | _wbuf_draining | (_state == STATE_MISS_FILL);
+
+    always_ff @(posedge i_clk) begin : state_machine
+        if (~i_rst) begin
+            _state <= STATE_IDLE;
+        end
+        else if (_wbuf_draining & i_s_err) begin
+            _state <= STATE_ERR;
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    // Hit: stay, next request can come right away
+                    if (_m_take & ~i_hit) begin
+                        if (i_victim_dirty) begin
+                            _state <= STATE_MISS_COPY;
+                        end
+                        else begin
+                            _state <= STATE_MISS_FILL;
+                        end
+                    end
+                end
+                STATE_ERR: begin
+                    /* Do nothing, TODO? */
+                end
+                // ==============================
+                // Miss sub-state-machine entry
+                // Need to fetch (and replace) data in cache
+                STATE_MISS_COPY: begin
+                    if (_cache_data_o_ack & _miss_ack_last) begin
+                        _state <= STATE_MISS_FILL;
+                    end
+                end
+                STATE_MISS_FILL: begin
+                    if (i_s_err) begin
+                        _state <= STATE_ERR;
+                    end
+                    else if (_miss_done) begin
+                        _state <= STATE_IDLE;
+                    end
+                end
+            endcase
+        end
+    end
+
+    // ==================================================================================
+    // Latching_request
+    // Whole set of tags kept too, new tag is merged into it when the fill is done
+    logic                                    _m_en, _m_we;
+    logic [31:0]                             _m_addr, _m_data;
+    logic [1:0]                              _m_mask_type;
+    logic [CACHE_WAY_WIDTH_BIT      - 1 : 0] _victim;
+    logic [CACHE_SET_TAGS_WIDTH_BIT - 1 : 0] _m_set_tags;
+
+    always_ff @(posedge i_clk) begin : latch_request
+        if (~i_rst) begin
+            _m_en        <= 1'b0;
+            _m_we        <= 1'b0;
+            _m_addr      <= 32'h0;
+            _m_data      <= 32'h0;
+            _m_mask_type <= 2'b0;
+            _victim      <=  'h0;
+            _m_set_tags  <=  'h0;
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    if (_m_take & ~i_hit) begin
+                        _m_en        <= i_m_en;
+                        _m_we        <= i_m_we;
+                        _m_addr      <= i_m_addr;
+                        _m_data      <= i_m_data;
+                        _m_mask_type <= i_m_mask_type;
+                        _victim      <= i_victim;
+                        _m_set_tags  <= _cache_tag_o_data;
+                    end
+                end
+            endcase
+        end
+    end
+
+    // Addr decomposition
+    logic [CACHE_TAG_WIDTH_BIT        - 1 : 0]  _m_tag;
+    logic [CACHE_SET_ADDR_WIDTH_BIT   - 1 : 0]  _m_addr_set;
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0]  _m_addr_word;
+    logic [1:0]                                 _m_addr_byte;
+    assign {_m_tag, _m_addr_set, _m_addr_word, _m_addr_byte} = _m_addr;
+
+    assign _miss_req_word_p1  = _m_addr_word + _miss_req_cnt_p1;
+    assign _miss_ack_word     = _m_addr_word + _miss_ack_cnt;
+    assign _miss_ack_critical = (_miss_ack_cnt == 'h0);
+
+    // Cache mem byte lanes: byte 0 of a word is [31:24], see BRAMArray32Bits
+    // Readout of a dword the way cache mem would return it for the access
+    function automatic logic [31:0] dword_readout(input logic [31:0] word, input logic [1:0] mask_type,
+                                                  input logic [1:0] byte_addr);
+        case (mask_type)
+            2'b00:   dword_readout = {24'b0, word[{~byte_addr, 3'b000} +: 8]};
+            2'b01:   dword_readout = {16'b0, word[{~byte_addr[1], 4'b0000} +: 16]};
+            default: dword_readout = word;
+        endcase
+    endfunction
+
+    // Store merged into a dword
+    function automatic logic [31:0] dword_merge(input logic [31:0] word, input logic [31:0] data,
+                                                input logic [1:0] mask_type, input logic [1:0] byte_addr);
+        dword_merge = word;
+        case (mask_type)
+            2'b00:   dword_merge[{~byte_addr, 3'b000} +: 8]     = data[7:0];
+            2'b01:   dword_merge[{~byte_addr[1], 4'b0000} +: 16] = data[15:0];
+            default: dword_merge = data;
+        endcase
+    endfunction
+
+    // ==================================================================================
+    // Tag lookup
+    // Read every cycle for next cycle's request:
+    //  - request here and not taken: same one again
+    //  - otherwise: master's guess
+    // Fill done writes the new tag, nothing is read on that edge
+    assign _cache_tag_i_we   = (_state == STATE_MISS_FILL) & _miss_done;
+    assign _cache_tag_i_addr = _cache_tag_i_we      ? _m_addr_set  :
+                               (i_m_en & ~_m_take)  ? i_m_addr_set :
+                                                      i_m_next_addr_set;
+    always_comb begin : cache_tag_write_data
+        _cache_tag_i_data = _m_set_tags;
+        _cache_tag_i_data[_victim * CACHE_TAG_WIDTH_BIT +: CACHE_TAG_WIDTH_BIT] = _m_tag;
+    end
+
+    always_ff @(posedge i_clk) begin : cache_tag_lookup
+        if (~i_rst) begin
+            _lookup_valid    <= 1'b0;
+            _lookup_addr_set <=  'h0;
+        end
+        else begin
+            _lookup_valid    <= ~_cache_tag_i_we;
+            _lookup_addr_set <= _cache_tag_i_addr;
+        end
+    end
+
+    // ==================================================================================
+    // OUTPUT to cache memory
+    // Hit goes in the same cycle it is taken, cache mem is not used by the miss path in IDLE
+    always_comb begin : cache_backing_mem_input_mux
+        if (_m_take_hit) begin
+            _cache_data_addr_set   = i_m_addr_set;
+            _cache_data_addr_block = i_hit_way;
+            _cache_data_addr_byte  = {i_m_addr_word, i_m_addr_byte};
+            _cache_data_i_en       = 1'b1;
+            _cache_data_i_we       = i_m_we;
+            _cache_data_i_mask     = i_m_mask_type;
+            _cache_data_i_data     = i_m_data;
+        end
+        else begin
+            _cache_data_addr_set   = _miss_mem_addr_set;
+            _cache_data_addr_block = _miss_mem_addr_block;
+            _cache_data_addr_byte  = _miss_mem_addr_byte;
+            _cache_data_i_en       = _miss_mem_en;
+            _cache_data_i_we       = _miss_mem_we;
+            _cache_data_i_mask     = _miss_mem_mask;
+            _cache_data_i_data     = _miss_mem_data;
+        end
+    end
+
+    always_ff @(posedge i_clk) begin : cache_backing_mem_input
+        if (~i_rst) begin
+            _miss_mem_en <= 1'b0;
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    if (_m_take & ~i_hit) begin
+                        // For the case victim is dirty and need to eject old data, read old block data, started at 0,
+                        // into the write-back buffer. If not dirty then only have to wait for external memory
+                        // Technically we check for dirty here but since getting data from cache is short
+                        // we hit it any way, less comb logic.
+                        _miss_mem_addr_set   <= i_m_addr_set;
+                        _miss_mem_addr_block <= i_victim;
+                        _miss_mem_addr_byte  <= 'h0;
+                        _miss_mem_en         <= 1'b1;
+                        _miss_mem_we         <= 1'b0;  // read first
+                        _miss_mem_mask       <= 2'b10; // dword
+                    end
+                end
+                // Entry to miss states
+                STATE_MISS_COPY: begin
+                    // One read per cycle, cache mem is not used by anything else
+                    if (~_miss_req_last) begin
+                        _miss_mem_addr_byte  <= {_miss_req_cnt_p1, 2'b00};
+                        _miss_mem_en         <= 1'b1;
+                    end
+                    else begin
+                        _miss_mem_en         <= 1'b0;
+                    end
+                end
+                STATE_MISS_FILL: begin
+                    if (i_s_ack) begin
+                        // Write new data as it comes, acks are in request order
+                        // Store miss goes into the critical word on the way in
+                        _miss_mem_addr_set   <= _m_addr_set;
+                        _miss_mem_addr_block <= _victim;
+                        _miss_mem_addr_byte  <= {_miss_ack_word, 2'b00};
+                        _miss_mem_en         <= 1'b1;
+                        _miss_mem_we         <= 1'b1;
+                        _miss_mem_mask       <= 2'b10; // dword
+                        _miss_mem_data       <= (_miss_ack_critical & _m_we) ?
+                                                dword_merge(i_s_data, _m_data, _m_mask_type, _m_addr_byte) :
+                                                i_s_data;
+                    end
+                    else begin
+                        _miss_mem_en         <= 1'b0;
+                    end
+                end
+            endcase
+        end
+    end
+
+    // ==================================================================================
+    // Cache miss counters
+    // Requests and acks are counted separately since up to a whole block can be in flight
+    always_ff @(posedge i_clk) begin : cache_miss_counters
+        if (~i_rst) begin
+            _miss_req_cnt   <=  'h0;
+            _miss_ack_cnt   <=  'h0;
+            _miss_fill_done <= 1'b0;
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    if (_m_take) begin
+                        _miss_req_cnt   <=  'h0;
+                        _miss_ack_cnt   <=  'h0;
+                        _miss_fill_done <= 1'b0;
+                    end
+                end
+                // req: cache mem reads, ack: words read out
+                STATE_MISS_COPY: begin
+                    if (~_miss_req_last) begin
+                        _miss_req_cnt <= _miss_req_cnt_p1;
+                    end
+                    if (_cache_data_o_ack) begin
+                        // wraps to 0 on the last one, ready for fill
+                        _miss_ack_cnt <= _miss_ack_cnt_p1;
+                        if (_miss_ack_last) begin
+                            _miss_req_cnt <= 'h0;
+                        end
+                    end
+                end
+                STATE_MISS_FILL: begin
+                    if (_s_accept & ~_miss_req_last) begin
+                        _miss_req_cnt <= _miss_req_cnt_p1;
+                    end
+                    if (i_s_ack) begin
+                        _miss_ack_cnt <= _miss_ack_cnt_p1;
+                        if (_miss_ack_last) begin
+                            _miss_fill_done <= 1'b1;
+                        end
+                    end
+                end
+            endcase
+        end
+    end
+
+    // ==================================================================================
+    // OUTPUT to slave bus
+    always_ff @(posedge i_clk) begin : cache_slave_bus_mem_output
+        if (~i_rst) begin
+            o_s_en        <= 'h0;
+            o_s_we        <= 'h0;
+            o_s_addr      <= 'h0;
+            o_s_data      <= 'h0;
+            o_s_mask_type <= 'h0;
+        end
+        // Write-back buffer drain, whole block posted back to back
+        else if (_wbuf_drain_start) begin
+            o_s_en        <= 1'b1;
+            o_s_we        <= 1'b1;
+            o_s_addr      <= {_wbuf_tag, _wbuf_addr_set, {CACHE_DATA_ADDR_WIDTH_BIT{1'b0}}};
+            o_s_data      <= _wbuf_data[0];
+            o_s_mask_type <= 2'b10; // write dword
+        end
+        else if (_wbuf_draining) begin
+            if (i_s_err) begin
+                o_s_en <= 1'b0;
+            end
+            else if (_s_accept) begin
+                if (_wbuf_req_last) begin
+                    o_s_en   <= 1'b0;
+                end
+                else begin
+                    o_s_addr <= {_wbuf_tag, _wbuf_addr_set, _wbuf_req_cnt_p1, 2'b00};
+                    o_s_data <= _wbuf_data[_wbuf_req_cnt_p1];
+                end
+            end
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    if (_m_take) begin
+                        // Dirty block is copied out first, its data is not read from cache mem yet
+                        if (~i_hit & ~i_victim_dirty) begin
+                            o_s_en        <= 1'b1;
+                            o_s_we        <= 1'b0; // Need to read new data into cache first
+                            // need to read whole block, started at the missed word
+                            o_s_addr      <= {i_m_tag, i_m_addr_set, i_m_addr_word, 2'b00};
+                            o_s_mask_type <= 2'b10; // read dword
+                        end
+                    end
+                end
+                STATE_MISS_COPY: begin
+                    // Old block is in the buffer, start reading the new one
+                    if (_cache_data_o_ack & _miss_ack_last) begin
+                        o_s_en        <= 1'b1;
+                        o_s_we        <= 1'b0;
+                        o_s_addr      <= {_m_tag, _m_addr_set, _m_addr_word, 2'b00};
+                        o_s_mask_type <= 2'b10; // read dword
+                    end
+                end
+                STATE_MISS_FILL: begin
+                    if (i_s_err) begin
+                        o_s_en <= 1'b0;
+                    end
+                    // Next word right away, slave stall is the only thing holding it back
+                    else if (_s_accept) begin
+                        if (_miss_req_last) begin
+                            o_s_en   <= 1'b0;
+                        end
+                        else begin
+                            o_s_addr <= {_m_tag, _m_addr_set, _miss_req_word_p1, 2'b00};
+                        end
+                    end
+                end
+            endcase
+        end
+    end
+
+    // ==================================================================================
+    // Write-back buffer
+    // Copy: words land in order from cache mem while in STATE_MISS_COPY, tag / set with the last one
+    always_ff @(posedge i_clk) begin : wbuf_copy
+        if ((_state == STATE_MISS_COPY) & _cache_data_o_ack) begin
+            _wbuf_data[_miss_ack_cnt] <= _cache_data_o_data;
+            if (_miss_ack_last) begin
+                _wbuf_tag      <= _m_set_tags[_victim * CACHE_TAG_WIDTH_BIT +: CACHE_TAG_WIDTH_BIT];
+                _wbuf_addr_set <= _m_addr_set;
+            end
+        end
+    end
+
+    // Drain: requests and acks counted like a refill, empty once the last write is acked
+    always_ff @(posedge i_clk) begin : wbuf_drain
+        if (~i_rst) begin
+            _wbuf_valid    <= 1'b0;
+            _wbuf_draining <= 1'b0;
+            _wbuf_req_cnt  <=  'h0;
+            _wbuf_ack_cnt  <=  'h0;
+        end
+        else begin
+            if ((_state == STATE_MISS_COPY) & _cache_data_o_ack & _miss_ack_last) begin
+                _wbuf_valid    <= 1'b1;
+            end
+            else if (_wbuf_drain_start) begin
+                _wbuf_draining <= 1'b1;
+                _wbuf_req_cnt  <=  'h0;
+                _wbuf_ack_cnt  <=  'h0;
+            end
+            else if (_wbuf_draining) begin
+                if (_s_accept & ~_wbuf_req_last) begin
+                    _wbuf_req_cnt <= _wbuf_req_cnt_p1;
+                end
+                // Stays valid on error, cache is stuck in STATE_ERR anyway
+                if (i_s_ack) begin
+                    _wbuf_ack_cnt <= _wbuf_ack_cnt + 1;
+                    if (_wbuf_ack_last) begin
+                        _wbuf_valid    <= 1'b0;
+                        _wbuf_draining <= 1'b0;
+                    end
+                end
+            end
+        end
+    end
+
+    // ==================================================================================
+    // Set valid metadata flag
+    // On block fetch done. Victim stays valid while filling, no request is taken meanwhile
+    always_ff @(posedge i_clk) begin : set_valid
+        if (~i_rst) begin
+            for (int i = 0; i < CACHE_N_SET; i++) begin
+                for (int j = 0; j < CACHE_BLOCK_PER_SET; j++ ) begin
+                    _cache_metadata_valid_bit[i][j] <= 1'b0;
+                end
+            end
+        end
+        else begin
+            case (_state)
+                STATE_MISS_FILL: begin
+                    if (_miss_done) begin
+                        _cache_metadata_valid_bit[_m_addr_set][_victim] <= 1'b1;
+                    end
+                end
+            endcase
+        end
+    end
+
+    // ==================================================================================
+    // Set dirty metadata flag
+    // dirty flag changes when:
+    //  - hit write -> 1
+    //  - miss fetch -> 0, 1 if it was a store miss (merged in while filling)
+    always_ff @(posedge i_clk) begin : set_cache_metadata_dirty
+        if (~i_rst) begin
+            for (int i = 0; i < CACHE_N_SET; i++) begin
+                for (int j = 0; j < CACHE_BLOCK_PER_SET; j++ ) begin
+                    _cache_metadata_dirty_bit[i][j] <= 1'b0;
+                end
+            end
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    if (_m_take_hit & i_m_we) begin
+                        _cache_metadata_dirty_bit[i_m_addr_set][i_hit_way] <= 1'b1;
+                    end
+                end
+                STATE_MISS_FILL: begin
+                    if (_miss_done) begin
+                        _cache_metadata_dirty_bit[_m_addr_set][_victim] <= _m_we;
+                    end
+                end
+            endcase
+        end
+    end
+
+    // ==================================================================================
+    // Set PLRU metadata
+    // Path of the way points away from it when:
+    //  - hit (on idle)
+    //  - miss fetch done
+    // Not there when direct mapped, only one way to replace
+    generate
+        if (CACHE_BLOCK_PER_SET > 1) begin : plru
+            always_ff @(posedge i_clk) begin : set_cache_metadata_plru
+                if (~i_rst) begin
+                    for (int i = 0; i < CACHE_N_SET; i++) begin
+                        _cache_metadata_set_plru[i] <= 'h0;
+                    end
+                end
+                else begin
+                    case (_state)
+                        STATE_IDLE: begin
+                            if (_m_take_hit) begin
+                                _cache_metadata_set_plru[i_m_addr_set] <= plru_touch(_cache_metadata_set_plru[i_m_addr_set], i_hit_way);
+                            end
+                        end
+                        STATE_MISS_FILL: begin
+                            if (_miss_done) begin
+                                _cache_metadata_set_plru[_m_addr_set] <= plru_touch(_cache_metadata_set_plru[_m_addr_set], _victim);
+                            end
+                        end
+                    endcase
+                end
+            end
+        end
+    endgenerate
+
+    // ==================================================================================
+    // OUTPUT to master
+    // Hit: acked the cycle after it was taken, readout straight from cache mem
+    // Miss: acked with the critical word, readout registered from the bus
+    logic        _hit_ack, _miss_ack;
+    logic [31:0] _miss_readout;
+
+    assign o_m_ack  = _hit_ack | _miss_ack;
+    assign o_m_data = _hit_ack ? _cache_data_o_data : _miss_readout;
+
+    always_ff @(posedge i_clk) begin : master_bus_output
+        if (~i_rst) begin
+            _hit_ack      <= 1'b0;
+            _miss_ack     <= 1'b0;
+            _miss_readout <= 'h0;
+            o_m_err       <= 1'b0;
+        end
+        else begin
+            _hit_ack  <= _m_take_hit;
+            _miss_ack <= 1'b0;
+            if (_wbuf_draining & i_s_err) begin
+                o_m_err <= 1'b1;
+            end
+            else if (_state == STATE_MISS_FILL) begin
+                if (i_s_err) begin
+                    o_m_err <= 1'b1;
+                end
+                // Critical word is back, ack master now, rest of the block keeps coming
+                else if (i_s_ack & _miss_ack_critical) begin
+                    _miss_ack     <= 1'b1;
+                    _miss_readout <= _m_we ? 32'h0 : dword_readout(i_s_data, _m_mask_type, _m_addr_byte);
+                end
+            end
+        end
+    end
+
+endmodule
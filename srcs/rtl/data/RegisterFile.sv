@@ -4,6 +4,9 @@ module RegisterFile (
     input  logic [ 4:0] i_a1, i_a2, i_a3,
     input  logic        i_we3,            // write enable for port 3
     input  logic [31:0] i_wd3,            // write data for port 3
+    input  logic [ 4:0] i_a4,             // port 4, late load results from LSU
+    input  logic        i_we4,
+    input  logic [31:0] i_wd4,
     output logic [31:0] o_rd1, o_rd2
 );
 
@@ -15,9 +18,10 @@ module RegisterFile (
             regs[i] = 32'h0;
     end */
 
-    // three ported register file
+    // four ported register file
     // read two ports on rising edge (A1/RD1, A2/RD2)
-    // write third port on falling edge of clock (A3/WD3/WE3)
+    // write third and fourth port on falling edge of clock (A3/WD3/WE3, A4/WD4/WE4)
+    // 3 and 4 never write the same register, hazard pending load mask stalls that
     // register 0 hardwired to 0
 
     always_ff @(posedge i_clk) begin
@@ -35,6 +39,9 @@ module RegisterFile (
             if (i_we3) begin
                 regs[i_a3] <= (i_a3 != 0) ? i_wd3 : 0;
             end
+            if (i_we4) begin
+                regs[i_a4] <= (i_a4 != 0) ? i_wd4 : 0;
+            end
         end
 
 endmodule
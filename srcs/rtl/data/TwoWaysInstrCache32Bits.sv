@@ -0,0 +1,266 @@
+/* 2 ways instruction cache, read only version of the data cache (NWaysCache32Bits, 2 ways, flops metadata)
+ * a set = [[valid1][tag1][block1] | [valid2][tag2][block2] | [LRU]]
+ * ...
+ * Address resolution
+ * [tag_addr][set_addr][[data_unit_addr][byte_addr]]
+ * ...
+ * Fetch side is not request / ack: hit is checked on the fetch address in the same cycle (metadata in flops),
+ * instr comes out of the data BRAM on the next edge, exactly like InstrMemory (held by fd_en, cleared by fd_clr).
+ * So a hit costs nothing. On a miss o_f_miss stays high until the block is in, fetch holds pc meanwhile.
+ * Bus error during a fill: the master drops what is in flight, the cache goes back to IDLE with the block
+ * still invalid and o_f_err high, so fetch misses again and the fill is retried. o_f_err stays up until a
+ * fill goes through: a bad address keeps retrying with it up instead of hanging silently
+ * Slave side is the same as the data cache: pipelined, whole block streamed in, acks in order.
+ * No write path, code is not expected to change under it (no fence.i)
+ */
+
+module TwoWaysInstrCache32Bits #(
+    parameter   CACHE_O_CAPACITY_BYTE     = 4096, // divisible by block size
+    parameter   CACHE_O_BLOCK_SIZE_BYTE   = 64,   // divisible by 32
+
+    // 2 ways, hardcoded, DO NOT CHANGE
+    localparam  CACHE_BLOCK_PER_SET       = 2,
+    localparam  CACHE_N_BLOCK             = CACHE_O_CAPACITY_BYTE / CACHE_O_BLOCK_SIZE_BYTE, // default: 64
+    localparam  CACHE_N_SET               = CACHE_N_BLOCK / CACHE_BLOCK_PER_SET,             // default: 32
+    localparam  CACHE_N_DWORD             = CACHE_O_BLOCK_SIZE_BYTE / 4,                     // default: 16
+
+    // [ADDR] = [TAG][SET ADDR][DATA ADDR]
+    // [DATA ADDR] = [DWORD ADDR] + 2 bit byte addressing
+    localparam  CACHE_DATA_ADDR_WIDTH_BIT = $clog2(CACHE_O_BLOCK_SIZE_BYTE - 1), // default: 6
+    localparam  CACHE_DWORD_ADDR_WIDTH_BIT= $clog2(CACHE_N_DWORD - 1),           // default: 4
+    localparam  CACHE_SET_ADDR_WIDTH_BIT  = $clog2(CACHE_N_SET - 1),             // default: 5
+    localparam  CACHE_TAG_WIDTH_BIT       = 32 - CACHE_DATA_ADDR_WIDTH_BIT - CACHE_SET_ADDR_WIDTH_BIT // default: 21
+) (
+    input  logic        i_clk,
+    input  logic        i_rst,
+    // ==================================================
+    // Fetch interface
+    input  logic        i_f_req,        // fetch address is in cached range
+    input  logic [31:0] i_f_addr,
+    input  logic        i_f_en,         // fetch -> decode enable
+    input  logic        i_f_clr,        // fetch -> decode clear
+    output logic        o_f_miss,       // instr not here, hold pc
+    output logic        o_f_err,        // last fill got a bus error, retrying
+    output logic [31:0] o_f_instr,
+
+    // ==================================================
+    // Memory interface to slave bus, read only
+    output logic        o_s_en,
+    output logic [31:0] o_s_addr,
+    input  logic        i_s_stall,      // request not taken, hold en
+    input  logic        i_s_ack,
+    input  logic        i_s_err,
+    input  logic [31:0] i_s_data
+);
+
+    // Metadata in flops so hit is known in fetch cycle
+    logic                               _cache_metadata_valid_bit   [CACHE_N_SET - 1 : 0][CACHE_BLOCK_PER_SET - 1 : 0];
+    logic [CACHE_TAG_WIDTH_BIT - 1 : 0] _cache_metadata_tag         [CACHE_N_SET - 1 : 0][CACHE_BLOCK_PER_SET - 1 : 0];
+    // Store index of LEAST recently used block
+    logic                               _cache_metadata_set_LRU_bit [CACHE_N_SET - 1 : 0];
+
+    // Block data, addr = {set, way, dword}
+    localparam CACHE_N_DWORD_TOTAL = CACHE_O_CAPACITY_BYTE / 4;
+    logic [31:0] _cache_data [CACHE_N_DWORD_TOTAL - 1 : 0];
+
+    // ==================================================================================
+    // Addr decomposition
+    logic [CACHE_TAG_WIDTH_BIT        - 1 : 0]  i_f_tag;
+    logic [CACHE_SET_ADDR_WIDTH_BIT   - 1 : 0]  i_f_addr_set;
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0]  i_f_addr_word;
+    logic [1:0]                                 i_f_addr_byte;
+    assign {i_f_tag, i_f_addr_set, i_f_addr_word, i_f_addr_byte} = i_f_addr;
+
+    // Cache hit signals, 2 ways
+    logic  i_hit, i_hit0, i_hit1;
+    assign i_hit  = i_hit0 | i_hit1;
+    assign i_hit1 = _cache_metadata_valid_bit[i_f_addr_set][1] &
+                    (i_f_tag == _cache_metadata_tag[i_f_addr_set][1]);
+    assign i_hit0 = _cache_metadata_valid_bit[i_f_addr_set][0] &
+                    (i_f_tag == _cache_metadata_tag[i_f_addr_set][0]);
+
+    assign o_f_miss = i_f_req & ~i_hit;
+
+    // ==================================================================================
+    // STATE MACHINE
+    typedef enum logic [1:0] {  // Wait for miss
+                                STATE_IDLE, // 00
+                                // Error on external bus landed here, 1 cycle for the master to drop the rest
+                                STATE_ERR,  // 01
+                                // Read new block, all requests back to back, each ack written into cache mem
+                                STATE_MISS_FILL // 10
+                            } _state_t;
+    _state_t _state;
+
+    // Miss counters, same as data cache
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_req_cnt; // next word to request from slave
+    logic [CACHE_DWORD_ADDR_WIDTH_BIT - 1 : 0] _miss_ack_cnt; // next word to be acked
+    logic                                      _miss_req_last, _miss_ack_last;
+    assign _miss_req_last = &_miss_req_cnt;
+    assign _miss_ack_last = &_miss_ack_cnt;
+
+    logic _s_accept;
+    assign _s_accept = o_s_en & ~i_s_stall;
+
+    // Block being filled
+    logic [CACHE_TAG_WIDTH_BIT      - 1 : 0] _m_tag;
+    logic [CACHE_SET_ADDR_WIDTH_BIT - 1 : 0] _m_addr_set;
+    logic                                    _lru;
+
+    logic _miss_start, _miss_done;
+    assign _miss_start = (_state == STATE_IDLE) & o_f_miss;
+    assign _miss_done  = (_state == STATE_MISS_FILL) & i_s_ack & _miss_ack_last;
+
+    always_ff @(posedge i_clk) begin : state_machine
+        if (~i_rst) begin
+            _state <= STATE_IDLE;
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    if (o_f_miss)
+                        _state <= STATE_MISS_FILL;
+                end
+                STATE_ERR: begin
+                    _state <= STATE_IDLE;
+                end
+                STATE_MISS_FILL: begin
+                    if (i_s_err)
+                        _state <= STATE_ERR;
+                    else if (_miss_done)
+                        _state <= STATE_IDLE;
+                end
+                default: begin
+                    _state <= STATE_IDLE;
+                end
+            endcase
+        end
+    end
+
+    always_ff @(posedge i_clk) begin : fill_err
+        if (~i_rst | _miss_done)
+            o_f_err <= 1'b0;
+        else if ((_state == STATE_MISS_FILL) & i_s_err)
+            o_f_err <= 1'b1;
+    end
+
+    // ==================================================================================
+    // Latching miss
+    always_ff @(posedge i_clk) begin : latch_miss
+        if (_miss_start) begin
+            _m_tag      <= i_f_tag;
+            _m_addr_set <= i_f_addr_set;
+            _lru        <= _cache_metadata_set_LRU_bit[i_f_addr_set];
+        end
+    end
+
+    // ==================================================================================
+    // Miss counters
+    always_ff @(posedge i_clk) begin : cache_miss_counters
+        if (_miss_start) begin
+            _miss_req_cnt <= 'h0;
+            _miss_ack_cnt <= 'h0;
+        end
+        else if (_state == STATE_MISS_FILL) begin
+            if (_s_accept & ~_miss_req_last)
+                _miss_req_cnt <= _miss_req_cnt + 1;
+            if (i_s_ack)
+                _miss_ack_cnt <= _miss_ack_cnt + 1;
+        end
+    end
+
+    // ==================================================================================
+    // OUTPUT to slave bus
+    always_ff @(posedge i_clk) begin : cache_slave_bus_output
+        if (~i_rst) begin
+            o_s_en   <= 1'b0;
+            o_s_addr <= 'h0;
+        end
+        else begin
+            case (_state)
+                STATE_IDLE: begin
+                    if (o_f_miss) begin
+                        o_s_en   <= 1'b1;
+                        o_s_addr <= {i_f_tag, i_f_addr_set, {CACHE_DATA_ADDR_WIDTH_BIT{1'b0}}};
+                    end
+                end
+                STATE_MISS_FILL: begin
+                    if (i_s_err) begin
+                        o_s_en <= 1'b0;
+                    end
+                    else if (_s_accept) begin
+                        if (_miss_req_last)
+                            o_s_en   <= 1'b0;
+                        else
+                            o_s_addr <= {_m_tag, _m_addr_set, _miss_req_cnt + 1'b1, 2'b00};
+                    end
+                end
+                default: begin
+                    o_s_en <= 1'b0;
+                end
+            endcase
+        end
+    end
+
+    // ==================================================================================
+    // Cache data, write port: words as they come in
+    always_ff @(posedge i_clk) begin : cache_data_write
+        if ((_state == STATE_MISS_FILL) & i_s_ack)
+            _cache_data[{_m_addr_set, _lru, _miss_ack_cnt}] <= i_s_data;
+    end
+
+    // Cache data, read port: fetch
+    always_ff @(posedge i_clk) begin : cache_data_read
+        if (i_f_en) begin
+            if (i_f_clr)
+                o_f_instr <= 32'd0;
+            else
+                o_f_instr <= _cache_data[{i_f_addr_set, i_hit1, i_f_addr_word}];
+        end
+        else begin /* Do nothing, hold value */ end
+    end
+
+    // ==================================================================================
+    // Metadata
+    // Victim way is invalidated on miss start so it does not hit half filled,
+    // valid + tag on fill done
+    always_ff @(posedge i_clk) begin : set_valid
+        if (~i_rst) begin
+            for (int i = 0; i < CACHE_N_SET; i++) begin
+                for (int j = 0; j < CACHE_BLOCK_PER_SET; j++ ) begin
+                    _cache_metadata_valid_bit[i][j] <= 1'b0;
+                end
+            end
+        end
+        else begin
+            if (_miss_start)
+                _cache_metadata_valid_bit[i_f_addr_set][_cache_metadata_set_LRU_bit[i_f_addr_set]] <= 1'b0;
+            else if (_miss_done)
+                _cache_metadata_valid_bit[_m_addr_set][_lru] <= 1'b1;
+        end
+    end
+
+    // Does not need rst
+    always_ff @(posedge i_clk) begin : set_tag
+        if (_miss_done)
+            _cache_metadata_tag[_m_addr_set][_lru] <= _m_tag;
+    end
+
+    // LRU -> other way when:
+    //  - instr latched from a way (hit)
+    //  - fill done
+    always_ff @(posedge i_clk) begin : set_cache_metadata_used_way
+        if (~i_rst) begin
+            for (int i = 0; i < CACHE_N_SET; i++) begin
+                _cache_metadata_set_LRU_bit[i] <= 1'b0;
+            end
+        end
+        else begin
+            if (i_f_en & i_f_req & i_hit)
+                _cache_metadata_set_LRU_bit[i_f_addr_set] <= ~i_hit1;
+            if (_miss_done)
+                _cache_metadata_set_LRU_bit[_m_addr_set] <= ~_lru;
+        end
+    end
+
+endmodule
@@ -305,6 +305,7 @@ module BRAMWB #(
     assign o_err = 1'b0;
 
     // STALL
+    // Never, a request is taken every cycle and acked the next one (WB B4 pipelined)
     assign o_stall = 1'b0;
 
 endmodule
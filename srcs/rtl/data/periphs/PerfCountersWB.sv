@@ -0,0 +1,108 @@
+/* Performance counters, memory mapped, read from code through addr.h
+ * One 32 bit counter per event line, +1 every cycle its line is high while running
+ * Register map, word access only (others read 0):
+ *  0x00        : CTRL, write 1s only: bit 0 start, bit 1 clear all counters, bit 2 stop (wins over start)
+ *                read bit 0 = running (1 after rst). Clear alone keeps counting
+ *  0x04 + 4 * i: counter i, read only
+ * Event lines are wired in DataMemStageBlock, see map there and in addr.h
+ * 32 bits wrap in ~107 s at 40 MHz, clear before measuring
+ */
+
+module PerfCountersWB #(
+    parameter N_COUNTERS = 10,
+    // 32 bit address interface
+    parameter START_ADDR = 32'hffffff80,
+    localparam SIZEBYTE  = (N_COUNTERS + 1) << 2 // + CTRL
+)(
+    // Intercon
+    input  logic        i_clk, i_rst,
+    input  logic        i_cyc,
+    input  logic        i_stb,
+    input  logic [31:0] i_addr,
+    input  logic        i_we,
+    input  logic [31:0] i_data,
+    input  logic [3:0]  i_sel,
+    output logic        o_ack,
+    output logic        o_err,
+    output logic [31:0] o_data,
+    output logic        o_stall,
+
+    // Events
+    input  logic [N_COUNTERS - 1:0] i_events
+);
+
+    // Byte addressible
+    localparam ADDRWIDTH = $clog2(SIZEBYTE - 1);
+
+    // START_ADDR alignment check
+    always_comb begin
+        if (START_ADDR[ADDRWIDTH-1:0] != 'b0)
+            $fatal("%m: Address range is not aligned!");
+    end
+
+    logic        _run;
+    logic [31:0] _counters [N_COUNTERS - 1:0];
+
+    // Mem access
+    logic [ADDRWIDTH - 3:0] _addr; // word index, 0 = CTRL
+    assign _addr = i_addr[ADDRWIDTH - 1:2];
+    logic _en;
+    assign _en = i_cyc & i_stb;
+    logic _word;
+    assign _word = (i_sel == 4'b1111);
+    // Write
+    logic _we, _start, _clear, _stop;
+    assign _we    = i_we & _en & _word & (_addr == 'h0);
+    assign _start = _we & i_data[0];
+    assign _clear = _we & i_data[1];
+    assign _stop  = _we & i_data[2];
+
+    always_ff @(posedge i_clk) begin : ctrl
+        if (~i_rst)
+            _run <= 1'b1;
+        else if (_stop)
+            _run <= 1'b0;
+        else if (_start)
+            _run <= 1'b1;
+    end
+
+    always_ff @(posedge i_clk) begin : counters
+        if (~i_rst | _clear) begin
+            for (int i = 0; i < N_COUNTERS; i++) _counters[i] <= 32'h0;
+        end
+        else if (_run) begin
+            for (int i = 0; i < N_COUNTERS; i++) begin
+                if (i_events[i])
+                    _counters[i] <= _counters[i] + 1;
+            end
+        end
+    end
+
+    // Read
+    logic _re;
+    assign _re = ~i_we & _en;
+    always_ff @(posedge i_clk) begin : read
+        if (_re & _word) begin
+            if (_addr == 'h0)
+                o_data <= {31'b0, _run};
+            else if (_addr <= N_COUNTERS)
+                o_data <= _counters[_addr - 1];
+            else
+                o_data <= 32'b0;
+        end
+        else
+            o_data <= 32'b0; // return 0 to databus
+    end
+
+    // ACK
+    always_ff @(posedge i_clk) begin : ack
+        o_ack <= _en;
+    end
+
+    // ERR
+    assign o_err = 1'b0;
+
+    // STALL
+    assign o_stall = 1'b0;
+
+endmodule
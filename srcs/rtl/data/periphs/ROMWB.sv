@@ -150,6 +150,7 @@ module ROMWB #(
     assign o_err = i_cyc & i_stb & (i_we | ~_align);
 
     // STALL
+    // Never, a request is taken every cycle and acked the next one (WB B4 pipelined)
     assign o_stall = 1'b0;
 
 endmodule
@@ -1,13 +1,14 @@
 `include "srcs/rtl/include/config.svh"
 
 /* WB interface for SDRAM controller for EM638325BK-6H on Colorlight-i5
- * Use the busy signal for the stall signal, this can reduce performance since the controller support changing request right after ack (after request latched)
- * Ack problem: 
- *  - ack in the controller means data is latched, not when data is available, so depend on read | write WB ack must be on controller valid | ack signal
- *  -> need to save state
- * Delay problem:
- *  - IF READ / WRITE DATA SEEM TO BE REPEATED THIS MIGHT BE THE PROBLEM, INCREASE THE COUNTER
- *  - If we rely on ack signal to stop sending request then CDC delay is a big problem. Multiple request will be send and received by the controller before first ack arrives.
+ * 2 async FIFOs between the WB and the SDRAM clock, no per word handshake across domains:
+ *  - command FIFO, WB -> RAM: {addr, data, we}, CMD_FIFO_DEPTH entries
+ *  - read data FIFO, RAM -> WB: every read beat, deep enough for a whole line
+ * Writes are posted: acked the cycle after they are in the command FIFO, stall only when it is full.
+ * A whole dcache block write back goes in back to back.
+ * Reads go through a one line buffer filled by a single SDRAM burst, see line buffer below
+ * WB B4 pipelined, acks in order: line buffer hits stream one per cycle, a read waiting on SDRAM stalls the bus.
+ * Ordering: FIFO and controller are in order so a read queued behind a posted write sees it.
  */
 
 module SDRAMControllerWB #(
@@ -32,6 +33,8 @@ module SDRAMControllerWB #(
     output logic        o_wb_err,
     output logic [31:0] o_wb_data,
     output logic        o_wb_stall,
+    // Request held up while the controller refreshes, perf counters
+    output logic        o_wb_refresh_stall,
     // ==============================================
     // Controller Port
     input  logic        i_ram_clk,
@@ -55,182 +58,166 @@ module SDRAMControllerWB #(
 `endif
 );
 
-    // SDRAM clk domain rst
+    // SDRAM clk domain rst, double flopped. Every RAM side block takes _ram_rst (the synchronized bit),
+    // never the 2 bit vector: a port connection would truncate it to the first flop
     logic [1:0] _ram_i_rst;
+    logic       _ram_rst;
     always_ff @(posedge i_ram_clk) begin : ram_rst_doubleflop
-        _ram_i_rst = {_ram_i_rst[0], i_wb_rst};
+        _ram_i_rst <= {_ram_i_rst[0], i_wb_rst};
     end
+    assign _ram_rst = _ram_i_rst[1];
 
     // High when both i_wb_cyc and i_wb_stb high
     logic i_wb_en;
     assign i_wb_en = i_wb_cyc & i_wb_stb;
 
-    // State machine
-    // To avoid fifo delay problem (see header note) leads to sending multiple request repeatedly
-    // have a third stage that the controller will get to after sending request for 1 clock
-    // , wait there for a set amount of time, if not receive anything then go to request and try again
-    // , else move to idle
-    typedef enum logic [1:0] {STATE_IDLE, STATE_REQUEST, STATE_WAIT} _state_t;
-    _state_t _state;
+    localparam integer CMD_FIFO_DEPTH = 16; // a whole dcache block write back
 
-    always_ff @(posedge i_wb_clk) begin : state_machine
-        if (~i_wb_rst) begin
-            _state <= STATE_IDLE;
-        end
-        else begin
-            case (_state)
-                STATE_IDLE: begin
-                    if (i_wb_en) begin
-                        _state <= STATE_REQUEST;
-                    end
-                end
-                STATE_REQUEST: begin
-                    // There is a chance that ack / valid will high after the state has changed
-                    // to request from wait. To give it a last chance, handle ack here.
-                    // If the wait counter is any shorter then it will loop indefinitely
-                    if ((_wb_we & _wb_ack) | (~_wb_we & _wb_valid)) begin
-                        _state <= STATE_IDLE;
-                    end
-                    else begin
-                        // Then we can proceed with the default flow
-                        _state <= STATE_WAIT;
-                    end
-                end
-                STATE_WAIT: begin
-                    // if _wait_counter_p1[4] == 1'b0 && receive ack or valid? => too bad try again
-                    if (_wait_counter_p1[4] == 1'b0) begin
-                        if (_wb_we & _wb_ack) begin
-                            _state <= STATE_IDLE;
-                        end
-                        else 
-                        if (~_wb_we & _wb_valid) begin
-                            _state <= STATE_IDLE;
-                        end
-                        // else do nothing
-                    end
-                    else if (_wait_counter_p1[4] == 1'b1) begin
-                        _state <= STATE_REQUEST;
-                    end
-                end
-            endcase
-        end
-    end
+    // ==============================================
+    // Line buffer
+    // Reads are done as one SDRAM burst of a whole line (RAM_BURST_LENGTH words, 64 bytes = one dcache block)
+    // and kept here, so a cache refill reading its block word by word only waits on SDRAM for the first word.
+    // Words are valid one by one as the burst streams in, a read acks as soon as its word is there.
+    // Writes stay single word (SDRAM_O_WRITE_SINGLE), the buffered copy is updated so it never goes stale.
+    // A write landing while the line fills marks its word valid, the older burst word is then dropped.
+    // RAM_BURST_LENGTH must be a power of 2 and >= 2
+    localparam integer LINE_WORDS  = `RAM_BURST_LENGTH;
+    localparam integer LINE_OFFSET = $clog2(LINE_WORDS);          // word offset bits
+    localparam integer LINE_TAG_W  = 21 - LINE_OFFSET;            // 21 bits block addr, see _wb_addr_trunc
+    logic [31:0]                 _line [LINE_WORDS - 1 : 0];
+    logic [LINE_WORDS - 1 : 0]   _line_wvalid;
+    logic                        _line_tag_valid;
+    logic [LINE_TAG_W - 1 : 0]   _line_tag;
+    logic [LINE_OFFSET - 1 : 0]  _fill_cnt; // next beat to come in
+    logic                        _fill_busy;
 
-    // Wait counter
-    // Setting this too low will cause repeating request
-    logic [3:0] _wait_counter;
-    logic [4:0] _wait_counter_p1;
-    assign _wait_counter_p1 = _wait_counter + 1;
+    logic [LINE_TAG_W - 1 : 0]   i_wb_tag;
+    logic [LINE_OFFSET - 1 : 0]  i_wb_word;
+    assign i_wb_tag  = i_wb_addr[22 : LINE_OFFSET + 2];
+    assign i_wb_word = i_wb_addr[LINE_OFFSET + 1 : 2];
 
-    always_ff @(posedge i_wb_clk) begin : wait_counter
-        if (~i_wb_rst) begin
-            _wait_counter <= 'b0;
+    logic _line_hit, _line_word_hit;
+    assign _line_hit      = _line_tag_valid & (i_wb_tag == _line_tag);
+    assign _line_word_hit = _line_hit & _line_wvalid[i_wb_word];
+
+    // ==============================================
+    // WB side
+    // _rd_wait: read taken but its word is not in yet, everything else stalls behind it (acks in order)
+    // _rd_fill: ... and its line still has to be requested (line buffer was busy filling another line)
+    logic                        _cmd_full;
+    logic                        _wb_take;
+    logic                        _rd_wait, _rd_fill, _rd_ready;
+    logic [LINE_TAG_W - 1 : 0]   _rd_tag;
+    logic [LINE_OFFSET - 1 : 0]  _ack_word;
+    logic                        _ack_q; // write / line buffer hit taken last cycle
+
+    assign _wb_take  = i_wb_en & ~_rd_wait & ~_cmd_full;
+    assign _rd_ready = _rd_wait & ~_rd_fill & _line_wvalid[_ack_word];
+
+    // Command FIFO push: writes, line requests
+    logic        _cmd_push;
+    logic        _cmd_we;
+    logic [20:0] _cmd_addr;
+    logic        _fill_start;
+    logic [LINE_TAG_W - 1 : 0] _fill_tag;
+
+    // Read miss goes out right away when the line buffer is free, else once its fill is done
+    always_comb begin : command_push
+        _fill_start = 1'b0;
+        _fill_tag   = i_wb_tag;
+        if (_wb_take & ~i_wb_we & ~_line_hit & ~_fill_busy) begin
+            _fill_start = 1'b1;
         end
-        else begin
-            case (_state)
-                STATE_IDLE: begin
-                    _wait_counter <= 'b0;
-                end
-                STATE_REQUEST: begin
-                    _wait_counter <= 'b0;
-                end
-                STATE_WAIT: begin
-                    if (_wait_counter_p1[4] == 1'b0)
-                        _wait_counter <= _wait_counter_p1[3:0];
-                end
-            endcase
+        else if (_rd_fill & ~_fill_busy & ~_cmd_full) begin
+            _fill_start = 1'b1;
+            _fill_tag   = _rd_tag;
         end
+        _cmd_push = (_wb_take & i_wb_we) | _fill_start;
+        _cmd_we   = _wb_take & i_wb_we;
+        // 32 bits address convert to sdram block 21 bits address
+        // i_wb_addr = {9'b0, bankaddr, rowaddr, columnaddr, 2'b0}
+        // Reads fetch the whole line, from its first word
+        _cmd_addr = _cmd_we ? i_wb_addr[22:2] : {_fill_tag, {LINE_OFFSET{1'b0}}};
     end
 
-    // Fifo read en, only read from fifo during wait state
-    logic _fifo_ram_mem_en;
-    always_ff @(posedge i_wb_clk) begin : fifo_read_en
+    always_ff @(posedge i_wb_clk) begin : wb_requests
         if (~i_wb_rst) begin
-            _fifo_ram_mem_en <= 'b0;
+            _rd_wait <= 1'b0;
+            _rd_fill <= 1'b0;
+            _ack_q   <= 1'b0;
         end
         else begin
-            case (_state)
-                STATE_REQUEST: begin
-                    // last chance, see state
-                    if ((_wb_we & _wb_ack) | (~_wb_we & _wb_valid)) begin
-                        _fifo_ram_mem_en <= 'b0;
-                    end
-                    else begin
-                        // default
-                        _fifo_ram_mem_en <= 'b1;
-                    end
+            _ack_q <= _wb_take & (i_wb_we | _line_word_hit);
+            if (_wb_take) begin
+                _ack_word <= i_wb_word;
+                _rd_tag   <= i_wb_tag;
+                if (~i_wb_we & ~_line_word_hit) begin
+                    _rd_wait <= 1'b1;
+                    _rd_fill <= ~_line_hit & _fill_busy;
                 end
-                STATE_WAIT: begin
-                    if (_wait_counter_p1[4] == 1'b0) begin
-                        if (_wb_we & _wb_ack) begin
-                            _fifo_ram_mem_en <= 'b0;
-                        end
-                        else 
-                        if (~_wb_we & _wb_valid) begin
-                            _fifo_ram_mem_en <= 'b0;
-                        end
-                        // else do nothing
-                    end
-                    else if (_wait_counter_p1[4] == 1'b1) begin
-                        _fifo_ram_mem_en <= 'b0;
-                    end
-                end
-            endcase
+            end
+            else begin
+                if (_rd_fill & _fill_start)
+                    _rd_fill <= 1'b0;
+                if (_rd_ready)
+                    _rd_wait <= 1'b0;
+            end
         end
     end
 
-    // Latching_request
-    logic [31:0] _wb_addr, _wb_data;
-    logic        _wb_en, _wb_we;
+    // Line buffer: fills from the read data FIFO, writes from WB
+    logic        _rdata_rd; // read data FIFO entry on its output this cycle
+    logic [31:0] _rdata;
 
-    always_ff @(posedge i_wb_clk) begin : latching_request
+    always_ff @(posedge i_wb_clk) begin : line_buffer
         if (~i_wb_rst) begin
-            _wb_addr <= 'h0;
-            _wb_data <= 'h0;
-            _wb_en   <= 'b0;
-            _wb_we   <= 'b0;
+            _line_tag_valid <= 1'b0;
+            _line_wvalid    <= 'h0;
+            _fill_busy      <= 1'b0;
+            _fill_cnt       <= 'h0;
         end
         else begin
-            case (_state)
-                STATE_IDLE: begin
-                    if (i_wb_en) begin
-                        _wb_addr <= i_wb_addr;
-                        _wb_data <= i_wb_data;
-                        _wb_en   <= i_wb_en;
-                        _wb_we   <= i_wb_we;
+            if (_fill_start) begin
+                // buffer is garbage until words come in
+                _line_tag_valid <= 1'b1;
+                _line_tag       <= _fill_tag;
+                _line_wvalid    <= 'h0;
+                _fill_busy      <= 1'b1;
+                _fill_cnt       <= 'h0;
+            end
+            else begin
+                if (_rdata_rd & _fill_busy) begin
+                    if (~_line_wvalid[_fill_cnt]) begin
+                        _line[_fill_cnt]        <= _rdata;
+                        _line_wvalid[_fill_cnt] <= 1'b1;
                     end
+                    _fill_cnt <= _fill_cnt + 1;
+                    if (_fill_cnt == LINE_WORDS - 1)
+                        _fill_busy <= 1'b0;
                 end
-                STATE_REQUEST: begin
-                    // Coming from wait timeout
-                    if (_wait_counter_p1[4] == 1'b1) begin
-                        if ((_wb_we & _wb_ack) | (~_wb_we & _wb_valid)) begin
-                            // got data, not resend
-                            _wb_en <= 'b0;
-                        end
-                        else begin
-                            // default, resend request
-                            _wb_en <= 'b1;
-                        end 
-                    end
-                    else begin
-                        // Coming from idle, sending only 1 request
-                        if (_wait_counter_p1[4] == 1'b0) begin
-                            _wb_en <= 'b0;
-                        end
-                    end
+                // write through, keep buffered copy up to date
+                // never on the same cycle as a fill start (one request per cycle)
+                if (_wb_take & i_wb_we & _line_hit) begin
+                    _line[i_wb_word]        <= i_wb_data;
+                    _line_wvalid[i_wb_word] <= 1'b1;
                 end
-                STATE_WAIT: begin
-                    // In case coming from request resend
-                    _wb_en <= 'b0;
-                end
-            endcase
+            end
         end
     end
 
-    // 32 bits address convert to sdram block 21 bits address
-    // i_wb_addr = {9'b0, bankaddr, rowaddr, columnaddr, 2'b0}
-    logic [20:0] _wb_addr_trunc;
-    assign _wb_addr_trunc = _wb_addr[22:2];
+    // ==============================================
+    // SDRAM controller signals
+    // Inputs - 54 bits
+    logic [20:0] _ram_i_addr; // 21 bits block addr
+    logic [31:0] _ram_i_data; // 32 bits data input to ram
+    logic        _ram_i_we;
+    logic        _ram_i_req;
+    // Outputs - 35 bits
+    logic        _ram_o_ack;
+    logic        _ram_o_valid;
+    logic [31:0] _ram_o_data;
+    logic        _ram_o_busy; // unused
+    logic        _ram_o_refresh;
 
     // ==============================================
     // FIFO for controller inputs
@@ -238,91 +225,111 @@ module SDRAMControllerWB #(
     logic _fifo_mem_ram_ae, _fifo_mem_ram_af; // Almost signals, currently unused
     // Data go in the controller:
     //  i_addr - 21 bits = address point to 4 bytes block, convert from 32 bits i_wb_addr
-    //  i_data - 32 bits = _wb_data
-    //  i_we   -  1 bits = _wb_we
-    //  i_req  -  1 bits = _wb_en
-    //  total  -  55 bits
-    logic [54:0] _fifo_mem_ram_data_in, _fifo_mem_ram_data_out;
+    //  i_data - 32 bits = i_wb_data
+    //  i_we   -  1 bits
+    //  total  -  54 bits
+    logic [53:0] _fifo_mem_ram_data_in, _fifo_mem_ram_data_out;
+    logic        _fifo_mem_ram_rp_en;
 
-    assign _fifo_mem_ram_data_in = {_wb_addr_trunc, _wb_data, _wb_we, _wb_en};
-    assign {_ram_i_addr, _ram_i_data, _ram_i_we, _ram_i_req} = _fifo_mem_ram_data_out;
+    assign _fifo_mem_ram_data_in = {_cmd_addr, i_wb_data, _cmd_we};
+    assign _cmd_full = _fifo_mem_ram_full;
 
     FIFO #(
-        .FIFO_O_WIDTH(55)
+        .FIFO_O_WIDTH(54),
+        .FIFO_O_DEPTH(CMD_FIFO_DEPTH)
     ) toRAMController (
         // out rp == controller
         .i_rp_clk  (i_ram_clk),
-        .i_rp_rst  (_ram_i_rst),
-        .i_rp_en   (1'b1), // always read when possible, FULL/EMPTY check already performed by FIFO
+        .i_rp_rst  (_ram_rst),
+        .i_rp_en   (_fifo_mem_ram_rp_en),
         .o_rp_data (_fifo_mem_ram_data_out),
         .o_rp_ae   (_fifo_mem_ram_ae),
         .o_rp_empty(_fifo_mem_ram_empty),
         // in wp == cpu
         .i_wp_clk  (i_wb_clk),
         .i_wp_rst  (i_wb_rst),
-        .i_wp_en   (_wb_en), // FULL/EMPTY check already performed by FIFO
+        .i_wp_en   (_cmd_push), // FULL/EMPTY check already performed by FIFO
         .i_wp_data (_fifo_mem_ram_data_in),
         .o_wp_af   (_fifo_mem_ram_af),
         .o_wp_full (_fifo_mem_ram_full)
     );
 
+    // RAM side: FIFO entry is on its output only the cycle after it is read, hold it until the controller acks
+    // Controller does not look at i_req in its ack cycle, next entry is read then: 1 request / 2 RAM cycles
+    logic        _ram_cmd_rd, _ram_cmd_hold_valid;
+    logic [53:0] _ram_cmd_hold, _ram_cmd;
+
+    assign _fifo_mem_ram_rp_en = (~_ram_cmd_rd & ~_ram_cmd_hold_valid) | _ram_o_ack;
+    assign _ram_cmd = _ram_cmd_rd ? _fifo_mem_ram_data_out : _ram_cmd_hold;
+
+    always_ff @(posedge i_ram_clk) begin : ram_command_hold
+        if (~_ram_rst) begin
+            _ram_cmd_rd         <= 1'b0;
+            _ram_cmd_hold_valid <= 1'b0;
+        end
+        else begin
+            _ram_cmd_rd <= _fifo_mem_ram_rp_en & ~_fifo_mem_ram_empty;
+            if (_ram_cmd_rd) begin
+                _ram_cmd_hold_valid <= 1'b1;
+                _ram_cmd_hold       <= _fifo_mem_ram_data_out;
+            end
+            else if (_ram_o_ack) begin
+                _ram_cmd_hold_valid <= 1'b0;
+            end
+        end
+    end
+
+    assign {_ram_i_addr, _ram_i_data, _ram_i_we} = _ram_cmd;
+    assign _ram_i_req = _ram_cmd_rd | _ram_cmd_hold_valid;
+
     // ==============================================
-    // FIFO for controller outputs
-    logic _fifo_ram_mem_in_en;
+    // FIFO for controller outputs, read beats only
     logic _fifo_ram_mem_empty, _fifo_ram_mem_full;
     logic _fifo_ram_mem_ae, _fifo_ram_mem_af;  // Almost signals, currently unused
-    // Data go out from the controller:
-    //  o_ack   -  1 bits = high when request received
-    //  o_valid -  1 bits = high when read data valid
-    //  o_data  - 32 bits
-    //  total  -  34 bits
-    logic [33:0] _fifo_ram_mem_data_in, _fifo_ram_mem_data_out;
-    // WB does not have valid signal while sdram controller implements 2 diff signals
-    logic _wb_ack, _wb_valid;
-    
-    assign _fifo_ram_mem_in_en = _ram_o_ack | _ram_o_valid; // High when has something to say
-    assign _fifo_ram_mem_data_in = {_ram_o_ack, _ram_o_valid, _ram_o_data};
-    assign {_wb_ack, _wb_valid, o_wb_data} = _fifo_ram_mem_data_out;
 
+    always_ff @(posedge i_wb_clk) begin : read_data_fifo_out
+        if (~i_wb_rst)
+            _rdata_rd <= 1'b0;
+        else
+            _rdata_rd <= ~_fifo_ram_mem_empty;
+    end
+
+    // Deep enough for a whole burst, the controller does not wait for the WB side to drain
+    // Only one line in flight (see _fill_busy)
     FIFO #(
-        .FIFO_O_WIDTH(34)
+        .FIFO_O_WIDTH(32),
+        .FIFO_O_DEPTH(32)
     ) fromRAMController (
         // out rp == cpu
         .i_rp_clk  (i_wb_clk),
         .i_rp_rst  (i_wb_rst),
-        .i_rp_en   (_fifo_ram_mem_en),
-        .o_rp_data (_fifo_ram_mem_data_out),
+        .i_rp_en   (1'b1), // always read when possible
+        .o_rp_data (_rdata),
         .o_rp_ae   (_fifo_ram_mem_ae),
         .o_rp_empty(_fifo_ram_mem_empty),
         // in wp == controller
         .i_wp_clk  (i_ram_clk),
-        .i_wp_rst  (_ram_i_rst),
-        .i_wp_en   (_fifo_ram_mem_in_en),
-        .i_wp_data (_fifo_ram_mem_data_in),
+        .i_wp_rst  (_ram_rst),
+        .i_wp_en   (_ram_o_valid),
+        .i_wp_data (_ram_o_data),
         .o_wp_af   (_fifo_ram_mem_af),
         .o_wp_full (_fifo_ram_mem_full)
     );
 
     // ==============================================
     // SDRAM controller
-    // Inputs - 55 bits
-    logic [20:0] _ram_i_addr; // 21 bits block addr
-    logic [31:0] _ram_i_data; // 32 bits data input to ram
-    logic        _ram_i_we;
-    logic        _ram_i_req;
-    // Outputs - 35 bits
-    logic        _ram_o_ack;
-    logic        _ram_o_valid;
-    logic [31:0] _ram_o_data;
-    logic        _ram_o_busy; // Cause fifo bloat, do not use
 
     // FOR TESTING REMEMBER TO CHANGE CLOCK IN SDRAM CONTROLLER AS WELL AS SDRAM SIMULATION MODEL
+    // Line bursts: BL up to 8 is native, longer is full page cut with burst stop
     SDRAMController #(
         .SDRAM_O_CLK_FREQ(`RAM_CLK_FREQ),
-        .SDRAM_C_CAS_LATENCY(`RAM_CAS_LATENCY)
+        .SDRAM_C_CAS_LATENCY(`RAM_CAS_LATENCY),
+        .SDRAM_O_BURST_LENGTH((LINE_WORDS > 8) ? 256 : LINE_WORDS),
+        .SDRAM_O_PAGE_BURST_BEATS(LINE_WORDS),
+        .SDRAM_O_WRITE_SINGLE(1)
     ) SDRAMController (
         .i_clk   (i_ram_clk),
-        .i_rst   (_ram_i_rst),
+        .i_rst   (_ram_rst),
         // Memory interface
         .i_addr  (_ram_i_addr),
         .i_data  (_ram_i_data),
@@ -332,6 +339,7 @@ module SDRAMControllerWB #(
         .o_valid (_ram_o_valid),
         .o_data  (_ram_o_data),
         .o_busy  (_ram_o_busy),
+        .o_refresh(_ram_o_refresh),
         // SDRAM interface, PASSTHROUGH
         // .o_r_clk (), // Connect at top
         // .o_r_cke (), // fixed vcc
@@ -350,11 +358,19 @@ module SDRAMControllerWB #(
 `endif
     );
 
-    // Stall
-    assign o_wb_stall = (_state != STATE_IDLE);
-    // Ack
-    assign o_wb_ack   = _wb_we ? _wb_ack : _wb_valid;
+    // Stall, only on a request to this slave: read waiting on SDRAM, or command FIFO full
+    assign o_wb_stall = i_wb_en & (_rd_wait | _cmd_full);
+    // Ack, read data always from line buffer, 0 when not acking (slaves are or-ed)
+    assign o_wb_ack   = _ack_q | _rd_ready;
+    assign o_wb_data  = o_wb_ack ? _line[_ack_word] : 32'h0;
     // Err
     assign o_wb_err   = 1'b0;
 
+    // Refresh state into wb clk domain, level lasts a few wb cycles so double flop is enough
+    logic [1:0] _wb_refresh;
+    always_ff @(posedge i_wb_clk) begin : refresh_doubleflop
+        _wb_refresh <= {_wb_refresh[0], _ram_o_refresh};
+    end
+    assign o_wb_refresh_stall = _wb_refresh[1] & o_wb_stall;
+
 endmodule
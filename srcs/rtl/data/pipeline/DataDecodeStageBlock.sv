@@ -6,6 +6,10 @@ module DataDecodeStageBlock (
     // From writeback
     input  logic [4:0]  i_result_addr,
     input  logic [31:0] i_final_result,
+    // From LSU, load results coming back after the instr left
+    input  logic [4:0]  i_late_result_addr,
+    input  logic        i_en_late_write,
+    input  logic [31:0] i_late_result,
     // From control
     input  logic        i_en_regfile_write,
     input  logic [2:0]  i_mux_immext_src,
@@ -22,6 +26,9 @@ module DataDecodeStageBlock (
         .i_a3(i_result_addr),
         .i_we3(i_en_regfile_write),
         .i_wd3(i_final_result),
+        .i_a4(i_late_result_addr),
+        .i_we4(i_en_late_write),
+        .i_wd4(i_late_result),
         .o_rd1(o_rd1),
         .o_rd2(o_rd2)
     );
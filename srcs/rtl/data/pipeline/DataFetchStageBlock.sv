@@ -3,10 +3,16 @@
 module DataFetchStageBlock (
     input  logic        i_clk,
     input  logic        i_rst,         // Active low
-    // From pc adder in exec stage
-    input  logic [31:0] i_pc_ext_addr,
-    // From control
-    input  logic        i_mux_pc_src,
+    // From hazard, exec resolved a branch differently than predicted
+    input  logic        i_redirect,
+    input  logic [31:0] i_redirect_pc, // exec branch target or pc + 4
+    // From exec, resolved branch / jump, predictor update
+    input  logic        i_bp_update_branch,
+    input  logic        i_bp_update_jump,
+    input  logic [31:0] i_bp_update_pc,
+    input  logic        i_bp_update_taken,
+    input  logic [31:0] i_bp_update_target,
+    input  logic [`BP_PHT_IDX_WIDTH - 1 : 0] i_bp_update_idx,
     // From hazard
     input  logic        i_f_en_pc,     // Active high
     input  logic        i_fd_en,
@@ -15,14 +21,35 @@ module DataFetchStageBlock (
     output logic [31:0] o_pc_p_4,
     output logic [31:0] o_pc,
     output logic [31:0] o_instr,
+    // Prediction for the fetched instr, goes down the pipeline with it
+    output logic        o_pred_taken,
+    output logic [31:0] o_pred_target,
+    output logic        o_pred_btb_hit,
+    output logic [`BP_PHT_IDX_WIDTH - 1 : 0] o_pred_idx,
+    // To hazard
+    output logic        o_f_miss,      // instr not available yet, hold pc
+    output logic        o_f_err,       // icache fill got a bus error, being retried
     // ROM - memory stage interface, 32 bits granularity only
     input  logic        i_rom_p2_clk,
     input  logic        i_rom_p2_en,
     input  logic [31:0] i_rom_p2_addr,
     output logic [31:0] o_rom_p2_rd
+`ifdef ICACHE_EN
+    ,
+    // Icache - memory stage interface, refill over wishbone
+    output logic        o_icache_s_en,
+    output logic [31:0] o_icache_s_addr,
+    input  logic        i_icache_s_stall,
+    input  logic        i_icache_s_ack,
+    input  logic        i_icache_s_err,
+    input  logic [31:0] i_icache_s_data
+`endif
 );
 
     parameter ROMADDRWIDTH = $clog2(`ROM_SIZE);
+    localparam ROMSTARTADDR = `ROM_START_ADDR;
+
+    logic [31:0] _rom_instr;
 
     InstrMemory #(
         .SIZE_BYTE(`ROM_SIZE)
@@ -31,21 +58,146 @@ module DataFetchStageBlock (
         .i_fd_en(i_fd_en),
         .i_fd_clr(i_fd_clr),
         .i_a(o_pc[ROMADDRWIDTH - 1 : 0]),
-        .o_rd(o_instr),
+        .o_rd(_rom_instr),
         .i_p2_clk(i_rom_p2_clk),
         .i_p2_en(i_rom_p2_en),
         .i_p2_addr(i_rom_p2_addr[ROMADDRWIDTH - 1 : 0]),
         .o_p2_rd(o_rom_p2_rd) 
     );
 
+`ifdef ICACHE_EN
+    // Fetch from RAM goes through icache, anything else is ROM (low bits only)
+    localparam RAMADDRWIDTH = $clog2(`RAM_SIZE - 1);
+    localparam RAMSTARTADDR = `RAM_START_ADDR;
+    logic        _pc_cacheable;
+    assign _pc_cacheable = (o_pc[31:RAMADDRWIDTH] == RAMSTARTADDR[31:RAMADDRWIDTH]);
+
+    logic [31:0] _icache_instr;
+
+    TwoWaysInstrCache32Bits #(
+        .CACHE_O_CAPACITY_BYTE(`ICACHE_CAPACITY),
+        .CACHE_O_BLOCK_SIZE_BYTE(`ICACHE_BLOCK_SIZE)
+    ) instrCache (
+        .i_clk    (i_clk),
+        .i_rst    (i_rst),
+        .i_f_req  (_pc_cacheable),
+        .i_f_addr (o_pc),
+        .i_f_en   (i_fd_en),
+        .i_f_clr  (i_fd_clr),
+        .o_f_miss (o_f_miss),
+        .o_f_err  (o_f_err),
+        .o_f_instr(_icache_instr),
+        .o_s_en   (o_icache_s_en),
+        .o_s_addr (o_icache_s_addr),
+        .i_s_stall(i_icache_s_stall),
+        .i_s_ack  (i_icache_s_ack),
+        .i_s_err  (i_icache_s_err),
+        .i_s_data (i_icache_s_data)
+    );
+
+    // Which one decode gets, follows fd register rules
+    logic _instr_from_cache;
+    always_ff @(posedge i_clk) begin
+        if (~i_rst)
+            _instr_from_cache <= 1'b0;
+        else if (i_fd_en)
+            _instr_from_cache <= i_fd_clr ? 1'b0 : _pc_cacheable;
+    end
+
+    assign o_instr = _instr_from_cache ? _icache_instr : _rom_instr;
+`else
+    assign o_instr  = _rom_instr;
+    assign o_f_miss = 1'b0;
+    assign o_f_err  = 1'b0;
+`endif
+
+`ifdef BP_EN
+    // ==================================================================================
+    // Branch prediction
+    // BTB: direct mapped, full tag, in flops so lookup is done in fetch cycle (like icache hit).
+    //      Only taken branches / jumps get in. Jump = always taken, jalr gets its last target
+    // PHT: 2 bit saturating counters, index is pc (bimodal) or pc ^ global history (gshare).
+    //      Index goes down with the instr so the update hits the counter used for the prediction,
+    //      history only moves on resolve (exec), so back to back branches see an older one. Fine
+    localparam BTBIDXWIDTH = $clog2(`BP_BTB_ENTRIES);
+    localparam BTBTAGWIDTH = 30 - BTBIDXWIDTH;
+    localparam PHTIDXWIDTH = `BP_PHT_IDX_WIDTH;
+
+    logic                       _btb_valid  [`BP_BTB_ENTRIES - 1 : 0];
+    logic                       _btb_jump   [`BP_BTB_ENTRIES - 1 : 0];
+    logic [BTBTAGWIDTH - 1 : 0] _btb_tag    [`BP_BTB_ENTRIES - 1 : 0];
+    logic [31:0]                _btb_target [`BP_BTB_ENTRIES - 1 : 0];
+    logic [1:0]                 _pht        [`BP_PHT_ENTRIES - 1 : 0];
+    logic [PHTIDXWIDTH - 1 : 0] _ghr;
+
+    // Lookup
+    logic [BTBIDXWIDTH - 1 : 0] _f_btb_idx;
+    logic [BTBTAGWIDTH - 1 : 0] _f_btb_tag;
+    assign {_f_btb_tag, _f_btb_idx} = o_pc[31:2];
+
+    assign o_pred_btb_hit = _btb_valid[_f_btb_idx] & (_btb_tag[_f_btb_idx] == _f_btb_tag);
+`ifdef BP_GSHARE
+    assign o_pred_idx     = o_pc[PHTIDXWIDTH + 1 : 2] ^ _ghr;
+`else
+    assign o_pred_idx     = o_pc[PHTIDXWIDTH + 1 : 2];
+`endif
+    assign o_pred_taken   = o_pred_btb_hit & (_btb_jump[_f_btb_idx] | _pht[o_pred_idx][1]);
+    assign o_pred_target  = _btb_target[_f_btb_idx];
+
+    // Update
+    logic [BTBIDXWIDTH - 1 : 0] _u_btb_idx;
+    logic [BTBTAGWIDTH - 1 : 0] _u_btb_tag;
+    assign {_u_btb_tag, _u_btb_idx} = i_bp_update_pc[31:2];
+
+    always_ff @(posedge i_clk) begin : btb_update
+        if (~i_rst) begin
+            for (int i = 0; i < `BP_BTB_ENTRIES; i++)
+                _btb_valid[i] <= 1'b0;
+        end
+        else if ((i_bp_update_branch | i_bp_update_jump) & i_bp_update_taken) begin
+            _btb_valid[_u_btb_idx]  <= 1'b1;
+            _btb_jump[_u_btb_idx]   <= i_bp_update_jump;
+            _btb_tag[_u_btb_idx]    <= _u_btb_tag;
+            _btb_target[_u_btb_idx] <= i_bp_update_target;
+        end
+    end
+
+    always_ff @(posedge i_clk) begin : pht_update
+        if (~i_rst) begin
+            for (int i = 0; i < `BP_PHT_ENTRIES; i++)
+                _pht[i] <= 2'b01; // weakly not taken
+            _ghr <= 'h0;
+        end
+        else if (i_bp_update_branch) begin
+            if (i_bp_update_taken) begin
+                if (_pht[i_bp_update_idx] != 2'b11)
+                    _pht[i_bp_update_idx] <= _pht[i_bp_update_idx] + 1;
+            end
+            else begin
+                if (_pht[i_bp_update_idx] != 2'b00)
+                    _pht[i_bp_update_idx] <= _pht[i_bp_update_idx] - 1;
+            end
+            _ghr <= {_ghr[PHTIDXWIDTH - 2 : 0], i_bp_update_taken};
+        end
+    end
+`else
+    assign o_pred_btb_hit = 1'b0;
+    assign o_pred_idx     = 'h0;
+    assign o_pred_taken   = 1'b0;
+    assign o_pred_target  = 32'h0;
+`endif
+
     assign o_pc_p_4 = o_pc + 4;
 
+    // Start at ROM link address, code in ROM only used the low bits so it did not matter before,
+    // but pc relative jumps / calls into RAM code need the real one
     always_ff @(posedge i_clk) begin
         if (~i_rst)
-            o_pc <= 0;
+            o_pc <= ROMSTARTADDR;
         else
             if (i_f_en_pc)
-                o_pc <= i_mux_pc_src ? i_pc_ext_addr : o_pc_p_4;
+                o_pc <= i_redirect   ? i_redirect_pc :
+                        o_pred_taken ? o_pred_target : o_pc_p_4;
     end
 
 endmodule
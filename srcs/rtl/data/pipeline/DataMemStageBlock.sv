@@ -24,6 +24,9 @@
  * - Now if the cache were to introduce delay to the way slave ack return to pipeline. The problem must be addressed by
  *   sync the output within the cache state machine itself and not accepting new request before giving out ack.
  *   So as far as the pipeline is concerned, nothing has changed.
+ * - Now request / ack is split like the wishbone side: i_req is taken on the cycle o_memory_stall is low and
+ *   not held after that, acks come back in order. Nothing gets repeated, and a cache hit is taken and acked
+ *   on the next cycle, back to back.
  */
 
 module DataMemStageBlock (
@@ -34,15 +37,26 @@ module DataMemStageBlock (
     input  logic        i_we,
     input  logic [1:0]  i_mask_type,
     input  logic        i_ext_type,
+    input  logic [4:0]  i_tag,            // Request tag (load destination), given back with ack
     // From exec
     input  logic [31:0] i_memory_address,
     input  logic [31:0] i_memory_data,
+    // Address of next cycle's request, best guess. Dcache looks its tags up one cycle early with it
+    input  logic [31:0] i_next_memory_address,
+    // Perf counter events from pipeline: {mispredict, fetch wait, mem wait, exec bubble, decode stall, retired}
+    input  logic [5:0]  i_perf_events,
     // To Writeback
     output logic [31:0] o_memory_readout,
     // To Hazard
     // Ack when data is ready in read mode, or being writen in wire mode, not when request is accepted
     // Needed for stalling arbitrary cycle, currently if invalid address stall indefinitely
     output logic        o_memory_ack,
+    // Tag of the acked request. Bus acks in order and there is one request at a time here
+    output logic [4:0]  o_memory_tag,
+    // Request not taken this cycle, hold it
+    output logic        o_memory_stall,
+    // Request taken and acked next cycle for sure (cache hit)
+    output logic        o_memory_hit,
     // Not know what to do yet
     output logic        o_memory_err,
     // Connect to instr mem port 2
@@ -50,6 +64,16 @@ module DataMemStageBlock (
     output logic        o_rom_p2_en,
     output logic [31:0] o_rom_p2_addr,
     input  logic [31:0] i_rom_p2_rd
+`ifdef ICACHE_EN
+    ,
+    // Icache refill, read only, from fetch stage
+    input  logic        i_icache_en,
+    input  logic [31:0] i_icache_addr,
+    output logic        o_icache_stall,
+    output logic        o_icache_ack,
+    output logic        o_icache_err,
+    output logic [31:0] o_icache_data
+`endif
 `ifndef BRAM_AS_RAM
     ,
     input  logic        i_ram_clk,
@@ -96,6 +120,9 @@ module DataMemStageBlock (
     logic [31:0] _mem_cache_data;
     logic [1:0]  _mem_cache_mask;
     // These will be muxed with output from WB master to mem
+    logic        _cache_mem_stall;
+    logic        _cache_mem_hit;
+    logic        _cache_mem_miss;
     logic        _cache_mem_ack;
     logic        _cache_mem_err;
     logic [31:0] _cache_mem_data;
@@ -106,7 +133,9 @@ module DataMemStageBlock (
     logic [31:0] _cache_wb_addr;
     logic [31:0] _cache_wb_data;
     logic [1:0]  _cache_wb_mask;
+    logic        _cache_wb_busy;
     // From wb master output
+    logic        _wb_cache_stall;
     logic        _wb_cache_ack;
     logic        _wb_cache_err;
     logic [31:0] _wb_cache_data;
@@ -118,14 +147,16 @@ module DataMemStageBlock (
     assign _mem_cache_addr = i_memory_address;
     assign _mem_cache_data = i_memory_data;
     assign _mem_cache_mask = i_mask_type;
-    // From WB master
-    assign _wb_cache_ack   = _wbmaster_mem_o_ack;
-    assign _wb_cache_err   = _wbmaster_mem_o_err;
+    // From WB master, held off while a non-cacheable access owns it
+    assign _wb_cache_stall = _wbmaster_mem_o_stall | _direct_own;
+    assign _wb_cache_ack   = _wbmaster_mem_o_ack & ~_direct_sent;
+    assign _wb_cache_err   = _wbmaster_mem_o_err & ~_direct_sent;
     assign _wb_cache_data  = _wbmaster_mem_o_rd;
 
-    TwoWaysCache32Bits #(
+    NWaysCache32Bits #(
         .CACHE_O_CAPACITY_BYTE(`DCACHE_CAPACITY),
-        .CACHE_O_BLOCK_SIZE_BYTE(`DCACHE_BLOCK_SIZE)
+        .CACHE_O_BLOCK_SIZE_BYTE(`DCACHE_BLOCK_SIZE),
+        .CACHE_O_WAYS(`DCACHE_WAYS)
     ) dataCache (
         .i_clk        (i_clk),
         .i_rst        (i_rst),
@@ -135,6 +166,10 @@ module DataMemStageBlock (
         .i_m_addr     (_mem_cache_addr),
         .i_m_data     (_mem_cache_data),
         .i_m_mask_type(_mem_cache_mask),
+        .i_m_next_addr(i_next_memory_address),
+        .o_m_stall    (_cache_mem_stall),
+        .o_m_hit      (_cache_mem_hit),
+        .o_m_miss     (_cache_mem_miss),
         .o_m_ack      (_cache_mem_ack),
         .o_m_err      (_cache_mem_err),
         .o_m_data     (_cache_mem_data),
@@ -144,9 +179,11 @@ module DataMemStageBlock (
         .o_s_addr     (_cache_wb_addr),
         .o_s_data     (_cache_wb_data),
         .o_s_mask_type(_cache_wb_mask),
+        .i_s_stall    (_wb_cache_stall),
         .i_s_ack      (_wb_cache_ack),
         .i_s_err      (_wb_cache_err),
-        .i_s_data     (_wb_cache_data)
+        .i_s_data     (_wb_cache_data),
+        .o_s_busy     (_cache_wb_busy)
     ); 
 `endif
 
@@ -173,11 +210,14 @@ module DataMemStageBlock (
     logic [31:0] _wbmaster_mem_i_mem_addr;
     logic [31:0] _wbmaster_mem_i_wd;
     logic [1:0]  _wbmaster_mem_i_mask_type;
+    logic        _wbmaster_mem_o_stall;
     logic        _wbmaster_mem_o_ack;
     logic        _wbmaster_mem_o_err;
     logic [31:0] _wbmaster_mem_o_rd;
 
     // Outputs out of mem stage
+    logic        _mem_op_stall;
+    logic        _mem_op_hit;
     logic        _mem_op_ack;
     // Wishbone master error signal will be or-ed with other access signals to indicate
     // valid access request, else set error output for mem stage high
@@ -185,10 +225,31 @@ module DataMemStageBlock (
     // Readout is used for extension
     logic [31:0] _mem_op_readout;
 
+    // Master takes a request every cycle en is high and it is not stalling. One non-cacheable access
+    // at a time, the next one is stalled until the ack
+    logic _direct_sent;
+    // Non-cacheable access owns the master: sent and waiting for ack, or about to be sent.
+    // Cache acks a miss before its refill / write back is over, so it only goes when the cache is off the bus
+    logic _direct_own;
+`ifdef DCACHE_EN
+    assign _direct_own = _direct_sent | (i_req & ~_cachable_access & ~_cache_wb_busy);
+`else
+    assign _direct_own = 1'b1;
+`endif
+
+    always_ff @(posedge i_clk) begin : direct_request_sent
+        if (~i_rst)
+            _direct_sent <= 1'b0;
+        else if (_direct_own & _wbmaster_mem_i_en & ~_wbmaster_mem_o_stall)
+            _direct_sent <= 1'b1;
+        else if (_wbmaster_mem_o_ack | _wbmaster_mem_o_err)
+            _direct_sent <= 1'b0;
+    end
+
     // Assigns
     always_comb begin : wb_master_input_mux
 `ifdef DCACHE_EN
-        if (_cachable_access) begin
+        if (~_direct_own) begin
             _wbmaster_mem_i_en        = _cache_wb_en;
             _wbmaster_mem_i_we        = _cache_wb_we;
             _wbmaster_mem_i_mem_addr  = _cache_wb_addr;
@@ -198,7 +259,7 @@ module DataMemStageBlock (
         else 
 `endif
         begin
-            _wbmaster_mem_i_en        = i_req;
+            _wbmaster_mem_i_en        = i_req & ~_direct_sent;
             _wbmaster_mem_i_we        = i_we;
             _wbmaster_mem_i_mem_addr  = i_memory_address;
             _wbmaster_mem_i_wd        = i_memory_data;
@@ -206,9 +267,22 @@ module DataMemStageBlock (
         end
     end
 
+    // Stall / hit are for the request presented now, ack / readout for whichever was taken before,
+    // so these are not muxed by the current address
     always_comb begin : mem_stage_output_mux
 `ifdef DCACHE_EN
         if (_cachable_access) begin
+            _mem_op_stall   = _cache_mem_stall;
+            _mem_op_hit     = _cache_mem_hit;
+        end
+        else
+`endif
+        begin
+            _mem_op_stall   = ~_direct_own | _direct_sent | _wbmaster_mem_o_stall;
+            _mem_op_hit     = 1'b0;
+        end
+`ifdef DCACHE_EN
+        if (_cache_mem_ack | _cache_mem_err) begin
             _mem_op_ack     = _cache_mem_ack;
             _mem_op_err     = _cache_mem_err;
             _mem_op_readout = _cache_mem_data;
@@ -216,14 +290,16 @@ module DataMemStageBlock (
         else
 `endif
         begin
-            _mem_op_ack     = _wbmaster_mem_o_ack;
-            _mem_op_err     = _wbmaster_mem_o_err;
+            _mem_op_ack     = _wbmaster_mem_o_ack & _direct_sent;
+            _mem_op_err     = _wbmaster_mem_o_err & _direct_sent;
             _mem_op_readout = _wbmaster_mem_o_rd;
         end
     end
 
     // Memory bus master
-    DataMemWBMaster dataMemWBMaster(
+    DataMemWBMaster #(
+        .WB_O_MAX_OUTSTANDING(`WB_MAX_OUTSTANDING)
+    ) dataMemWBMaster (
         .i_clk          (i_clk),
         .i_rst          (i_rst),
         // WB IOs
@@ -243,11 +319,54 @@ module DataMemStageBlock (
         .i_mem_addr     (_wbmaster_mem_i_mem_addr),
         .i_mem_wd       (_wbmaster_mem_i_wd),
         .i_mem_mask_type(_wbmaster_mem_i_mask_type),
+        .o_mem_stall    (_wbmaster_mem_o_stall),
         .o_mem_ack      (_wbmaster_mem_o_ack),
         .o_mem_err      (_wbmaster_mem_o_err),
         .o_mem_rd       (_wbmaster_mem_o_rd)  
     );
 
+`ifdef ICACHE_EN
+    // Second master for icache refill, same pipelining
+    logic [31:0] _icmaster_wb_i_data;
+    logic        _icmaster_wb_i_stall;
+    logic        _icmaster_wb_i_ack;
+    logic        _icmaster_wb_i_err;
+    logic [3:0]  _icmaster_wb_o_sel;
+    logic [31:0] _icmaster_wb_o_addr;
+    logic [31:0] _icmaster_wb_o_data;
+    logic        _icmaster_wb_o_cyc;
+    logic        _icmaster_wb_o_stb;
+    logic        _icmaster_wb_o_we;
+
+    DataMemWBMaster #(
+        .WB_O_MAX_OUTSTANDING(`WB_MAX_OUTSTANDING)
+    ) instrMemWBMaster (
+        .i_clk          (i_clk),
+        .i_rst          (i_rst),
+        // WB IOs
+        .o_wb_cyc       (_icmaster_wb_o_cyc),
+        .o_wb_stb       (_icmaster_wb_o_stb),
+        .o_wb_sel       (_icmaster_wb_o_sel),
+        .o_wb_addr      (_icmaster_wb_o_addr),
+        .o_wb_data      (_icmaster_wb_o_data),
+        .o_wb_we        (_icmaster_wb_o_we),
+        .i_wb_data      (_icmaster_wb_i_data),
+        .i_wb_stall     (_icmaster_wb_i_stall),
+        .i_wb_ack       (_icmaster_wb_i_ack),
+        .i_wb_err       (_icmaster_wb_i_err),
+        // Icache interface
+        .i_mem_en       (i_icache_en),
+        .i_mem_we       (1'b0),
+        .i_mem_addr     (i_icache_addr),
+        .i_mem_wd       (32'h0),
+        .i_mem_mask_type(2'b10),
+        .o_mem_stall    (o_icache_stall),
+        .o_mem_ack      (o_icache_ack),
+        .o_mem_err      (o_icache_err),
+        .o_mem_rd       (o_icache_data)
+    );
+`endif
+
     // WISHBONE MASTER ARBITER
     // ==================================================================================
     // Wishbone arbiter interface
@@ -276,11 +395,24 @@ module DataMemStageBlock (
 	logic        _slave_arb_ack;
 	logic        _slave_arb_err;
     
+	// Master interface assign
+    // Add more master line here if needed
+`ifdef ICACHE_EN
+    // 1: icache refill
+	assign {_icmaster_wb_i_data,  _wbmaster_wb_i_data}  = _arb_master_data;
+	assign {_icmaster_wb_i_stall, _wbmaster_wb_i_stall} = _arb_master_stall;
+	assign {_icmaster_wb_i_ack,   _wbmaster_wb_i_ack}   = _arb_master_ack;
+	assign {_icmaster_wb_i_err,   _wbmaster_wb_i_err}   = _arb_master_err;
+	assign _master_arb_sel  = {_icmaster_wb_o_sel,  _wbmaster_wb_o_sel};
+	assign _master_arb_addr = {_icmaster_wb_o_addr, _wbmaster_wb_o_addr};
+	assign _master_arb_data = {_icmaster_wb_o_data, _wbmaster_wb_o_data};
+	assign _master_arb_cyc  = {_icmaster_wb_o_cyc,  _wbmaster_wb_o_cyc};
+	assign _master_arb_stb  = {_icmaster_wb_o_stb,  _wbmaster_wb_o_stb};
+	assign _master_arb_we   = {_icmaster_wb_o_we,   _wbmaster_wb_o_we};
+`else
     logic [31:0] unused32_0;
     logic unused1_0, unused1_1, unused1_2;
 
-	// Master interface assign
-    // Add more master line here if needed
 	assign {unused32_0, _wbmaster_wb_i_data} = _arb_master_data;
 	assign {unused1_0, _wbmaster_wb_i_stall} = _arb_master_stall;
 	assign {unused1_1, _wbmaster_wb_i_ack}   = _arb_master_ack;
@@ -291,6 +423,7 @@ module DataMemStageBlock (
 	assign _master_arb_cyc  = {1'b0,  _wbmaster_wb_o_cyc};
 	assign _master_arb_stb  = {1'b0,  _wbmaster_wb_o_stb};
 	assign _master_arb_we   = {1'b0,  _wbmaster_wb_o_we};
+`endif
     
     // Slave signal coming to arbiter must be or-ed here
     // Non active slave must output 0
@@ -316,6 +449,12 @@ module DataMemStageBlock (
         _slave_arb_stall = _slave_arb_stall | _HDMI_o_stall;
         _slave_arb_ack   = _slave_arb_ack   | _HDMI_o_ack;
         _slave_arb_err   = _slave_arb_err   | _HDMI_o_err;
+`endif
+`ifdef PERF_EN
+        _slave_arb_data  = _slave_arb_data  | _PERF_o_data;
+        _slave_arb_stall = _slave_arb_stall | _PERF_o_stall;
+        _slave_arb_ack   = _slave_arb_ack   | _PERF_o_ack;
+        _slave_arb_err   = _slave_arb_err   | _PERF_o_err;
 `endif
     end
 
@@ -354,6 +493,8 @@ module DataMemStageBlock (
     // Addressing scheme:
     // Pass full address to module (include address partition)
     // The module will do the extraction of real address, discarding partition part
+    // Slave cyc / stb decode the bus address, not the mem stage one: a cache write back
+    // goes to where the old block came from
 
 `ifdef DCACHE_EN
     // =======================================
@@ -383,8 +524,10 @@ module DataMemStageBlock (
     logic        _ROM_o_stall;
     logic [31:0] _ROM_o_data;
 
-    assign _ROM_i_cyc = _rom_addr_access & _arb_slave_cyc;
-    assign _ROM_i_stb = _rom_addr_access & _arb_slave_stb;
+    logic  _rom_bus_access;
+    assign _rom_bus_access = (_arb_slave_addr[31:ROMADDRWIDTH] == ROMSTARTADDR[31:ROMADDRWIDTH]);
+    assign _ROM_i_cyc = _rom_bus_access & _arb_slave_cyc;
+    assign _ROM_i_stb = _rom_bus_access & _arb_slave_stb;
 
     ROMWB #(
         .SIZE_BYTE(`ROM_SIZE),
@@ -421,9 +564,12 @@ module DataMemStageBlock (
     logic        _RAM_o_err;
     logic        _RAM_o_stall;
     logic [31:0] _RAM_o_data;
+    logic        _RAM_o_refresh_stall; // SDRAM only
 
-    assign _RAM_i_cyc = _ram_addr_access & _arb_slave_cyc;
-    assign _RAM_i_stb = _ram_addr_access & _arb_slave_stb;
+    logic  _ram_bus_access;
+    assign _ram_bus_access = (_arb_slave_addr[31:RAMADDRWIDTH] == RAMSTARTADDR[31:RAMADDRWIDTH]);
+    assign _RAM_i_cyc = _ram_bus_access & _arb_slave_cyc;
+    assign _RAM_i_stb = _ram_bus_access & _arb_slave_stb;
 
 `ifdef BRAM_AS_RAM
     BRAMWB #(
@@ -458,6 +604,7 @@ module DataMemStageBlock (
         .o_wb_err  (_RAM_o_err),
         .o_wb_data (_RAM_o_data),
         .o_wb_stall(_RAM_o_stall),
+        .o_wb_refresh_stall(_RAM_o_refresh_stall),
         // Remember to change freq inside
         .i_ram_clk (i_ram_clk),
         .o_ram_ras (o_ram_ras),
@@ -491,8 +638,10 @@ module DataMemStageBlock (
     logic        _BRAM_o_stall;
     logic [31:0] _BRAM_o_data;
 
-    assign _BRAM_i_cyc = _bram_addr_access & _arb_slave_cyc;
-    assign _BRAM_i_stb = _bram_addr_access & _arb_slave_stb;
+    logic  _bram_bus_access;
+    assign _bram_bus_access = (_arb_slave_addr[31:BRAMADDRWIDTH] == BRAMSTARTADDR[31:BRAMADDRWIDTH]);
+    assign _BRAM_i_cyc = _bram_bus_access & _arb_slave_cyc;
+    assign _BRAM_i_stb = _bram_bus_access & _arb_slave_stb;
 
     BRAMWB #(
 		.SIZE_BYTE(`BRAM_SIZE),
@@ -529,8 +678,10 @@ module DataMemStageBlock (
     logic        _GPIO_o_stall;
     logic [31:0] _GPIO_o_data;
 
-    assign _GPIO_i_cyc = _gpio_addr_access & _arb_slave_cyc;
-    assign _GPIO_i_stb = _gpio_addr_access & _arb_slave_stb;
+    logic  _gpio_bus_access;
+    assign _gpio_bus_access = (_arb_slave_addr[31:GPIOADDRWIDTH] == GPIOSTARTADDR[31:GPIOADDRWIDTH]);
+    assign _GPIO_i_cyc = _gpio_bus_access & _arb_slave_cyc;
+    assign _GPIO_i_stb = _gpio_bus_access & _arb_slave_stb;
 
     GPIOWB #(
         .SIZE_BIT(32),
@@ -570,8 +721,10 @@ module DataMemStageBlock (
     logic        _HDMI_o_stall;
     logic [31:0] _HDMI_o_data;
 
-    assign _HDMI_i_cyc = _hdmi_addr_access & _arb_slave_cyc;
-    assign _HDMI_i_stb = _hdmi_addr_access & _arb_slave_stb;
+    logic  _hdmi_bus_access;
+    assign _hdmi_bus_access = (_arb_slave_addr[31:HDMIADDRWIDTH] == HDMISTARTADDR[31:HDMIADDRWIDTH]);
+    assign _HDMI_i_cyc = _hdmi_bus_access & _arb_slave_cyc;
+    assign _HDMI_i_stb = _hdmi_bus_access & _arb_slave_stb;
 
     HDMIController480p #(
         .START_ADDR(`HDMI_START_ADDR)
@@ -596,6 +749,65 @@ module DataMemStageBlock (
     );
 `endif /* HDMI_EN */
 
+`ifdef PERF_EN
+    // =======================================
+    // PERF COUNTERS
+    logic _perf_addr_access;
+    localparam PERFADDRWIDTH = $clog2(((`PERF_N_COUNTERS + 1) << 2) - 1); // + CTRL
+    localparam PERFSTARTADDR = `PERF_START_ADDR;
+    // Should check upper bound too
+    assign _perf_addr_access = ((i_memory_address[31:PERFADDRWIDTH] == PERFSTARTADDR[31:PERFADDRWIDTH]) ? 1 : 0);
+
+    // PERF wishbone IOs
+    logic        _PERF_i_cyc;
+    logic        _PERF_i_stb;
+    logic        _PERF_o_ack;
+    logic        _PERF_o_err;
+    logic        _PERF_o_stall;
+    logic [31:0] _PERF_o_data;
+
+    logic  _perf_bus_access;
+    assign _perf_bus_access = (_arb_slave_addr[31:PERFADDRWIDTH] == PERFSTARTADDR[31:PERFADDRWIDTH]);
+    assign _PERF_i_cyc = _perf_bus_access & _arb_slave_cyc;
+    assign _PERF_i_stb = _perf_bus_access & _arb_slave_stb;
+
+    // Event map, same order as addr.h:
+    //  0 cycles, 1 retired, 2 decode stall, 3 exec bubble, 4 mem wait, 5 fetch wait (icache miss),
+    //  6 mispredict, 7 dcache hit, 8 dcache miss, 9 SDRAM refresh stall
+    logic _perf_dcache_hit, _perf_dcache_miss, _perf_refresh_stall;
+`ifdef DCACHE_EN
+    assign _perf_dcache_hit  = _cache_mem_hit;
+    assign _perf_dcache_miss = _cache_mem_miss;
+`else
+    assign _perf_dcache_hit  = 1'b0;
+    assign _perf_dcache_miss = 1'b0;
+`endif
+`ifdef BRAM_AS_RAM
+    assign _perf_refresh_stall = 1'b0;
+`else
+    assign _perf_refresh_stall = _RAM_o_refresh_stall;
+`endif
+
+    PerfCountersWB #(
+        .N_COUNTERS(`PERF_N_COUNTERS),
+        .START_ADDR(`PERF_START_ADDR)
+    ) PERF (
+        .i_clk(i_clk),
+        .i_rst(i_rst),
+        .i_cyc(_PERF_i_cyc),
+        .i_stb(_PERF_i_stb),
+        .i_addr(_arb_slave_addr),
+        .i_we(_arb_slave_we),
+        .i_data(_arb_slave_data),
+        .i_sel(_arb_slave_sel),
+        .o_ack(_PERF_o_ack),
+        .o_err(_PERF_o_err),
+        .o_data(_PERF_o_data),
+        .o_stall(_PERF_o_stall),
+        .i_events({_perf_refresh_stall, _perf_dcache_miss, _perf_dcache_hit, i_perf_events, 1'b1})
+    );
+`endif /* PERF_EN */
+
 
     // =======================================
     // Other signals
@@ -613,31 +825,36 @@ module DataMemStageBlock (
 `endif
 `ifdef HDMI_EN
         _access_valid = _access_valid | _hdmi_addr_access;
+`endif
+`ifdef PERF_EN
+        _access_valid = _access_valid | _perf_addr_access;
 `endif
         _access_valid = _access_valid & i_req;
     end
 
-    assign o_memory_ack = _mem_op_ack;
-    assign o_memory_err = _mem_op_err | ~_access_valid; // or with other errors
+    assign o_memory_stall = _mem_op_stall;
+    assign o_memory_hit   = _mem_op_hit;
+    assign o_memory_ack   = _mem_op_ack;
+    assign o_memory_err   = _mem_op_err | (i_req & ~_access_valid); // or with other errors
 
     // =======================================
     // Output extension
     // Keeping here in case another module with direct access to mem interface is needed
     // should move into wb master if use solely wb
     // though output of that should be ored with wishbone bus readout
-    // THIS ASSUME I_REQ DOES NOT CHANGE DURING REQUESTS (UNTIL ACK)
-    // AND READ TAKES AT LEAST 1 CYCLE
-    // Wishbone bus can only return data after 1+ cycle so use this in extension logic
-    // Should really tie i_req and o_memory_ack together... state machine?
-    // In this state one can mistakenly triggered a request before previous ack -> bug
+    // Saved when the request is taken, READ TAKES AT LEAST 1 CYCLE so the ack uses these
+    // before the next taken request overwrites them
     logic [1:0] _mask_type_saved;
     logic       _ext_type_saved;
+    logic [4:0] _tag_saved;
     always_ff @(posedge i_clk) begin
-        if(i_req) begin
+        if(i_req & ~o_memory_stall) begin
             _mask_type_saved <= i_mask_type;
             _ext_type_saved  <= i_ext_type;
+            _tag_saved       <= i_tag;
         end
     end
+    assign o_memory_tag = _tag_saved;
     // Sign extend
     always_comb begin
         if(o_memory_ack) begin
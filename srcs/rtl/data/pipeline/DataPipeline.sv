@@ -5,6 +5,8 @@ module DataPipeline (
     input  logic       i_rst,
     // From control
     input  logic       i_mux_pc_src,
+    input  logic       i_e_branch,    // Exec instr kind, predictor update
+    input  logic       i_e_jump,
     input  logic       i_en_regfile_write,
     input  logic [2:0] i_mux_immext_src,
     input  logic       i_mux_pc_adder_src,
@@ -34,6 +36,8 @@ module DataPipeline (
     input  logic       i_fd_clr,      // Clear fetch -> decode registers
     input  logic       i_de_clr,      // Clear decode -> exec registers
     input  logic       i_mw_clr,      // Clear mem -> write register
+    //   Branch
+    input  logic       i_redirect,    // Exec mispredicted, pc <- exec result
     // To hazard
     //   Forward
     output logic [4:0] o_e_rs1,
@@ -41,10 +45,21 @@ module DataPipeline (
     output logic [4:0] o_m_rd,
     output logic [4:0] o_w_rd,
     //   Stall
+    output logic       o_f_miss,      // Fetch waiting on icache
     output logic [4:0] o_d_rs1,
     output logic [4:0] o_d_rs2,
+    output logic [4:0] o_d_rd,
     output logic [4:0] o_e_rd,
-    output logic       o_m_ack
+    output logic       o_m_ack,
+    output logic       o_m_hit,       // Mem access taken this cycle, acked next one
+    output logic       o_lsu_busy,
+    output logic       o_lsu_ret,     // Load result written this cycle
+    output logic [4:0] o_lsu_ret_rd,
+    //   Branch
+    output logic       o_e_pred_taken,
+    output logic       o_e_pred_target_match,
+    // Perf counters, stall causes from hazard
+    input  logic [3:0] i_perf_stall
 `ifndef BRAM_AS_RAM
     ,
     input  logic        i_ram_clk,
@@ -83,6 +98,9 @@ module DataPipeline (
     // Fetch stage
     // Register file will be connected straight into f_instr
     logic [31:0] f_instr, f_pc, f_pc_p_4;
+    logic        f_pred_taken, f_pred_btb_hit;
+    logic [31:0] f_pred_target;
+    logic [`BP_PHT_IDX_WIDTH - 1 : 0] f_pred_idx;
     // Decode stage
     // Because register file read / write needs 1 cycle, so we need to buffer / delay
     // Before passing to exec
@@ -92,6 +110,9 @@ module DataPipeline (
     logic [31:0] d_pc, d_pc_p_4;
     logic [31:0] d_immext;
     logic [4:0]  d_rs1, d_rs2, d_rd;
+    logic        d_pred_taken, d_pred_btb_hit;
+    logic [31:0] d_pred_target;
+    logic [`BP_PHT_IDX_WIDTH - 1 : 0] d_pred_idx;
     // Exec stage
     logic [31:0] e_rd1, e_rd2;
     logic [31:0] e_immext;
@@ -104,14 +125,38 @@ module DataPipeline (
     logic [4:0]  e_rs1, e_rs2, e_rd;
     logic [31:0] e_alu_result;
     logic [31:0] e_mem_data;
+    logic        e_pred_taken, e_pred_btb_hit;
+    logic [31:0] e_pred_target;
+    logic [`BP_PHT_IDX_WIDTH - 1 : 0] e_pred_idx;
+    logic [31:0] e_redirect_pc;
+    logic [31:0] e_instr; // retire trace only
     // Mem stage, also need delay buffer
     logic [31:0] m_alu_result;
     logic [31:0] m_mem_data;
     logic [31:0] m_pc_p_4;
+    logic [31:0] m_instr; // retire trace only
     logic [4:0]  m_rd;
     logic [31:0] m_immext;
     logic [31:0] m_memory_readout;
     logic        m_memory_ack;
+    logic [4:0]  m_memory_tag;
+    logic        m_memory_stall;
+    logic        m_memory_hit;
+    // Load store unit
+    logic        lsu_busy, lsu_sent, lsu_take;
+    logic        lsu_we, lsu_ext;
+    logic [1:0]  lsu_mask;
+    logic [31:0] lsu_addr, lsu_data;
+    logic [4:0]  lsu_rd;
+    logic        lsu_ret;
+    // What mem stage block sees
+    logic        mem_req, mem_we, mem_ext;
+    logic [1:0]  mem_mask;
+    logic [31:0] mem_addr, mem_data;
+    logic [4:0]  mem_tag;
+    logic [31:0] mem_next_addr;
+    // Perf counter events
+    logic [5:0]  perf_events;
     // Writeback stage
     logic [31:0] w_memory_readout;
     logic [31:0] w_alu_result;
@@ -127,6 +172,7 @@ module DataPipeline (
     //   Hazard
     assign o_d_rs1 = d_rs1;
     assign o_d_rs2 = d_rs2;
+    assign o_d_rd  = d_rd;
 
     assign o_e_rs1 = e_rs1;
     assign o_e_rs2 = e_rs2;
@@ -134,29 +180,69 @@ module DataPipeline (
 
     assign o_m_rd  = m_rd;
     assign o_m_ack = m_memory_ack;
+    assign o_m_hit = m_memory_hit & lsu_take;
+
+    assign o_lsu_busy   = lsu_busy;
+    assign o_lsu_ret    = lsu_ret;
+    assign o_lsu_ret_rd = m_memory_tag;
 
     assign o_w_rd  = w_rd;
 
+    assign o_e_pred_taken        = e_pred_taken;
+    assign o_e_pred_target_match = (pc_adder_result == e_pred_target);
+
     // ====================================================================================
 
     logic _rom_p2_clk, _rom_p2_en;
     logic [31:0] _rom_p2_addr, _rom_p2_rd;
+`ifdef ICACHE_EN
+    logic        _icache_en, _icache_stall, _icache_ack, _icache_err;
+    logic [31:0] _icache_addr, _icache_data;
+`endif
+
+    // Icache fill bus error, fetch retries it (no fetch fault), harness reports it
+    logic f_fetch_err
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
 
     DataFetchStageBlock dataFetchStageBlock (
         .i_clk(i_clk),
         .i_rst(i_rst),
-        .i_pc_ext_addr(pc_adder_result),
-        .i_mux_pc_src(i_mux_pc_src),
+        .i_redirect(i_redirect),
+        .i_redirect_pc(e_redirect_pc),
+        .i_bp_update_branch(i_e_branch),
+        .i_bp_update_jump(i_e_jump),
+        .i_bp_update_pc(e_pc),
+        .i_bp_update_taken(i_mux_pc_src),
+        .i_bp_update_target(pc_adder_result),
+        .i_bp_update_idx(e_pred_idx),
         .i_f_en_pc(i_f_en_pc),
         .i_fd_en(i_fd_en),
         .i_fd_clr(i_fd_clr),
         .o_pc_p_4(f_pc_p_4),
         .o_pc(f_pc),
         .o_instr(f_instr),
+        .o_pred_taken(f_pred_taken),
+        .o_pred_target(f_pred_target),
+        .o_pred_btb_hit(f_pred_btb_hit),
+        .o_pred_idx(f_pred_idx),
+        .o_f_miss(o_f_miss),
+        .o_f_err(f_fetch_err),
         .i_rom_p2_clk(_rom_p2_clk),
         .i_rom_p2_en(_rom_p2_en),
         .i_rom_p2_addr(_rom_p2_addr),
         .o_rom_p2_rd(_rom_p2_rd)
+`ifdef ICACHE_EN
+        ,
+        .o_icache_s_en(_icache_en),
+        .o_icache_s_addr(_icache_addr),
+        .i_icache_s_stall(_icache_stall),
+        .i_icache_s_ack(_icache_ack),
+        .i_icache_s_err(_icache_err),
+        .i_icache_s_data(_icache_data)
+`endif
     );
 
     DataDecodeStageBlock dataDecodeStageBlock (
@@ -166,6 +252,9 @@ module DataPipeline (
         .i_result_addr(w_rd),
         .i_en_regfile_write(i_en_regfile_write),
         .i_final_result(w_final_result),
+        .i_late_result_addr(m_memory_tag),
+        .i_en_late_write(lsu_ret),
+        .i_late_result(m_memory_readout),
         .i_mux_immext_src(i_mux_immext_src),
         .o_rd1(d_rd1),
         .o_rd2(d_rd2),
@@ -197,19 +286,34 @@ module DataPipeline (
     DataMemStageBlock dataMemStageBlock (
         .i_clk(i_clk),
         .i_rst(i_rst),
-        .i_req(i_en_datamem_access),
-        .i_we(i_en_datamem_write),
-        .i_mask_type(i_mask_type),
-        .i_ext_type(i_ext_type),
-        .i_memory_address(m_alu_result),
-        .i_memory_data(m_mem_data),
+        .i_req(mem_req),
+        .i_we(mem_we),
+        .i_mask_type(mem_mask),
+        .i_ext_type(mem_ext),
+        .i_tag(mem_tag),
+        .i_memory_address(mem_addr),
+        .i_memory_data(mem_data),
+        .i_next_memory_address(mem_next_addr),
+        .i_perf_events(perf_events),
         .o_memory_readout(m_memory_readout),
         .o_memory_ack(m_memory_ack),
+        .o_memory_tag(m_memory_tag),
+        .o_memory_stall(m_memory_stall),
+        .o_memory_hit(m_memory_hit),
         .o_memory_err(_err_unused),
         .o_rom_p2_clk(_rom_p2_clk),
         .o_rom_p2_en(_rom_p2_en),
         .o_rom_p2_addr(_rom_p2_addr),
         .i_rom_p2_rd(_rom_p2_rd)
+`ifdef ICACHE_EN
+        ,
+        .i_icache_en(_icache_en),
+        .i_icache_addr(_icache_addr),
+        .o_icache_stall(_icache_stall),
+        .o_icache_ack(_icache_ack),
+        .o_icache_err(_icache_err),
+        .o_icache_data(_icache_data)
+`endif
 `ifndef BRAM_AS_RAM
         ,
         .i_ram_clk(i_ram_clk),
@@ -271,6 +375,10 @@ module DataPipeline (
             // d_instr  <= i_fd_clr ? 32'd0 : f_instr;
             d_pc     <= i_fd_clr ? 32'd0 : f_pc;
             d_pc_p_4 <= i_fd_clr ? 32'd0 : f_pc_p_4;
+            d_pred_taken   <= i_fd_clr ? 1'b0  : f_pred_taken;
+            d_pred_target  <= i_fd_clr ? 32'd0 : f_pred_target;
+            d_pred_btb_hit <= i_fd_clr ? 1'b0  : f_pred_btb_hit;
+            d_pred_idx     <= i_fd_clr ?  'h0  : f_pred_idx;
         end
     end
 
@@ -281,8 +389,55 @@ module DataPipeline (
         e_rs1    <= i_de_clr ?  5'd0 : d_rs1;
         e_rs2    <= i_de_clr ?  5'd0 : d_rs2;
         e_rd     <= i_de_clr ?  5'd0 : d_rd;
+        e_pred_taken   <= i_de_clr ? 1'b0  : d_pred_taken;
+        e_pred_target  <= i_de_clr ? 32'd0 : d_pred_target;
+        e_pred_btb_hit <= i_de_clr ? 1'b0  : d_pred_btb_hit;
+        e_pred_idx     <= i_de_clr ?  'h0  : d_pred_idx;
+        e_instr        <= i_de_clr ? 32'd0 : d_instr;
     end
 
+    // Where fetch should have gone after the exec instr, used on mispredict
+    assign e_redirect_pc = i_mux_pc_src ? pc_adder_result : e_pc_p_4;
+
+    // ====================================================================================
+    // Branch prediction counters, read from harness
+    logic [31:0] bp_cf_cnt          // branches + jumps resolved
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [31:0] bp_btb_hit_cnt     // of those, found in BTB at fetch
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [31:0] bp_mispredict_cnt  // redirects from exec (every taken one without prediction)
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+
+    always_ff @(posedge i_clk) begin : bp_counters
+        if (~i_rst) begin
+            bp_cf_cnt         <= 32'd0;
+            bp_btb_hit_cnt    <= 32'd0;
+            bp_mispredict_cnt <= 32'd0;
+        end
+        else begin
+            if (i_e_branch | i_e_jump) begin
+                bp_cf_cnt <= bp_cf_cnt + 1;
+                if (e_pred_btb_hit)
+                    bp_btb_hit_cnt <= bp_btb_hit_cnt + 1;
+            end
+            if (i_redirect)
+                bp_mispredict_cnt <= bp_mispredict_cnt + 1;
+        end
+    end
+
+    // Perf counter events, see DataMemStageBlock for the map
+    // Retired: instr leaving mem (loads when handed to LSU), bubbles have pc 0
+    assign perf_events = {i_redirect, i_perf_stall, i_em_en & (m_pc_p_4 != 32'd0)};
+
     always_ff @(posedge i_clk) begin : e2m
         if (i_em_en) begin
             m_rd         <= e_rd;
@@ -290,6 +445,54 @@ module DataPipeline (
             m_alu_result <= e_alu_result;
             m_mem_data   <= e_mem_data;
             m_immext     <= e_immext;
+            m_instr      <= e_instr;
+        end
+    end
+
+    // ====================================================================================
+    // Load store unit
+    // Mem stage access goes straight to the mem stage block, LSU takes a copy on the same edge and
+    // waits for its ack so the instr can leave mem (and the pipeline keeps going). If the mem stage block
+    // stalls it, LSU presents the copy again until taken (lsu_sent).
+    // Loads come back with their destination as tag and are written through register file port 4,
+    // hazard pending load mask keeps dependent instrs in decode until then. Writeback never sees them.
+    // 1 request deep, next access goes on the cycle the previous is acked (cache hits back to back),
+    // hazard holds it in mem before that.
+    // Acks take at least 1 cycle after a request so there is never one on the capturing cycle
+    assign lsu_take = i_en_datamem_access & (~lsu_busy | m_memory_ack);
+
+    assign mem_req  = lsu_take | (lsu_busy & ~lsu_sent);
+    assign mem_we   = lsu_take ? i_en_datamem_write : lsu_we;
+    assign mem_mask = lsu_take ? i_mask_type        : lsu_mask;
+    assign mem_ext  = lsu_take ? i_ext_type         : lsu_ext;
+    assign mem_addr = lsu_take ? m_alu_result       : lsu_addr;
+    assign mem_data = lsu_take ? m_mem_data         : lsu_data;
+    assign mem_tag  = lsu_take ? m_rd               : lsu_rd;
+    // Next cycle's mem stage addr, dcache reads tags with it. A held request is looked up by the cache itself
+    assign mem_next_addr = i_em_en ? e_alu_result : m_alu_result;
+
+    assign lsu_ret  = lsu_busy & m_memory_ack & ~lsu_we;
+
+    always_ff @(posedge i_clk) begin : lsu
+        if (~i_rst) begin
+            lsu_busy <= 1'b0;
+            lsu_sent <= 1'b0;
+        end
+        else if (lsu_take) begin
+            lsu_busy <= 1'b1;
+            lsu_sent <= ~m_memory_stall;
+            lsu_we   <= i_en_datamem_write;
+            lsu_mask <= i_mask_type;
+            lsu_ext  <= i_ext_type;
+            lsu_addr <= m_alu_result;
+            lsu_data <= m_mem_data;
+            lsu_rd   <= m_rd;
+        end
+        else if (lsu_busy) begin
+            if (m_memory_ack)
+                lsu_busy <= 1'b0;
+            else if (~m_memory_stall)
+                lsu_sent <= 1'b1;
         end
     end
 
@@ -300,5 +503,83 @@ module DataPipeline (
         w_pc_p_4         <= i_mw_clr ? 32'd0 : m_pc_p_4;
         w_immext         <= i_mw_clr ? 32'd0 : m_immext;
     end
+
+    // ====================================================================================
+    // Retire trace, read from harness (+retire_trace=<file>), not used by hw so synth drops it
+    // Instr leaving mem (same as perf retired event) shows up here the next cycle, W values of that cycle are its own.
+    // Loads leave W empty, their value comes later through the LSU port (tr_lret), at most one in flight
+    logic        tr_valid
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [31:0] tr_pc
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [31:0] tr_instr
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [1:0]  tr_mem  // 01 load, 10 store
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [31:0] tr_addr  // mem access addr
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic        tr_we  // regfile write in W
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [4:0]  tr_rd
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [31:0] tr_wb
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic        tr_lret  // load result written this cycle
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [4:0]  tr_lret_rd
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+    logic [31:0] tr_lret_data
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+
+    always_ff @(posedge i_clk) begin : retire_trace
+        if (~i_rst)
+            tr_valid <= 1'b0;
+        else
+            tr_valid <= i_em_en & (m_pc_p_4 != 32'd0);
+        tr_pc    <= m_pc_p_4 - 32'd4;
+        tr_instr <= m_instr;
+        tr_mem   <= {i_en_datamem_access & i_en_datamem_write, i_en_datamem_access & ~i_en_datamem_write};
+        tr_addr  <= m_alu_result;
+    end
+
+    assign tr_we        = i_en_regfile_write;
+    assign tr_rd        = w_rd;
+    assign tr_wb        = w_final_result;
+    assign tr_lret      = lsu_ret;
+    assign tr_lret_rd   = m_memory_tag;
+    assign tr_lret_data = m_memory_readout;
     
 endmodule
@@ -24,10 +24,22 @@
  *    (Compare backward), and target matches load instrs
  *  - To stall, stop updating pc and stop fecting from instr mem
  *    Flush exec stage
+ *  - Loads / stores leave the mem stage right away, the load store unit (LSU, in data pipeline)
+ *    holds the request until ack and writes load results into the register file itself.
+ *    The load not back yet is tracked by destination register (pending load mask below),
+ *    decode only stalls when it reads / writes it (or a load still in exec / mem).
+ *    Not a scoreboard of several outstanding loads: the LSU is 1 deep, so at most one bit is set
+ *  - LSU is 1 request deep, a mem access reaching mem while it is busy (and not acked) waits there (mem stall),
+ *    exec has no enable so that is decided while the access is in exec, bubble goes behind it.
+ *    An access taken as a cache hit is acked next cycle, so the one behind it does not need the bubble
+ *  - Icache miss: hold pc, decode gets bubbles (fd clear) until the block is in.
+ *    Does not hold anything after fetch
  */ 
 
 /* Branch flush logic:
- *  - If branch (pc != pc + 4) then initiate flush on both fd and de
+ *  - Fetch predicts (BTB + counters), exec resolves. If exec disagrees with what fetch did after the instr
+ *    (taken or not, or target) then initiate flush on both fd and de and redirect pc
+ *  - Without prediction fetch always goes pc + 4, so this is the old flush on every taken branch
  */
 
 module HazardBlock (
@@ -46,17 +58,24 @@ module HazardBlock (
     //   To data
     output logic [1:0] o_data_mux_alu_forward_src_a,
     output logic [1:0] o_data_mux_alu_forward_src_b,
-    // Stall, some will not be used if stall all
+    // Stall
     //   From data
+    input  logic       i_data_f_miss,    // Icache miss, no instr for decode
     input  logic [4:0] i_data_d_rs1,
     input  logic [4:0] i_data_d_rs2,
+    input  logic [4:0] i_data_d_rd,
     input  logic [4:0] i_data_e_rd,
     input  logic       i_data_m_bus_ack, // Ored from modules
+    input  logic       i_data_m_hit,     // Mem access taken as a cache hit, acked next cycle
+    input  logic       i_data_lsu_busy,  // LSU request in flight
+    input  logic       i_data_lsu_ret,   // LSU writing a load result this cycle
+    input  logic [4:0] i_data_lsu_ret_rd,
     //   From control
     input  logic [1:0] i_ctrl_e_mux_final_result_src,
     input  logic       i_ctrl_d_mux_alu_src_a,
     input  logic       i_ctrl_d_mux_alu_src_b,
-    input  logic       i_ctrl_e_en_datamem_access, // for stalling on ALL memory accesses
+    input  logic       i_ctrl_e_en_datamem_access,
+    input  logic       i_ctrl_m_en_datamem_access,
     //   To data
     output logic       o_data_f_stall,
     output logic       o_data_fd_stall,
@@ -67,8 +86,14 @@ module HazardBlock (
     // Branch
     //   From control
     input  logic       i_ctrl_e_mux_pc_src,
+    //   From data, what fetch predicted for the exec instr
+    input  logic       i_data_e_pred_taken,
+    input  logic       i_data_e_pred_target_match,
     //   To data
-    output logic       o_data_fd_flush // also o_de_flush 
+    output logic       o_data_redirect, // mispredict, pc <- exec result
+    output logic       o_data_fd_flush, // also o_de_flush 
+    // Perf counters, stall cycles by cause: {fetch wait, mem wait, exec bubble, decode stall}
+    output logic [3:0] o_perf_stall
 
 );
     // Forward logic
@@ -107,45 +132,80 @@ module HazardBlock (
     //          Original stall logic only stall a5 load, because loads take only 1 cycle (BRAM).
     //          If loads need 2 cycle then a4 load also need to be stalled
     //          If you can't predict how many cycle a load will take then it won't work
-    // SCORCHED EARTH:
+    // SCORCHED EARTH (old):
     //          Stall ALL loads (and store) until periph flip ack signal
+    // NOW:
+    //          Pending load mask, a bit per register for the load handed to the LSU and not written back yet
 
-    logic _stall;
-    // STALL ON ALL ACCESS
-    assign _stall = i_ctrl_e_en_datamem_access;
-    // When stall arbitrary number of cycles,
-    // exec stage is flushed to will need to save stall state
-    logic _stall_save;
-    always_ff @(posedge i_clk) begin
-        if (~i_rst) begin
-            _stall_save <= 1'b0;
-        end
-        else begin
-            if (_stall) _stall_save <= 1'b1; // delayed for 1 cycle
-            // Stall until receive bus confirmation
-            // Bus confirmation order of multiple loads may matter once selective stall is enabled again
-            else if (_stall_save & i_data_m_bus_ack)
-                _stall_save <= 1'b0;
-        end
+    logic _branch_flush;
+    // Branch detection logic, mispredict
+    assign _branch_flush   = (i_ctrl_e_mux_pc_src != i_data_e_pred_taken) |
+                             (i_ctrl_e_mux_pc_src & ~i_data_e_pred_target_match);
+    assign o_data_redirect = _branch_flush;
+
+    // Fetch has nothing for decode
+    logic _f_wait;
+    assign _f_wait = i_data_f_miss;
+    assign o_data_fd_flush = _branch_flush | _f_wait; // no effect while decode holds
+
+    logic _e_load, _m_load;
+    assign _e_load = (i_ctrl_e_mux_final_result_src == 2'b01);
+    assign _m_load = (i_ctrl_m_mux_final_result_src == 2'b01);
+
+    // Mem access waiting for the LSU, everything before it holds, write back gets bubbles
+    // LSU takes the next one on the ack cycle
+    logic _m_wait;
+    assign _m_wait = i_ctrl_m_en_datamem_access & i_data_lsu_busy & ~i_data_m_bus_ack;
+
+    // Pending load mask
+    // Set when mem stage hands a load to the LSU, cleared on the cycle its result is written.
+    // That write happens on the negedge, before decode reads the register file, so it is already
+    // not pending then
+    // 1 load in flight (LSU 1 deep), a bit per register anyway so a deeper LSU only needs more set / clr
+    logic [31:0] _ld_pending, _ld_set, _ld_clr, _ld_busy;
+    always_comb begin : ld_pending_update
+        _ld_set = 32'h0;
+        _ld_clr = 32'h0;
+        if (_m_load & ~_m_wait & (i_data_m_rd != 0))
+            _ld_set[i_data_m_rd] = 1'b1;
+        if (i_data_lsu_ret)
+            _ld_clr[i_data_lsu_ret_rd] = 1'b1;
+    end
+    assign _ld_busy = _ld_pending & ~_ld_clr;
+
+    always_ff @(posedge i_clk) begin : ld_pending
+        if (~i_rst)
+            _ld_pending <= 32'h0;
+        else
+            _ld_pending <= _ld_busy | _ld_set;
     end
 
-    // This signal goes low 1 cycle earlier than _stall_save, align with ack
-    // This is required because the pipeline must resume the moment ack is received,
-    // else the signal from the pipeline will persist for an additional cycle,
-    // messing up master transfer.
-    logic _stall_save_ack; 
-    assign _stall_save_ack = ~i_data_m_bus_ack & _stall_save;
+    // Decode stall, register not there yet: sources (RAW) or destination (WAW, late write would win)
+    // Compared without checking if the instr really uses rs / rd, worst case is a useless bubble
+    function automatic logic reg_not_ready(input logic [4:0] r);
+        reg_not_ready = (r != 0) & (_ld_busy[r] |
+                                    (_e_load & (r == i_data_e_rd)) |
+                                    (_m_load & (r == i_data_m_rd)));
+    endfunction
 
-    assign o_data_f_stall  = _stall | _stall_save_ack;
-    assign o_data_fd_stall = _stall | _stall_save_ack;
-    // Flush
-    assign o_de_flush      = _stall | _branch_flush  | _stall_save_ack;
-    assign o_em_stall      = _stall_save_ack;
-    assign o_mw_flush      = _stall_save_ack;
+    logic _d_stall;
+    assign _d_stall = reg_not_ready(i_data_d_rs1) | reg_not_ready(i_data_d_rs2) | reg_not_ready(i_data_d_rd);
 
-    logic _branch_flush;
-    // Branch detection logic
-    assign _branch_flush   = i_ctrl_e_mux_pc_src;
-    assign o_data_fd_flush = _branch_flush;
+    // Mem access in exec that may have to wait in mem: LSU still busy next cycle and not acked
+    // (not acked now, or taking the access currently in mem and it is not a hit). Let it go, bubble behind
+    logic _e_stall;
+    assign _e_stall = i_ctrl_e_en_datamem_access &
+                      ((i_data_lsu_busy & ~i_data_m_bus_ack) | (i_ctrl_m_en_datamem_access & ~i_data_m_hit));
+
+    // Mispredict flushes fetch / decode anyway, do not hold pc
+    assign o_data_f_stall  = (_d_stall | _e_stall | _m_wait | _f_wait) & ~_branch_flush;
+    assign o_data_fd_stall = (_d_stall | _e_stall | _m_wait) & ~_branch_flush;
+    // Flush
+    assign o_de_flush      = _d_stall | _e_stall | _m_wait | _branch_flush;
+    assign o_em_stall      = _m_wait;
+    // Loads leaving mem do not write back through the pipeline, LSU does it
+    assign o_mw_flush      = _m_wait | _m_load;
+    // Causes can overlap, each one is counted
+    assign o_perf_stall    = {_f_wait, _m_wait, _e_stall, _d_stall};
 
 endmodule
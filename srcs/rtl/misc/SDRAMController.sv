@@ -17,18 +17,37 @@
  * t[CAC]: minimum time from CAS line falling to valid data output
  * t[RC] : minimum time from the start of one row access to the start of the next
  * t[PC] : minimum time from the start of one column access to the start of the next
+ * t[RRD]: minimum time from ACTIVE on one bank to ACTIVE on another
  */
 
  /* FOR MEMORY INTERFACE THAT CONNECTED TO THIS
+  * Requests go in a 2 entry queue, ack is the cycle after a request is taken. i_req is not looked at in the ack cycle
   * READ | WRITE burst size == 1:
-  *     - Hold request until received ack            => request received, data may or may not available, might duplicate request if slow
+  *     - Hold request until received ack            => request received, data may or may not available
   *     - Hold request until received valid          => request duplication likely
   *     - Only request for 1 cycle, don't wait       => request might not be handled if controller busy
   *     - Only request for 1 cycle, wait ack | valid => same problem as prev, might not get ack | valid at all
-  * WRITE: if burst size > 1: 
-  *     - MUST NOT wait until received ack or valid, send entire burst first then wait
+  * WRITE: if burst size > 1:
+  *     - Hold request and first word until ack, then the rest of the burst one word per cycle right after ack
+  * READ: if burst size > 1:
+  *     - valid is high for every beat, back to back. Read data comes back in request order
+  * Full page burst:
+  *     - Bursts are cut after SDRAM_O_PAGE_BURST_BEATS by burst stop, column wraps inside the page so keep bursts aligned
   */
 
+/* Open page policy
+ * Rows are left open after an access, every bank keeps its open row:
+ *  - row hit     : READ / WRITE right away, no tRCD / tRP
+ *  - bank closed : ACTIVE then READ / WRITE
+ *  - row conflict: PRECHARGE, ACTIVE then READ / WRITE
+ * Queue head owns the data bus (READ / WRITE). The entry behind it can PRECHARGE / ACTIVE its own bank meanwhile
+ * when it is not the head's bank, so a miss on another bank overlaps the current access.
+ * No wait states, every command is checked against per bank down counters (tRCD, tRAS / tWR, tRP / tRC)
+ * and global ones (tRRD, burst spacing, read -> write turnaround), issued once they hit 0.
+ * Refresh: one owed every tREFI. Done when the queue is empty, postponed while busy up to SDRAM_O_REFRESH_POSTPONE owed,
+ * then new requests are held off until it is done. Refresh closes every row, which also keeps rows under tRAS max.
+ */
+
 // 32 bit address space
 module SDRAMController #(
     // O == option, T == timing (ns), C == clock timing
@@ -50,8 +69,11 @@ module SDRAMController #(
     // t[CAC] is not mentioned anywhere else in the datasheet except this formula
     // Use value from others 2=below 133MHz, 3=above 133MHz
     parameter SDRAM_C_CAS_LATENCY  = 3,
-    parameter SDRAM_O_BURST_LENGTH = 1,  // 1, 2, 4, 8, whole page
+    parameter SDRAM_O_BURST_LENGTH = 1,  // 1, 2, 4, 8 or SDRAM_O_PAGE_SIZE for full page
     parameter SDRAM_O_PAGE_SIZE    = 256,
+    parameter SDRAM_O_PAGE_BURST_BEATS = 16, // Full page only, beats before burst stop
+    parameter SDRAM_O_WRITE_SINGLE = 0,  // A9, 1: writes are single word, reads still burst
+    parameter SDRAM_O_REFRESH_POSTPONE = 4, // Refreshes owed before requests are held off, JEDEC allows 8
     // ==================================================
     // Timings in nanoseconds, some converted from tck @ 143MHz
     parameter real SDRAM_T_DESL    = 200000.0, // -- startup delay, power on sequence
@@ -60,8 +82,10 @@ module SDRAMController #(
     parameter real SDRAM_T_RCD     =     21.0, // -- RAS to CAS delay
     parameter real SDRAM_T_RP      =     21.0, // -- precharge to activate delay
     parameter real SDRAM_T_WR      =     14.0, // -- write recovery time
-    parameter real SDRAM_T_REFI    =  15600.0  // -- average refresh interval
-    
+    parameter real SDRAM_T_REFI    =  15600.0, // -- average refresh interval
+    parameter real SDRAM_T_RAS     =     42.0, // -- active to precharge
+    parameter real SDRAM_T_RRD     =     14.0  // -- active to active, different banks
+
 ) (
     input  logic                              i_clk, // SDRAM clk
     input  logic                              i_rst,
@@ -79,6 +103,8 @@ module SDRAMController #(
     output logic [SDRAM_O_DATA_WIDTH - 1 : 0] o_data,
     // High when not idle
     output logic                              o_busy,
+    // High while auto refreshing or holding requests off for it, perf counters
+    output logic                              o_refresh,
     // ==================================================
     // SDRAM interface
     // output logic                           o_r_clk, // Connect at top
@@ -106,14 +132,23 @@ module SDRAMController #(
     localparam integer SDRAM_C_ACTIVE_WAIT      = $ceil(SDRAM_T_RCD / SDRAM_T_CLK_PERIOD);
     localparam integer SDRAM_C_REFRESH_WAIT     = $ceil(SDRAM_T_RC / SDRAM_T_CLK_PERIOD);
     localparam integer SDRAM_C_PRECHARGE_WAIT   = $ceil(SDRAM_T_RP / SDRAM_T_CLK_PERIOD);
-    // This here is how cas latency can be determined (in this case)
-    // SDRAM_C_READ_WAIT is required by datasheet to be >= T_RP + burst length (read + autoprecharge)
-    // For a read operation it must wait for CAS so SDRAM_C_CAS_LATENCY must be >= T_RP
-    localparam integer SDRAM_C_READ_WAIT        = SDRAM_C_CAS_LATENCY + SDRAM_O_BURST_LENGTH;
-    localparam integer SDRAM_C_WRITE_WAIT       = SDRAM_O_BURST_LENGTH + $ceil((SDRAM_T_WR + SDRAM_T_RP) / SDRAM_T_CLK_PERIOD);
-    // To avoid refresh wait is maxxed during read / write, subtract read / write time (whichever is greater)
-    // from refresh wait time in order to hae time spare for refresh, + few more cycle for state change
-    localparam integer SDRAM_C_REFRESH_INTERVAL = $floor(SDRAM_T_REFI / SDRAM_T_CLK_PERIOD) - SDRAM_C_ACTIVE_WAIT - SDRAM_C_WRITE_WAIT - 3;
+    localparam integer SDRAM_C_RAS_WAIT         = $ceil(SDRAM_T_RAS / SDRAM_T_CLK_PERIOD);
+    localparam integer SDRAM_C_WR_WAIT          = $ceil(SDRAM_T_WR / SDRAM_T_CLK_PERIOD);
+    localparam integer SDRAM_C_RRD_WAIT         = $ceil(SDRAM_T_RRD / SDRAM_T_CLK_PERIOD);
+    // ==================================================
+    // Burst, beats per read / write. Full page has no length of its own, it is cut after SDRAM_O_PAGE_BURST_BEATS
+    localparam integer SDRAM_O_FULL_PAGE        = (SDRAM_O_BURST_LENGTH == SDRAM_O_PAGE_SIZE);
+    localparam [2:0]   SDRAM_O_BURST_CODE       = SDRAM_O_FULL_PAGE ? 3'b111 : $clog2(SDRAM_O_BURST_LENGTH); // MRS A2-0
+    localparam integer SDRAM_C_READ_BEATS       = SDRAM_O_FULL_PAGE ? SDRAM_O_PAGE_BURST_BEATS : SDRAM_O_BURST_LENGTH;
+    localparam integer SDRAM_C_WRITE_BEATS      = SDRAM_O_WRITE_SINGLE ? 1 : SDRAM_C_READ_BEATS;
+    localparam integer SDRAM_O_WRITE_STOP       = SDRAM_O_FULL_PAGE & (SDRAM_O_WRITE_SINGLE == 0);
+    // Earliest precharge of the same bank, counted from the read / write cmd
+    // read : precharge cuts data CAS latency later, so right after the last beat left the array
+    // write: tWR after the last data in
+    localparam integer SDRAM_C_READ_TO_PRE      = SDRAM_C_READ_BEATS;
+    localparam integer SDRAM_C_WRITE_TO_PRE     = SDRAM_C_WRITE_BEATS - 1 + SDRAM_C_WR_WAIT;
+    // One refresh owed every tREFI, postponing keeps the average
+    localparam integer SDRAM_C_REFRESH_INTERVAL = $floor(SDRAM_T_REFI / SDRAM_T_CLK_PERIOD);
 
     // ==================================================
     // Command list (RAS, CAS, WE)
@@ -128,24 +163,16 @@ module SDRAMController #(
     // Data Write/Output Enable (N/A)
     // Data Mask/Output Disable (N/A)
     // Mode Register Set                    (RAS# = "L", CAS# = "L", WE# = "L", A0-A10 = Register Data)
-    // localparam [2:0] SDRAM_CMD_LOADMODE   = 3'b000;
     // AutoRefresh                          (RAS# = "L", CAS# = "L", WE# = "H", A0-A10 = Don't care)
-    // localparam [2:0] SDRAM_CMD_REFRESH    = 3'b001;
     // Bank Precharge                       (RAS# = "L", CAS# = "H", WE# = "L", BAs = Bank, A10 = "L", A0-A9 = Don't care)
     // Precharge all                        (RAS# = "L", CAS# = "H", WE# = "L", BAs = Don’t care, A10 = "H", A0-A9 = Don't care)
-    // localparam [2:0] SDRAM_CMD_PRECHARGE  = 3'b010;
     // BankActivate                         (RAS# = "L", CAS# = "H", WE# = "H", BAs = Bank, A0-A10 = Row Address)
-    // localparam [2:0] SDRAM_CMD_ACTIVE     = 3'b011;
     // Write                                (RAS# = "H", CAS# = "L", WE# = "L", BAs = Bank, A10 = "L", A0-A7 = Column Address)
-    // Write and AutoPrecharge              (RAS# = "H", CAS# = "L", WE# = "L", BAs = Bank, A10 = "H", A0-A7 = Column Address)
-    // localparam [2:0] SDRAM_CMD_WRITE      = 3'b100;
+    // Write and AutoPrecharge (unused)     (RAS# = "H", CAS# = "L", WE# = "L", BAs = Bank, A10 = "H", A0-A7 = Column Address)
     // Read                                 (RAS# = "H", CAS# = "L", WE# = "H", BAs = Bank, A10 = "L", A0-A7 = Column Address)
-    // Read and AutoPrecharge               (RAS# = "H", CAS# = "L", WE# = "H", BAs = Bank, A10 = "H", A0-A7 = Column Address)
-    // localparam [2:0] SDRAM_CMD_READ       = 3'b101;
+    // Read and AutoPrecharge (unused)      (RAS# = "H", CAS# = "L", WE# = "H", BAs = Bank, A10 = "H", A0-A7 = Column Address)
     // Burst Stop                           (RAS# = "H", CAS# = "H", WE# = "L")
-    // localparam [2:0] SDRAM_CMD_BURST_STOP = 3'b110;
     // No-Operation                         (RAS# = "H", CAS# = "H", WE# = "H")
-    // localparam [2:0] SDRAM_CMD_NOP        = 3'b111;
     // This is nicer, the range is continuous anyway
     typedef enum logic [2:0] {  CMD_LOADMODE,   // 000
                                 CMD_REFRESH,    // 001
@@ -156,335 +183,456 @@ module SDRAMController #(
                                 CMD_BURST_STOP, // 110
                                 CMD_NOP         // 111
     } _sdram_cmd_t;
-    _sdram_cmd_t _cmd, _next_cmd;
+
+    // Command picked this cycle (_sel_*) goes on the bus next cycle (_cmd*), all sdram outputs are flops
+    _sdram_cmd_t                       _sel_cmd, _cmd;
+    logic [SDRAM_O_BANK_WIDTH - 1 : 0] _sel_ba,  _cmd_ba;
+    logic [SDRAM_O_ADDR_WIDTH - 1 : 0] _sel_addr, _cmd_addr;
+    logic                              _sel_all; // precharge all
+
+    // A10 high, precharge all
+    localparam [SDRAM_O_ADDR_WIDTH - 1 : 0] SDRAM_A10 = {{(SDRAM_O_ADDR_WIDTH - 11){1'b0}}, 11'b1_0000000000};
 
     // ==================================================
-    // States
-    typedef enum logic [2:0] {  STATE_INIT,   // 000
-                                STATE_IDLE,   // 001
-                                STATE_ACTIVE, // 010
-                                STATE_READ,   // 011
-                                STATE_WRITE,  // 100
-                                STATE_REFRESH // 101
-    } _controller_state_t;
-    _controller_state_t _state, _next_state;
-
-    always_ff @(posedge i_clk) begin
+    // Power on sequence
+    // One cmd per step, each waits its own delay counted from the previous cmd
+    // Seems like yosys does not like having compare net to localparam arithmetic
+    localparam integer SDRAM_C_INIT_STEP_PRECHARGE = 0;
+    localparam integer SDRAM_C_INIT_STEP_REFRESH_1 = 1;
+    localparam integer SDRAM_C_INIT_STEP_REFRESH_2 = 2;
+    localparam integer SDRAM_C_INIT_STEP_LOAD_MODE = 3;
+    localparam integer SDRAM_C_INIT_STEP_DONE      = 4;
+
+    localparam integer SDRAM_C_INIT_WAIT_INIT      = SDRAM_C_INIT_WAIT - 1;
+
+    logic [2:0]  _init_step;
+    logic [15:0] _init_wait;
+    logic        _init_fire;
+    logic        _init_done;
+    // Public so a harness can fast forward the power on delay (include/sdramFastForward.h), it writes it
+    // once right after reset. >= below so a counter moved that way still goes through every init cmd
+    logic [15:0] _init_counter
+`ifdef VERILATOR
+    /* verilator public */
+`endif
+    ;
+
+    always_comb begin : init_wait
+        case (_init_step)
+            SDRAM_C_INIT_STEP_PRECHARGE: _init_wait = 16'(SDRAM_C_INIT_WAIT_INIT);
+            SDRAM_C_INIT_STEP_REFRESH_1: _init_wait = 16'(SDRAM_C_PRECHARGE_WAIT);
+            SDRAM_C_INIT_STEP_REFRESH_2: _init_wait = 16'(SDRAM_C_REFRESH_WAIT);
+            SDRAM_C_INIT_STEP_LOAD_MODE: _init_wait = 16'(SDRAM_C_REFRESH_WAIT);
+            default:                     _init_wait = 16'(SDRAM_C_LOAD_MODE_WAIT);
+        endcase
+    end
+
+    assign _init_fire = ~_init_done & (_init_counter >= _init_wait);
+
+    always_ff @(posedge i_clk) begin : init_counter
         if (~i_rst) begin
-            _state <= STATE_INIT;
-            _cmd <= CMD_NOP;
+            _init_counter <= 16'h0;
+            _init_step    <= 3'h0;
+            _init_done    <= 1'b0;
+        end
+        else if (_init_fire) begin
+            // Cmd cycle counts as 1 toward the next wait
+            _init_counter <= 16'h1;
+            // First real cmd lands one cycle after tMRD
+            if (_init_step == 3'(SDRAM_C_INIT_STEP_DONE))
+                _init_done <= 1'b1;
+            else
+                _init_step <= _init_step + 1;
+        end
+        else if (~_init_done) begin
+            _init_counter <= _init_counter + 1;
+        end
+    end
+
+    // ==================================================
+    // Refresh, owed counter
+    logic [11:0] _refresh_counter;
+    logic [3:0]  _refresh_owed;
+    logic        _refresh_tick, _refresh_issue;
+    logic        _refresh_hold; // too many owed, hold new requests off
+    logic [7:0]  _refresh_busy; // tRC after refresh
+
+    assign _refresh_tick  = (_refresh_counter == SDRAM_C_REFRESH_INTERVAL - 1);
+    assign _refresh_issue = (_sel_cmd == CMD_REFRESH) & _init_done;
+    assign _refresh_hold  = (_refresh_owed >= SDRAM_O_REFRESH_POSTPONE);
+
+    always_ff @(posedge i_clk) begin : refresh_counter
+        if (~i_rst | ~_init_done) begin
+            _refresh_counter <= 'h0;
+            _refresh_owed    <= 'h0;
         end
         else begin
-            _state <= _next_state;
-            _cmd <= _next_cmd;
+            _refresh_counter <= _refresh_tick ? 'h0 : _refresh_counter + 1;
+            if (_refresh_tick & ~_refresh_issue & ~(&_refresh_owed))
+                _refresh_owed <= _refresh_owed + 1;
+            else if (~_refresh_tick & _refresh_issue)
+                _refresh_owed <= _refresh_owed - 1;
         end
     end
 
+    always_ff @(posedge i_clk) begin : refresh_busy
+        if (~i_rst)
+            _refresh_busy <= 'h0;
+        else if (_refresh_issue)
+            _refresh_busy <= SDRAM_C_REFRESH_WAIT;
+        else if (_refresh_busy != 'h0)
+            _refresh_busy <= _refresh_busy - 1;
+    end
+
     // ==================================================
-    // Wait counter
-    logic [15:0] _wait_counter;
-    logic [16:0] _wait_counter_p1;
+    // Request queue, 2 entries, head = oldest
+    // [bank][row][column]
+    logic                              _q_valid [1:0];
+    logic                              _q_we    [1:0];
+    logic [MEM_O_ADDR_WIDTH - 1 : 0]   _q_addr  [1:0];
+    logic                              _q_head;
+    // In case of write burst:
+    // The data is sent since the start of request must be buffered else lost
+    // First word comes with the request, the rest one per cycle right after ack.
+    // All are buffered in the entry and sent out indexed by the write beat counter
+    localparam integer C_WCAP_WIDTH = $clog2(SDRAM_C_WRITE_BEATS + 1);
+    logic [SDRAM_O_DATA_WIDTH - 1 : 0] _q_wdata [1:0][SDRAM_C_WRITE_BEATS - 1 : 0];
+    logic [C_WCAP_WIDTH - 1 : 0]       _wcap; // next word to capture, == SDRAM_C_WRITE_BEATS when done
+    logic                              _wcap_slot;
+
+    // Head and the entry behind it
+    logic                              _h_valid, _s_valid, _h_we;
+    logic [SDRAM_O_BANK_WIDTH - 1 : 0] _h_bank, _s_bank;
+    logic [SDRAM_O_ROW_WIDTH - 1 : 0]  _h_row, _s_row;
+    logic [SDRAM_O_COLUMN_WIDTH - 1 : 0] _h_col;
+    logic                              _tail;
+
+    assign _h_valid = _q_valid[_q_head];
+    assign _s_valid = _q_valid[~_q_head];
+    assign _h_we    = _q_we[_q_head];
+    assign {_h_bank, _h_row, _h_col} = _q_addr[_q_head];
+    assign {_s_bank, _s_row} = _q_addr[~_q_head][MEM_O_ADDR_WIDTH - 1 : SDRAM_O_COLUMN_WIDTH];
+    assign _tail    = _h_valid ? ~_q_head : _q_head;
 
-    assign _wait_counter_p1 = _wait_counter + 1;
+    // Taking a new request
+    // Not in ack cycle so a request held until ack is taken once
+    // Not while a write burst is still captured / sent, its entry must stay put
+    logic _accept, _pop;
+    logic _wr_active;
+    assign _accept = i_req & ~o_ack & _init_done & ~_refresh_hold & ~(_h_valid & _s_valid) &
+                     ~_wr_active & (_wcap == SDRAM_C_WRITE_BEATS);
+    assign _pop    = (_sel_cmd == CMD_READ) | (_sel_cmd == CMD_WRITE);
 
-    always_ff @(posedge i_clk) begin : wait_counter
+    always_ff @(posedge i_clk) begin : request_queue
         if (~i_rst) begin
-            _wait_counter <= 16'h0;
+            _q_valid[0] <= 1'b0;
+            _q_valid[1] <= 1'b0;
+            _q_head     <= 1'b0;
         end
         else begin
-            if (_state != _next_state) begin
-                _wait_counter <= 16'h0;
-            end
-            else begin
-                if (_wait_counter_p1[16] == 0) // prevent overflow
-                    _wait_counter <= _wait_counter_p1[15:0];
+            if (_pop) begin
+                _q_valid[_q_head] <= 1'b0;
+                _q_head <= ~_q_head;
             end
+            if (_accept)
+                _q_valid[_tail] <= 1'b1;
         end
     end
 
-    // ==================================================
-    // Refresh counter
-    logic [11:0] _refresh_counter;
-    logic [12:0] _refresh_counter_p1;
-
-    assign _refresh_counter_p1 = _refresh_counter + 1;
+    always_ff @(posedge i_clk) begin : saving_req
+        if (_accept) begin
+            _q_we[_tail]       <= i_we;
+            _q_addr[_tail]     <= i_addr;
+            _q_wdata[_tail][0] <= i_data;
+            _wcap_slot         <= _tail;
+        end
+    end
 
-    always_ff @(posedge i_clk) begin : refresh_counter
+    always_ff @(posedge i_clk) begin : saving_data
         if (~i_rst) begin
-            _refresh_counter <= 'h0;
+            _wcap <= SDRAM_C_WRITE_BEATS;
         end
         else begin
-            if (_state == STATE_REFRESH & _wait_counter == 'h0) begin
-                _refresh_counter <= 'h0;
+            if (o_ack) begin
+                _wcap <= 1;
             end
-            else begin
-                if(_refresh_counter_p1[12] == 0) // prevent overflow
-                    _refresh_counter <= _refresh_counter_p1[11:0];
+            else if (_wcap < SDRAM_C_WRITE_BEATS) begin
+                _q_wdata[_wcap_slot][_wcap] <= i_data;
+                _wcap <= _wcap + 1;
             end
         end
     end
 
     // ==================================================
-    // State machine control signals
-    logic _sig_active_done;
-    logic _sig_refresh_done;
-    logic _sig_read_done;
-    logic _sig_read_data_avail;
-    logic _sig_write_done;
-    logic _sig_need_refresh;
-    logic _sig_state_changing;
-
-    // Assign signals
-    // Most of the time you would just need an edge, if these signal were to be lengthened (>=)
-    // check the _next_state condition
-    assign _sig_active_done     = (_state == STATE_ACTIVE) & (_wait_counter >= SDRAM_C_ACTIVE_WAIT - 1);
-    assign _sig_refresh_done    = (_state == STATE_REFRESH) & (_wait_counter >= SDRAM_C_REFRESH_WAIT - 1);
-    assign _sig_read_done       = (_state == STATE_READ) & (_wait_counter >= SDRAM_C_READ_WAIT - 1);
-    assign _sig_read_data_avail = (~_sig_state_changing) & (_state == STATE_READ) & ((_wait_counter >= SDRAM_C_CAS_LATENCY) & (_wait_counter < (SDRAM_C_WRITE_WAIT - 1))); // held for burst
-    assign _sig_write_done      = (_state == STATE_WRITE) & (_wait_counter >= SDRAM_C_WRITE_WAIT - 1);
-    assign _sig_need_refresh    = (_refresh_counter >= (SDRAM_C_REFRESH_INTERVAL - 1));
-    assign _sig_state_changing  = (_next_state != _state);
+    // Bank state, open row + down counters, cmd allowed at 0
+    // Counters are loaded with N - 1 when the cmd is picked, it is on the bus next cycle
+    logic                              _bank_open [SDRAM_O_NBANK - 1 : 0];
+    logic [SDRAM_O_ROW_WIDTH - 1 : 0]  _bank_row  [SDRAM_O_NBANK - 1 : 0];
+    logic [7:0]                        _bank_act_cnt [SDRAM_O_NBANK - 1 : 0]; // ACTIVE: tRP after precharge, tRC after active / refresh
+    logic [7:0]                        _bank_col_cnt [SDRAM_O_NBANK - 1 : 0]; // READ / WRITE: tRCD after active
+    logic [7:0]                        _bank_pre_cnt [SDRAM_O_NBANK - 1 : 0]; // PRECHARGE: tRAS after active, data out / tWR after read / write
+    // Global
+    logic [7:0]                        _rrd_cnt;  // ACTIVE: tRRD after active on any bank
+    logic [7:0]                        _bus_cnt;  // READ / WRITE: previous burst done
+    logic [7:0]                        _stop_cnt; // full page: burst stop goes out when picked at 1
+    // Read beats in flight, bit 0 = data on dq this cycle
+    localparam integer C_RD_SR_WIDTH = SDRAM_C_CAS_LATENCY + SDRAM_C_READ_BEATS;
+    logic [C_RD_SR_WIDTH - 1 : 0]      _rd_sr;
+
+    // Down counter reload, keep whichever ends later
+    function automatic logic [7:0] timer_load(input logic [7:0] cnt, input integer n);
+        logic [7:0] dec;
+        dec = (cnt != 'h0) ? cnt - 1 : 'h0;
+        timer_load = (dec > n - 1) ? dec : n - 1;
+    endfunction
+
+    function automatic logic [7:0] timer_dec(input logic [7:0] cnt);
+        timer_dec = (cnt != 'h0) ? cnt - 1 : 'h0;
+    endfunction
 
     // ==================================================
-    // State machine
+    // Scheduler
+    // Priority: head READ / WRITE > burst stop > refresh > head PRECHARGE / ACTIVE > next entry PRECHARGE / ACTIVE
+    logic _h_open, _h_hit, _s_open, _s_hit;
+    assign _h_open = _bank_open[_h_bank];
+    assign _h_hit  = _h_open & (_bank_row[_h_bank] == _h_row);
+    assign _s_open = _bank_open[_s_bank];
+    assign _s_hit  = _s_open & (_bank_row[_s_bank] == _s_row);
 
-    // Wait timing parameters
-    // Seems like yosys does not like having compare net to localparam arithmetic
-    localparam integer SDRAM_C_INIT_WAIT_INIT      = SDRAM_C_INIT_WAIT - 1;
-    localparam integer SDRAM_C_INIT_WAIT_PRECHARGE = SDRAM_C_INIT_WAIT_INIT + SDRAM_C_PRECHARGE_WAIT;      // already -1
-    localparam integer SDRAM_C_INIT_WAIT_REFRESH_1 = SDRAM_C_INIT_WAIT_PRECHARGE + SDRAM_C_REFRESH_WAIT;   // already -1
-    localparam integer SDRAM_C_INIT_WAIT_REFRESH_2 = SDRAM_C_INIT_WAIT_REFRESH_1 + SDRAM_C_REFRESH_WAIT;   // already -1
-    localparam integer SDRAM_C_INIT_WAIT_LOAD_MODE = SDRAM_C_INIT_WAIT_REFRESH_2 + SDRAM_C_LOAD_MODE_WAIT; // already -1
+    logic _any_open, _pre_all_ok, _act_all_ok;
+    always_comb begin : all_banks
+        _any_open   = 1'b0;
+        _pre_all_ok = 1'b1;
+        _act_all_ok = 1'b1;
+        for (int b = 0; b < SDRAM_O_NBANK; b++) begin
+            _any_open = _any_open | _bank_open[b];
+            if (_bank_open[b] & (_bank_pre_cnt[b] != 'h0))
+                _pre_all_ok = 1'b0;
+            if (_bank_act_cnt[b] != 'h0)
+                _act_all_ok = 1'b0;
+        end
+    end
 
-    always_ff @(posedge i_clk) begin : state_machine
-        if (~i_rst) begin
-            // Set state and cmd
-            _next_state <= STATE_INIT;
-            _next_cmd <= CMD_NOP;
+    // Column cmd of the head, write also waits for read data to be off dq (+1 cycle turnaround, no DQM)
+    logic _h_col_ok;
+    assign _h_col_ok = _h_valid & _h_hit & (_bank_col_cnt[_h_bank] == 'h0) & (_bus_cnt == 'h0) &
+                       (~_h_we | (_rd_sr == 'h0));
+
+    always_comb begin : scheduler
+        _sel_cmd  = CMD_NOP;
+        _sel_ba   = 'h0;
+        _sel_addr = 'h0;
+        _sel_all  = 1'b0;
+        if (~_init_done) begin
+            // Precharge all
+            if (_init_fire & (_init_step == 3'(SDRAM_C_INIT_STEP_PRECHARGE))) begin
+                _sel_cmd  = CMD_PRECHARGE;
+                _sel_addr = SDRAM_A10;
+            end
+            // Auto refresh x2
+            else if (_init_fire & ((_init_step == 3'(SDRAM_C_INIT_STEP_REFRESH_1)) | (_init_step == 3'(SDRAM_C_INIT_STEP_REFRESH_2)))) begin
+                _sel_cmd  = CMD_REFRESH;
+            end
+            // Mode register set
+            // BA0-1: Reserved
+            // A10: Reserved
+            // A9: Write burst length 0: burst, 1: single word
+            // A8-7: Test mode : 00: normal
+            // A6-4: CAS latency: 010: 2, 011: 3
+            // A3: BT: 0: sequential, 1: interleave
+            // A2-0: Burst length: 32bits multiple
+            //       000: 1
+            //       001: 2
+            //       010: 4
+            //       011: 8
+            //       111: Full Page (Sequential)
+            else if (_init_fire & (_init_step == 3'(SDRAM_C_INIT_STEP_LOAD_MODE))) begin
+                _sel_cmd  = CMD_LOADMODE;
+                _sel_addr = {{(SDRAM_O_ADDR_WIDTH - 11){1'b0}}, 1'b0, SDRAM_O_WRITE_SINGLE[0], 2'b00, SDRAM_C_CAS_LATENCY[2:0], 1'b0, SDRAM_O_BURST_CODE};
+            end
         end
-        else begin
-            case (_state)
-                // Power on sequence
-                STATE_INIT: begin
-                    // Precharge all
-                    if (_wait_counter == SDRAM_C_INIT_WAIT_INIT) begin
-                        _next_cmd <= CMD_PRECHARGE;
-                        // _local_r_addr <= {{(SDRAM_O_ADDR_WIDTH - 11){1'b0}}, 11'b10000000000}; // a[10] = 1
-                    end
-                    // Auto refresh x2
-                    else if (_wait_counter == SDRAM_C_INIT_WAIT_PRECHARGE) begin
-                        _next_cmd <= CMD_REFRESH;
-                    end
-                    else if (_wait_counter == SDRAM_C_INIT_WAIT_REFRESH_1) begin
-                        _next_cmd <= CMD_REFRESH;
-                    end
-                    // Mode register set
-                    // BA0-1: Reserved
-                    // A10: Reserved
-                    // A9: Write burst length 0: burst, 1: single bit
-                    // A8-7: Test mode : 00: normal
-                    // A6-4: CAS latency: 010: 2, 011: 3
-                    // A3: BT: 0: sequential, 1: interleave
-                    // A2-0: Burst length: 32bits multiple
-                    //       000: 1
-                    //       001: 2
-                    //       010: 4
-                    //       011: 8
-                    //       111: Full Page (Sequential)
-                    else if (_wait_counter == SDRAM_C_INIT_WAIT_REFRESH_2) begin
-                        _next_cmd <= CMD_LOADMODE;
-                    end
-                    // Done
-                    else if (_wait_counter == SDRAM_C_INIT_WAIT_LOAD_MODE) begin
-                        _next_state <= STATE_IDLE;
-                    end
-                    else begin
-                        _next_cmd <= CMD_NOP;
-                    end
-                end
-                STATE_IDLE: begin
-                    if (_sig_need_refresh) begin
-                        if (_sig_state_changing) begin
-                            _next_cmd <= CMD_NOP;
-                        end
-                        else begin
-                            _next_state <= STATE_REFRESH;
-                            _next_cmd <= CMD_REFRESH;
-                        end
-                    end
-                    else if (i_req) begin
-                        if (_sig_state_changing) begin
-                            _next_cmd <= CMD_NOP;
-                        end
-                        else begin
-                            _next_state <= STATE_ACTIVE;
-                            _next_cmd <= CMD_ACTIVE;
-                        end
-                    end
-                    else begin
-                        _next_cmd <= CMD_NOP;
-                    end
-                end
-                STATE_ACTIVE: begin
-                    if (_sig_active_done) begin
-                        if (_sig_state_changing) begin
-                            _next_cmd <= CMD_NOP;
-                        end
-                        else begin
-                            if (_we) begin
-                                _next_state <= STATE_WRITE;
-                                _next_cmd <= CMD_WRITE;
-                            end
-                            else begin
-                                _next_state <= STATE_READ;
-                                _next_cmd <= CMD_READ;
-                            end
-                        end
-                    end
-                    else begin
-                        _next_cmd <= CMD_NOP;
-                    end
+        else if (_h_col_ok) begin
+            _sel_cmd  = _h_we ? CMD_WRITE : CMD_READ;
+            _sel_ba   = _h_bank;
+            _sel_addr = {{(SDRAM_O_ADDR_WIDTH - SDRAM_O_COLUMN_WIDTH){1'b0}}, _h_col}; // A10 low, no auto precharge
+        end
+        else if (_stop_cnt == 'h1) begin
+            _sel_cmd  = CMD_BURST_STOP;
+        end
+        // Refresh when nothing is queued, close every row first
+        else if ((_refresh_owed != 'h0) & ~_h_valid) begin
+            if (_any_open) begin
+                if (_pre_all_ok) begin
+                    _sel_cmd  = CMD_PRECHARGE;
+                    _sel_addr = SDRAM_A10;
+                    _sel_all  = 1'b1;
                 end
-                // and AutoPrecharge
-                STATE_READ: begin
-                    if (_sig_read_done) begin
-                        if (_sig_state_changing) begin
-                            _next_cmd <= CMD_NOP;
-                        end
-                        else begin
-                            if (_sig_need_refresh) begin
-                                _next_state <= STATE_REFRESH;
-                                _next_cmd <= CMD_REFRESH;
-                            end
-                            else if (i_req) begin
-                                _next_state <= STATE_ACTIVE;
-                                _next_cmd <= CMD_ACTIVE;
-                            end
-                            else begin
-                                _next_state <= STATE_IDLE;
-                                _next_cmd <= CMD_NOP;
-                            end
-                        end
-                    end
-                    else begin
-                        _next_cmd <= CMD_NOP;
-                    end
+            end
+            else if (_act_all_ok) begin
+                _sel_cmd  = CMD_REFRESH;
+            end
+        end
+        // Head row cmd
+        else if (_h_valid & ~_h_hit & (_h_open ? (_bank_pre_cnt[_h_bank] == 'h0) :
+                                                ((_bank_act_cnt[_h_bank] == 'h0) & (_rrd_cnt == 'h0)))) begin
+            _sel_cmd  = _h_open ? CMD_PRECHARGE : CMD_ACTIVE;
+            _sel_ba   = _h_bank;
+            _sel_addr = _h_open ? 'h0 : _h_row;
+        end
+        // Next entry row cmd, only on another bank
+        else if (_s_valid & ~_s_hit & (_s_bank != _h_bank) & (_s_open ? (_bank_pre_cnt[_s_bank] == 'h0) :
+                                                                        ((_bank_act_cnt[_s_bank] == 'h0) & (_rrd_cnt == 'h0)))) begin
+            _sel_cmd  = _s_open ? CMD_PRECHARGE : CMD_ACTIVE;
+            _sel_ba   = _s_bank;
+            _sel_addr = _s_open ? 'h0 : _s_row;
+        end
+    end
+
+    // ==================================================
+    // Bank / bus state update
+    always_ff @(posedge i_clk) begin : bank_state
+        if (~i_rst | ~_init_done) begin
+            for (int b = 0; b < SDRAM_O_NBANK; b++) begin
+                _bank_open[b]    <= 1'b0;
+                _bank_act_cnt[b] <= 'h0;
+                _bank_col_cnt[b] <= 'h0;
+                _bank_pre_cnt[b] <= 'h0;
+            end
+            _rrd_cnt  <= 'h0;
+            _bus_cnt  <= 'h0;
+            _stop_cnt <= 'h0;
+        end
+        else begin
+            for (int b = 0; b < SDRAM_O_NBANK; b++) begin
+                if (_sel_cmd == CMD_REFRESH) begin
+                    _bank_act_cnt[b] <= SDRAM_C_REFRESH_WAIT - 1;
                 end
-                // and AutoPrecharge
-                STATE_WRITE: begin
-                    if (_sig_write_done) begin
-                        if (_sig_state_changing) begin
-                            _next_cmd <= CMD_NOP;
-                        end
-                        else begin
-                            if (_sig_need_refresh) begin
-                                _next_state <= STATE_REFRESH;
-                                _next_cmd <= CMD_REFRESH;
-                            end
-                            else if (i_req) begin
-                                _next_state <= STATE_ACTIVE;
-                                _next_cmd <= CMD_ACTIVE;
-                            end
-                            else begin
-                                _next_state <= STATE_IDLE;
-                                _next_cmd <= CMD_NOP;
-                            end
-                        end
-                    end
-                    else begin
-                        _next_cmd <= CMD_NOP;
-                    end
+                else if ((_sel_cmd == CMD_PRECHARGE) & (_sel_all | (_sel_ba == b))) begin
+                    _bank_open[b]    <= 1'b0;
+                    _bank_act_cnt[b] <= timer_load(_bank_act_cnt[b], SDRAM_C_PRECHARGE_WAIT);
                 end
-                // AutoRefresh
-                STATE_REFRESH: begin
-                    if(_sig_refresh_done) begin
-                        if (_sig_state_changing) begin
-                            _next_cmd <= CMD_NOP;
-                        end
-                        else begin
-                            if(i_req) begin
-                                _next_state <= STATE_ACTIVE;
-                                _next_cmd <= CMD_ACTIVE;
-                            end
-                            else begin
-                                _next_state <= STATE_IDLE;
-                                _next_cmd <= CMD_NOP;
-                            end
-                        end
-                    end
-                    else begin
-                        _next_cmd <= CMD_NOP;
-                    end
+                else if ((_sel_cmd == CMD_ACTIVE) & (_sel_ba == b)) begin
+                    _bank_open[b]    <= 1'b1;
+                    _bank_row[b]     <= _sel_addr[SDRAM_O_ROW_WIDTH - 1 : 0];
+                    _bank_act_cnt[b] <= SDRAM_C_REFRESH_WAIT - 1; // tRC
                 end
-                default: begin
-                    // DED
-                    _next_state <= STATE_IDLE;
-                    _next_cmd <= CMD_NOP;
+                else begin
+                    _bank_act_cnt[b] <= timer_dec(_bank_act_cnt[b]);
                 end
-            endcase
+
+                if ((_sel_cmd == CMD_ACTIVE) & (_sel_ba == b))
+                    _bank_col_cnt[b] <= SDRAM_C_ACTIVE_WAIT - 1;
+                else
+                    _bank_col_cnt[b] <= timer_dec(_bank_col_cnt[b]);
+
+                if ((_sel_cmd == CMD_ACTIVE) & (_sel_ba == b))
+                    _bank_pre_cnt[b] <= SDRAM_C_RAS_WAIT - 1;
+                else if ((_sel_cmd == CMD_READ) & (_sel_ba == b))
+                    _bank_pre_cnt[b] <= timer_load(_bank_pre_cnt[b], SDRAM_C_READ_TO_PRE);
+                else if ((_sel_cmd == CMD_WRITE) & (_sel_ba == b))
+                    _bank_pre_cnt[b] <= timer_load(_bank_pre_cnt[b], SDRAM_C_WRITE_TO_PRE);
+                else
+                    _bank_pre_cnt[b] <= timer_dec(_bank_pre_cnt[b]);
+            end
+
+            if (_sel_cmd == CMD_ACTIVE)
+                _rrd_cnt <= SDRAM_C_RRD_WAIT - 1;
+            else
+                _rrd_cnt <= timer_dec(_rrd_cnt);
+
+            if (_sel_cmd == CMD_READ) begin
+                _bus_cnt  <= SDRAM_C_READ_BEATS - 1;
+                _stop_cnt <= SDRAM_O_FULL_PAGE ? SDRAM_C_READ_BEATS : 0;
+            end
+            else if (_sel_cmd == CMD_WRITE) begin
+                _bus_cnt  <= SDRAM_C_WRITE_BEATS - 1;
+                _stop_cnt <= SDRAM_O_WRITE_STOP ? SDRAM_C_WRITE_BEATS : 0;
+            end
+            else begin
+                _bus_cnt  <= timer_dec(_bus_cnt);
+                _stop_cnt <= timer_dec(_stop_cnt);
+            end
         end
     end
 
     // ==================================================
-    // Mem interface I/Os
-    // Latching new request
-    logic allow_new_req;
-    // Does not allow latching new req when state changing
-    assign allow_new_req =  (~_sig_state_changing) &
-                            ((_state == STATE_IDLE) |
-                            (_sig_read_done) |
-                            (_sig_write_done) |
-                            (_sig_refresh_done));
-
-    logic _we;
-    logic [MEM_O_ADDR_WIDTH - 1 : 0] _addr;
-    // In case of write burst:
-    // The data is sent since the start of request must be buffered else lost
-    // Depth of _data needs to be the same as the number of write cycle delayed by the state machine
-    // Buffer to hold data from: active wait time -> write = 
-    //                           SDRAM_C_ACTIVE_WAIT + 2
-    localparam integer C_DATA_DELAY = 2 + SDRAM_C_ACTIVE_WAIT; // number of cycle from request to read / write state
-    // How big is too big? 32 words?
-    logic [SDRAM_O_DATA_WIDTH - 1 : 0] _data [C_DATA_DELAY - 1 : 0];
-
-    always_ff @(posedge i_clk) begin : saving_req
-        if(allow_new_req) begin
-            _we <= i_we;
-            _addr <= i_addr;
-            _data[0] <= i_data;
+    // Cmd register
+    always_ff @(posedge i_clk) begin : cmd_register
+        if (~i_rst) begin
+            _cmd      <= CMD_NOP;
+            _cmd_ba   <= 'h0;
+            _cmd_addr <= 'h0;
+        end
+        else begin
+            _cmd      <= _sel_cmd;
+            _cmd_ba   <= _sel_ba;
+            _cmd_addr <= _sel_addr;
         end
     end
- 
-    always_ff @(posedge i_clk) begin : saving_data
-        for (int i = C_DATA_DELAY - 2; i >= 0; i--) begin
-            _data[i+1] <= _data[i];
+
+    // ==================================================
+    // Data
+    // Read beats, READ on the bus next cycle, its beats on dq CAS latency after that
+    always_ff @(posedge i_clk) begin : read_beats
+        if (~i_rst)
+            _rd_sr <= 'h0;
+        else if (_sel_cmd == CMD_READ & _init_done)
+            _rd_sr <= (_rd_sr >> 1) | ({SDRAM_C_READ_BEATS{1'b1}} << SDRAM_C_CAS_LATENCY);
+        else
+            _rd_sr <= _rd_sr >> 1;
+    end
+
+    // Write beats, entry stays put until done (see _accept)
+    logic [C_WCAP_WIDTH - 1 : 0] _wr_beat;
+    logic                        _wr_slot;
+
+    always_ff @(posedge i_clk) begin : write_beats
+        if (~i_rst) begin
+            _wr_active <= 1'b0;
+            _wr_beat   <= 'h0;
+        end
+        else if (_sel_cmd == CMD_WRITE & _init_done) begin
+            _wr_active <= 1'b1;
+            _wr_beat   <= 'h0;
+            _wr_slot   <= _q_head;
+        end
+        else if (_wr_active) begin
+            if (_wr_beat == SDRAM_C_WRITE_BEATS - 1)
+                _wr_active <= 1'b0;
+            else
+                _wr_beat <= _wr_beat + 1;
         end
     end
 
+    logic [SDRAM_O_DATA_WIDTH - 1 : 0] _wdata_out;
+    assign _wdata_out = _q_wdata[_wr_slot][_wr_beat];
+
     // Data I/Os
-    assign o_busy = (_state != STATE_IDLE); 
-    assign o_ack  = (_state == STATE_ACTIVE & _wait_counter == 0);
+    assign o_busy    = ~_init_done | _h_valid | _wr_active | (_rd_sr != 'h0) | (_refresh_busy != 'h0);
+    assign o_refresh = (_refresh_hold & _init_done) | (_refresh_busy != 'h0);
+
+    always_ff @(posedge i_clk) begin : ack_sig
+        if (~i_rst)
+            o_ack <= 1'b0;
+        else
+            o_ack <= _accept;
+    end
 
     always_ff @(posedge i_clk) begin : valid_sig
         if (~i_rst) begin
             o_valid <= 1'b0;
         end
         else begin
-            if (_sig_read_data_avail) begin // valid on read data available
-                o_valid <= 1'b1;
-            end
-            else begin
-                o_valid <= 1'b0;
-            end
+            o_valid <= _rd_sr[0]; // valid on read data available
         end
     end
-    
+
     always_ff @(posedge i_clk) begin : latch_sdram_data
         if (~i_rst) begin
             o_data <= 'h0;
         end
         else begin
-            if (_sig_read_data_avail) begin
+            if (_rd_sr[0]) begin
 `ifdef VERILATOR
                 o_data <= i_r_dq;
 `else
@@ -501,52 +649,15 @@ module SDRAMController #(
     // Assigning ouputs to sdram
     // Cmds
     assign {o_r_ras, o_r_cas, o_r_we} = _cmd;
-
-    // Address and bank address
-    // In compatible sdram, o_r_ba and o_r_addr[10] is used in some commands
-    always_comb begin : assigning_o_r_ba
-        if (_state == STATE_ACTIVE | _state == STATE_READ | _state == STATE_WRITE)
-            o_r_ba = _addr[MEM_O_ADDR_WIDTH - 1 : MEM_O_ADDR_WIDTH - SDRAM_O_BANK_WIDTH];
-        else
-            o_r_ba = 2'b00;
-    end
-
-    always_comb begin : assigning_o_r_addr
-        case (_state)
-            STATE_INIT: begin
-                // Timing, roughly, doesn't need to be exact
-                if (_wait_counter < SDRAM_C_INIT_WAIT_REFRESH_2) begin
-                    // PrechargeAll
-                    o_r_addr = {{(SDRAM_O_ADDR_WIDTH - 11){1'b0}}, 11'b1_0000000000};
-                end
-                else begin
-                    // Mode register set
-                    o_r_addr = {{(SDRAM_O_ADDR_WIDTH - 11){1'b0}}, 4'b0_0_00, SDRAM_C_CAS_LATENCY[2:0], 1'b0, SDRAM_O_BURST_LENGTH[2:0]};
-                end
-            end
-            STATE_ACTIVE: begin
-                o_r_addr = _addr[MEM_O_ADDR_WIDTH - SDRAM_O_BANK_WIDTH - 1 : MEM_O_ADDR_WIDTH - SDRAM_O_BANK_WIDTH - SDRAM_O_ROW_WIDTH]; // row
-            end
-            // and AutoPrecharge
-            STATE_READ: begin
-                o_r_addr = {{(SDRAM_O_ADDR_WIDTH - 11){1'b0}}, 1'b1, {(11 - (MEM_O_ADDR_WIDTH - SDRAM_O_BANK_WIDTH - SDRAM_O_ROW_WIDTH) - 1){1'b0}}, _addr[MEM_O_ADDR_WIDTH - SDRAM_O_BANK_WIDTH - SDRAM_O_ROW_WIDTH - 1 : 0]}; // column
-            end
-            // and AutoPrecharge
-            STATE_WRITE: begin
-                o_r_addr = {{(SDRAM_O_ADDR_WIDTH - 11){1'b0}}, 1'b1, {(11 - (MEM_O_ADDR_WIDTH - SDRAM_O_BANK_WIDTH - SDRAM_O_ROW_WIDTH) - 1){1'b0}}, _addr[MEM_O_ADDR_WIDTH - SDRAM_O_BANK_WIDTH - SDRAM_O_ROW_WIDTH - 1 : 0]}; // column
-            end
-            default: begin
-                // STATE_IDLE || STATE_REFRESH || DED
-                o_r_addr = 'h0;
-            end 
-        endcase
-    end
+    // Address and bank address, A10 low except precharge all
+    assign o_r_ba   = _cmd_ba;
+    assign o_r_addr = _cmd_addr;
 
 `ifdef VERILATOR
-    assign o_r_dq = _data[C_DATA_DELAY - 1];
+    assign o_r_dq = _wdata_out;
 `else
-    // SDRAM data line, burst length = 1 as 32 bit interface
-    assign io_r_dq = (_state == STATE_WRITE) ? _data[C_DATA_DELAY - 1] : 32'bZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ;
+    // SDRAM data line
+    assign io_r_dq = _wr_active ? _wdata_out : 32'bZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ;
 `endif
 
 endmodule
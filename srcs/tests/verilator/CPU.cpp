@@ -1,10 +1,17 @@
+#include <cassert>
+#include <climits>
 #include <csignal>
+#include <cstdio>
 #include <cstdlib>
 
 #include "include/config.h"
 
 #include "include/utils.h"
 #include "include/testbench.h"
+#include "include/retireTrace.h"
+#include "include/memImage.h"
+#include "include/models/RV32ISim.h"
+#include "include/cosimChecker.h"
 
 // For symbols from top modules 
 #include "VCPU.h"
@@ -19,6 +26,7 @@
 
 #ifndef BRAM_AS_RAM
 #include "include/models/SDRAM.h"
+#include "include/sdramFastForward.h"
 #endif /* BRAM_AS_RAM */
 
 // ========================================================
@@ -30,25 +38,35 @@ Module<VCPU> *p_module_cpu;
 
 #ifndef BRAM_AS_RAM
 ClockDomain  *p_domain_ram;
-SDRAM *p_sdram;
+SDRAMModel<RAM_GEOMETRY> *p_sdram;
+static_assert(SDRAMModel<RAM_GEOMETRY>::s_size_byte >= RAM_SIZE, "RAM_GEOMETRY part is smaller than RAM_SIZE");
 #endif
 
 #define CPUPtr ((VCPU*)(p_module_cpu->getUUTPtr()))
 
+// +retire_trace=<file>, nullptr when off
+RetireTraceWriter *p_retire_trace;
+
+// +cosim, nullptr when off
+class CosimChecker;
+CosimChecker *p_cosim;
+
+// Firmware, env ROMFILE (ELF or rom.txt) + SDRAMFILE, loaded before the first eval
+MemImage g_image;
+uint32_t g_rom_words[ROM_SIZE / 4];
+
 // ========================================================
 // Support functions
 
 // ==============================
 // Export to DPI-C
 
-const char* fetchenv(const char* env_var)
+// InstrMemory initial block, ROM word by word
+int romImageWord(int idx)
 {
-	const char* data = getenv(env_var);
-	if (!data) {
-		DEBUG("Could not fetch env %s, exiting!", env_var);
-		exit(EXIT_FAILURE);
-	}
-	return data;
+	if ((idx < 0) || (idx >= ROM_SIZE / 4))
+		return 0;
+	return g_rom_words[idx];
 }
 
 // ==============================
@@ -71,9 +89,96 @@ void cleanup_exit()
 
 // ==============================
 
+// Counters live in DataPipeline (verilator public), count resolved branches / jumps in exec
+// Return false when they do not add up: hits / mispredicts are subsets of resolved branches / jumps
+bool dumpBranchStats()
+{
+	if (!p_tb)
+		return true;
+	VCPU_DataPipeline *p_pipeline = CPUPtr->rootp->CPU->dataPipeline;
+	uint32_t cf   = p_pipeline->bp_cf_cnt;
+	uint32_t hit  = p_pipeline->bp_btb_hit_cnt;
+	uint32_t miss = p_pipeline->bp_mispredict_cnt;
+#ifdef BP_EN
+	LOG_INFO(LOG_HARNESS, "Branch prediction (%s, BTB %d, PHT %d):",
+#ifdef BP_GSHARE
+		"gshare",
+#else
+		"bimodal",
+#endif
+		BP_BTB_ENTRIES, BP_PHT_ENTRIES);
+#else
+	LOG_INFO(LOG_HARNESS, "Branch prediction disabled (always pc + 4):");
+#endif
+	LOG_INFO(LOG_HARNESS, "  branches / jumps %10u", cf);
+	LOG_INFO(LOG_HARNESS, "  BTB hits         %10u (%5.1f%%)", hit, cf ? 100.0 * hit / cf : 0.0);
+	LOG_INFO(LOG_HARNESS, "  mispredicts      %10u (%5.1f%%), %u cycles flushed (fetch + decode)", miss,
+		cf ? 100.0 * miss / cf : 0.0, 2 * miss);
+	if ((hit > cf) || (miss > cf)) {
+		LOG_ERROR(LOG_HARNESS, "Branch counters do not add up, more hits / mispredicts than branches");
+		return false;
+	}
+	return true;
+}
+
+// ==============================
+
+// One retired instr, loads go in with their value pending
+void sampleRetireRecord(unsigned long long cycle, VCPU_DataPipeline *p_pipeline)
+{
+	uint8_t flags = 0;
+	if (p_pipeline->tr_mem & 0x1)
+		flags |= RETIRE_F_LOAD;
+	else if (p_pipeline->tr_mem & 0x2)
+		flags |= RETIRE_F_STORE;
+	else if (p_pipeline->tr_we && p_pipeline->tr_rd)
+		flags |= RETIRE_F_WB;
+	// Loads: rd from the instr, W was flushed
+	uint8_t rd = (p_pipeline->tr_instr >> 7) & 0x1f;
+	p_retire_trace->retire(cycle, p_pipeline->tr_pc, p_pipeline->tr_instr, rd,
+		(flags & RETIRE_F_WB) ? p_pipeline->tr_wb : 0, (flags & (RETIRE_F_LOAD | RETIRE_F_STORE)) ? p_pipeline->tr_addr : 0, flags);
+}
+
+// Retire trace signals live in DataPipeline (verilator public), sample once per CPU cycle after the edge
+void sampleRetire(unsigned long long cycle)
+{
+	if (!p_retire_trace)
+		return;
+	VCPU_DataPipeline *p_pipeline = CPUPtr->rootp->CPU->dataPipeline;
+	if (p_pipeline->tr_valid)
+		sampleRetireRecord(cycle, p_pipeline);
+	// Load value from LSU after the retire: a dcache hit is acked in the cycle its own load retires.
+	// LSU is 1 deep, the value always belongs to the oldest pending load, retired this cycle or before
+	if (p_pipeline->tr_lret)
+		p_retire_trace->loadReturn(p_pipeline->tr_lret_rd, p_pipeline->tr_lret_data);
+}
+
+// ==============================
+
+void closeRetireTrace()
+{
+	if (p_retire_trace) {
+		delete p_retire_trace;
+		p_retire_trace = nullptr;
+	}
+	// After the trace, closing it hands over loads still pending
+	if (p_cosim) {
+		if (!p_cosim->hasFailed() && p_cosim->getChecked())
+			LOG_INFO(LOG_ISS, "Cosim passed, %llu instrs checked", p_cosim->getChecked());
+		else if (!p_cosim->hasFailed())
+			LOG_ERROR(LOG_ISS, "Cosim: nothing retired, no instr checked");
+		delete p_cosim;
+		p_cosim = nullptr;
+	}
+}
+
+// ==============================
+
 void sigint_handler(int num)
 {
-	DEBUG("SIGINT caught, exiting...");
+	LOG_INFO(LOG_HARNESS, "SIGINT caught, exiting...");
+	dumpBranchStats();
+	closeRetireTrace();
 	exit(EXIT_SUCCESS);
 }
 
@@ -87,13 +192,41 @@ void install_signal_handlers()
 	// (might just call signal() instead)
 	sa.sa_flags = SA_RESTART; 
 	if (sigaction(SIGINT, &sa, NULL) == -1) {
-		DEBUG("SIGACTION failed!");
+		LOG_ERROR(LOG_HARNESS, "SIGACTION failed!");
 		exit(EXIT_FAILURE);
 	}
 }
 
 // ==============================
 
+/* Firmware straight into the memories, no $readmemh: ROM words for InstrMemory (romImageWord), and with SDRAM
+ * the model backing memory gets .sdram_text (ELF or SDRAMFILE) plus .data / .bss at their run address (ELF),
+ * reset.c then skips its copy loops. BRAM as RAM: the RAM is in the RTL, reset.c still copies
+ * SDRAM backing memory can start as an image file, firmware goes on top of it:
+ * +sdram_image=<file> preload only (E.G. a data set), +sdram_dump=<file> shared, the file holds RAM after the run
+ */
+void loadImage()
+{
+	if (!g_image.loadFromEnv())
+		exit(EXIT_FAILURE);
+#ifndef BRAM_AS_RAM
+	const char *p_image_arg = p_tb->getContextPtr()->commandArgsPlusMatch("sdram_image=");
+	const char *p_dump_arg  = p_tb->getContextPtr()->commandArgsPlusMatch("sdram_dump=");
+	if (p_dump_arg && p_dump_arg[0])
+		p_sdram->setBackingFile(p_dump_arg + strlen("+sdram_dump="), true);
+	else if (p_image_arg && p_image_arg[0])
+		p_sdram->setBackingFile(p_image_arg + strlen("+sdram_image="), false);
+	// Before the ROM copy, patches _data_preloaded there
+	g_image.markDataPreloaded();
+	// Backing memory is [bank][row][column] = linear in RAM address
+	g_image.copyTo(RAM_START_ADDR, RAM_SIZE, (uint8_t *)p_sdram->getBackingMemPtr());
+#endif
+	size_t n_rom = g_image.copyTo(ROM_START_ADDR, ROM_SIZE, (uint8_t *)g_rom_words);
+	LOG_INFO(LOG_HARNESS, "ROM %zu / %d bytes used", n_rom, ROM_SIZE);
+}
+
+// ==============================
+
 // SDRAM does not have rst line
 void resetCPU()
 {
@@ -105,17 +238,18 @@ void resetCPU()
 
 // ==============================
 
+// Instrs passed on the way are in the retire trace when on, no per cycle print
 void cycleUntilROMAddr(const unsigned int& curr, unsigned int target)
 {
 	unsigned long long current_time = p_tb->getContextPtr()->time();
-	DEBUG("Begin cycling until instr addr 0x%08X, currently at 0x%08X, time %llu ps",target, curr, current_time);
+	unsigned long long cycle = 0;
+	LOG_INFO(LOG_HARNESS, "Begin cycling until instr addr 0x%08X, currently at 0x%08X, time %llu ps",target, curr, current_time);
 	while(target != curr) {
 		p_tb->evalUntilClockEdge(p_domain_cpu, 0);
-		current_time = p_tb->getContextPtr()->time();
-		// stalling set the ptr to 0
-		if (curr)
-			DEBUG("Reached instr: 0x%08X @ %llu ps", curr, current_time);
+		sampleRetire(++cycle);
 	}
+	current_time = p_tb->getContextPtr()->time();
+	LOG_INFO(LOG_HARNESS, "Reached instr: 0x%08X @ %llu ps, %llu cycles", curr, current_time, cycle);
 }
 
 // ========================================================
@@ -157,8 +291,8 @@ int main(int argc, char **argv)
 
 #ifndef BRAM_AS_RAM
 	// Follow RTL file since SDRAMController is not standalone module anymore
-    p_sdram = new SDRAM(RAM_CLK_FREQ, RAM_CAS_LATENCY);
-	p_domain_ram->addModelClock(&(p_sdram->i_clk));
+    p_sdram = new SDRAMModel<RAM_GEOMETRY>(RAM_CLK_FREQ, RAM_CAS_LATENCY);
+	p_domain_ram->addModel(p_sdram, &(p_sdram->i_clk));
 #endif
 
 	// ==============================
@@ -178,6 +312,9 @@ int main(int argc, char **argv)
     p_sdram->o_data  = &(CPUPtr->i_ram_dq);
 #endif
 
+	// Before anything evals, InstrMemory reads the ROM in its initial block
+	loadImage();
+
 	// ==============================
 	// 6. Add all into testbench
 
@@ -191,12 +328,64 @@ int main(int argc, char **argv)
 
 	// ==============================
 	// 7. Setup tracer
-	p_tb->setTracing(1, "CPU.vcd");
+	p_tb->setTracing(1, "CPU" TRACE_FILE_EXT);
+	// Only capture from when PC reaches +trace_pc=<hex>, for +trace_len=<ps> if given
+	const char *p_trace_pc_arg  = p_tb->getContextPtr()->commandArgsPlusMatch("trace_pc=");
+	const char *p_trace_len_arg = p_tb->getContextPtr()->commandArgsPlusMatch("trace_len=");
+	if (p_trace_pc_arg && p_trace_pc_arg[0]) {
+		IData trace_pc = strtoul(p_trace_pc_arg + strlen("+trace_pc="), nullptr, 16);
+		ITraceTrigger *p_trace_stop = nullptr;
+		if (p_trace_len_arg && p_trace_len_arg[0])
+			p_trace_stop = new TimeTraceTrigger(strtoull(p_trace_len_arg + strlen("+trace_len="), nullptr, 10), true);
+		p_tb->setTraceTriggers(new SignalTraceTrigger<IData>(&(CPUPtr->rootp->CPU->dataPipeline->e_pc), trace_pc), p_trace_stop);
+	}
+
+	// Retire trace, binary, decode with tools/retireDecode
+	const char *p_retire_trace_arg = p_tb->getContextPtr()->commandArgsPlusMatch("retire_trace=");
+	if (p_retire_trace_arg && p_retire_trace_arg[0]) {
+		p_retire_trace = new RetireTraceWriter(p_retire_trace_arg + strlen("+retire_trace="));
+		if (!p_retire_trace->isOpen())
+			closeRetireTrace();
+	}
+	// Lockstep against the RV32I ISS, +cosim, rides on the retire trace (file optional)
+	const char *p_cosim_arg = p_tb->getContextPtr()->commandArgsPlusMatch("cosim");
+	if (p_cosim_arg && p_cosim_arg[0]) {
+		p_cosim = new CosimChecker(g_image);
+		if (!p_retire_trace)
+			p_retire_trace = new RetireTraceWriter(nullptr);
+		p_retire_trace->addListener(p_cosim);
+	}
 
 	// ==============================
 	// 8. Simulate
 
+#ifdef VRLT_SAVABLE
+	// Checkpoint: +restore=<file> continues from a snapshot instead of resetting,
+	// +save=<file> snapshots after reset, or once time reaches +save_at=<ps> (E.G. after SDRAM init)
+	const char *p_restore_arg = p_tb->getContextPtr()->commandArgsPlusMatch("restore=");
+	const char *p_save_arg    = p_tb->getContextPtr()->commandArgsPlusMatch("save=");
+	const char *p_save_at_arg = p_tb->getContextPtr()->commandArgsPlusMatch("save_at=");
+	if (p_restore_arg && p_restore_arg[0])
+		p_tb->restore(p_restore_arg + strlen("+restore="));
+	else
+		resetCPU();
+	if (p_save_arg && p_save_arg[0]) {
+		if (p_save_at_arg && p_save_at_arg[0]) {
+			unsigned long long save_at = strtoull(p_save_at_arg + strlen("+save_at="), nullptr, 10);
+			while (p_tb->getContextPtr()->time() < save_at)
+				p_tb->evalUntilClockEdge(p_domain_cpu, 0);
+		}
+		p_tb->save(p_save_arg + strlen("+save="));
+	}
+#else
 	resetCPU();
+#endif
+#ifndef BRAM_AS_RAM
+	// Core just left reset, nothing in flight: skip the SDRAM power on delay, +full_sdram_init keeps it
+	const char *p_full_init_arg = p_tb->getContextPtr()->commandArgsPlusMatch("full_sdram_init");
+	if (!(p_full_init_arg && p_full_init_arg[0]))
+		sdramSkipStartup(p_tb, p_domain_ram, p_sdram);
+#endif
 	
 	// Run
 	// while(!p_tb->isDone()) {
@@ -206,11 +395,25 @@ int main(int argc, char **argv)
 	// Instr test
 	// cycleUntilROMAddr(CPUPtr->rootp->CPU->dataPipeline->e_pc, 0x1e4);
 
+	// Benchmark ROMs (E.G. ldst_bench) mark phases on GPIO out, +gpio_marks prints cycles spent in each
+	const char *p_gpio_marks_arg = p_tb->getContextPtr()->commandArgsPlusMatch("gpio_marks");
+	bool gpio_marks = p_gpio_marks_arg && p_gpio_marks_arg[0];
+	IData gpio_out = CPUPtr->o_gpio;
+	unsigned long long cycle = 0, gpio_cycle = 0;
+	// Stop after +max_cycles=<n> CPU cycles, for scripted runs (make vrlt_dcache_sweep)
+	const char *p_max_cycles_arg = p_tb->getContextPtr()->commandArgsPlusMatch("max_cycles=");
+	unsigned long long max_cycles = ULLONG_MAX;
+	if (p_max_cycles_arg && p_max_cycles_arg[0])
+		max_cycles = strtoull(p_max_cycles_arg + strlen("+max_cycles="), nullptr, 10);
+
+	// Icache fill bus errors, fetch retries them, reported on the way up
+	CData fetch_err = 0;
+
 	// HW test
 	int counter = 0; 
-	while(!p_tb->isDone()) {
+	while(!p_tb->isDone() && cycle < max_cycles && !(p_cosim && p_cosim->hasFailed())) {
 		counter++;
-		if (counter >= 9) {
+		if (counter >= 9 && !gpio_marks) {
 			counter = 0;
 			// flip GPIO
 			if (!CPUPtr->i_gpio)
@@ -219,5 +422,29 @@ int main(int argc, char **argv)
 				CPUPtr->i_gpio = 0x00000000;
 		}
 	 	p_tb->evalUntilClockEdge(p_domain_cpu, 0);
+		cycle++;
+		sampleRetire(cycle);
+		if (CPUPtr->rootp->CPU->dataPipeline->f_fetch_err && !fetch_err)
+			LOG_WARN(LOG_HARNESS, "Icache fill bus error @ cycle %llu, fetch retrying", cycle);
+		fetch_err = CPUPtr->rootp->CPU->dataPipeline->f_fetch_err;
+		if (gpio_marks && CPUPtr->o_gpio != gpio_out) {
+			LOG_INFO(LOG_HARNESS, "GPIO out 0x%08X -> 0x%08X, %llu cycles", gpio_out, CPUPtr->o_gpio, cycle - gpio_cycle);
+			gpio_out   = CPUPtr->o_gpio;
+			gpio_cycle = cycle;
+		}
+	}
+	bool failed = !dumpBranchStats();
+	// Nothing retired is a failure too, E.G. pipeline stuck on the first fetch
+	failed |= p_cosim && (p_cosim->hasFailed() || !p_cosim->getChecked());
+	// Self checking ROMs end on a GPIO out value, +expect_gpio=<hex>
+	const char *p_expect_gpio_arg = p_tb->getContextPtr()->commandArgsPlusMatch("expect_gpio=");
+	if (p_expect_gpio_arg && p_expect_gpio_arg[0]) {
+		IData expect_gpio = strtoul(p_expect_gpio_arg + strlen("+expect_gpio="), nullptr, 16);
+		if (CPUPtr->o_gpio != expect_gpio) {
+			LOG_ERROR(LOG_HARNESS, "GPIO out 0x%08X at the end, expected 0x%08X", CPUPtr->o_gpio, expect_gpio);
+			failed = true;
+		}
 	}
+	closeRetireTrace();
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,422 @@
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "include/config.h"
+
+#include "include/utils.h"
+#include "include/testbench.h"
+
+#include "VDataMemStageBlock.h"
+#include "VDataMemStageBlock___024root.h"
+
+#ifndef BRAM_AS_RAM
+#include "include/models/SDRAM.h"
+#include "include/sdramFastForward.h"
+#endif /* BRAM_AS_RAM */
+
+/* Data bus bandwidth benchmark
+ * Drives the mem stage like the pipeline does (request held until taken, next one on the ack cycle)
+ * and measures how fast the dcache moves whole blocks over the wishbone bus:
+ *  - refill from ROM (1 cycle slave)
+ *  - refill from SDRAM
+ *  - store stream where every miss evicts a dirty block, the write back drains behind the refill
+ *    and the next miss waits for it
+ * Misses are acked on the critical word, so cycles here are latency to the access, not whole block time
+ * Also back to back hits, one request per cycle, and miss latency evicting a clean vs a dirty block
+ * make vrlt_bus_bench builds and runs it with WB_MAX_OUTSTANDING 1 (one request at a time) and 16
+ * Capacity / ways come from config.h, make vrlt_dcache_sweep builds and runs this for each pair
+ * +instances=<n>: n copies, each with its own SDRAM, get the same requests in lockstep and must answer the same
+ * as copy 0 every cycle. Gives TestBench threads (+threads=<n>) something to split, see make vrlt_threads_check
+ */
+
+// ========================================================
+// Globals
+
+TestBench    *p_tb;
+ClockDomain  *p_domain_cpu;
+// Copy 0 is driven and checked, the others mirror it
+std::vector<Module<VDataMemStageBlock> *> v_modules_mem;
+
+#ifndef BRAM_AS_RAM
+ClockDomain  *p_domain_ram;
+std::vector<SDRAMModel<RAM_GEOMETRY> *> v_sdrams;
+#endif
+
+#define DataMemPtrN(n) ((VDataMemStageBlock*)(v_modules_mem[n]->getUUTPtr()))
+#define DataMemPtr DataMemPtrN(0)
+
+// Same as CPU.cpp
+static const double s_cpu_freq_mhz = 20;
+
+// Request presented in the last cycle() was taken on its rising edge
+static bool s_req_taken;
+
+// ========================================================
+// Support functions
+
+void sigint_handler(int num)
+{
+	LOG_INFO(LOG_HARNESS, "SIGINT caught, exiting...");
+	exit(EXIT_SUCCESS);
+}
+
+void install_signal_handlers()
+{
+	// SIGINT
+	struct sigaction sa;
+	sa.sa_handler = sigint_handler;
+	sigemptyset(&sa.sa_mask);
+	// Restart functions if interrupted by handler
+	// (might just call signal() instead)
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGINT, &sa, NULL) == -1) {
+		LOG_ERROR(LOG_HARNESS, "SIGACTION failed!");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// ==============================
+
+// Word the ROM / SDRAM hold at addr before any store, easy to check
+uint32_t initial_word(uint32_t addr)
+{
+	return addr & 0xfffffffc;
+}
+
+// Copy 0 inputs to the other copies, ROM data is per copy
+void mirrorInputs()
+{
+	for (size_t n = 1; n < v_modules_mem.size(); n++) {
+		DataMemPtrN(n)->i_rst                 = DataMemPtr->i_rst;
+		DataMemPtrN(n)->i_req                 = DataMemPtr->i_req;
+		DataMemPtrN(n)->i_we                  = DataMemPtr->i_we;
+		DataMemPtrN(n)->i_mask_type           = DataMemPtr->i_mask_type;
+		DataMemPtrN(n)->i_ext_type            = DataMemPtr->i_ext_type;
+		DataMemPtrN(n)->i_memory_address      = DataMemPtr->i_memory_address;
+		DataMemPtrN(n)->i_memory_data         = DataMemPtr->i_memory_data;
+		DataMemPtrN(n)->i_next_memory_address = DataMemPtr->i_next_memory_address;
+	}
+}
+
+// Every copy must answer like copy 0, same cycle
+void checkCopies()
+{
+	for (size_t n = 1; n < v_modules_mem.size(); n++) {
+		if ((DataMemPtrN(n)->o_memory_ack != DataMemPtr->o_memory_ack) ||
+			(DataMemPtrN(n)->o_memory_stall != DataMemPtr->o_memory_stall) ||
+			(DataMemPtrN(n)->o_memory_err != DataMemPtr->o_memory_err) ||
+			(DataMemPtr->o_memory_ack && (DataMemPtrN(n)->o_memory_readout != DataMemPtr->o_memory_readout))) {
+			LOG_ERROR(LOG_HARNESS, "Copy %zu differs from copy 0 @ %llu ps", n, (unsigned long long)p_tb->getContextPtr()->time());
+			abort();
+		}
+	}
+}
+
+// One CPU clock
+// ROM port 2 is a BRAM outside of the mem stage, emulate it here:
+// en / addr get latched on the rising edge, data is out after it
+void cycle()
+{
+	mirrorInputs();
+	p_tb->evalUntilClockEdge(p_domain_cpu, 1);
+	// Rising edge not evaluated yet, these are what the ROM sees on it
+	static std::vector<uint32_t> v_rom_addr(v_modules_mem.size());
+	static std::vector<unsigned char> v_rom_en(v_modules_mem.size());
+	for (size_t n = 0; n < v_modules_mem.size(); n++) {
+		v_rom_en[n]   = DataMemPtrN(n)->o_rom_p2_en;
+		v_rom_addr[n] = DataMemPtrN(n)->o_rom_p2_addr;
+	}
+	s_req_taken = DataMemPtr->i_req && !DataMemPtr->o_memory_stall;
+	p_tb->evalUntilClockEdge(p_domain_cpu, 0);
+	for (size_t n = 0; n < v_modules_mem.size(); n++) {
+		if (v_rom_en[n])
+			DataMemPtrN(n)->i_rom_p2_rd = initial_word(v_rom_addr[n]);
+	}
+	checkCopies();
+}
+
+void resetDataMem()
+{
+	DataMemPtr->i_req = 0;
+	DataMemPtr->i_rst = 0;
+	cycle();
+	DataMemPtr->i_rst = 1;
+	cycle();
+}
+
+void check_err(uint32_t addr)
+{
+	if (DataMemPtr->o_memory_err) {
+		LOG_ERROR(LOG_HARNESS, "Access error @ 0x%08X", addr);
+		abort();
+	}
+}
+
+/* Word access, held until taken then wait for ack like the pipeline
+ * Returns cycles from request to ack, readout in p_data for loads
+ */
+unsigned long long mem_access(uint32_t addr, bool we, uint32_t *p_data)
+{
+	DataMemPtr->i_req            = 1;
+	DataMemPtr->i_we             = we;
+	DataMemPtr->i_mask_type      = 2; // word
+	DataMemPtr->i_ext_type       = 0;
+	DataMemPtr->i_memory_address = addr;
+	DataMemPtr->i_memory_data    = we ? *p_data : 0;
+	// Dcache tag lookup guess, held request is looked up again by the cache anyway
+	DataMemPtr->i_next_memory_address = addr;
+	unsigned long long cycles = 0;
+	do {
+		cycle();
+		cycles++;
+		check_err(addr);
+	} while (!s_req_taken);
+	DataMemPtr->i_req = 0;
+	while (!DataMemPtr->o_memory_ack) {
+		cycle();
+		cycles++;
+		check_err(addr);
+	}
+	if (!we)
+		*p_data = DataMemPtr->o_memory_readout;
+	return cycles;
+}
+
+/* n word loads in one block at addr, a new request every cycle the last one was taken
+ * Returns cycles from first request to last ack
+ */
+unsigned long long hit_stream_cycles(uint32_t addr, int n)
+{
+	const int n_words = DCACHE_BLOCK_SIZE / 4;
+	int sent = 0, acked = 0;
+	unsigned long long cycles = 0;
+	DataMemPtr->i_we        = 0;
+	DataMemPtr->i_mask_type = 2; // word
+	DataMemPtr->i_ext_type  = 0;
+	while (acked < n) {
+		DataMemPtr->i_req            = sent < n;
+		DataMemPtr->i_memory_address = addr + (sent % n_words) * 4;
+		// Next one if this is taken, like the pipeline does with the exec stage addr
+		DataMemPtr->i_next_memory_address = addr + ((sent + 1) % n_words) * 4;
+		cycle();
+		cycles++;
+		if (s_req_taken)
+			sent++;
+		if (DataMemPtr->o_memory_ack) {
+			uint32_t acked_addr = addr + (acked % n_words) * 4;
+			if (DataMemPtr->o_memory_readout != initial_word(acked_addr)) {
+				LOG_ERROR(LOG_HARNESS, "Data mismatch @ 0x%08X: 0x%08X != 0x%08X", acked_addr,
+					DataMemPtr->o_memory_readout, initial_word(acked_addr));
+				abort();
+			}
+			acked++;
+		}
+	}
+	DataMemPtr->i_req = 0;
+	return cycles;
+}
+
+/* Touch one word in each of n_blocks consecutive blocks from addr, every access misses
+ * Loads check data against initial_word, stores write ~addr
+ */
+unsigned long long block_stream_cycles(uint32_t addr, int n_blocks, bool we)
+{
+	unsigned long long cycles = 0;
+	for (int i = 0; i < n_blocks; i++) {
+		uint32_t data = ~addr;
+		cycles += mem_access(addr, we, &data);
+		if (!we && data != initial_word(addr)) {
+			LOG_ERROR(LOG_HARNESS, "Data mismatch @ 0x%08X: 0x%08X != 0x%08X", addr, data, initial_word(addr));
+			abort();
+		}
+		addr += DCACHE_BLOCK_SIZE;
+	}
+	return cycles;
+}
+
+/* Dirty eviction, then a load of the evicted block right away: it has to come back with the store in it,
+ * from the write back buffer or SDRAM, whichever has it then. Blocks at addr + k * set stride, all one set,
+ * addr not touched before. Consecutive misses fill every way once (PLRU), so the set is all clean / all dirty
+ * Logs miss latency evicting a clean block vs a dirty one: the write back is off the miss path when they are
+ * close, without the write back buffer the dirty one pays the whole block write first
+ */
+void dirty_evict_reload_test(uint32_t addr)
+{
+	const uint32_t set_stride = DCACHE_CAPACITY / DCACHE_WAYS;
+	uint32_t data;
+	// Clean set, let write backs of blocks from earlier tests drain
+	for (int k = 0; k < DCACHE_WAYS; k++)
+		mem_access(addr + k * set_stride, false, &data);
+	for (int i = 0; i < 256; i++)
+		cycle();
+	unsigned long long clean_cycles = mem_access(addr + DCACHE_WAYS * set_stride, false, &data);
+	// Dirty set, store misses evict clean blocks. Mid block word: refill starts there (critical word),
+	// the store is merged into the refilled block
+	const uint32_t dirty_addr = addr + (DCACHE_WAYS + 1) * set_stride + 20;
+	for (int k = 0; k < DCACHE_WAYS; k++) {
+		data = ~(dirty_addr + k * set_stride);
+		mem_access(dirty_addr + k * set_stride, true, &data);
+	}
+	for (int i = 0; i < 256; i++)
+		cycle();
+	// Evicts the first dirty block, then load it back
+	unsigned long long dirty_cycles  = mem_access(addr + (2 * DCACHE_WAYS + 1) * set_stride, false, &data);
+	unsigned long long reload_cycles = mem_access(dirty_addr, false, &data);
+	if (data != ~dirty_addr) {
+		LOG_ERROR(LOG_HARNESS, "Evicted block reload mismatch @ 0x%08X: 0x%08X != 0x%08X", dirty_addr, data, ~dirty_addr);
+		abort();
+	}
+	// Rest of the block is what the refill brought in
+	mem_access(dirty_addr - 20, false, &data);
+	if (data != initial_word(dirty_addr - 20)) {
+		LOG_ERROR(LOG_HARNESS, "Evicted block reload mismatch @ 0x%08X: 0x%08X != 0x%08X", dirty_addr - 20, data,
+			initial_word(dirty_addr - 20));
+		abort();
+	}
+	// Rest of the stored blocks, some evicted by now
+	for (int k = 1; k < DCACHE_WAYS; k++) {
+		mem_access(dirty_addr + k * set_stride, false, &data);
+		if (data != ~(dirty_addr + k * set_stride)) {
+			LOG_ERROR(LOG_HARNESS, "Dirty block mismatch @ 0x%08X: 0x%08X != 0x%08X", dirty_addr + k * set_stride,
+				data, ~(dirty_addr + k * set_stride));
+			abort();
+		}
+	}
+	LOG_INFO(LOG_HARNESS, "Miss latency: clean eviction %llu cycles, dirty eviction %llu cycles, evicted block reload %llu cycles",
+		clean_cycles, dirty_cycles, reload_cycles);
+}
+
+void report(const char *name, unsigned long long bytes, unsigned long long cycles)
+{
+	double bytes_per_cycle = (double)bytes / cycles;
+	LOG_INFO(LOG_HARNESS, "%-28s %6llu bytes %7llu cycles %5.3f B/cycle %6.2f MB/s", name, bytes, cycles,
+		bytes_per_cycle, bytes_per_cycle * s_cpu_freq_mhz);
+}
+
+// ========================================================
+
+int main(int argc, char **argv)
+{
+	install_signal_handlers();
+
+	// Testbench, domains, modules, models. Same layout as CPU.cpp
+	p_tb = new TestBench(argc, argv);
+	p_domain_cpu = new ClockDomain(s_cpu_freq_mhz);
+#ifndef BRAM_AS_RAM
+	// Clock follow RTL file since SDRAMController is not standalone module anymore
+	p_domain_ram = new ClockDomain(RAM_CLK_FREQ);
+#endif
+
+	unsigned int n_instances = 1;
+	const char *p_instances_arg = p_tb->getContextPtr()->commandArgsPlusMatch("instances=");
+	if (p_instances_arg && p_instances_arg[0])
+		n_instances = strtoul(p_instances_arg + strlen("+instances="), nullptr, 10);
+	if (n_instances < 1)
+		n_instances = 1;
+#ifndef BRAM_AS_RAM
+	unsigned char one = 1;
+	unsigned char zero = 0;
+#endif
+	for (unsigned int n = 0; n < n_instances; n++) {
+		// Copy 0 keeps the name it always had
+		std::string name = n ? "DataMemStageBlock" + std::to_string(n) : "DataMemStageBlock";
+		v_modules_mem.push_back(new Module<VDataMemStageBlock>(p_tb->getContextPtr(), name.c_str()));
+		p_domain_cpu->addModuleClock(&(DataMemPtrN(n)->i_clk));
+#ifndef BRAM_AS_RAM
+		p_domain_ram->addModuleClock(&(DataMemPtrN(n)->i_ram_clk));
+
+		SDRAMModel<RAM_GEOMETRY> *p_sdram = new SDRAMModel<RAM_GEOMETRY>(RAM_CLK_FREQ, RAM_CAS_LATENCY);
+		p_domain_ram->addModel(p_sdram, &(p_sdram->i_clk));
+		p_sdram->i_cke   = &one;
+		p_sdram->i_cs_n  = &zero;
+		p_sdram->i_ras_n = &(DataMemPtrN(n)->o_ram_ras);
+		p_sdram->i_cas_n = &(DataMemPtrN(n)->o_ram_cas);
+		p_sdram->i_we_n  = &(DataMemPtrN(n)->o_ram_we);
+		p_sdram->i_ba    = &(DataMemPtrN(n)->o_ram_ba);
+		p_sdram->i_addr  = &(DataMemPtrN(n)->o_ram_addr);
+		p_sdram->i_data  = &(DataMemPtrN(n)->o_ram_dq);
+		p_sdram->o_data  = &(DataMemPtrN(n)->i_ram_dq);
+		v_sdrams.push_back(p_sdram);
+#endif
+	}
+
+	p_tb->addClockDomain(p_domain_cpu);
+	for (unsigned int n = 0; n < n_instances; n++)
+		p_tb->addModule(v_modules_mem[n]);
+#ifndef BRAM_AS_RAM
+	p_tb->addClockDomain(p_domain_ram);
+	for (unsigned int n = 0; n < n_instances; n++)
+		p_tb->addModel(v_sdrams[n]);
+#endif
+
+	p_tb->setTracing(1, "DataMemStageBlock" TRACE_FILE_EXT);
+
+	// ==========================================================
+	// Regions, each in blocks. Cache is empty after reset
+	const int      n_sets        = DCACHE_CAPACITY / DCACHE_BLOCK_SIZE / DCACHE_WAYS;
+	const int      rom_blocks    = ROM_SIZE / DCACHE_BLOCK_SIZE;
+	const int      ram_blocks    = n_sets; // one way worth
+	const int      cache_blocks  = n_sets * DCACHE_WAYS;
+	const uint32_t ram_read_addr = RAM_START_ADDR + 0x10000;
+	const uint32_t ram_fill_addr = RAM_START_ADDR + 0x20000; // fills the whole cache with dirty blocks
+	const uint32_t ram_evict_addr= RAM_START_ADDR + 0x30000; // every store evicts one of those
+	const uint32_t ram_victim_addr = RAM_START_ADDR + 0x40000; // dirty eviction + reload, one set
+	const uint32_t ram_end_addr  = ram_victim_addr + (2 * DCACHE_WAYS + 2) * (DCACHE_CAPACITY / DCACHE_WAYS);
+
+#ifndef BRAM_AS_RAM
+	// Preload what is read back, backing memory is linear in block address
+	for (unsigned int n = 0; n < n_instances; n++) {
+		uint32_t *p_backing = (uint32_t *)v_sdrams[n]->getBackingMemPtr();
+		for (uint32_t a = RAM_START_ADDR; a < ram_end_addr; a += 4)
+			p_backing[(a - RAM_START_ADDR) >> 2] = initial_word(a);
+	}
+#endif
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	resetDataMem();
+#ifndef BRAM_AS_RAM
+	// Copies share the ram domain, all their models skip together
+	sdramSkipStartup(p_tb, p_domain_ram, v_sdrams[0]);
+#endif
+	LOG_INFO(LOG_HARNESS, "Data bus bandwidth, WB_MAX_OUTSTANDING %d (%s), %d bytes blocks", WB_MAX_OUTSTANDING,
+		WB_MAX_OUTSTANDING > 1 ? "pipelined" : "one request at a time", DCACHE_BLOCK_SIZE);
+	LOG_INFO(LOG_HARNESS, "Dcache %d bytes, %d ways, %d sets", DCACHE_CAPACITY, DCACHE_WAYS, n_sets);
+
+	// Warm up: rest of the SDRAM power on sequence runs on the first access. Last set, away from ROM blocks
+	uint32_t data;
+	mem_access(ram_read_addr + (n_sets - 1) * DCACHE_BLOCK_SIZE + 4, false, &data);
+
+	unsigned long long cycles;
+	cycles = block_stream_cycles(ROM_START_ADDR, rom_blocks, false);
+	report("ROM refill", (unsigned long long)rom_blocks * DCACHE_BLOCK_SIZE, cycles);
+	// Last ROM block is in
+	const int n_hits = 1024;
+	cycles = hit_stream_cycles(ROM_START_ADDR + (rom_blocks - 1) * DCACHE_BLOCK_SIZE, n_hits);
+	report("Back to back hits", (unsigned long long)n_hits * 4, cycles);
+#ifndef BRAM_AS_RAM
+	cycles = block_stream_cycles(ram_read_addr, ram_blocks - 1, false);
+	report("SDRAM refill", (unsigned long long)(ram_blocks - 1) * DCACHE_BLOCK_SIZE, cycles);
+	block_stream_cycles(ram_fill_addr, cache_blocks, true);
+	// Write back + refill per store
+	cycles = block_stream_cycles(ram_evict_addr, cache_blocks, true);
+	report("SDRAM write back + refill", (unsigned long long)cache_blocks * DCACHE_BLOCK_SIZE * 2, cycles);
+	// Written back data must be there
+	data = 0;
+	mem_access(ram_fill_addr, false, &data);
+	if (data != ~ram_fill_addr) {
+		LOG_ERROR(LOG_HARNESS, "Write back mismatch @ 0x%08X: 0x%08X != 0x%08X", ram_fill_addr, data, ~ram_fill_addr);
+		abort();
+	}
+	dirty_evict_reload_test(ram_victim_addr);
+#endif
+
+	for (int i = 0 ; i < 5; i++)
+		cycle();
+	// Wall time is the only thing allowed to differ between thread counts
+	LOG_INFO(LOG_HARNESS, "%u copies agree, wall time %.3f s", n_instances,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	delete p_tb;
+}
@@ -0,0 +1,172 @@
+#include <csignal>
+#include <cstdlib>
+
+#include "include/config.h"
+
+#include "include/utils.h"
+#include "include/testbench.h"
+
+#include "VPerfCountersWB.h"
+#include "VPerfCountersWB___024root.h"
+
+// ========================================================
+
+// Globals
+TestBench *p_tb;
+ClockDomain *p_domain;
+Module<VPerfCountersWB> *p_perf;
+#define PerfCountersWBPtr ((VPerfCountersWB*)(p_perf->getUUTPtr()))
+
+// CTRL bits, same as PerfCountersWB.sv and addr.h
+#define CTRL_START 0x1
+#define CTRL_CLEAR 0x2
+#define CTRL_STOP  0x4
+
+#define N_EVENT_CYCLES 50
+
+// ========================================================
+
+void sigint_handler(int)
+{
+	LOG_INFO(LOG_HARNESS, "SIGINT caught, exiting...");
+	exit(EXIT_SUCCESS);
+}
+
+void install_signal_handlers()
+{
+	// SIGINT
+	struct sigaction sa;
+	sa.sa_handler = sigint_handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGINT, &sa, NULL) == -1) {
+		LOG_ERROR(LOG_HARNESS, "SIGACTION failed!");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// ========================================================
+
+// Single word access, events are low while on the bus so they do not count
+uint32_t wb_access(uint32_t addr, bool we, uint32_t data)
+{
+	PerfCountersWBPtr->i_events = 0;
+	PerfCountersWBPtr->i_cyc  = 1;
+	PerfCountersWBPtr->i_stb  = 1;
+	PerfCountersWBPtr->i_addr = addr;
+	PerfCountersWBPtr->i_we   = we;
+	PerfCountersWBPtr->i_sel  = 0xf;
+	PerfCountersWBPtr->i_data = data;
+	do {
+		p_tb->evalUntilClockEdge(p_domain, 0);
+	} while (PerfCountersWBPtr->o_ack == 0);
+	uint32_t readout = PerfCountersWBPtr->o_data;
+	PerfCountersWBPtr->i_cyc  = 0;
+	PerfCountersWBPtr->i_stb  = 0;
+	PerfCountersWBPtr->i_we   = 0;
+	p_tb->evalUntilClockEdge(p_domain, 0);
+	return readout;
+}
+
+void write_ctrl(uint32_t data)
+{
+	wb_access(PERF_START_ADDR, true, data);
+}
+
+uint32_t read_ctrl()
+{
+	return wb_access(PERF_START_ADDR, false, 0);
+}
+
+uint32_t read_counter(int i)
+{
+	return wb_access(PERF_START_ADDR + 4 + 4 * i, false, 0);
+}
+
+// n cycles of events: line 0 every cycle, line 1 every other cycle, others never
+void drive_events(int n)
+{
+	for (int c = 0; c < n; c++) {
+		PerfCountersWBPtr->i_events = 0x1 | ((c & 1) ? 0x2 : 0x0);
+		p_tb->evalUntilClockEdge(p_domain, 0);
+	}
+	PerfCountersWBPtr->i_events = 0;
+}
+
+// Counters 0, 1 and the never line 2 against expected, ctrl run bit too
+int expect(const char *p_step, uint32_t run, uint32_t count_0, uint32_t count_1)
+{
+	uint32_t ctrl = read_ctrl();
+	uint32_t c0 = read_counter(0), c1 = read_counter(1), c2 = read_counter(2);
+	if ((ctrl != run) || (c0 != count_0) || (c1 != count_1) || (c2 != 0)) {
+		LOG_WARN(LOG_HARNESS, "%s: ctrl %u counters %u %u %u, expected ctrl %u counters %u %u 0", p_step, ctrl, c0,
+			c1, c2, run, count_0, count_1);
+		return 1;
+	}
+	LOG_INFO(LOG_HARNESS, "%s: ctrl %u counters %u %u %u", p_step, ctrl, c0, c1, c2);
+	return 0;
+}
+
+void resetPerf()
+{
+	PerfCountersWBPtr->i_rst = 0;
+	p_tb->evalUntilClockEdge(p_domain, 0);
+	PerfCountersWBPtr->i_rst = 1;
+	p_tb->evalUntilClockEdge(p_domain, 0);
+}
+
+// ========================================================
+
+int main(int argc, char **argv)
+{
+#ifndef PERF_EN
+	LOG_ERROR(LOG_HARNESS, "Abort, enable perf counters in both simulation config and rtl config files");
+	abort();
+#else
+	install_signal_handlers();
+	// Create testbench
+	p_tb = new TestBench(argc, argv);
+	p_domain = new ClockDomain(20);
+	p_perf = new Module<VPerfCountersWB>(p_tb->getContextPtr(), "PerfCountersWB");
+	p_domain->addModuleClock(&(PerfCountersWBPtr->i_clk));
+	p_tb->addClockDomain(p_domain);
+	p_tb->addModule(p_perf);
+	p_tb->setTracing(1, "PerfCountersWB" TRACE_FILE_EXT);
+	// ==========================================================
+	// TESTING
+	int failed = 0;
+	resetPerf();
+	failed |= expect("After reset", 1, 0, 0);
+	// Running out of reset, clear alone must keep it running
+	drive_events(N_EVENT_CYCLES);
+	failed |= expect("Start", 1, N_EVENT_CYCLES, N_EVENT_CYCLES / 2);
+	write_ctrl(CTRL_CLEAR);
+	failed |= expect("Clear", 1, 0, 0);
+	drive_events(N_EVENT_CYCLES);
+	failed |= expect("Count after clear", 1, N_EVENT_CYCLES, N_EVENT_CYCLES / 2);
+	// Stop freezes, readback is stable
+	write_ctrl(CTRL_STOP);
+	drive_events(N_EVENT_CYCLES);
+	failed |= expect("Stop", 0, N_EVENT_CYCLES, N_EVENT_CYCLES / 2);
+	// Clear while stopped stays stopped
+	write_ctrl(CTRL_CLEAR);
+	drive_events(N_EVENT_CYCLES);
+	failed |= expect("Clear stopped", 0, 0, 0);
+	// Start goes on from where it is, stop wins over start in the same write
+	write_ctrl(CTRL_START);
+	drive_events(N_EVENT_CYCLES);
+	failed |= expect("Start again", 1, N_EVENT_CYCLES, N_EVENT_CYCLES / 2);
+	write_ctrl(CTRL_START | CTRL_CLEAR | CTRL_STOP);
+	drive_events(N_EVENT_CYCLES);
+	failed |= expect("Start clear stop", 0, 0, 0);
+	// Past the last counter reads 0
+	uint32_t past = wb_access(PERF_START_ADDR + 4 + 4 * PERF_N_COUNTERS, false, 0);
+	if (past) {
+		LOG_WARN(LOG_HARNESS, "Read past the last counter: 0x%08X", past);
+		failed = 1;
+	}
+	if (!failed)
+		LOG_INFO(LOG_HARNESS, "Perf counters test passed");
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+#endif
+}
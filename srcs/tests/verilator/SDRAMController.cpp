@@ -1,5 +1,7 @@
 #include <csignal>
 #include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "include/config.h"
 
@@ -10,6 +12,7 @@
 #include "VSDRAMController___024root.h"
 
 #include "include/models/SDRAM.h"
+#include "include/sdramFastForward.h"
 
 // ========================================================
 
@@ -24,7 +27,7 @@ SDRAM *p_sdram;
 
 void sigint_handler(int num)
 {
-	DEBUG("SIGINT caught, exiting...");
+	LOG_INFO(LOG_HARNESS, "SIGINT caught, exiting...");
 	exit(EXIT_SUCCESS);
 }
 
@@ -38,7 +41,7 @@ void install_signal_handlers()
 	// (might just call signal() instead)
 	sa.sa_flags = SA_RESTART; 
 	if (sigaction(SIGINT, &sa, NULL) == -1) {
-		DEBUG("SIGACTION failed!");
+		LOG_ERROR(LOG_HARNESS, "SIGACTION failed!");
 		exit(EXIT_FAILURE);
 	}
 }
@@ -127,6 +130,158 @@ char *sdram_read(uint32_t idx, size_t len)
 	return target_buffer;
 }
 
+/* Open page pattern, one word each, written then read back:
+ * same row (hits), another bank (active overlaps), same bank other row (conflict)
+ * returns number of mismatches
+ */
+int sdram_open_page_test()
+{
+	const uint32_t row_stride  = 1u << SDRAM::s_column_bit_width; // blocks
+	const uint32_t bank_stride = 1u << (SDRAM::s_row_bit_width + SDRAM::s_column_bit_width);
+	const uint32_t blocks[] = {
+		1, 2, 3,
+		bank_stride + 1, 4, bank_stride + 2,
+		row_stride + 1, 5, 2 * bank_stride + row_stride, 3 * bank_stride, 6
+	};
+	const int n_blocks = sizeof(blocks) / sizeof(blocks[0]);
+	char word[8];
+	int mismatches = 0;
+	for (int i = 0; i < n_blocks; i++) {
+		snprintf(word, sizeof(word), "w%03d", i);
+		sdram_write(blocks[i] * SDRAM::s_data_block_size, word, SDRAM::s_data_block_size);
+	}
+	for (int i = 0; i < n_blocks; i++) {
+		snprintf(word, sizeof(word), "w%03d", i);
+		char *output_data = sdram_read(blocks[i] * SDRAM::s_data_block_size, SDRAM::s_data_block_size);
+		if (memcmp(output_data, word, SDRAM::s_data_block_size)) {
+			LOG_WARN(LOG_HARNESS, "Open page test mismatch @ block %u: \"%.4s\" != \"%.4s\"", blocks[i], output_data, word);
+			mismatches++;
+		}
+		delete[] output_data;
+	}
+	return mismatches;
+}
+
+/* Open page pays off: n single block reads in one row (bank 1), then n alternating between two rows of bank 2.
+ * Same row only activates once (a refresh may close it once more) and must take fewer cycles than the
+ * row to row reads, each of those activates. Row hits / activates / cycles of both are logged
+ * returns 1 when open page did not help
+ */
+int sdram_row_locality_test(int n)
+{
+	const uint32_t row_stride  = 1u << SDRAM::s_column_bit_width; // blocks
+	const uint32_t bank_stride = 1u << (SDRAM::s_row_bit_width + SDRAM::s_column_bit_width);
+	uint64_t hits[2], activates[2], cycles[2];
+	for (int pass = 0; pass < 2; pass++) {
+		uint64_t hits_start = p_sdram->getRowHits();
+		uint64_t activates_start = p_sdram->getActivates();
+		uint64_t cycles_start = p_sdram->getCycles();
+		for (int i = 0; i < n; i++) {
+			uint32_t block = pass ? (2 * bank_stride + (i & 1) * row_stride + 8 + i) : (bank_stride + 8 + i);
+			delete[] sdram_read(block * SDRAM::s_data_block_size, SDRAM::s_data_block_size * p_sdram->get_burst_length());
+		}
+		hits[pass] = p_sdram->getRowHits() - hits_start;
+		activates[pass] = p_sdram->getActivates() - activates_start;
+		cycles[pass] = p_sdram->getCycles() - cycles_start;
+	}
+	LOG_INFO(LOG_HARNESS, "Open page, %d reads in one row   : %llu row hits, %llu activates, %llu cycles", n,
+		(unsigned long long)hits[0], (unsigned long long)activates[0], (unsigned long long)cycles[0]);
+	LOG_INFO(LOG_HARNESS, "Open page, %d reads row to row   : %llu row hits, %llu activates, %llu cycles", n,
+		(unsigned long long)hits[1], (unsigned long long)activates[1], (unsigned long long)cycles[1]);
+	if ((activates[0] > 2) || (hits[0] < (uint64_t)n - 2) || (cycles[0] >= cycles[1])) {
+		LOG_WARN(LOG_HARNESS, "Open page test: same row reads did not stay in the open row");
+		return 1;
+	}
+	return 0;
+}
+
+/* Image file as backing memory (setBackingFile), one word at block: private mapping reads the file and
+ * keeps writes in process, shared mapping writes land in the file. Replaces the backing memory, run last
+ * returns number of failures
+ */
+int sdram_backing_file_test(uint32_t block)
+{
+	const off_t offset = (off_t)block * SDRAM::s_data_block_size;
+	char path[] = "/tmp/sdram_imageXXXXXX";
+	char word[8] = "";
+	int failures = 0;
+	int fd = mkstemp(path);
+	if ((fd < 0) || ftruncate(fd, SDRAM::s_size_byte) || (pwrite(fd, "file", 4, offset) != 4)) {
+		LOG_WARN(LOG_HARNESS, "Backing file test: could not create %s", path);
+		return 1;
+	}
+	// Private: file content visible, write through the controller stays out of the file
+	p_sdram->setBackingFile(path, false);
+	char *output_data = sdram_read(offset, SDRAM::s_data_block_size);
+	if (memcmp(output_data, "file", 4)) {
+		LOG_WARN(LOG_HARNESS, "Backing file test: private read \"%.4s\" != \"file\"", output_data);
+		failures++;
+	}
+	delete[] output_data;
+	sdram_write(offset, "priv", SDRAM::s_data_block_size);
+	if ((pread(fd, word, 4, offset) != 4) || memcmp(word, "file", 4)) {
+		LOG_WARN(LOG_HARNESS, "Backing file test: private write reached the file, \"%.4s\"", word);
+		failures++;
+	}
+	// Shared: private write is gone, new write is in the file
+	p_sdram->setBackingFile(path, true);
+	output_data = sdram_read(offset, SDRAM::s_data_block_size);
+	if (memcmp(output_data, "file", 4)) {
+		LOG_WARN(LOG_HARNESS, "Backing file test: shared read \"%.4s\" != \"file\"", output_data);
+		failures++;
+	}
+	delete[] output_data;
+	sdram_write(offset, "shrd", SDRAM::s_data_block_size);
+	if ((pread(fd, word, 4, offset) != 4) || memcmp(word, "shrd", 4)) {
+		LOG_WARN(LOG_HARNESS, "Backing file test: shared write not in the file, \"%.4s\"", word);
+		failures++;
+	}
+	close(fd);
+	unlink(path);
+	if (!failures)
+		LOG_INFO(LOG_HARNESS, "Backing file test passed");
+	return failures;
+}
+
+/* Power on delay fast forwarded right after reset (sdramSkipStartup): nearly all of it must be skipped,
+ * and the controller has to come out of its init sequence (precharge, 2 refreshes, MRS) a few dozen
+ * cycles later instead of after the whole delay. Once the model is out of its delay the counter is moved
+ * a whole delay further on top, far past every init cmd, the controller must still issue all of them
+ * Model init is checked once data went through
+ * returns 1 on failure
+ */
+int sdram_fast_forward_test()
+{
+	uint32_t wait = p_sdram->getStartupWait();
+	unsigned long long skipped = sdramSkipStartup(p_tb, p_domain, p_sdram);
+	unsigned long long cycles = 0;
+	while (p_sdram->getStartupWait() && cycles < 2 * SDRAM_FAST_FORWARD_MARGIN) {
+		p_tb->evalUntilClockEdge(p_domain, 0);
+		cycles++;
+	}
+	// Controller counter started at reset release, it is still before its precharge here
+	if (sdramInitSkipAdd(p_tb->getContextPtr(), wait) != 1) {
+		LOG_WARN(LOG_HARNESS, "Controller init counter not found");
+		return 1;
+	}
+	while (SDRAMControllerPtr->o_busy && cycles < 256) {
+		p_tb->evalUntilClockEdge(p_domain, 0);
+		cycles++;
+	}
+	LOG_INFO(LOG_HARNESS, "Fast forward: skipped %llu of %u startup cycles, controller init done %llu cycles later",
+		skipped, wait, cycles);
+	// One posedge can go to the alignment with the current time
+	if (skipped + SDRAM_FAST_FORWARD_MARGIN + 1 < wait) {
+		LOG_WARN(LOG_HARNESS, "Fast forward skipped too little");
+		return 1;
+	}
+	if (SDRAMControllerPtr->o_busy) {
+		LOG_WARN(LOG_HARNESS, "Controller still in init after fast forward");
+		return 1;
+	}
+	return 0;
+}
+
 // SDRAM does not have rst line
 void resetController()
 {
@@ -141,7 +296,7 @@ void resetController()
 int main(int argc, char **argv)
 {
 #ifdef BRAM_AS_RAM
-	DEBUG("Abort, enable SDRAM in both simulation config and rtl config files");
+	LOG_ERROR(LOG_HARNESS, "Abort, enable SDRAM in both simulation config and rtl config files");
 	abort();
 #else
 	install_signal_handlers();
@@ -156,7 +311,7 @@ int main(int argc, char **argv)
 	// Create models, add clock lines to clock domains
 	// SDRAMController is top module, can use default or custom values
     p_sdram = new SDRAM();
-	p_domain->addModelClock(&(p_sdram->i_clk));
+	p_domain->addModel(p_sdram, &(p_sdram->i_clk));
 	// Connect models to modules, models IOs should be pointers
 	unsigned char one = 1;
 	unsigned char zero = 0;
@@ -174,31 +329,51 @@ int main(int argc, char **argv)
 	p_tb->addModule(p_controller);
 	p_tb->addModel(p_sdram);
 	// Setup tracer
-	p_tb->setTracing(1, "SDRAMController.vcd");
+	p_tb->setTracing(1, "SDRAMController" TRACE_FILE_EXT);
 	// ==========================================================
 	// TESTING
 	resetController();
+	int failed = 0;
+	if (sdram_fast_forward_test())
+		failed = 1;
 	// Test data
 	const char *sample_data = "Good evening twitter this is your boy edp445";
 	sdram_write(0, sample_data, strlen(sample_data));
 	char *output_data = sdram_read(0, strlen(sample_data));
 	if (!strcmp(sample_data, output_data)) {
-		DEBUG("Data verified: %s", output_data);
+		LOG_INFO(LOG_HARNESS, "Data verified: %s", output_data);
 	}
 	else {
-		DEBUG("Output data mismatch: \"%s\" != \"%s\"", output_data, sample_data);
-		DEBUG("Data dump length: %ld", strlen(sample_data));
-		DEBUG("Hex dump:");
-		std::cout << "\t";
-		for (int i = 0 ; i < strlen(sample_data); i++) {
-			std::cout << std::hex << (int)output_data[i] << " ";
-		}
-		std::cout << "\n";
+		LOG_WARN(LOG_HARNESS, "Output data mismatch: \"%s\" != \"%s\"", output_data, sample_data);
+		LOG_WARN(LOG_HARNESS, "Data dump length: %ld", strlen(sample_data));
+		// 3 chars per byte, fits in a log message
+		char hex_dump[3 * 64 + 1] = "";
+		for (int i = 0 ; i < strlen(sample_data) && i < 64; i++)
+			snprintf(hex_dump + 3 * i, 4, "%02x ", (unsigned char)output_data[i]);
+		LOG_WARN(LOG_HARNESS, "Hex dump: %s", hex_dump);
+		failed = 1;
 	}
 	delete output_data;
+	if (sdram_open_page_test())
+		failed = 1;
+	if (sdram_row_locality_test(32))
+		failed = 1;
+	if (sdram_backing_file_test(64))
+		failed = 1;
 	
 	for (int i = 0 ; i < 5; i++) {
 		p_tb->evalUntilClockEdge(p_domain, 0);
 	}
+	if (!p_sdram->isInitDone()) {
+		LOG_WARN(LOG_HARNESS, "SDRAM model never finished its power on sequence");
+		failed = 1;
+	}
+	// Model counts violations instead of aborting, fail on any
+	p_sdram->dumpStats();
+	if (p_sdram->getTimingViolations()) {
+		LOG_WARN(LOG_HARNESS, "SDRAM timing violations: %llu", (unsigned long long)p_sdram->getTimingViolations());
+		failed = 1;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 #endif
 }
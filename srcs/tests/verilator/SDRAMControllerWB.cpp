@@ -10,6 +10,7 @@
 #include "VSDRAMControllerWB___024root.h"
 
 #include "include/models/SDRAM.h"
+#include "include/sdramFastForward.h"
 
 // ========================================================
 
@@ -25,7 +26,7 @@ SDRAM *p_sdram;
 
 void sigint_handler(int num)
 {
-	DEBUG("SIGINT caught, exiting...");
+	LOG_INFO(LOG_HARNESS, "SIGINT caught, exiting...");
 	exit(EXIT_SUCCESS);
 }
 
@@ -39,7 +40,7 @@ void install_signal_handlers()
 	// (might just call signal() instead)
 	sa.sa_flags = SA_RESTART; 
 	if (sigaction(SIGINT, &sa, NULL) == -1) {
-		DEBUG("SIGACTION failed!");
+		LOG_ERROR(LOG_HARNESS, "SIGACTION failed!");
 		exit(EXIT_FAILURE);
 	}
 }
@@ -52,12 +53,12 @@ void install_signal_handlers()
  */
 void sdram_write(uint32_t addr, const char *source_buffer, size_t len)
 {
-	DEBUG("START WRITING...");
+	LOG_DEBUG(LOG_HARNESS, "START WRITING...");
 	assert(len <= strlen(source_buffer));
 	// align addr to 4 bytes
 	uint32_t addr_aligned = addr & 0xfffffffc;
 	uint32_t *p_block_buffer = (uint32_t *)source_buffer;
-	// only do burstlen = 1
+	// WB side is single word, writes are single word on SDRAM as well
 	size_t block_buffer_len = len / 4; // floor trunc to block size
 
 	for (int b = 0; b < block_buffer_len; b++) {
@@ -77,11 +78,10 @@ void sdram_write(uint32_t addr, const char *source_buffer, size_t len)
 		SDRAMControllerWBPtr->i_wb_stb  = 0;
 		SDRAMControllerWBPtr->i_wb_data = 0;
 		p_tb->evalUntilClockEdge(p_wb_domain, 0);
-		// only do burstlen = 1
 		p_block_buffer += 1;
 		addr_aligned += 4;
 	}
-	DEBUG("END WRITING...");
+	LOG_DEBUG(LOG_HARNESS, "END WRITING...");
 }
 
 /* idx: memory byte index, this will be set to start of its block
@@ -90,7 +90,7 @@ void sdram_write(uint32_t addr, const char *source_buffer, size_t len)
  */
 char *sdram_read(uint32_t addr, size_t len)
 {
-	DEBUG("START READING...");
+	LOG_DEBUG(LOG_HARNESS, "START READING...");
 	// align addr to 4 bytes
 	uint32_t addr_aligned = addr & 0xfffffffc;
 	size_t block_buffer_len = len / 4; // floor trunc to block size
@@ -112,13 +112,67 @@ char *sdram_read(uint32_t addr, size_t len)
 		SDRAMControllerWBPtr->i_wb_cyc  = 0;
 		SDRAMControllerWBPtr->i_wb_stb  = 0;
 		p_tb->evalUntilClockEdge(p_wb_domain, 0);
-		// only do burstlen = 1
+		// WB side is single word, controller reads the whole line and serves the rest from its buffer
 		addr_aligned += 4;
 	}
-	DEBUG("END READING...");
+	LOG_DEBUG(LOG_HARNESS, "END READING...");
 	return target_buffer;
 }
 
+/* Refill latency, count WB cycles for n single word reads from addr, addr + stride...
+ * stride 4 is a cache block refill: one SDRAM burst, the rest hit the controller line buffer
+ * stride of a line: every read is its own burst
+ */
+unsigned long long sdram_read_cycles(uint32_t addr, uint32_t stride, int n)
+{
+	unsigned long long cycles = 0;
+	for (int i = 0; i < n; i++) {
+		SDRAMControllerWBPtr->i_wb_cyc  = 1;
+		SDRAMControllerWBPtr->i_wb_stb  = 1;
+		SDRAMControllerWBPtr->i_wb_addr = addr & 0xfffffffc;
+		SDRAMControllerWBPtr->i_wb_we   = 0;
+		do {
+			p_tb->evalUntilClockEdge(p_wb_domain, 0);
+			cycles++;
+		} while (SDRAMControllerWBPtr->o_wb_ack == 0);
+		SDRAMControllerWBPtr->i_wb_cyc  = 0;
+		SDRAMControllerWBPtr->i_wb_stb  = 0;
+		p_tb->evalUntilClockEdge(p_wb_domain, 0);
+		cycles++;
+		addr += stride;
+	}
+	return cycles;
+}
+
+/* Posted writes, n words from addr issued back to back (WB pipelined, stb held while not stalled)
+ * count WB cycles until the last ack, data = addr
+ */
+unsigned long long sdram_write_cycles(uint32_t addr, int n)
+{
+	unsigned long long cycles = 0;
+	int issued = 0, acked = 0;
+	SDRAMControllerWBPtr->i_wb_cyc = 1;
+	SDRAMControllerWBPtr->i_wb_we  = 1;
+	while (acked < n) {
+		SDRAMControllerWBPtr->i_wb_stb  = (issued < n);
+		SDRAMControllerWBPtr->i_wb_addr = (addr + issued * 4) & 0xfffffffc;
+		SDRAMControllerWBPtr->i_wb_data = addr + issued * 4;
+		// stall from last eval, stb was already high then (FIFO empty on the first one)
+		bool taken = (issued < n) && !SDRAMControllerWBPtr->o_wb_stall;
+		p_tb->evalUntilClockEdge(p_wb_domain, 0);
+		if (taken)
+			issued++;
+		if (SDRAMControllerWBPtr->o_wb_ack)
+			acked++;
+		cycles++;
+	}
+	SDRAMControllerWBPtr->i_wb_cyc = 0;
+	SDRAMControllerWBPtr->i_wb_stb = 0;
+	SDRAMControllerWBPtr->i_wb_we  = 0;
+	p_tb->evalUntilClockEdge(p_wb_domain, 0);
+	return cycles;
+}
+
 // ========================================================
 
 // SDRAM does not have rst line
@@ -136,7 +190,7 @@ void resetController()
 int main(int argc, char **argv)
 {
 #ifdef BRAM_AS_RAM
-	DEBUG("Abort, enable SDRAM in both simulation config and rtl config files");
+	LOG_ERROR(LOG_HARNESS, "Abort, enable SDRAM in both simulation config and rtl config files");
 	abort();
 #else
 	install_signal_handlers();
@@ -154,7 +208,7 @@ int main(int argc, char **argv)
 	// Create models, add clock lines to clock domains
 	// Follow RTL file since SDRAMController is not standalone module anymore
     p_sdram = new SDRAM(RAM_CLK_FREQ, RAM_CAS_LATENCY);
-	p_ram_domain->addModelClock(&(p_sdram->i_clk));
+	p_ram_domain->addModel(p_sdram, &(p_sdram->i_clk));
 	// Connect models to modules, models IOs should be pointers
 	unsigned char one = 1;
 	unsigned char zero = 0;
@@ -173,31 +227,75 @@ int main(int argc, char **argv)
 	p_tb->addModule(p_controller);
 	p_tb->addModel(p_sdram);
 	// Setup tracer
-	p_tb->setTracing(1, "SDRAMControllerWB.vcd");
+	p_tb->setTracing(1, "SDRAMControllerWB" TRACE_FILE_EXT);
 	// ==========================================================
 	// TESTING
 	resetController();
+	sdramSkipStartup(p_tb, p_ram_domain, p_sdram);
+	int failed = 0;
 	// Test data
 	const char *sample_data = "Good evening twitter this is your boy edp445";
 	sdram_write(0, sample_data, strlen(sample_data));
 	char *output_data = sdram_read(0, strlen(sample_data));
 	if (!strcmp(sample_data, output_data)) {
-		DEBUG("Data verified: %s", output_data);
+		LOG_INFO(LOG_HARNESS, "Data verified: %s", output_data);
 	}
 	else {
-		DEBUG("Output data mismatch: \"%s\" != \"%s\"", output_data, sample_data);
-		DEBUG("Data dump length: %ld", strlen(sample_data));
-		DEBUG("Hex dump:");
-		std::cout << "\t";
-		for (int i = 0 ; i < strlen(sample_data); i++) {
-			std::cout << std::hex << (int)output_data[i] << " ";
+		LOG_WARN(LOG_HARNESS, "Output data mismatch: \"%s\" != \"%s\"", output_data, sample_data);
+		LOG_WARN(LOG_HARNESS, "Data dump length: %ld", strlen(sample_data));
+		// 3 chars per byte, fits in a log message
+		char hex_dump[3 * 64 + 1] = "";
+		for (int i = 0 ; i < strlen(sample_data) && i < 64; i++)
+			snprintf(hex_dump + 3 * i, 4, "%02x ", (unsigned char)output_data[i]);
+		LOG_WARN(LOG_HARNESS, "Hex dump: %s", hex_dump);
+		failed = 1;
+	}
+	delete[] output_data;
+	// Refill latency, one block (RAM_BURST_LENGTH words) vs the same number of words each from another line
+	// Both start on lines not in the controller line buffer. One burst per word is what a refill cost
+	// before bursts (every word its own SDRAM read), so the ratio is the before / after
+	unsigned long long line_cycles    = sdram_read_cycles(0x1000, 4, RAM_BURST_LENGTH);
+	// Strided lines are all in one SDRAM row (1 KB), open page: one activate, every other burst a row hit
+	uint64_t strided_hits      = p_sdram->getRowHits();
+	uint64_t strided_activates = p_sdram->getActivates();
+	unsigned long long strided_cycles = sdram_read_cycles(0x2000, RAM_BURST_LENGTH * 4, RAM_BURST_LENGTH);
+	strided_hits      = p_sdram->getRowHits() - strided_hits;
+	strided_activates = p_sdram->getActivates() - strided_activates;
+	LOG_INFO(LOG_HARNESS, "Refill latency, %d words: line burst %llu WB cycles (%.2f / word), one burst per word %llu WB cycles (%.2f / word), %.2fx",
+		RAM_BURST_LENGTH, line_cycles, (double)line_cycles / RAM_BURST_LENGTH, strided_cycles,
+		(double)strided_cycles / RAM_BURST_LENGTH, (double)strided_cycles / line_cycles);
+	if (line_cycles >= strided_cycles) {
+		LOG_WARN(LOG_HARNESS, "Line burst refill is not faster than one burst per word");
+		failed = 1;
+	}
+	LOG_INFO(LOG_HARNESS, "Open page, %d bursts in one row: %llu row hits, %llu activates",
+		RAM_BURST_LENGTH, (unsigned long long)strided_hits, (unsigned long long)strided_activates);
+	// A refresh may close the row once
+	if ((strided_activates > 2) || (strided_hits < RAM_BURST_LENGTH - 2)) {
+		LOG_WARN(LOG_HARNESS, "Bursts in one row did not stay in the open row");
+		failed = 1;
+	}
+	// Posted writes, one line back to back, then read it back (queued behind the writes)
+	unsigned long long write_cycles = sdram_write_cycles(0x3000, RAM_BURST_LENGTH);
+	LOG_INFO(LOG_HARNESS, "Posted writes, %d words: %llu WB cycles", RAM_BURST_LENGTH, write_cycles);
+	char *posted_data = sdram_read(0x3000, RAM_BURST_LENGTH * 4);
+	for (int i = 0; i < RAM_BURST_LENGTH; i++) {
+		if (((uint32_t *)posted_data)[i] != 0x3000 + i * 4) {
+			LOG_WARN(LOG_HARNESS, "Posted write mismatch at word %d: %08x", i, ((uint32_t *)posted_data)[i]);
+			failed = 1;
 		}
-		std::cout << "\n";
 	}
-	delete output_data;
+	delete[] posted_data;
 	
 	for (int i = 0 ; i < 5; i++) {
 		p_tb->evalUntilClockEdge(p_wb_domain, 0);
 	}
+	// Model counts violations instead of aborting, fail on any
+	p_sdram->dumpStats();
+	if (p_sdram->getTimingViolations()) {
+		LOG_WARN(LOG_HARNESS, "SDRAM timing violations: %llu", (unsigned long long)p_sdram->getTimingViolations());
+		failed = 1;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 #endif
 }
@@ -0,0 +1,168 @@
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+
+#include "include/config.h"
+
+#include "include/utils.h"
+#include "include/testbench.h"
+
+#include "VTwoWaysInstrCache32Bits.h"
+#include "VTwoWaysInstrCache32Bits___024root.h"
+
+// ========================================================
+
+// Globals
+TestBench *p_tb;
+ClockDomain *p_domain;
+Module<VTwoWaysInstrCache32Bits> *p_icache;
+#define ICachePtr ((VTwoWaysInstrCache32Bits*)(p_icache->getUUTPtr()))
+
+// Slave side stand in: pipelined, never stalls, acks in order SLAVE_LATENCY cycles after a request is taken
+// An error drops what is in flight, like DataMemWBMaster does
+#define SLAVE_LATENCY    3
+#define N_CYCLES_TIMEOUT 1000
+
+struct SlaveReq {
+	uint32_t addr;
+	unsigned long long ready;
+};
+
+std::deque<SlaveReq> g_slave_reqs;
+unsigned long long g_cycle = 0;
+// Response index (from the start) to answer with an error, -1 for none
+long g_err_at = -1;
+long g_n_responses = 0;
+
+// ========================================================
+
+void sigint_handler(int)
+{
+	LOG_INFO(LOG_HARNESS, "SIGINT caught, exiting...");
+	exit(EXIT_SUCCESS);
+}
+
+void install_signal_handlers()
+{
+	// SIGINT
+	struct sigaction sa;
+	sa.sa_handler = sigint_handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGINT, &sa, NULL) == -1) {
+		LOG_ERROR(LOG_HARNESS, "SIGACTION failed!");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// ========================================================
+
+// Code in RAM, word at addr
+uint32_t code_word(uint32_t addr)
+{
+	return ~addr;
+}
+
+// One cycle, slave answers with the head request when it is due
+void cycle()
+{
+	bool respond = !g_slave_reqs.empty() && (g_slave_reqs.front().ready <= g_cycle);
+	bool err = respond && (g_n_responses == g_err_at);
+	ICachePtr->i_s_stall = 0;
+	ICachePtr->i_s_ack   = respond && !err;
+	ICachePtr->i_s_err   = err;
+	ICachePtr->i_s_data  = respond ? code_word(g_slave_reqs.front().addr) : 0;
+	// Request on the bus before the edge is taken at the edge
+	bool taken = ICachePtr->o_s_en;
+	uint32_t taken_addr = ICachePtr->o_s_addr;
+	p_tb->evalUntilClockEdge(p_domain, 0);
+	g_cycle++;
+	if (respond) {
+		g_n_responses++;
+		g_slave_reqs.pop_front();
+	}
+	if (err)
+		g_slave_reqs.clear();
+	else if (taken)
+		g_slave_reqs.push_back({taken_addr, g_cycle + SLAVE_LATENCY});
+}
+
+// Fetch addr until it hits, then latch the instr (fd_en), returns it. Err seen on the way in *p_err
+bool fetch(uint32_t addr, uint32_t *p_instr, bool *p_err)
+{
+	ICachePtr->i_f_req  = 1;
+	ICachePtr->i_f_addr = addr;
+	ICachePtr->i_f_en   = 0;
+	ICachePtr->i_f_clr  = 0;
+	*p_err = false;
+	// Settle the miss for the new address
+	cycle();
+	for (int c = 0; ICachePtr->o_f_miss; c++) {
+		if (c >= N_CYCLES_TIMEOUT) {
+			LOG_WARN(LOG_HARNESS, "Fetch 0x%08X still missing after %d cycles", addr, c);
+			return false;
+		}
+		cycle();
+		*p_err |= ICachePtr->o_f_err;
+	}
+	ICachePtr->i_f_en = 1;
+	cycle();
+	ICachePtr->i_f_en = 0;
+	*p_instr = ICachePtr->o_f_instr;
+	return true;
+}
+
+int expect_fetch(const char *p_step, uint32_t addr, bool expect_err)
+{
+	uint32_t instr = 0;
+	bool err = false;
+	if (!fetch(addr, &instr, &err))
+		return 1;
+	if ((instr != code_word(addr)) || (err != expect_err) || ICachePtr->o_f_err) {
+		LOG_WARN(LOG_HARNESS, "%s: 0x%08X -> 0x%08X, err seen %d (now %d), expected 0x%08X, err %d", p_step, addr,
+			instr, err, ICachePtr->o_f_err, code_word(addr), expect_err);
+		return 1;
+	}
+	LOG_INFO(LOG_HARNESS, "%s: 0x%08X -> 0x%08X, err seen %d", p_step, addr, instr, err);
+	return 0;
+}
+
+void resetICache()
+{
+	ICachePtr->i_f_req = 0;
+	ICachePtr->i_rst = 0;
+	cycle();
+	ICachePtr->i_rst = 1;
+	cycle();
+}
+
+// ========================================================
+
+int main(int argc, char **argv)
+{
+	install_signal_handlers();
+	// Create testbench
+	p_tb = new TestBench(argc, argv);
+	p_domain = new ClockDomain(20);
+	p_icache = new Module<VTwoWaysInstrCache32Bits>(p_tb->getContextPtr(), "TwoWaysInstrCache32Bits");
+	p_domain->addModuleClock(&(ICachePtr->i_clk));
+	p_tb->addClockDomain(p_domain);
+	p_tb->addModule(p_icache);
+	p_tb->setTracing(1, "TwoWaysInstrCache32Bits" TRACE_FILE_EXT);
+	// ==========================================================
+	// TESTING
+	int failed = 0;
+	resetICache();
+	// Plain fill
+	failed |= expect_fetch("Fill", RAM_START_ADDR + 0x100, false);
+	failed |= expect_fetch("Hit", RAM_START_ADDR + 0x104, false);
+	// Bus error on the 3rd word of the next fill: back to IDLE with o_f_err, fill retried, err gone once it is in
+	g_err_at = g_n_responses + 2;
+	failed |= expect_fetch("Fill with a bus error", RAM_START_ADDR + 0x208, true);
+	failed |= expect_fetch("Hit after retry", RAM_START_ADDR + 0x23c, false);
+	// Erroring block did not break the other one
+	failed |= expect_fetch("Hit first block", RAM_START_ADDR + 0x13c, false);
+	if (!failed)
+		LOG_INFO(LOG_HARNESS, "Icache test passed");
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+// Micro benchmark for TestBench clock edge scheduling, no verilator needed
+// Compares the old per eval timeToNextEdge scan against ClockScheduler
+// calendar / fallback mode, reports edges per second for each.
+// Build & run: make vrlt_bench
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../include/clockDomain.h"
+#include "../include/clockScheduler.h"
+
+// ========================================================
+// Globals
+
+#define N_EDGES_DEFAULT 20000000ULL
+
+struct Result {
+    double edges_per_sec;
+    unsigned long long end_time_ps;
+    unsigned long long n_updates;
+};
+
+// ========================================================
+// Support functions
+
+std::vector<ClockDomain *> createDomains(const std::vector<double> &freqs)
+{
+    std::vector<ClockDomain *> v_domains;
+    for (size_t i = 0; i < freqs.size(); i++)
+        v_domains.push_back(new ClockDomain(freqs[i]));
+    return v_domains;
+}
+
+void deleteDomains(std::vector<ClockDomain *> &v_domains)
+{
+    for (size_t i = 0; i < v_domains.size(); i++)
+        delete v_domains[i];
+    v_domains.clear();
+}
+
+// Copy of TestBench::eval edge selection before the scheduler
+Result runLegacy(const std::vector<double> &freqs, unsigned long long n_edges)
+{
+    std::vector<ClockDomain *> v_domains = createDomains(freqs);
+    std::vector<ClockDomain *>::iterator i_domain;
+    unsigned long long time = 0;
+    unsigned long long n_updates = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long long n = 0; n < n_edges; n++) {
+        unsigned long long ttne = 0;
+        std::vector<ClockDomain *> v_next_domains;
+        for (i_domain = v_domains.begin(); i_domain < v_domains.end(); i_domain++) {
+            unsigned long long ttne_tmp = (*i_domain)->timeToNextEdge(time);
+            if ((ttne == 0) || (ttne_tmp < ttne))
+                ttne = ttne_tmp;
+        }
+        for (i_domain = v_domains.begin(); i_domain < v_domains.end(); i_domain++) {
+            unsigned long long ttne_tmp = (*i_domain)->timeToNextEdge(time);
+            if (ttne_tmp == ttne)
+                v_next_domains.push_back(*i_domain);
+        }
+        time += ttne;
+        for (i_domain = v_next_domains.begin(); i_domain < v_next_domains.end(); i_domain++)
+            (*i_domain)->updateNewClockEdge(time);
+        n_updates += v_next_domains.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    deleteDomains(v_domains);
+    double sec = std::chrono::duration<double>(end - start).count();
+    return {n_edges / sec, time, n_updates};
+}
+
+Result runScheduler(const std::vector<double> &freqs, unsigned long long n_edges, unsigned long long max_entries)
+{
+    std::vector<ClockDomain *> v_domains = createDomains(freqs);
+    ClockScheduler scheduler;
+    unsigned long long time = 0;
+    unsigned long long n_updates = 0;
+
+    scheduler.build(v_domains, time, max_entries);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long long n = 0; n < n_edges; n++) {
+        ClockDomain * const *p_next_domains;
+        unsigned int n_next_domains;
+        time += scheduler.nextEdges(time, &p_next_domains, &n_next_domains);
+        for (unsigned int i = 0; i < n_next_domains; i++)
+            p_next_domains[i]->updateNewClockEdge(time);
+        n_updates += n_next_domains;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    deleteDomains(v_domains);
+    double sec = std::chrono::duration<double>(end - start).count();
+    return {n_edges / sec, time, n_updates};
+}
+
+void runCase(const char *name, const std::vector<double> &freqs, unsigned long long n_edges)
+{
+    Result legacy   = runLegacy(freqs, n_edges);
+    Result fallback = runScheduler(freqs, n_edges, 0);
+    Result calendar = runScheduler(freqs, n_edges, CLOCK_SCHEDULER_MAX_CALENDAR_ENTRIES);
+
+    // All three must walk the exact same edges
+    if ((legacy.end_time_ps != fallback.end_time_ps) || (legacy.end_time_ps != calendar.end_time_ps) ||
+        (legacy.n_updates != fallback.n_updates) || (legacy.n_updates != calendar.n_updates)) {
+        printf("[%s] MISMATCH: end time %llu / %llu / %llu ps, updates %llu / %llu / %llu\n", name,
+               legacy.end_time_ps, fallback.end_time_ps, calendar.end_time_ps,
+               legacy.n_updates, fallback.n_updates, calendar.n_updates);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("[%s] %llu edges, simulated %llu ps\n", name, n_edges, legacy.end_time_ps);
+    printf("    legacy   : %12.0f edges/s\n", legacy.edges_per_sec);
+    printf("    fallback : %12.0f edges/s (x%.2f)\n", fallback.edges_per_sec, fallback.edges_per_sec / legacy.edges_per_sec);
+    printf("    calendar : %12.0f edges/s (x%.2f)\n", calendar.edges_per_sec, calendar.edges_per_sec / legacy.edges_per_sec);
+}
+
+// ========================================================
+
+int main(int argc, char **argv)
+{
+    unsigned long long n_edges = (argc > 1) ? strtoull(argv[1], nullptr, 0) : N_EDGES_DEFAULT;
+
+    // CPU only, CPU + SDRAM (CPU.cpp), CPU + SDRAM + HDMI pixel / TMDS clocks
+    runCase("20MHz", {20}, n_edges);
+    runCase("20MHz + 90MHz", {20, 90}, n_edges);
+    runCase("20MHz + 90MHz + 25MHz + 250MHz", {20, 90, 25, 250}, n_edges);
+
+    return EXIT_SUCCESS;
+}
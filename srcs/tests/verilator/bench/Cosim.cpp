@@ -0,0 +1,137 @@
+// Cosim checker on the host, no verilator needed
+// A second ISS stands in for the pipeline: it runs a load heavy loop and its instrs go through
+// RetireTraceWriter the way the CPU harness samples them (retire, then LSU load return). Loads hit
+// (value in their retire cycle) or miss (value some cycles later, younger non memory instrs retire
+// meanwhile, LSU 1 deep). CosimChecker (include/cosimChecker.h) must agree on every instr, and must
+// catch a corrupted load value. Reports checked instrs per second.
+// Build & run: make vrlt_bench
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "../include/cosimChecker.h"
+
+// ========================================================
+// Globals
+
+#define MISS_LATENCY 4 // cycles from retire to load value on a miss
+
+// 200 rounds: sw, lw, use, sw, lw, lw, lbu, lh, 2 adds, lw x0, pointer / counter update, bne. Then jal x0, 0
+static const uint32_t s_prog[] = {
+    0x200000b7, 0x0c800113, 0x0020a023, 0x0000a283, 0x00228333, 0x0060a223, 0x0040a383, 0x0000a403,
+    0x0040c483, 0x00009503, 0x008385b3, 0x009585b3, 0x0000a003, 0x00808093, 0xfff10113, 0xfc0116e3,
+    0x0000006f
+};
+
+struct Result {
+    bool failed;
+    unsigned long long checked;
+    unsigned long long loads, misses;
+    double seconds;
+};
+
+// ========================================================
+// Support functions
+
+bool writeHex(const char *p_path)
+{
+    FILE *fp = fopen(p_path, "w");
+    if (!fp)
+        return false;
+    for (size_t i = 0; i < sizeof(s_prog) / sizeof(s_prog[0]); i++)
+        fprintf(fp, "%08x\n", s_prog[i]);
+    fclose(fp);
+    return true;
+}
+
+/* Pipeline stand-in, one loop turn = one CPU cycle
+ * every third load misses, corrupt_load >= 0 flips the value of that load
+ */
+Result run(const MemImage &image, int corrupt_load)
+{
+    Result result = {};
+    CosimChecker checker(image);
+    RetireTraceWriter trace(nullptr);
+    trace.addListener(&checker);
+    RV32ISim dut(ROM_START_ADDR);
+    dut.addRegion(ROM_START_ADDR, ROM_SIZE, false);
+    dut.addRegion(RAM_START_ADDR, RAM_SIZE, true);
+    dut.loadImage(image);
+
+    RV32ISim::StepInfo next;
+    RV32ISim::Status status = dut.step(&next);
+    bool pending = false;
+    uint8_t pending_rd = 0;
+    uint32_t pending_data = 0;
+    unsigned long long pending_ready = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned long long cycle = 1; status == RV32ISim::ISS_OK && !checker.hasFailed(); cycle++) {
+        bool lret = pending && (cycle >= pending_ready);
+        // LSU busy: next memory instr waits in mem
+        bool retire = !(pending && !lret && (next.load || next.store));
+        if (retire) {
+            uint8_t rd = (next.instr >> 7) & 0x1f;
+            uint8_t flags = next.load ? RETIRE_F_LOAD : next.store ? RETIRE_F_STORE : (next.rd ? RETIRE_F_WB : 0);
+            trace.retire(cycle, next.pc, next.instr, rd, (flags & RETIRE_F_WB) ? next.wb : 0,
+                         (next.load || next.store) ? next.addr : 0, flags);
+        }
+        if (lret) {
+            trace.loadReturn(pending_rd, pending_data);
+            pending = false;
+        }
+        if (!retire)
+            continue;
+        if (next.load) {
+            uint32_t data = (result.loads == (unsigned long long)corrupt_load) ? ~next.wb : next.wb;
+            if ((result.loads % 3) == 2) {
+                pending       = true;
+                pending_rd    = (next.instr >> 7) & 0x1f;
+                pending_data  = data;
+                pending_ready = cycle + MISS_LATENCY;
+                result.misses++;
+            }
+            else {
+                trace.loadReturn((next.instr >> 7) & 0x1f, data);
+            }
+            result.loads++;
+        }
+        status = dut.step(&next);
+    }
+    trace.close();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.failed  = checker.hasFailed() || (status != RV32ISim::ISS_HALT_LOOP);
+    result.checked = checker.getChecked();
+    return result;
+}
+
+// ========================================================
+
+int main(void)
+{
+    char path[] = "/tmp/cosim_benchXXXXXX";
+    int fd = mkstemp(path);
+    if ((fd < 0) || !writeHex(path)) {
+        printf("Could not write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    MemImage image;
+    bool loaded = image.loadHex(path, ROM_START_ADDR);
+    unlink(path);
+    if (!loaded)
+        return EXIT_FAILURE;
+
+    Result clean = run(image, -1);
+    printf("Load heavy loop: %llu instrs checked, %llu loads (%llu misses): %s, %.1f M instrs/s\n",
+           clean.checked, clean.loads, clean.misses, clean.failed ? "FAILED" : "ok",
+           clean.seconds > 0 ? clean.checked / clean.seconds / 1e6 : 0.0);
+    // A hit and a miss load with a wrong value
+    Result hit  = run(image, 100);
+    Result miss = run(image, 104);
+    bool caught = hit.failed && miss.failed;
+    printf("Corrupted load value caught: %s\n", caught ? "ok" : "FAILED");
+
+    return (!clean.failed && caught) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+// Worker pool (include/workerPool.h), no verilator needed
+// Checks every job index runs exactly once per run(), that idle workers park (no CPU burnt while the
+// harness does something else) and wake up on the next run(). Then single thread against pooled wall
+// time per edge, with stand in module evals of a few sizes (a small module is a few 100 ns per eval)
+// Build & run: make vrlt_bench, build_test/bench/WorkerPool [threads] by hand for another thread count
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include "../include/workerPool.h"
+
+// ========================================================
+// Globals
+
+#define N_CHECK_RUNS    10000
+#define N_MODULES       4
+#define IDLE_MS         200
+// CPU time the whole process may take while idle for IDLE_MS, spin / yield before parking included
+#define IDLE_CPU_MAX_MS 50
+
+struct Jobs {
+    std::vector<unsigned int> v_hits;
+    std::vector<uint32_t> v_state;
+    unsigned int work;
+};
+
+// ========================================================
+// Support functions
+
+void countJob(void *p_arg, unsigned int index)
+{
+    ((Jobs *)p_arg)->v_hits[index]++;
+}
+
+// Stand in for a module evalStep, work rounds of an LCG on its own state
+void evalJob(void *p_arg, unsigned int index)
+{
+    Jobs *p_jobs = (Jobs *)p_arg;
+    uint32_t x = p_jobs->v_state[index];
+    for (unsigned int i = 0; i < p_jobs->work; i++)
+        x = x * 1664525u + 1013904223u;
+    p_jobs->v_state[index] = x;
+}
+
+double cpuMs(void)
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+bool checkRuns(WorkerPool &pool)
+{
+    Jobs jobs;
+    for (unsigned int run = 0; run < N_CHECK_RUNS; run++) {
+        unsigned int count = 1 + run % 64;
+        jobs.v_hits.assign(count, 0);
+        pool.run(countJob, &jobs, count);
+        for (unsigned int i = 0; i < count; i++) {
+            if (jobs.v_hits[i] != 1) {
+                printf("  run %u: job %u ran %u times\n", run, i, jobs.v_hits[i]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Idle workers park and come back for the next run
+bool checkPark(WorkerPool &pool, double *p_idle_cpu_ms)
+{
+    double start = cpuMs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_MS));
+    *p_idle_cpu_ms = cpuMs() - start;
+    unsigned int parked = pool.getParkedCount();
+    if (parked != pool.getThreadCount() - 1) {
+        printf("  %u of %u workers parked\n", parked, pool.getThreadCount() - 1);
+        return false;
+    }
+    if (*p_idle_cpu_ms > IDLE_CPU_MAX_MS) {
+        printf("  %.1f ms CPU over %d ms idle\n", *p_idle_cpu_ms, IDLE_MS);
+        return false;
+    }
+    return checkRuns(pool);
+}
+
+// Wall ns per edge, N_MODULES evals of work rounds each
+double measureEdge(WorkerPool &pool, unsigned int work)
+{
+    Jobs jobs;
+    jobs.v_state.assign(N_MODULES, 1);
+    jobs.work = work;
+    unsigned long long n_edges = 200000000ULL / (work * N_MODULES + 1000);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned long long e = 0; e < n_edges; e++)
+        pool.run(evalJob, &jobs, N_MODULES);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / n_edges;
+}
+
+// ========================================================
+
+int main(int argc, char **argv)
+{
+    unsigned int n_cores   = std::thread::hardware_concurrency();
+    unsigned int n_threads = (argc > 1) ? strtoul(argv[1], nullptr, 0) : N_MODULES;
+    bool ok = true;
+
+    WorkerPool single(1);
+    WorkerPool pooled(n_threads);
+    bool runs = checkRuns(pooled);
+    printf("Every job once per run, %u threads: %s\n", n_threads, runs ? "ok" : "FAILED");
+    double idle_cpu_ms = 0;
+    bool park = checkPark(pooled, &idle_cpu_ms);
+    printf("Idle workers parked, %.1f ms CPU over %d ms idle, woken by the next run: %s\n", idle_cpu_ms, IDLE_MS,
+           park ? "ok" : "FAILED");
+    ok = runs && park;
+
+    // Not a pass / fail, depends on the cores around
+    printf("Wall time per edge, %d modules, 1 thread vs %u threads (%u core(s)):\n", N_MODULES, n_threads, n_cores);
+    const unsigned int works[] = {100, 1000, 10000, 100000};
+    for (size_t i = 0; i < sizeof(works) / sizeof(works[0]); i++) {
+        double t_single = measureEdge(single, works[i]);
+        double t_pooled = measureEdge(pooled, works[i]);
+        printf("  %6u rounds / eval: %10.0f ns vs %10.0f ns, %.2fx\n", works[i], t_single, t_pooled,
+               t_single / t_pooled);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
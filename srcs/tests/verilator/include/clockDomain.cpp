@@ -31,14 +31,14 @@ ClockDomain::ClockDomain(double freq_mhz, double phase_shift_degree)
     
     // ==================================================
     // Info dump
-    DEBUG("########################################");
-    DEBUG("INIT CLOCK DOMAIN %.2f MHZ, SHIFT %.2f DEG.", freq_mhz, phase_shift_degree);
-    DEBUG("    Normalized frequency: %.2f", this->freq_mhz);
-    DEBUG("    Period: %llu ps", this->period_ps);
-    DEBUG("    Normalized phase: %.2f", this->phase_shift_degree);
-    DEBUG("    Time until first posedge (phase delay): %llu ps", this->last_posedge_ps);
-    DEBUG("    Initial clock: %d", this->saved_clock_value);
-    DEBUG("########################################");
+    LOG_DEBUG(LOG_CLOCK, "########################################");
+    LOG_DEBUG(LOG_CLOCK, "INIT CLOCK DOMAIN %.2f MHZ, SHIFT %.2f DEG.", freq_mhz, phase_shift_degree);
+    LOG_DEBUG(LOG_CLOCK, "    Normalized frequency: %.2f", this->freq_mhz);
+    LOG_DEBUG(LOG_CLOCK, "    Period: %llu ps", this->period_ps);
+    LOG_DEBUG(LOG_CLOCK, "    Normalized phase: %.2f", this->phase_shift_degree);
+    LOG_DEBUG(LOG_CLOCK, "    Time until first posedge (phase delay): %llu ps", this->last_posedge_ps);
+    LOG_DEBUG(LOG_CLOCK, "    Initial clock: %d", this->saved_clock_value);
+    LOG_DEBUG(LOG_CLOCK, "########################################");
 }
 
 double ClockDomain::getFreqMhz()
@@ -51,6 +51,16 @@ double ClockDomain::getPhaseDeg()
     return this->phase_shift_degree;
 }
 
+unsigned long long ClockDomain::getHalfPeriodPs()
+{
+    return this->half_period_ps;
+}
+
+unsigned long long ClockDomain::getPeriodPs()
+{
+    return this->period_ps;
+}
+
 unsigned long long ClockDomain::getLastPosedgePs()
 {
     return this->last_posedge_ps;
@@ -184,3 +194,48 @@ void ClockDomain::addModelClock(unsigned char ** clk)
 {
     *clk = &this->saved_clock_value;
 }
+
+void ClockDomain::addModel(IModel *model, unsigned char ** clk)
+{
+    assert(model);
+    this->addModelClock(clk);
+    this->v_models.push_back(model);
+    std::sort(this->v_models.begin(), this->v_models.end());
+    this->v_models.erase(unique(this->v_models.begin(), this->v_models.end()), this->v_models.end());
+}
+
+std::vector<IModel *> &ClockDomain::getModels()
+{
+    return this->v_models;
+}
+
+// Posedges are at origin + k * period, last_posedge_ps is always one of them
+// and only go forward so it can be used to get origin
+unsigned char ClockDomain::getClockSignalValueAt(unsigned long long time_ps)
+{
+    unsigned long long origin = this->last_posedge_ps % this->period_ps;
+    unsigned long long offset = (time_ps % this->period_ps + this->period_ps - origin) % this->period_ps;
+    return (offset < this->half_period_ps);
+}
+
+unsigned long long ClockDomain::countPosedges(unsigned long long from_ps, unsigned long long to_ps)
+{
+    assert(from_ps <= to_ps);
+    unsigned long long origin = this->last_posedge_ps % this->period_ps;
+    // posedges in [0, to] - posedges in [0, from - 1]
+    unsigned long long n_to   = (to_ps >= origin) ? (to_ps - origin) / this->period_ps + 1 : 0;
+    unsigned long long n_from = ((from_ps > 0) && (from_ps - 1 >= origin)) ? (from_ps - 1 - origin) / this->period_ps + 1 : 0;
+    return n_to - n_from;
+}
+
+void ClockDomain::resync(unsigned long long time_ps)
+{
+    unsigned long long origin = this->last_posedge_ps % this->period_ps;
+    // Before origin only happens with phase shift, last posedge stays in the future like in constructor
+    if (time_ps >= origin)
+        this->last_posedge_ps = origin + ((time_ps - origin) / this->period_ps) * this->period_ps;
+    this->saved_clock_value = this->getClockSignalValueAt(time_ps);
+    std::vector<unsigned char *>::iterator i_clk;
+    for (i_clk = this->v_module_clocks.begin(); i_clk < this->v_module_clocks.end(); i_clk++)
+        *(*i_clk) = this->saved_clock_value;
+}
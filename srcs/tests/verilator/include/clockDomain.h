@@ -12,7 +12,8 @@
 #include <cmath>
 #include <cassert>
 
-#include "debug.h"
+#include "log.h"
+#include "models/model.h"
 
 class ClockDomain
 {
@@ -35,6 +36,8 @@ private:
     std::vector<unsigned char *> v_module_clocks;
     // Models clocks point to this
     unsigned char saved_clock_value;
+    // Models in this domain, only needed for fast forwarding
+    std::vector<IModel *> v_models;
 
 public:
     // NOTE ON MANAGING CLOCK SIGNALS:
@@ -53,6 +56,8 @@ public:
     ClockDomain(double freq_mhz, double phase_shift = 0);
     double getFreqMhz();
     double getPhaseDeg();
+    unsigned long long getHalfPeriodPs();
+    unsigned long long getPeriodPs();
     unsigned long long getLastPosedgePs();
     // Check if a posedge is at current time time that is not last posedge
     unsigned char isPosedgeAt(unsigned long long current_time_ps);
@@ -78,6 +83,18 @@ public:
     void removeModuleClock(unsigned char * const clk);
     // Set the model clock signal to point to saved_clock_value
     void addModelClock(unsigned char ** clk);
+    // Same as addModelClock, also register model to this domain so testbench knows
+    // which clock it counts cycles in (for fast forwarding)
+    void addModel(IModel *model, unsigned char ** clk);
+    std::vector<IModel *> &getModels();
+    // Arithmetic versions of the above, no 1 cycle window restriction
+    // Clock value at time after applying the edge at that time, if any
+    unsigned char getClockSignalValueAt(unsigned long long time_ps);
+    // Number of posedges in [from, to]
+    unsigned long long countPosedges(unsigned long long from_ps, unsigned long long to_ps);
+    // Jump to any time, set last posedge and clock value as if every edge until then
+    // had been updated. Used when testbench skips time
+    void resync(unsigned long long time_ps);
 };
 
 #endif
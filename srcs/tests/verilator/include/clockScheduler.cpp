@@ -0,0 +1,148 @@
+#include "clockScheduler.h"
+
+ClockScheduler::ClockScheduler()
+{
+    this->calendar_first_delta_t_ps = 0;
+    this->calendar_index = 0;
+    this->calendar_started = 0;
+    this->use_calendar = 0;
+}
+
+unsigned long long ClockScheduler::gcd(unsigned long long a, unsigned long long b)
+{
+    while (b) {
+        unsigned long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+void ClockScheduler::build(const std::vector<ClockDomain *> &domains, unsigned long long current_time_ps,
+                           unsigned long long max_calendar_entries)
+{
+    assert(domains.size() > 0);
+    this->v_domains = domains;
+    this->v_calendar.clear();
+    this->v_calendar_domains.clear();
+    this->calendar_index = 0;
+    this->calendar_started = 0;
+    this->use_calendar = 0;
+
+    // Next edge of each domain from current time
+    this->v_next_edge_ps.resize(this->v_domains.size());
+    for (size_t i = 0; i < this->v_domains.size(); i++)
+        this->v_next_edge_ps[i] = current_time_ps + this->v_domains[i]->timeToNextEdge(current_time_ps);
+    this->v_next_domains.clear();
+    this->v_next_domains.reserve(this->v_domains.size());
+
+    // Hyperperiod and number of entries, bail out on overflow / too big
+    unsigned long long hyperperiod = 1;
+    unsigned long long n_edges = 0;
+    bool fits = (max_calendar_entries > 0);
+    for (size_t i = 0; fits && (i < this->v_domains.size()); i++) {
+        unsigned long long half = this->v_domains[i]->getHalfPeriodPs();
+        unsigned long long mul = half / gcd(hyperperiod, half);
+        if (hyperperiod > ULLONG_MAX / mul)
+            fits = false;
+        else
+            hyperperiod *= mul;
+    }
+    for (size_t i = 0; fits && (i < this->v_domains.size()); i++) {
+        n_edges += hyperperiod / this->v_domains[i]->getHalfPeriodPs();
+        // Upper bound on entries, the real count is lower when edges coincide
+        if (n_edges > max_calendar_entries * this->v_domains.size())
+            fits = false;
+    }
+
+    if (fits) {
+        // Merge edges of all domains for times in (current, current + hyperperiod]
+        // Pattern repeats after that
+        std::vector<unsigned long long> v_t(this->v_next_edge_ps);
+        unsigned long long end_ps = current_time_ps + hyperperiod;
+        unsigned long long prev_ps = current_time_ps;
+        while (true) {
+            unsigned long long t = ULLONG_MAX;
+            for (size_t i = 0; i < v_t.size(); i++)
+                if (v_t[i] < t) t = v_t[i];
+            if (t > end_ps)
+                break;
+            if (this->v_calendar.size() >= max_calendar_entries) {
+                fits = false;
+                break;
+            }
+            CalendarEntry entry;
+            entry.delta_t_ps = t - prev_ps;
+            entry.first = this->v_calendar_domains.size();
+            entry.count = 0;
+            for (size_t i = 0; i < v_t.size(); i++) {
+                if (v_t[i] == t) {
+                    this->v_calendar_domains.push_back(this->v_domains[i]);
+                    entry.count++;
+                    v_t[i] += this->v_domains[i]->getHalfPeriodPs();
+                }
+            }
+            this->v_calendar.push_back(entry);
+            prev_ps = t;
+        }
+        if (fits) {
+            // Last edge in calendar - hyperperiod is the edge right before first entry
+            this->calendar_first_delta_t_ps = this->v_calendar[0].delta_t_ps;
+            this->v_calendar[0].delta_t_ps = this->v_calendar[0].delta_t_ps + hyperperiod - (prev_ps - current_time_ps);
+            this->use_calendar = 1;
+        }
+        else {
+            this->v_calendar.clear();
+            this->v_calendar_domains.clear();
+        }
+    }
+
+    LOG_INFO(LOG_CLOCK, "Clock scheduler: %s, hyperperiod %llu ps, %llu entries",
+          this->use_calendar ? "calendar" : "fallback", fits ? hyperperiod : 0ULL,
+          (unsigned long long)this->v_calendar.size());
+}
+
+bool ClockScheduler::isBuilt()
+{
+    return !this->v_domains.empty();
+}
+
+bool ClockScheduler::isUsingCalendar()
+{
+    return this->use_calendar;
+}
+
+unsigned long long ClockScheduler::getCalendarSize()
+{
+    return this->v_calendar.size();
+}
+
+unsigned long long ClockScheduler::nextEdges(unsigned long long current_time_ps,
+                                             ClockDomain * const **pp_domains, unsigned int *p_count)
+{
+    if (this->use_calendar) {
+        const CalendarEntry &entry = this->v_calendar[this->calendar_index];
+        unsigned long long delta = this->calendar_started ? entry.delta_t_ps : this->calendar_first_delta_t_ps;
+        this->calendar_started = 1;
+        *pp_domains = &this->v_calendar_domains[entry.first];
+        *p_count = entry.count;
+        if (++this->calendar_index == this->v_calendar.size())
+            this->calendar_index = 0;
+        return delta;
+    }
+
+    // Fallback, min scan on cached edge times
+    unsigned long long t = ULLONG_MAX;
+    for (size_t i = 0; i < this->v_next_edge_ps.size(); i++)
+        if (this->v_next_edge_ps[i] < t) t = this->v_next_edge_ps[i];
+    this->v_next_domains.clear();
+    for (size_t i = 0; i < this->v_next_edge_ps.size(); i++) {
+        if (this->v_next_edge_ps[i] == t) {
+            this->v_next_domains.push_back(this->v_domains[i]);
+            this->v_next_edge_ps[i] += this->v_domains[i]->getHalfPeriodPs();
+        }
+    }
+    *pp_domains = this->v_next_domains.data();
+    *p_count = this->v_next_domains.size();
+    return t - current_time_ps;
+}
@@ -0,0 +1,67 @@
+// Edge scheduler for TestBench::eval
+// The old way was asking every domain for timeToNextEdge twice per eval and building
+// a fresh vector of domains to update -> 2N checks + a heap allocation for every edge.
+// Since domains cannot be added after the clock lock, the whole edge pattern is known
+// the moment the first eval happens, and it repeats every hyperperiod
+// (LCM of all half periods). So precompute it once as a calendar:
+//     entry = {time from previous edge, range of domains that edge at this time}
+// then each step is just reading the next entry and wrapping the index.
+// If the hyperperiod is too long (frequencies with ugly ratios) fall back to caching
+// the next edge time for each domain, still no allocation, just a min scan.
+
+#ifndef CLOCK_SCHEDULER_H
+#define CLOCK_SCHEDULER_H
+
+#include <vector>
+
+#include <climits>
+#include <cassert>
+
+#include "clockDomain.h"
+#include "log.h"
+
+// Calendar bigger than this will use the fallback, 16 bytes per entry -> 4MB
+#define CLOCK_SCHEDULER_MAX_CALENDAR_ENTRIES (1 << 18)
+
+class ClockScheduler
+{
+private:
+    struct CalendarEntry {
+        unsigned long long delta_t_ps;  // time from previous edge (previous entry)
+        unsigned int first;             // index into v_calendar_domains
+        unsigned int count;             // number of domains edging at this time
+    };
+    // Domains in the order the testbench holds them, not owned
+    std::vector<ClockDomain *> v_domains;
+    // Calendar mode
+    std::vector<CalendarEntry> v_calendar;
+    std::vector<ClockDomain *> v_calendar_domains; // flattened domain lists of all entries
+    unsigned long long calendar_first_delta_t_ps;  // delta for the very first entry after build,
+                                                   // entry 0 delta is for wrapping around
+    unsigned int calendar_index;
+    unsigned char calendar_started;
+    // Fallback mode
+    std::vector<unsigned long long> v_next_edge_ps;
+    std::vector<ClockDomain *> v_next_domains;     // reserved on build, cleared every step
+    unsigned char use_calendar;
+
+    static unsigned long long gcd(unsigned long long a, unsigned long long b);
+
+public:
+    ClockScheduler();
+    // (Re)build the schedule, edges are calculated from current time so this can be called again
+    // after the testbench jumps in time (fast forward, restore...)
+    // max_calendar_entries = 0 forces the fallback
+    void build(const std::vector<ClockDomain *> &domains, unsigned long long current_time_ps,
+               unsigned long long max_calendar_entries = CLOCK_SCHEDULER_MAX_CALENDAR_ENTRIES);
+    bool isBuilt();
+    bool isUsingCalendar();
+    unsigned long long getCalendarSize();
+    // Return amount of time until next edge, pp_domains / p_count are set to the domains
+    // that edge at that time. The list stays valid until next call.
+    // Advances the schedule, so only call once per time increment
+    unsigned long long nextEdges(unsigned long long current_time_ps,
+                                 ClockDomain * const **pp_domains, unsigned int *p_count);
+};
+
+#endif
@@ -3,13 +3,75 @@
 
 // SYNC THIS WITH RTL CONFIG FILE
 
+/* Data cache */
+// Size / ways can come from the command line (make vrlt_dcache_sweep)
+#ifndef DCACHE_CAPACITY
+#define DCACHE_CAPACITY 8192
+#endif
+#define DCACHE_BLOCK_SIZE 64
+#ifndef DCACHE_WAYS
+#define DCACHE_WAYS 2
+#endif
+
+/* Instruction cache */
+#define ICACHE_EN 1
+#define ICACHE_CAPACITY 4096
+#define ICACHE_BLOCK_SIZE 64
+
+/* Branch prediction */
+#define BP_EN 1
+#define BP_BTB_ENTRIES 32
+#define BP_PHT_ENTRIES 256
+#define BP_GSHARE 1
+
+/* Data bus */
+// Can come from the command line (make vrlt_bus_bench)
+#ifndef WB_MAX_OUTSTANDING
+#define WB_MAX_OUTSTANDING 16
+#endif
+
+/* ROM */
+#define ROM_SIZE 2048
+#define ROM_START_ADDR 0x10000000
+
 /* RAM */
 #define BRAM_AS_RAM 1
 #undef  BRAM_AS_RAM
-#ifndef BRAM_AS_RAM
+#define RAM_START_ADDR 0x20000000
+#ifdef BRAM_AS_RAM
+    #define RAM_SIZE 8192 // 0x2000
+#else
     #define RAM_SIZE 8388608 // 0x800000
     #define RAM_CLK_FREQ 90
     #define RAM_CAS_LATENCY 2
+    #define RAM_BURST_LENGTH 16 // words per read burst, one dcache block
+    // SDRAM part simulated in CPU.cpp, see geometries in models/SDRAM.h
+    // Controller parameters in RTL must match
+    #define RAM_GEOMETRY EM638325Geometry
+    // .sdram_text in linker.ld, harness loads SDRAMFILE here
+    #define SDRAM_TEXT_START_ADDR 0x20100000
+#endif
+
+/* HDMI */
+#define HDMI_EN 1
+#undef  HDMI_EN
+#ifdef HDMI_EN
+    #define HDMI_SIZE 38408 // 480p frame + status reg 640*480/8 + 8
+    #define HDMI_START_ADDR 0x40000000
+#endif
+
+/* GPIO */
+#define GPIO_EN 1
+#ifdef GPIO_EN
+    #define GPIO_SIZE 32
+    #define GPIO_START_ADDR 0xfffffff8
+#endif
+
+/* Perf counters */
+#define PERF_EN 1
+#ifdef PERF_EN
+    #define PERF_N_COUNTERS 10
+    #define PERF_START_ADDR 0xffffff80
 #endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+// Lockstep cosim of the pipeline retire trace against the RV32I ISS, IRetireListener on RetireTraceWriter
+// Used by the CPU harness (+cosim), bench/Cosim.cpp runs it on the host against a second ISS
+
+#ifndef COSIM_CHECKER_H
+#define COSIM_CHECKER_H
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "config.h"
+#include "log.h"
+#include "memImage.h"
+#include "retireTrace.h"
+#include "models/RV32ISim.h"
+
+/* Lockstep check against the ISS, one ISS step per retired instr (program order, from the retire trace writer)
+ * Compares pc, instr, rd writeback, load / store addr. Stops at the first mismatch
+ * MMIO loads (GPIO, perf counters) can't be predicted, ISS takes the value the pipeline got
+ */
+class CosimChecker : public IRetireListener
+{
+private:
+    RV32ISim *p_iss;
+    const MemImage &image;
+    unsigned long long n_checked;
+    bool failed;
+
+    void fail(const RetireRecord &record, const char *p_what, uint32_t dut, uint32_t iss)
+    {
+        uint32_t offset = 0;
+        const char *p_symbol = this->image.symbolize(record.pc, offset);
+        // Bare pc when there is no symbol for it
+        char symbol[128] = "";
+        if (p_symbol)
+            snprintf(symbol, sizeof(symbol), " <%s+0x%X>", p_symbol, offset);
+        LOG_ERROR(LOG_ISS, "Cosim mismatch after %llu instrs @ pc 0x%08X%s instr 0x%08X: %s pipeline 0x%08X, ISS 0x%08X",
+            this->n_checked, record.pc, symbol, record.instr, p_what, dut, iss);
+        this->failed = true;
+    }
+
+public:
+    // Same image as the pipeline
+    CosimChecker(const MemImage &image) : image(image)
+    {
+        this->n_checked = 0;
+        this->failed    = false;
+        this->p_iss     = new RV32ISim(ROM_START_ADDR);
+        this->p_iss->addRegion(ROM_START_ADDR, ROM_SIZE, false);
+        this->p_iss->addRegion(RAM_START_ADDR, RAM_SIZE, true);
+        if (!this->p_iss->loadImage(image))
+            exit(EXIT_FAILURE);
+    }
+
+    ~CosimChecker()
+    {
+        delete this->p_iss;
+    }
+
+    void onRetire(const RetireRecord &record)
+    {
+        if (this->failed)
+            return;
+        RV32ISim::StepInfo info;
+        RV32ISim::Status status = this->p_iss->step(&info);
+        if (status == RV32ISim::ISS_ILLEGAL || status == RV32ISim::ISS_FETCH_FAULT) {
+            LOG_ERROR(LOG_ISS, "Cosim: ISS %s @ 0x%08X, pipeline retired pc 0x%08X",
+                RV32ISim::statusName(status), this->p_iss->getPC(), record.pc);
+            this->failed = true;
+            return;
+        }
+        if (record.pc != info.pc)
+            return this->fail(record, "pc", record.pc, info.pc);
+        if (record.instr != info.instr)
+            return this->fail(record, "instr", record.instr, info.instr);
+        if (record.flags & (RETIRE_F_LOAD | RETIRE_F_STORE)) {
+            if (record.addr != info.addr)
+                return this->fail(record, "mem addr", record.addr, info.addr);
+        }
+        if (record.flags & RETIRE_F_LOAD) {
+            // Trace closed before the value came back, nothing to compare
+            if ((record.flags & RETIRE_F_LATE) || !info.rd) {}
+            else if (info.mmio)
+                this->p_iss->setReg(info.rd, record.wb);
+            else if (record.wb != info.wb)
+                return this->fail(record, "load value", record.wb, info.wb);
+        }
+        else if (info.rd || (record.flags & RETIRE_F_WB)) {
+            if (!(record.flags & RETIRE_F_WB) || (record.rd != info.rd))
+                return this->fail(record, "rd", (record.flags & RETIRE_F_WB) ? record.rd : 0, info.rd);
+            if (record.wb != info.wb)
+                return this->fail(record, "writeback", record.wb, info.wb);
+        }
+        this->n_checked++;
+    }
+
+    bool hasFailed() { return this->failed; }
+    unsigned long long getChecked() { return this->n_checked; }
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include "log.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Ring size, power of 2. Entries are fixed size so a message never spans two
+#define LOG_RING_SIZE 2048
+#define LOG_MSG_SIZE  512
+// Drain thread naps this long when the ring is empty
+#define LOG_IDLE_US   200
+
+static const char *s_log_module_names[LOG_N_MODULES] = {"harness", "tb", "clock", "sdram", "retire", "iss"};
+static const char  s_log_level_tags[] = {'-', 'E', 'W', 'I', 'D', 'T'};
+
+std::atomic<uint32_t> Log::g_module_mask((1u << LOG_N_MODULES) - 1);
+
+// ==================================================
+/* Bounded MPMC queue (D. Vyukov), only one consumer here
+ * Each entry carries a sequence number: == pos free for the producer claiming pos,
+ * == pos + 1 written and ready for the consumer, then bumped by LOG_RING_SIZE when read
+ */
+namespace {
+
+struct LogEntry {
+    std::atomic<size_t> seq;
+    uint8_t  level;
+    uint8_t  module;
+    uint16_t line;
+    const char *p_file;
+    char msg[LOG_MSG_SIZE];
+};
+
+class Logger
+{
+private:
+    LogEntry *p_ring;
+    std::atomic<size_t> enqueue_pos;
+    std::atomic<size_t> dequeue_pos;   // only written by the drain thread
+    std::atomic<unsigned long long> dropped;
+    std::atomic<bool> stop;
+    std::thread drain_thread;
+    std::atomic<bool> running;
+
+    void print(const LogEntry &entry)
+    {
+        fprintf(stdout, "[%c][%s][%s:%u] %s\n", s_log_level_tags[entry.level], s_log_module_names[entry.module],
+                entry.p_file, entry.line, entry.msg);
+    }
+
+    // Print everything ready, returns false when nothing was
+    bool drain()
+    {
+        bool any = false;
+        size_t pos = this->dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            LogEntry &entry = this->p_ring[pos & (LOG_RING_SIZE - 1)];
+            if (entry.seq.load(std::memory_order_acquire) != pos + 1)
+                break;
+            this->print(entry);
+            entry.seq.store(pos + LOG_RING_SIZE, std::memory_order_release);
+            pos++;
+            this->dequeue_pos.store(pos, std::memory_order_release);
+            any = true;
+        }
+        if (any)
+            fflush(stdout);
+        return any;
+    }
+
+    void drainLoop()
+    {
+        while (!this->stop.load(std::memory_order_acquire)) {
+            if (!this->drain())
+                std::this_thread::sleep_for(std::chrono::microseconds(LOG_IDLE_US));
+        }
+        this->drain();
+    }
+
+public:
+    Logger()
+    {
+        this->p_ring = new LogEntry[LOG_RING_SIZE];
+        for (size_t i = 0; i < LOG_RING_SIZE; i++)
+            this->p_ring[i].seq.store(i, std::memory_order_relaxed);
+        this->enqueue_pos = 0;
+        this->dequeue_pos = 0;
+        this->dropped     = 0;
+        this->stop        = false;
+        // LOGMODULES=sdram,tb
+        const char *p_env = getenv("LOGMODULES");
+        if (p_env && p_env[0]) {
+            uint32_t mask = 0;
+            for (int i = 0; i < LOG_N_MODULES; i++) {
+                const char *p_name = s_log_module_names[i];
+                size_t len = strlen(p_name);
+                for (const char *p = strstr(p_env, p_name); p; p = strstr(p + 1, p_name)) {
+                    bool start = (p == p_env) || (p[-1] == ',');
+                    bool end   = (p[len] == ',') || (p[len] == '\0');
+                    if (start && end)
+                        mask |= 1u << i;
+                }
+            }
+            Log::g_module_mask.store(mask, std::memory_order_relaxed);
+        }
+        this->drain_thread = std::thread(&Logger::drainLoop, this);
+        this->running = true;
+    }
+
+    // At exit, never deleted: late loggers (other static destructors) go straight to stdout
+    void shutdown()
+    {
+        if (!this->running)
+            return;
+        this->stop.store(true, std::memory_order_release);
+        this->drain_thread.join();
+        this->running = false;
+        if (this->dropped)
+            fprintf(stdout, "[W][log] %llu messages dropped, ring full\n", this->dropped.load());
+        fflush(stdout);
+    }
+
+    // Returns position + 1 of the entry, 0 if dropped
+    size_t write(int level, LogModule module, const char *p_file, int line, const char *p_fmt, va_list args)
+    {
+        if (!this->running) {
+            LogEntry entry;
+            entry.level  = level;
+            entry.module = module;
+            entry.line   = line;
+            entry.p_file = p_file;
+            vsnprintf(entry.msg, LOG_MSG_SIZE, p_fmt, args);
+            this->print(entry);
+            fflush(stdout);
+            return 0;
+        }
+        size_t pos = this->enqueue_pos.load(std::memory_order_relaxed);
+        LogEntry *p_entry;
+        while (true) {
+            p_entry = &this->p_ring[pos & (LOG_RING_SIZE - 1)];
+            size_t seq = p_entry->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (this->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                // Full, drain thread is behind. Up to INFO waits for room, DEBUG / TRACE floods are dropped
+                if (level > LOG_LEVEL_INFO) {
+                    this->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return 0;
+                }
+                std::this_thread::yield();
+                pos = this->enqueue_pos.load(std::memory_order_relaxed);
+            }
+            else {
+                pos = this->enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        p_entry->level  = level;
+        p_entry->module = module;
+        p_entry->line   = line;
+        p_entry->p_file = p_file;
+        vsnprintf(p_entry->msg, LOG_MSG_SIZE, p_fmt, args);
+        p_entry->seq.store(pos + 1, std::memory_order_release);
+        return pos + 1;
+    }
+
+    void flush(size_t pos)
+    {
+        while (this->running && (this->dequeue_pos.load(std::memory_order_acquire) < pos))
+            std::this_thread::yield();
+    }
+
+    void flush()
+    {
+        this->flush(this->enqueue_pos.load(std::memory_order_acquire));
+    }
+
+    unsigned long long getDropped()
+    {
+        return this->dropped.load(std::memory_order_relaxed);
+    }
+};
+
+void shutdownLogger();
+
+// First use starts it, so logging from other static initializers is fine
+// Drained by atexit, exit() from signal handlers included. abort() is not, see LOG_ERROR
+Logger &getLogger()
+{
+    static Logger *p_logger = nullptr;
+    if (!p_logger) {
+        p_logger = new Logger();
+        atexit(shutdownLogger);
+    }
+    return *p_logger;
+}
+
+void shutdownLogger()
+{
+    getLogger().shutdown();
+}
+
+// Start the drain thread with the program, not on the first message of a hot loop
+struct LoggerInit {
+    LoggerInit() { getLogger(); }
+} s_logger_init;
+
+}
+
+// ==================================================
+
+void Log::write(int level, LogModule module, const char *p_file, int line, const char *p_fmt, ...)
+{
+    va_list args;
+    va_start(args, p_fmt);
+    size_t pos = getLogger().write(level, module, p_file, line, p_fmt, args);
+    va_end(args);
+    if (level <= LOG_LEVEL_ERROR)
+        getLogger().flush(pos);
+}
+
+void Log::flush()
+{
+    getLogger().flush();
+}
+
+unsigned long long Log::getDropped()
+{
+    return getLogger().getDropped();
+}
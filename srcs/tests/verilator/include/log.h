@@ -0,0 +1,73 @@
+// Leveled logging for the harness, replaces the old DEBUG macro (debug.h)
+//  - Level filtered at compile time: LOG_<LEVEL>() above LOG_LEVEL is dead code, args are not evaluated
+//  - Per module enable: compile time with LOG_MODULE_MASK, runtime with env LOGMODULES=<name>,<name>...
+//    (names in log.cpp, default all), a disabled module costs one load + branch
+//  - Messages are formatted by the caller into a lock-free ring buffer (multi producer, model worker
+//    threads can log too), a background thread drains it to stdout. When the ring is full
+//    DEBUG / TRACE are dropped (counted), up to INFO waits for room
+//  - LOG_ERROR waits until everything before it is out, so abort() right after loses nothing
+// Build with -DLOG_LEVEL=LOG_LEVEL_TRACE for per access SDRAM model output, -DLOG_LEVEL=0 for none
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <cstdint>
+#include <atomic>
+
+#include "utils.h"
+
+#define LOG_LEVEL_OFF   0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Modules, one bit each in the enable masks, keep s_log_module_names in log.cpp in sync
+enum LogModule {
+    LOG_HARNESS = 0, // test drivers (<top>.cpp)
+    LOG_TB,          // testbench, modules, checkpoints
+    LOG_CLOCK,       // clock domains, scheduler, worker pool
+    LOG_SDRAM,       // SDRAM model
+    LOG_RETIRE,      // retire trace
+    LOG_ISS,         // RV32I ISS, cosim
+    LOG_N_MODULES
+};
+
+#ifndef LOG_MODULE_MASK
+#define LOG_MODULE_MASK ((1u << LOG_N_MODULES) - 1)
+#endif
+
+namespace Log {
+    // Runtime module mask, set from LOGMODULES on first use
+    extern std::atomic<uint32_t> g_module_mask;
+
+    inline bool isEnabled(LogModule module)
+    {
+        return (g_module_mask.load(std::memory_order_relaxed) >> module) & 1;
+    }
+
+    void write(int level, LogModule module, const char *p_file, int line, const char *p_fmt, ...)
+        __attribute__((format(printf, 5, 6)));
+    // Wait until everything logged so far is out
+    void flush();
+    // Messages lost to a full ring
+    unsigned long long getDropped();
+}
+
+#define LOG(level, module, ...) do {\
+    if (((level) <= LOG_LEVEL) && ((LOG_MODULE_MASK >> (module)) & 1) && Log::isEnabled(module))\
+        Log::write((level), (module), __FILENAME__, __LINE__, __VA_ARGS__);\
+    } while (0)
+
+#define LOG_ERROR(module, ...) LOG(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#define LOG_WARN(module, ...)  LOG(LOG_LEVEL_WARN,  module, __VA_ARGS__)
+#define LOG_INFO(module, ...)  LOG(LOG_LEVEL_INFO,  module, __VA_ARGS__)
+#define LOG_DEBUG(module, ...) LOG(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#define LOG_TRACE(module, ...) LOG(LOG_LEVEL_TRACE, module, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,309 @@
+#include "memImage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// ==================================================
+// ELF32, only what the loader reads. Little endian host, same as the target
+
+#define ELF_MAGIC      0x464c457f // "\x7fELF"
+#define ELF_CLASS32    1
+#define ELF_DATA_LSB   1
+#define ELF_ET_EXEC    2
+#define ELF_EM_RISCV   243
+#define ELF_PT_LOAD    1
+#define ELF_SHT_SYMTAB 2
+#define ELF_STT_OBJECT 1
+#define ELF_STT_FUNC   2
+
+struct Elf32Header {
+    uint32_t magic;
+    uint8_t  ei_class;
+    uint8_t  ei_data;
+    uint8_t  ei_pad[10];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+};
+
+struct Elf32ProgramHeader {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+};
+
+struct Elf32SectionHeader {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint32_t sh_flags;
+    uint32_t sh_addr;
+    uint32_t sh_offset;
+    uint32_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint32_t sh_addralign;
+    uint32_t sh_entsize;
+};
+
+struct Elf32Symbol {
+    uint32_t st_name;
+    uint32_t st_value;
+    uint32_t st_size;
+    uint8_t  st_info;
+    uint8_t  st_other;
+    uint16_t st_shndx;
+};
+
+static_assert(sizeof(Elf32Header) == 52 && sizeof(Elf32ProgramHeader) == 32 && sizeof(Elf32SectionHeader) == 40 &&
+              sizeof(Elf32Symbol) == 16, "ELF32 structs must match the file layout");
+
+// ==================================================
+
+MemImage::MemImage()
+{
+    this->ram_init = false;
+}
+
+bool MemImage::loadHex(const char *p_file, uint32_t addr)
+{
+    FILE *fp = fopen(p_file, "r");
+    if (!fp) {
+        LOG_ERROR(LOG_TB, "Could not open %s", p_file);
+        return false;
+    }
+    MemSegment segment;
+    segment.addr = addr;
+    unsigned int word;
+    while (fscanf(fp, "%x", &word) == 1) {
+        uint8_t bytes[4] = {(uint8_t)word, (uint8_t)(word >> 8), (uint8_t)(word >> 16), (uint8_t)(word >> 24)};
+        segment.v_data.insert(segment.v_data.end(), bytes, bytes + 4);
+    }
+    fclose(fp);
+    LOG_INFO(LOG_TB, "Loaded %s, %zu bytes @ 0x%08X", p_file, segment.v_data.size(), addr);
+    if (!segment.v_data.empty())
+        this->v_segments.push_back(std::move(segment));
+    return true;
+}
+
+// Whole file in memory, firmware ELFs are a few 10s of KB
+bool MemImage::loadELF(const char *p_file)
+{
+    FILE *fp = fopen(p_file, "rb");
+    if (!fp) {
+        LOG_ERROR(LOG_TB, "Could not open %s", p_file);
+        return false;
+    }
+    std::vector<uint8_t> v_file;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        v_file.insert(v_file.end(), buf, buf + n);
+    fclose(fp);
+
+    Elf32Header header;
+    if (v_file.size() < sizeof(header)) {
+        LOG_ERROR(LOG_TB, "%s is too short for an ELF", p_file);
+        return false;
+    }
+    memcpy(&header, v_file.data(), sizeof(header));
+    if ((header.magic != ELF_MAGIC) || (header.ei_class != ELF_CLASS32) || (header.ei_data != ELF_DATA_LSB) ||
+        (header.e_type != ELF_ET_EXEC) || (header.e_machine != ELF_EM_RISCV)) {
+        LOG_ERROR(LOG_TB, "%s is not a RV32 little endian executable", p_file);
+        return false;
+    }
+    // Bounds check for every table / blob read below
+    auto inFile = [&](uint64_t offset, uint64_t len) { return offset + len <= v_file.size(); };
+
+    // Segments
+    if (!inFile(header.e_phoff, (uint64_t)header.e_phnum * sizeof(Elf32ProgramHeader))) {
+        LOG_ERROR(LOG_TB, "%s: program headers outside the file", p_file);
+        return false;
+    }
+    size_t n_bytes = 0;
+    for (int i = 0; i < header.e_phnum; i++) {
+        Elf32ProgramHeader ph;
+        memcpy(&ph, v_file.data() + header.e_phoff + i * sizeof(ph), sizeof(ph));
+        if ((ph.p_type != ELF_PT_LOAD) || !ph.p_memsz)
+            continue;
+        if (!inFile(ph.p_offset, ph.p_filesz) || (ph.p_filesz > ph.p_memsz)) {
+            LOG_ERROR(LOG_TB, "%s: segment %d outside the file", p_file, i);
+            return false;
+        }
+        const uint8_t *p_data = v_file.data() + ph.p_offset;
+        // Load address: what is in ROM on hw (.text, .rodata, the .data copy)
+        if (ph.p_filesz) {
+            MemSegment segment;
+            segment.addr = ph.p_paddr;
+            segment.v_data.assign(p_data, p_data + ph.p_filesz);
+            this->v_segments.push_back(std::move(segment));
+            n_bytes += ph.p_filesz;
+        }
+        // Run address in RAM: what reset.c would copy / clear there (.data, .bss), stack (NOLOAD) zeroed too
+        if ((ph.p_vaddr != ph.p_paddr) || (ph.p_memsz > ph.p_filesz)) {
+            if ((ph.p_vaddr - RAM_START_ADDR) < RAM_SIZE) {
+                MemSegment segment;
+                segment.addr = ph.p_vaddr;
+                segment.v_data.assign(p_data, p_data + ph.p_filesz);
+                segment.v_data.resize(ph.p_memsz, 0);
+                this->v_segments.push_back(std::move(segment));
+                this->ram_init = true;
+            }
+        }
+    }
+
+    // Symbols, optional (stripped ELF loads fine)
+    if (inFile(header.e_shoff, (uint64_t)header.e_shnum * sizeof(Elf32SectionHeader))) {
+        for (int i = 0; i < header.e_shnum; i++) {
+            Elf32SectionHeader sh, strtab;
+            memcpy(&sh, v_file.data() + header.e_shoff + i * sizeof(sh), sizeof(sh));
+            if ((sh.sh_type != ELF_SHT_SYMTAB) || (sh.sh_link >= header.e_shnum))
+                continue;
+            memcpy(&strtab, v_file.data() + header.e_shoff + sh.sh_link * sizeof(strtab), sizeof(strtab));
+            if (!inFile(sh.sh_offset, sh.sh_size) || !inFile(strtab.sh_offset, strtab.sh_size))
+                continue;
+            for (uint32_t offset = 0; offset + sizeof(Elf32Symbol) <= sh.sh_size; offset += sizeof(Elf32Symbol)) {
+                Elf32Symbol sym;
+                memcpy(&sym, v_file.data() + sh.sh_offset + offset, sizeof(sym));
+                uint8_t type = sym.st_info & 0xf;
+                // Functions, objects and asm labels (hang, _reset_handler), no section / file entries
+                if ((type != ELF_STT_FUNC) && (type != ELF_STT_OBJECT) && (type != 0))
+                    continue;
+                if (!sym.st_name || (sym.st_name >= strtab.sh_size) || !sym.st_shndx)
+                    continue;
+                const char *p_name = (const char *)v_file.data() + strtab.sh_offset + sym.st_name;
+                // Local labels from the assembler, empty names
+                if (!p_name[0] || p_name[0] == '.' || !strncmp(p_name, "$x", 2) || !strncmp(p_name, "$d", 2))
+                    continue;
+                this->v_symbols.push_back({sym.st_value, sym.st_size,
+                                           std::string(p_name, strnlen(p_name, strtab.sh_size - sym.st_name))});
+            }
+        }
+        // Same addr: labels (size 0) first, symbolize() takes the last one = the function / object
+        std::sort(this->v_symbols.begin(), this->v_symbols.end(),
+                  [](const MemSymbol &a, const MemSymbol &b) { return (a.addr != b.addr) ? a.addr < b.addr : a.size < b.size; });
+    }
+    LOG_INFO(LOG_TB, "Loaded %s, %zu bytes, entry 0x%08X, %zu symbols%s", p_file, n_bytes, header.e_entry,
+             this->v_symbols.size(), this->ram_init ? ", RAM preset" : "");
+    if (header.e_entry != ROM_START_ADDR)
+        LOG_WARN(LOG_TB, "%s: entry 0x%08X, the core always starts at 0x%08X", p_file, header.e_entry, ROM_START_ADDR);
+    return true;
+}
+
+bool MemImage::loadFile(const char *p_file, uint32_t addr)
+{
+    FILE *fp = fopen(p_file, "rb");
+    if (!fp) {
+        LOG_ERROR(LOG_TB, "Could not open %s", p_file);
+        return false;
+    }
+    uint32_t magic = 0;
+    size_t n = fread(&magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    if ((n == sizeof(magic)) && (magic == ELF_MAGIC))
+        return this->loadELF(p_file);
+    return this->loadHex(p_file, addr);
+}
+
+bool MemImage::loadFromEnv()
+{
+    const char *p_rom_file = getenv("ROMFILE");
+    if (!p_rom_file) {
+        LOG_ERROR(LOG_TB, "ROMFILE not set");
+        return false;
+    }
+    if (!this->loadFile(p_rom_file, ROM_START_ADDR))
+        return false;
+#ifndef BRAM_AS_RAM
+    // Hex only, an ELF has .sdram_text already
+    const char *p_sdram_file = getenv("SDRAMFILE");
+    if (p_sdram_file && !this->loadHex(p_sdram_file, SDRAM_TEXT_START_ADDR))
+        return false;
+#endif
+    return true;
+}
+
+const std::vector<MemSegment> &MemImage::getSegments() const
+{
+    return this->v_segments;
+}
+
+size_t MemImage::copyTo(uint32_t base, uint32_t size, uint8_t *p_mem) const
+{
+    size_t copied = 0;
+    for (const MemSegment &segment : this->v_segments) {
+        // Overlap of [segment.addr, + len) and [base, + size), 64 bit so nothing wraps
+        uint64_t start = std::max<uint64_t>(segment.addr, base);
+        uint64_t end   = std::min<uint64_t>((uint64_t)segment.addr + segment.v_data.size(), (uint64_t)base + size);
+        if (start >= end)
+            continue;
+        memcpy(p_mem + (start - base), segment.v_data.data() + (start - segment.addr), end - start);
+        copied += end - start;
+    }
+    return copied;
+}
+
+bool MemImage::patch32(uint32_t addr, uint32_t value)
+{
+    bool patched = false;
+    for (MemSegment &segment : this->v_segments) {
+        if ((uint64_t)addr + 4 <= (uint64_t)segment.addr + segment.v_data.size() && addr >= segment.addr) {
+            memcpy(segment.v_data.data() + (addr - segment.addr), &value, 4);
+            patched = true;
+        }
+    }
+    return patched;
+}
+
+bool MemImage::markDataPreloaded()
+{
+    uint32_t addr;
+    if (!this->ram_init || !this->findSymbol("_data_preloaded", addr))
+        return false;
+    if (!this->patch32(addr, 1))
+        return false;
+    LOG_INFO(LOG_TB, ".data / .bss preset in RAM, reset.c copy loops skipped");
+    return true;
+}
+
+bool MemImage::findSymbol(const char *p_name, uint32_t &addr) const
+{
+    for (const MemSymbol &symbol : this->v_symbols) {
+        if (symbol.name == p_name) {
+            addr = symbol.addr;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *MemImage::symbolize(uint32_t addr, uint32_t &offset) const
+{
+    // Last symbol at or below addr
+    std::vector<MemSymbol>::const_iterator i_symbol = std::upper_bound(this->v_symbols.begin(), this->v_symbols.end(), addr,
+        [](uint32_t a, const MemSymbol &symbol) { return a < symbol.addr; });
+    if (i_symbol == this->v_symbols.begin())
+        return nullptr;
+    i_symbol--;
+    // Sized symbols must contain addr, size 0 (asm labels) take everything up to the next one
+    if (i_symbol->size && (addr - i_symbol->addr >= i_symbol->size))
+        return nullptr;
+    offset = addr - i_symbol->addr;
+    return i_symbol->name.c_str();
+}
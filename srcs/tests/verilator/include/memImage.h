@@ -0,0 +1,63 @@
+// Firmware image shared by everything that loads code: CPU harness (ROM, SDRAM backing memory), cosim ISS, SoC emulator
+// Loaders fill it with segments, users copy the segments that fall into their memories
+// Sources:
+//  - rom.sh hex text (rom.txt / sdram.txt), one word per line at a given address
+//  - the linked ELF (rom.sh rom.elf): PT_LOAD segments at their load address (ROM copy of .data included),
+//    segments linked to RAM (.data, .bss) also at their run address. Symbols are kept for trace annotation
+
+#ifndef MEM_IMAGE_H
+#define MEM_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "log.h"
+
+struct MemSegment {
+    uint32_t addr;
+    std::vector<uint8_t> v_data;
+};
+
+struct MemSymbol {
+    uint32_t addr;
+    uint32_t size;
+    std::string name;
+};
+
+class MemImage
+{
+private:
+    std::vector<MemSegment> v_segments;
+    std::vector<MemSymbol>  v_symbols; // sorted by addr
+    bool ram_init;                     // ELF segments with a run address in RAM loaded there
+
+public:
+    MemImage();
+    // Hex words, one per line (rom.sh rom.txt / sdram.txt, $readmemh format) at addr
+    bool loadHex(const char *p_file, uint32_t addr);
+    // RV32 little endian executable
+    bool loadELF(const char *p_file);
+    // ELF when the file starts with the ELF magic, hex at addr otherwise
+    bool loadFile(const char *p_file, uint32_t addr);
+    // What the harness runs: env ROMFILE (ELF or hex at ROM_START_ADDR), optional SDRAMFILE (hex at SDRAM_TEXT_START_ADDR)
+    bool loadFromEnv();
+    const std::vector<MemSegment> &getSegments() const;
+    // Copy the parts in [base, base + size) to p_mem (base .. base + size), returns bytes copied
+    size_t copyTo(uint32_t base, uint32_t size, uint8_t *p_mem) const;
+    // Overwrite a word already in a segment
+    bool patch32(uint32_t addr, uint32_t value);
+    /* Tell reset.c .data / .bss are already in RAM (sets _data_preloaded in the ROM copy) so it skips the copy loops
+     * Only when the loader of this image writes RAM too, false if nothing to skip / symbol missing
+     */
+    bool markDataPreloaded();
+
+    bool findSymbol(const char *p_name, uint32_t &addr) const;
+    // Symbol containing addr (or the closest one below for size 0 symbols), nullptr if none
+    const char *symbolize(uint32_t addr, uint32_t &offset) const;
+    size_t getSymbolCount() const { return v_symbols.size(); }
+};
+
+#endif
@@ -0,0 +1,472 @@
+/* RV32I instruction set simulator, reference for the pipeline and fast functional sim for firmware
+ * No clock, no timing: one step() = one instr. Not an IModel, it is driven by retired instrs (CPU.cpp +cosim)
+ * or runs on its own (tools/socemu) at a few hundred MIPS
+ * Same ISA as the core: RV32I, no CSR / interrupts / misaligned traps. fence = nop, ecall / ebreak stop run()
+ * Speed:
+ *  - instrs are decoded once into a direct mapped decode cache (tag = pc), stores to a cached word drop it
+ *  - threaded dispatch, see exec()
+ *  - memory is a few flat regions (ROM, RAM) owned by the sim, anything else goes to an IMMIO handler
+ */
+
+#ifndef RV32ISIM_H
+#define RV32ISIM_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "../log.h"
+#include "../memImage.h"
+
+// Decode cache entries, power of 2. 16K instrs = 64KB of code before conflicts
+#define RV32ISIM_DECODE_CACHE_SIZE 16384
+#define RV32ISIM_MAX_REGIONS       4
+
+// Memory outside regions (GPIO, perf counters...), size in bytes 1 / 2 / 4, addr aligned to size
+class IMMIO
+{
+public:
+    virtual ~IMMIO() {}
+    virtual uint32_t read(uint32_t addr, unsigned int size) = 0;
+    virtual void write(uint32_t addr, unsigned int size, uint32_t data) = 0;
+};
+
+class RV32ISim
+{
+public:
+    enum Status {
+        ISS_OK = 0,
+        ISS_HALT_LOOP,     // jal x0, 0: firmware is done (reset.c hang), executed
+        ISS_ECALL,         // executed as nop
+        ISS_EBREAK,        // executed as nop
+        ISS_ILLEGAL,       // not executed, pc stays
+        ISS_FETCH_FAULT    // pc outside regions, not executed
+    };
+
+    // What the last step() did, same fields the pipeline retire trace has
+    struct StepInfo {
+        uint32_t pc;
+        uint32_t instr;
+        uint32_t wb;
+        uint32_t addr;
+        uint8_t  rd;       // 0 = no writeback
+        bool     load;
+        bool     store;
+        bool     mmio;     // load / store went to the IMMIO handler
+    };
+
+private:
+    // Decoded instr, op indexes the handler table in exec()
+    struct Decoded {
+        uint32_t tag;      // pc, 1 = empty (pcs are aligned)
+        uint8_t  op;
+        uint8_t  rd;
+        uint8_t  rs1;
+        uint8_t  rs2;
+        int32_t  imm;
+        uint32_t instr;
+    };
+
+    enum Op : uint8_t {
+        OP_LUI, OP_AUIPC, OP_JAL, OP_JALR,
+        OP_BEQ, OP_BNE, OP_BLT, OP_BGE, OP_BLTU, OP_BGEU,
+        OP_LB, OP_LH, OP_LW, OP_LBU, OP_LHU,
+        OP_SB, OP_SH, OP_SW,
+        OP_ADDI, OP_SLTI, OP_SLTIU, OP_XORI, OP_ORI, OP_ANDI, OP_SLLI, OP_SRLI, OP_SRAI,
+        OP_ADD, OP_SUB, OP_SLL, OP_SLT, OP_SLTU, OP_XOR, OP_SRL, OP_SRA, OP_OR, OP_AND,
+        OP_FENCE, OP_ECALL, OP_EBREAK, OP_ILLEGAL
+    };
+
+    struct Region {
+        uint32_t base;
+        uint32_t size;
+        uint8_t  *p_mem;
+        bool     writable;
+    };
+
+    uint32_t x[32];
+    uint32_t pc;
+    uint32_t reset_pc;
+    uint64_t instret;
+    Region   regions[RV32ISIM_MAX_REGIONS];
+    unsigned int n_regions;
+    IMMIO    *p_mmio;
+    Decoded  *p_decode_cache;
+
+    Region *findRegion(uint32_t addr, uint32_t size);
+    void decode(uint32_t instr, Decoded &d);
+    const Decoded *fetchMiss(uint32_t pc);
+    uint32_t load(uint32_t addr, unsigned int size, bool &mmio);
+    void store(uint32_t addr, unsigned int size, uint32_t data, bool &mmio);
+    template<bool Info> Status exec(StepInfo *p_info, uint64_t max_instrs);
+
+public:
+    RV32ISim(uint32_t reset_pc);
+    ~RV32ISim();
+    // Sim owned, zeroed memory at [base, base + size), returns it for loading
+    uint8_t *addRegion(uint32_t base, uint32_t size, bool writable);
+    void setMMIO(IMMIO *p_mmio);
+    // pc = reset pc, regs = 0, memory kept
+    void reset();
+    // One instr, p_info filled when given
+    Status step(StepInfo *p_info = nullptr);
+    // Until max_instrs or a non OK status (HALT_LOOP included), returns the status that stopped it
+    Status run(uint64_t max_instrs);
+    // Write to memory from outside (loaders), goes around write protection, keeps decode cache right
+    bool writeMem(uint32_t addr, const void *p_data, uint32_t len);
+    // Segments outside the regions are reported and skipped
+    bool loadImage(const MemImage &image);
+
+    uint32_t getReg(unsigned int idx) { return x[idx & 0x1f]; }
+    void setReg(unsigned int idx, uint32_t value) { if (idx & 0x1f) x[idx & 0x1f] = value; }
+    uint32_t getPC() { return pc; }
+    void setPC(uint32_t pc) { this->pc = pc; }
+    uint64_t getInstret() { return instret; }
+    static const char *statusName(Status status);
+};
+
+// ==================================================
+
+inline RV32ISim::RV32ISim(uint32_t reset_pc)
+{
+    this->reset_pc  = reset_pc;
+    this->n_regions = 0;
+    this->p_mmio    = nullptr;
+    this->p_decode_cache = new Decoded[RV32ISIM_DECODE_CACHE_SIZE];
+    for (unsigned int i = 0; i < RV32ISIM_DECODE_CACHE_SIZE; i++)
+        this->p_decode_cache[i].tag = 1;
+    this->reset();
+}
+
+inline RV32ISim::~RV32ISim()
+{
+    for (unsigned int i = 0; i < this->n_regions; i++)
+        delete[] this->regions[i].p_mem;
+    delete[] this->p_decode_cache;
+}
+
+inline uint8_t *RV32ISim::addRegion(uint32_t base, uint32_t size, bool writable)
+{
+    assert(this->n_regions < RV32ISIM_MAX_REGIONS);
+    Region &region  = this->regions[this->n_regions++];
+    region.base     = base;
+    region.size     = size;
+    region.p_mem    = new uint8_t[size]();
+    region.writable = writable;
+    return region.p_mem;
+}
+
+inline void RV32ISim::setMMIO(IMMIO *p_mmio)
+{
+    this->p_mmio = p_mmio;
+}
+
+inline void RV32ISim::reset()
+{
+    memset(this->x, 0, sizeof(this->x));
+    this->pc      = this->reset_pc;
+    this->instret = 0;
+}
+
+inline const char *RV32ISim::statusName(Status status)
+{
+    switch (status) {
+        case ISS_OK:          return "ok";
+        case ISS_HALT_LOOP:   return "halt loop";
+        case ISS_ECALL:       return "ecall";
+        case ISS_EBREAK:      return "ebreak";
+        case ISS_ILLEGAL:     return "illegal instr";
+        case ISS_FETCH_FAULT: return "fetch fault";
+    }
+    return "?";
+}
+
+// Few regions, ROM first then RAM, linear search is fine
+inline RV32ISim::Region *RV32ISim::findRegion(uint32_t addr, uint32_t size)
+{
+    for (unsigned int i = 0; i < this->n_regions; i++) {
+        Region &region = this->regions[i];
+        if ((addr - region.base) <= (region.size - size))
+            return &region;
+    }
+    return nullptr;
+}
+
+inline void RV32ISim::decode(uint32_t instr, Decoded &d)
+{
+    uint32_t funct3 = (instr >> 12) & 0x7;
+    bool     b30    = (instr >> 30) & 0x1;
+    d.instr = instr;
+    d.rd    = (instr >> 7) & 0x1f;
+    d.rs1   = (instr >> 15) & 0x1f;
+    d.rs2   = (instr >> 20) & 0x1f;
+    d.imm   = 0;
+    d.op    = OP_ILLEGAL;
+    switch (instr & 0x7f) {
+        case 0x37: d.op = OP_LUI;   d.imm = instr & 0xfffff000; break;
+        case 0x17: d.op = OP_AUIPC; d.imm = instr & 0xfffff000; break;
+        case 0x6f:
+            d.op  = OP_JAL;
+            d.imm = ((int32_t)(instr & 0x80000000) >> 11) | (instr & 0xff000) | ((instr >> 9) & 0x800) | ((instr >> 20) & 0x7fe);
+            break;
+        case 0x67:
+            if (funct3 == 0) { d.op = OP_JALR; d.imm = (int32_t)instr >> 20; }
+            break;
+        case 0x63: {
+            static const uint8_t s_ops[8] = {OP_BEQ, OP_BNE, OP_ILLEGAL, OP_ILLEGAL, OP_BLT, OP_BGE, OP_BLTU, OP_BGEU};
+            d.op  = s_ops[funct3];
+            d.imm = ((int32_t)(instr & 0x80000000) >> 19) | ((instr & 0x80) << 4) | ((instr >> 20) & 0x7e0) | ((instr >> 7) & 0x1e);
+            break;
+        }
+        case 0x03: {
+            static const uint8_t s_ops[8] = {OP_LB, OP_LH, OP_LW, OP_ILLEGAL, OP_LBU, OP_LHU, OP_ILLEGAL, OP_ILLEGAL};
+            d.op  = s_ops[funct3];
+            d.imm = (int32_t)instr >> 20;
+            break;
+        }
+        case 0x23: {
+            static const uint8_t s_ops[8] = {OP_SB, OP_SH, OP_SW, OP_ILLEGAL, OP_ILLEGAL, OP_ILLEGAL, OP_ILLEGAL, OP_ILLEGAL};
+            d.op  = s_ops[funct3];
+            d.imm = ((int32_t)(instr & 0xfe000000) >> 20) | ((instr >> 7) & 0x1f);
+            break;
+        }
+        case 0x13: {
+            static const uint8_t s_ops[8] = {OP_ADDI, OP_SLLI, OP_SLTI, OP_SLTIU, OP_XORI, OP_SRLI, OP_ORI, OP_ANDI};
+            d.op  = s_ops[funct3];
+            d.imm = (int32_t)instr >> 20;
+            if (funct3 == 0x1 || funct3 == 0x5) {
+                d.imm &= 0x1f;
+                if (funct3 == 0x5 && b30)
+                    d.op = OP_SRAI;
+            }
+            break;
+        }
+        case 0x33: {
+            static const uint8_t s_ops[8] = {OP_ADD, OP_SLL, OP_SLT, OP_SLTU, OP_XOR, OP_SRL, OP_OR, OP_AND};
+            d.op = s_ops[funct3];
+            if (b30) {
+                if (funct3 == 0x0)      d.op = OP_SUB;
+                else if (funct3 == 0x5) d.op = OP_SRA;
+            }
+            break;
+        }
+        case 0x0f: d.op = OP_FENCE; break;
+        case 0x73: d.op = (instr >> 20) ? OP_EBREAK : OP_ECALL; break;
+        default: break;
+    }
+}
+
+// Decode cache miss, decode into the slot of pc. nullptr = pc not in a region / misaligned
+inline const RV32ISim::Decoded *RV32ISim::fetchMiss(uint32_t pc)
+{
+    Region *p_region = this->findRegion(pc, 4);
+    if (!p_region || (pc & 0x3))
+        return nullptr;
+    Decoded &d = this->p_decode_cache[(pc >> 2) & (RV32ISIM_DECODE_CACHE_SIZE - 1)];
+    uint32_t instr;
+    memcpy(&instr, p_region->p_mem + (pc - p_region->base), 4);
+    this->decode(instr, d);
+    d.tag = pc;
+    return &d;
+}
+
+inline uint32_t RV32ISim::load(uint32_t addr, unsigned int size, bool &mmio)
+{
+    Region *p_region = this->findRegion(addr, size);
+    if (p_region) {
+        uint32_t data = 0;
+        memcpy(&data, p_region->p_mem + (addr - p_region->base), size);
+        return data;
+    }
+    mmio = true;
+    return this->p_mmio ? this->p_mmio->read(addr, size) : 0;
+}
+
+inline void RV32ISim::store(uint32_t addr, unsigned int size, uint32_t data, bool &mmio)
+{
+    Region *p_region = this->findRegion(addr, size);
+    if (p_region) {
+        if (!p_region->writable)
+            return; // ROM ignores writes
+        memcpy(p_region->p_mem + (addr - p_region->base), &data, size);
+        // Self modifying / loaded code
+        Decoded &d = this->p_decode_cache[(addr >> 2) & (RV32ISIM_DECODE_CACHE_SIZE - 1)];
+        if (d.tag == (addr & ~0x3u))
+            d.tag = 1;
+        return;
+    }
+    mmio = true;
+    if (this->p_mmio)
+        this->p_mmio->write(addr, size, data);
+}
+
+/* Threaded interpreter: every handler ends with its own fetch + indirect jump to the next handler
+ * (GCC labels as values), the host predicts each of those jumps on its own instead of one shared switch jump
+ * Info = step(): one instr, p_info filled. The compiler drops the Info parts from run()
+ * MMIO handlers may look at getPC() / getInstret(), both are current when load() / store() are called
+ */
+#define ISS_FETCH() do {\
+        p_d = &p_cache[(pc >> 2) & (RV32ISIM_DECODE_CACHE_SIZE - 1)];\
+        if (p_d->tag != pc) {\
+            p_d = this->fetchMiss(pc);\
+            if (!p_d) { status = ISS_FETCH_FAULT; goto out; }\
+        }\
+        if (Info) { addr = 0; mmio = false; }\
+        goto *s_handlers[p_d->op];\
+    } while (0)
+
+// Retire: x0 back to 0, info, next pc, stop on status / count
+#define ISS_END(next_pc, wrote_rd) do {\
+        x[0] = 0;\
+        if (Info) {\
+            p_info->pc    = pc;\
+            p_info->instr = p_d->instr;\
+            p_info->rd    = (wrote_rd) ? p_d->rd : 0;\
+            p_info->wb    = x[p_info->rd];\
+            p_info->addr  = addr;\
+            p_info->load  = (p_d->op >= OP_LB) && (p_d->op <= OP_LHU);\
+            p_info->store = (p_d->op >= OP_SB) && (p_d->op <= OP_SW);\
+            p_info->mmio  = mmio;\
+        }\
+        pc = (next_pc);\
+        this->instret++;\
+        if (Info || (status != ISS_OK) || (this->instret == end))\
+            goto out;\
+        ISS_FETCH();\
+    } while (0)
+
+#define ISS_WB(value)          do { x[p_d->rd] = (value); ISS_END(pc + 4, true); } while (0)
+#define ISS_BRANCH(cond)       ISS_END((cond) ? pc + p_d->imm : pc + 4, false)
+#define ISS_LOAD(type, size)   do { addr = x[p_d->rs1] + p_d->imm; this->pc = pc;\
+                                    x[p_d->rd] = (uint32_t)(type)this->load(addr, size, mmio); ISS_END(pc + 4, true); } while (0)
+#define ISS_STORE(size)        do { addr = x[p_d->rs1] + p_d->imm; this->pc = pc;\
+                                    this->store(addr, size, x[p_d->rs2], mmio); ISS_END(pc + 4, false); } while (0)
+
+template<bool Info>
+inline RV32ISim::Status RV32ISim::exec(StepInfo *p_info, uint64_t max_instrs)
+{
+    // Same order as Op
+    static void *const s_handlers[] = {
+        &&op_lui, &&op_auipc, &&op_jal, &&op_jalr,
+        &&op_beq, &&op_bne, &&op_blt, &&op_bge, &&op_bltu, &&op_bgeu,
+        &&op_lb, &&op_lh, &&op_lw, &&op_lbu, &&op_lhu,
+        &&op_sb, &&op_sh, &&op_sw,
+        &&op_addi, &&op_slti, &&op_sltiu, &&op_xori, &&op_ori, &&op_andi, &&op_slli, &&op_srli, &&op_srai,
+        &&op_add, &&op_sub, &&op_sll, &&op_slt, &&op_sltu, &&op_xor, &&op_srl, &&op_sra, &&op_or, &&op_and,
+        &&op_fence, &&op_ecall, &&op_ebreak, &&op_illegal
+    };
+    static_assert(sizeof(s_handlers) / sizeof(s_handlers[0]) == OP_ILLEGAL + 1, "Handler table out of sync with Op");
+
+    uint32_t *x = this->x;
+    Decoded  *p_cache = this->p_decode_cache;
+    uint32_t pc = this->pc;
+    uint64_t end = (max_instrs > UINT64_MAX - this->instret) ? UINT64_MAX : this->instret + max_instrs;
+    const Decoded *p_d;
+    uint32_t addr = 0;
+    bool     mmio = false;
+    Status   status = ISS_OK;
+    if (!max_instrs)
+        return ISS_OK;
+    ISS_FETCH();
+
+op_lui:    ISS_WB(p_d->imm);
+op_auipc:  ISS_WB(pc + p_d->imm);
+op_jal:
+    // jal x0, 0 = firmware hang loop
+    if (p_d->imm == 0)
+        status = ISS_HALT_LOOP;
+    x[p_d->rd] = pc + 4;
+    ISS_END(pc + p_d->imm, true);
+op_jalr: {
+    uint32_t target = (x[p_d->rs1] + p_d->imm) & ~0x1u;
+    x[p_d->rd] = pc + 4;
+    ISS_END(target, true);
+}
+op_beq:    ISS_BRANCH(x[p_d->rs1] == x[p_d->rs2]);
+op_bne:    ISS_BRANCH(x[p_d->rs1] != x[p_d->rs2]);
+op_blt:    ISS_BRANCH((int32_t)x[p_d->rs1] <  (int32_t)x[p_d->rs2]);
+op_bge:    ISS_BRANCH((int32_t)x[p_d->rs1] >= (int32_t)x[p_d->rs2]);
+op_bltu:   ISS_BRANCH(x[p_d->rs1] <  x[p_d->rs2]);
+op_bgeu:   ISS_BRANCH(x[p_d->rs1] >= x[p_d->rs2]);
+op_lb:     ISS_LOAD(int8_t, 1);
+op_lh:     ISS_LOAD(int16_t, 2);
+op_lw:     ISS_LOAD(uint32_t, 4);
+op_lbu:    ISS_LOAD(uint8_t, 1);
+op_lhu:    ISS_LOAD(uint16_t, 2);
+op_sb:     ISS_STORE(1);
+op_sh:     ISS_STORE(2);
+op_sw:     ISS_STORE(4);
+op_addi:   ISS_WB(x[p_d->rs1] + p_d->imm);
+op_slti:   ISS_WB((int32_t)x[p_d->rs1] < p_d->imm);
+op_sltiu:  ISS_WB(x[p_d->rs1] < (uint32_t)p_d->imm);
+op_xori:   ISS_WB(x[p_d->rs1] ^ p_d->imm);
+op_ori:    ISS_WB(x[p_d->rs1] | p_d->imm);
+op_andi:   ISS_WB(x[p_d->rs1] & p_d->imm);
+op_slli:   ISS_WB(x[p_d->rs1] << p_d->imm);
+op_srli:   ISS_WB(x[p_d->rs1] >> p_d->imm);
+op_srai:   ISS_WB((int32_t)x[p_d->rs1] >> p_d->imm);
+op_add:    ISS_WB(x[p_d->rs1] + x[p_d->rs2]);
+op_sub:    ISS_WB(x[p_d->rs1] - x[p_d->rs2]);
+op_sll:    ISS_WB(x[p_d->rs1] << (x[p_d->rs2] & 0x1f));
+op_slt:    ISS_WB((int32_t)x[p_d->rs1] < (int32_t)x[p_d->rs2]);
+op_sltu:   ISS_WB(x[p_d->rs1] < x[p_d->rs2]);
+op_xor:    ISS_WB(x[p_d->rs1] ^ x[p_d->rs2]);
+op_srl:    ISS_WB(x[p_d->rs1] >> (x[p_d->rs2] & 0x1f));
+op_sra:    ISS_WB((int32_t)x[p_d->rs1] >> (x[p_d->rs2] & 0x1f));
+op_or:     ISS_WB(x[p_d->rs1] | x[p_d->rs2]);
+op_and:    ISS_WB(x[p_d->rs1] & x[p_d->rs2]);
+op_fence:  ISS_END(pc + 4, false);
+op_ecall:  status = ISS_ECALL;  ISS_END(pc + 4, false);
+op_ebreak: status = ISS_EBREAK; ISS_END(pc + 4, false);
+op_illegal:
+    status = ISS_ILLEGAL;
+out:
+    this->pc = pc;
+    return status;
+}
+
+#undef ISS_FETCH
+#undef ISS_END
+#undef ISS_WB
+#undef ISS_BRANCH
+#undef ISS_LOAD
+#undef ISS_STORE
+
+inline RV32ISim::Status RV32ISim::step(StepInfo *p_info)
+{
+    if (p_info)
+        return this->exec<true>(p_info, 1);
+    return this->exec<false>(nullptr, 1);
+}
+
+inline RV32ISim::Status RV32ISim::run(uint64_t max_instrs)
+{
+    return this->exec<false>(nullptr, max_instrs);
+}
+
+inline bool RV32ISim::writeMem(uint32_t addr, const void *p_data, uint32_t len)
+{
+    Region *p_region = this->findRegion(addr, len);
+    if (!p_region)
+        return false;
+    memcpy(p_region->p_mem + (addr - p_region->base), p_data, len);
+    // Loaders run before anything is decoded, drop the lot anyway
+    for (unsigned int i = 0; i < RV32ISIM_DECODE_CACHE_SIZE; i++)
+        this->p_decode_cache[i].tag = 1;
+    return true;
+}
+
+
+inline bool RV32ISim::loadImage(const MemImage &image)
+{
+    bool all = true;
+    for (const MemSegment &segment : image.getSegments()) {
+        if (!this->writeMem(segment.addr, segment.v_data.data(), segment.v_data.size())) {
+            LOG_ERROR(LOG_ISS, "Image segment @ 0x%08X (%zu bytes) is outside ISS memory", segment.addr, segment.v_data.size());
+            all = false;
+        }
+    }
+    return all;
+}
+
+#endif
@@ -1,5 +1,7 @@
 /* Model for testing simple SDRAM controller 
- * No interleaving supported, single acive bank at a time
+ * Banks are tracked on their own (open row, tRCD / tRP / tRAS / tRC / tWR, tRRD between banks), interleaving and open page
+ * controllers are accepted, row hit / miss / conflict and bus statistics are dumped on exit
+ * Refresh may be postponed up to s_max_refresh_postpone intervals, not skipped
  * simulation: https://github.com/ZipCPU/xulalx25soc/tree/master/bench/cpp
  * gg: verilator test sdram controller
  * https://www.reddit.com/r/FPGA/comments/a5e3ok/recommend_an_sdram_model_for_verilator/
@@ -9,14 +11,20 @@
 #ifndef SDRAM_H
 #define SDRAM_H
 
+#include <climits>
 #include <cmath>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <memory>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "model.h"
-#include "../debug.h"
+#include "../log.h"
 
 // ==================================================
 template<uint32_t Max>
@@ -57,41 +65,94 @@ template<uint32_t Max>
 struct SelectTypeWidth : SelectInteger_<AlignBitWidth<Max>::value> {};
 
 // ==================================================
-/* Implementation of a SDRAM model based on simple controller for EM638325-6H (SDRAMController.sv)
- * Using the controller state-machine model, forcing certain constraints based on the datasheet
+/* SDRAM geometries, check datasheet. Everything here is needed at compile time for IO types
+ * and address masks, so each part is a trait struct the model is templated over
+ * Only x32 parts for now, the controller / top module data bus is 32 bits
  */
-class SDRAM : public IModel
+// EM638325-6H, 64Mbit (8MB), 4 banks x 2048 rows x 256 columns x 32 bits, on Colorlight-i5
+struct EM638325Geometry
 {
-public:
-    // SDRAM specs, check datasheet. EM638325-6H as example
-    // Size, data & addr bit width
-    // Due to bit width values being needed at compile time, these values must be either static or defined, not object constant
-    // This lead to limited configurability of SDRAM model, but I guess I can just create another class
-    // ==================================================
     // SDRAM size in bit
-    static const uint32_t s_size_bit        = 67108864;
-    static const uint32_t s_size_byte       = s_size_bit / 8; // s_size_bit / 8
+    static const uint32_t size_bit         = 67108864;
     // Number of data line, E.G: DQ0-DQ31 -> 32
-    static const uint8_t  s_data_bit_width  = 32;
-    // Number of "block" in this SDRAM
-    // Each "block" consists of s_data_bit_width bits (or s_data_block_size bytes)
-    static const uint32_t s_n_blocks        = s_size_bit / s_data_bit_width; // s_size_bit / s_data_bit_width
-    static const uint8_t  s_data_block_size = s_data_bit_width / 8; // s_data_bit_width / 8
-    static const uint8_t  s_block_bit_width = 21; // ceil(log2(s_n_blocks))
+    static const uint8_t  data_bit_width   = 32;
     // Number of banks
-    static const uint8_t  s_n_banks         = 4;
+    static const uint8_t  n_banks          = 4;
     // Number of bank addr line, E.G: BA0-BA1 -> 2, or from n banks
-    static const uint8_t  s_bank_bit_width  = 2;  // ceil(log2(s_n_banks))
+    static const uint8_t  bank_bit_width   = 2;
     // Number of data addr line, E.G: A0-A10 -> 11
-    static const uint8_t  s_addr_bit_width  = 11;
+    static const uint8_t  addr_bit_width   = 11;
     // Number of data addr line needed for row, E.G: A0-A10 in BankActive
-    static const uint8_t  s_row_bit_width   = s_addr_bit_width;
+    static const uint8_t  row_bit_width    = 11;
     // Number of data addr line needed for column, E.G: A0-A7 in Read / Write
-    static const uint8_t  s_column_bit_width= 8;// ceil(log2(s_size_bit / s_data_bit_width)) - s_bank_bit_width - s_row_bit_width
-    // Used when read / write entire page, currently not implemented
-    static const uint16_t s_page_size       = 256;
+    static const uint8_t  column_bit_width = 8;
+    static const uint8_t  dqm_bit_width    = 4;
+};
+
+// IS42S32400, 128Mbit (16MB), 4 banks x 4096 rows x 256 columns x 32 bits
+struct IS42S32400Geometry
+{
+    static const uint32_t size_bit         = 134217728;
+    static const uint8_t  data_bit_width   = 32;
+    static const uint8_t  n_banks          = 4;
+    static const uint8_t  bank_bit_width   = 2;
+    static const uint8_t  addr_bit_width   = 12;
+    static const uint8_t  row_bit_width    = 12;
+    static const uint8_t  column_bit_width = 8;
+    static const uint8_t  dqm_bit_width    = 4;
+};
+
+// IS42S32800, 256Mbit (32MB), 4 banks x 4096 rows x 512 columns x 32 bits
+struct IS42S32800Geometry
+{
+    static const uint32_t size_bit         = 268435456;
+    static const uint8_t  data_bit_width   = 32;
+    static const uint8_t  n_banks          = 4;
+    static const uint8_t  bank_bit_width   = 2;
+    static const uint8_t  addr_bit_width   = 12;
+    static const uint8_t  row_bit_width    = 12;
+    static const uint8_t  column_bit_width = 9;
+    static const uint8_t  dqm_bit_width    = 4;
+};
+
+// ==================================================
+/* Implementation of a SDRAM model based on simple controller for EM638325-6H (SDRAMController.sv)
+ * Using the controller state-machine model, forcing certain constraints based on the datasheet
+ * Geometry is one of the trait structs above, SDRAM is the EM638325 one which the board has
+ */
+template<class Geometry>
+class SDRAMModel : public IModel
+{
+public:
+    // Derived from geometry, all compile time so masks / shifts in cycle() fold to constants
+    // ==================================================
+    static const uint32_t s_size_bit        = Geometry::size_bit;
+    static const uint32_t s_size_byte       = s_size_bit / 8;
+    static const uint8_t  s_data_bit_width  = Geometry::data_bit_width;
+    // Number of "block" in this SDRAM
+    // Each "block" consists of s_data_bit_width bits (or s_data_block_size bytes)
+    static const uint32_t s_n_blocks        = s_size_bit / s_data_bit_width;
+    static const uint8_t  s_data_block_size = s_data_bit_width / 8;
+    static const uint8_t  s_n_banks         = Geometry::n_banks;
+    static const uint8_t  s_bank_bit_width  = Geometry::bank_bit_width;
+    static const uint8_t  s_addr_bit_width  = Geometry::addr_bit_width;
+    static const uint8_t  s_row_bit_width   = Geometry::row_bit_width;
+    static const uint8_t  s_column_bit_width= Geometry::column_bit_width;
+    // [bank][row][column]
+    static const uint8_t  s_block_bit_width = s_bank_bit_width + s_row_bit_width + s_column_bit_width;
+    static const uint32_t s_column_mask     = (1u << s_column_bit_width) - 1;
+    // Full page burst length, column wraps around inside the row
+    static const uint16_t s_page_size       = 1u << s_column_bit_width;
     // Currently not implemented
-    static const uint8_t  s_dqm_bit_width   = 4;
+    static const uint8_t  s_dqm_bit_width   = Geometry::dqm_bit_width;
+    static_assert(s_n_blocks == (1u << s_block_bit_width), "SDRAM geometry does not add up to its size");
+    static_assert(s_n_banks == (1u << s_bank_bit_width), "SDRAM bank count does not match bank address width");
+    // IO types
+    typedef typename SelectTypeWidth<s_bank_bit_width>::type  bank_t;
+    typedef typename SelectTypeWidth<s_addr_bit_width>::type  addr_t;
+    typedef typename SelectTypeWidth<s_data_bit_width>::type  data_t;
+    typedef typename SelectTypeWidth<s_dqm_bit_width>::type   dqm_t;
+    typedef typename SelectTypeWidth<s_block_bit_width>::type block_t;
 private:
     // Variables
     // ==================================================
@@ -110,6 +171,10 @@ private:
     double s_t_rp       = 21.0;
     // -- write recovery time
     double s_t_wr       = 14.0;
+    // -- active to precharge delay
+    double s_t_ras      = 42.0;
+    // -- active to active delay, different banks
+    double s_t_rrd      = 14.0;
     // -- average refresh interval
     double s_t_refi     = 15600.0;
     // -- max refresh interval
@@ -125,30 +190,87 @@ private:
     uint32_t s_c_precharge_wait       = ceil(s_t_rp / s_t_clk_period);
     uint32_t s_c_refresh_interval     = floor(s_t_refi / s_t_clk_period);
     uint32_t s_c_max_refresh_interval = floor(s_t_max_refi / s_t_clk_period);
+    uint32_t s_c_ras_wait             = ceil(s_t_ras / s_t_clk_period);
+    uint32_t s_c_wr_wait              = ceil(s_t_wr / s_t_clk_period);
+    uint32_t s_c_rrd_wait             = ceil(s_t_rrd / s_t_clk_period);
+    // Refresh intervals a refresh can be late by, JEDEC
+    static const uint32_t s_max_refresh_postpone = 8;
     // ==================================================
     // Modifiable by using MRS command, these ONLY SERVE AS DEFAULT VALUE
     // CAS latency, use value from others 2=below 133MHz, 3=above 133MHz
     // t[CAC] (min) ≤ CAS Latency * t[CK]
     // t[CAC] is not mentioned anywhere else in the datasheet except this formula
     uint8_t v_cas_latency  = 3;
-    uint8_t v_burst_length = 1; // full page when >8
-    uint8_t v_read_wait    = v_cas_latency + v_burst_length;
-    uint8_t v_write_wait   = ceil((s_t_wr + s_t_rp) / s_t_clk_period) + v_burst_length;
+    uint16_t v_burst_length = 1; // 1, 2, 4, 8 or s_page_size for full page
+    uint8_t  v_write_single = 0; // A9, writes are single location while reads burst
     // ==================================================
     // Backing memory for simulated SDRAM, byte addressible
+    // mmap-ed, anonymous by default: pages are zero and only get real memory on first write,
+    // so a mostly unused 8MB+ part costs close to nothing. Can be swapped for a file mapping
+    static const uint32_t s_backing_page_size = 4096;
     uint8_t *p_v_backing_mem;
+    int backing_fd; // -1 when anonymous
     // ==================================================
-    // State machine
-    enum state_t {INIT_STARTUP_DELAY, INIT_PRECHARGE, INIT_REFRESH1, INIT_REFRESH2, INIT_MRS, 
-                    WORK_IDLE, WORK_ACTIVE, WORK_READ, WORK_WRITE, WORK_REFRESH};
+    // State machine, only used for the power on sequence
+    // Once done every bank is tracked on its own, see BankState
+    enum state_t {INIT_STARTUP_DELAY, INIT_PRECHARGE, INIT_REFRESH1, INIT_REFRESH2, INIT_MRS, WORK};
     uint8_t v_init_refreshed, v_init_MRSed, v_init_done; // flags used during init
     state_t v_state; // Main state machine
-    uint32_t v_wait_timer, v_refresh_timer; // Shared between all banks, no interleaving, counting down
+    uint32_t v_wait_timer, v_refresh_timer; // Init timer & refresh interval, counting down
+    uint32_t v_refresh_debt;                // Refresh intervals gone by without a refresh
     // ==================================================
-    // Saved addrs
-    SelectTypeWidth<s_bank_bit_width>::type  v_bank_addr_active, v_bank_addr_rw; // Bank addr
-    SelectTypeWidth<s_addr_bit_width>::type  v_row_addr, v_col_addr;
-    SelectTypeWidth<s_block_bit_width>::type v_full_addr;
+    // Banks
+    // Cycle stamps instead of count down timers, so idle banks cost nothing per cycle
+    // and timing checks are a subtraction against v_cycle
+    uint64_t v_cycle;           // Posedges since construction
+    uint64_t v_refresh_cycle;   // Last AutoRefresh, all banks busy for tRC after
+    uint64_t v_activate_cycle;  // Last ACTIVE of any bank, tRRD
+    struct BankState {
+        uint8_t  active;                // a row is open
+        uint8_t  row_used;              // open row already served a read / write, next one is a row hit
+        uint8_t  last_row_valid;        // row below is the last one opened, cleared by refresh
+        uint8_t  precharge_pending;     // read / write with auto precharge issued, closes at precharge_cycle
+        uint32_t row;                   // open row, or last open row when closed
+        uint64_t activate_cycle;        // last ACTIVE
+        uint64_t precharge_cycle;       // last (auto) precharge start, tRP counts from here
+        uint64_t write_cycle;           // last write beat, tWR counts from here
+    };
+    BankState v_banks[s_n_banks];
+    // ==================================================
+    // Data bus
+    // Bursts are queued so back to back read / write (seamless bursts, CAS latency overlapping the
+    // previous burst data) work. A new burst cuts queued ones at its first beat, like the datasheet's
+    // read / write interrupt, burst stop cuts everything
+    struct Burst {
+        uint64_t start_cycle;           // cycle of beat 0
+        uint32_t length;                // beats, cut down by interrupts
+        uint32_t wrap;                  // burst length at issue, column wraps inside it
+        uint32_t beat;                  // next beat
+        uint32_t base;                  // block addr of [bank][row][column 0]
+        uint32_t column;                // starting column, wraps inside burst length
+        uint8_t  write;
+        uint8_t  bank;
+        uint8_t  auto_precharge;
+    };
+    static const uint8_t s_burst_queue_size = 4;
+    Burst v_bursts[s_burst_queue_size];
+    uint8_t v_burst_head, v_burst_count;
+    // ==================================================
+    // Statistics, dumped when model is destroyed
+    // row hit     : read / write to a row that is open and already accessed
+    // row miss    : activate to a bank that had no open row since the last refresh
+    // row conflict: activate replacing a different row than the last one opened in the bank
+    // row reopen  : activate of the same row that was just closed, an open page policy would have hit
+    // timing violations are counted instead of asserted so controller experiments can be measured,
+    // protocol errors (read from closed bank...) still abort
+    struct Stats {
+        uint64_t activates, reads, writes, precharges;
+        uint64_t row_hits, row_misses, row_conflicts, row_reopens;
+        uint64_t refreshes, refresh_stall_cycles, max_refresh_debt;
+        uint64_t bus_busy_cycles, work_cycles;
+        uint64_t timing_violations;
+    };
+    Stats v_stats;
     // For checking edge
     uint8_t last_clk;
     // for checking used signal is not null
@@ -156,30 +278,42 @@ private:
     // Funcs
     // ==================================================
     void init(void);
+    void mapBackingMem(int fd, bool shared);
+    void unmapBackingMem(void);
+#ifdef VRLT_SAVABLE
+    bool isBackingPageZero(uint32_t page);
+#endif
     void signalAssertCheck(void);
     void modeRegisterSet(void);
+    void timingCheck(bool ok, const char *what, uint8_t bank);
+    void settleBanks(void);
+    bool banksIdle(void);
+    void pushBurst(uint8_t write, uint8_t bank, uint32_t column, uint32_t length, uint8_t auto_precharge);
+    void cutBursts(uint64_t from_cycle, int bank = -1);
+    void burstCycle(void);
+    void workCycle(void);
     void cycle(void);
 
 public:
     // Give user access to set the IOs
-    uint8_t                                 *i_clk;
-    uint8_t                                 *i_cke;
-    uint8_t                                 *i_cs_n;
-    uint8_t                                 *i_ras_n;
-    uint8_t                                 *i_cas_n;
-    uint8_t                                 *i_we_n;
-	SelectTypeWidth<s_bank_bit_width>::type *i_ba;
-    SelectTypeWidth<s_addr_bit_width>::type *i_addr;
-    SelectTypeWidth<s_data_bit_width>::type *i_data;
-    SelectTypeWidth<s_dqm_bit_width>::type  *i_dqm;
-    SelectTypeWidth<s_data_bit_width>::type *i_dq;
-    SelectTypeWidth<s_data_bit_width>::type *o_data;
-
-    SDRAM(void);
-    SDRAM(
+    uint8_t *i_clk;
+    uint8_t *i_cke;
+    uint8_t *i_cs_n;
+    uint8_t *i_ras_n;
+    uint8_t *i_cas_n;
+    uint8_t *i_we_n;
+    bank_t  *i_ba;
+    addr_t  *i_addr;
+    data_t  *i_data;
+    dqm_t   *i_dqm;
+    data_t  *i_dq;
+    data_t  *o_data;
+
+    SDRAMModel(void);
+    SDRAMModel(
         double  freq_mhz,
         uint8_t cas_latency,
-        uint8_t burst_length = 1,
+        uint16_t burst_length = 1,
         double  t_desl       = 200000.0,
         double  t_mrd        = 14.0,
         double  t_rc         = 63.0,
@@ -187,13 +321,868 @@ public:
         double  t_rp         = 21.0,
         double  t_wr         = 14.0,
         double  t_refi       = 15600.0,
-        double  t_max_refi   = 15625.0
+        double  t_max_refi   = 15625.0,
+        double  t_ras        = 42.0,
+        double  t_rrd        = 14.0
     );
-    ~SDRAM(void);
-    uint8_t get_burst_length(void);
-    void eval(void) override;
+    ~SDRAMModel(void);
+    // Beats per read burst, s_page_size when full page
+    uint16_t get_burst_length(void);
+    // Direct access to backing memory, s_size_byte bytes, block (s_data_block_size bytes) addressed as
+    // [bank][row][column] like the SDRAM sees it
+    uint8_t *getBackingMemPtr(void);
+    // Map backing memory to an image file instead, existing content is discarded
+    // shared: writes go to the file (dump memory with no copy), file is extended to size if shorter
+    // else  : file is only a preload, writes stay in process (copy on write)
+    // Checkpoint restore drops the file mapping, the file is left as it is
+    void setBackingFile(const char *file, bool shared = false);
+    // Print row hit / miss / conflict, refresh and bus statistics, also done on destruction
+    void dumpStats(void);
+    // Timing violations so far, a test passes only at 0
+    uint64_t getTimingViolations(void);
+    // Row hits / activates so far, harness checks the open page policy with them
+    uint64_t getRowHits(void);
+    uint64_t getActivates(void);
+    // Posedges taken so far, skipped ones included
+    uint64_t getCycles(void);
+    // Cycles left of the power on delay, 0 once it ran out
+    uint32_t getStartupWait(void);
+    // Power on sequence done, mode register set
+    bool isInitDone(void);
+    bool eval(void) override;
+    unsigned long long getIdleCycles(void) override;
+    void skipCycles(unsigned long long n_cycles) override;
+#ifdef VRLT_SAVABLE
+    void save(VerilatedSave &os) override;
+    void restore(VerilatedRestore &is) override;
+#endif
     bool operator< (const IModel& comp) const override;
     bool operator== (const IModel& comp) const override;
 };
 
+// g++ template function not in object file, same as module.h, keep implementation here
+// ==================================================
+
+template<class Geometry>
+void SDRAMModel<Geometry>::init(void)
+{
+    // Allocate memory, lazily
+    p_v_backing_mem = nullptr;
+    backing_fd = -1;
+    mapBackingMem(-1, false);
+    // State machine init
+    v_state = INIT_STARTUP_DELAY;
+    // State machine flags
+    v_init_done      = 0;
+    v_init_refreshed = 0;
+    v_init_MRSed     = 0;
+    // Timer
+    v_wait_timer     = s_c_init_wait;
+    v_refresh_timer  = s_c_max_refresh_interval;
+    v_refresh_debt   = 0;
+    // Banks, all precharged. Power on sequence is longer than any bank timing so zero stamps are fine
+    v_cycle = 0;
+    v_refresh_cycle = 0;
+    v_activate_cycle = 0;
+    memset(v_banks, 0, sizeof(v_banks));
+    memset(v_bursts, 0, sizeof(v_bursts));
+    v_burst_head  = 0;
+    v_burst_count = 0;
+    memset(&v_stats, 0, sizeof(v_stats));
+    // IOs - all to null, user must set them all before eval else crash lol
+    i_clk = nullptr;
+    i_cke = nullptr;
+    i_cs_n = nullptr;
+    i_ras_n = nullptr;
+    i_cas_n = nullptr;
+    i_we_n = nullptr;
+    i_ba = nullptr;
+    i_addr = nullptr;
+    i_data = nullptr;
+    i_dqm = nullptr;
+    i_dq = nullptr;
+    o_data = nullptr;
+    // Flags
+    last_clk = 0;
+    signal_asserted = 0;
+}
+
+template<class Geometry>
+SDRAMModel<Geometry>::SDRAMModel(void)
+{
+    // Unparameterized constructor, see default values in h file
+    init();
+}
+
+template<class Geometry>
+SDRAMModel<Geometry>::SDRAMModel(
+    double  freq_mhz,
+    uint8_t cas_latency,
+    uint16_t burst_length,
+    double  t_desl,
+    double  t_mrd,
+    double  t_rc,
+    double  t_rcd,
+    double  t_rp,
+    double  t_wr,
+    double  t_refi,
+    double  t_max_refi,
+    double  t_ras,
+    double  t_rrd
+)
+{
+    // Set new values
+    this->s_freq_mhz     = freq_mhz;
+    this->v_cas_latency  = cas_latency;
+    this->v_burst_length = burst_length;
+    this->s_t_desl       = t_desl;
+    this->s_t_mrd        = t_mrd;
+    this->s_t_rc         = t_rc;
+    this->s_t_rcd        = t_rcd;
+    this->s_t_rp         = t_rp;
+    this->s_t_wr         = t_wr;
+    this->s_t_refi       = t_refi;
+    this->s_t_max_refi   = t_max_refi;
+    this->s_t_ras        = t_ras;
+    this->s_t_rrd        = t_rrd;
+    // Recalculate
+    this->s_t_clk_period           = (1000.0 / s_freq_mhz);
+    this->s_c_init_wait            = ceil(s_t_desl / s_t_clk_period);
+    this->s_c_load_mode_wait       = ceil(s_t_mrd / s_t_clk_period);
+    this->s_c_active_wait          = ceil(s_t_rcd / s_t_clk_period);
+    this->s_c_refresh_wait         = ceil(s_t_rc / s_t_clk_period);
+    this->s_c_precharge_wait       = ceil(s_t_rp / s_t_clk_period);
+    this->s_c_refresh_interval     = floor(s_t_refi / s_t_clk_period);
+    this->s_c_max_refresh_interval = floor(s_t_max_refi / s_t_clk_period);
+    this->s_c_ras_wait             = ceil(s_t_ras / s_t_clk_period);
+    this->s_c_wr_wait              = ceil(s_t_wr / s_t_clk_period);
+    this->s_c_rrd_wait             = ceil(s_t_rrd / s_t_clk_period);
+    //
+    init();
+}
+
+template<class Geometry>
+SDRAMModel<Geometry>::~SDRAMModel(void)
+{
+    if (v_init_done)
+        dumpStats();
+    unmapBackingMem();
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::mapBackingMem(int fd, bool shared)
+{
+    void *p_mem;
+    if (fd < 0)
+        // NORESERVE: do not count 8MB+ against commit limit for pages never written
+        p_mem = mmap(nullptr, s_size_byte, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    else
+        p_mem = mmap(nullptr, s_size_byte, PROT_READ | PROT_WRITE, (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_NORESERVE, fd, 0);
+    if (p_mem == MAP_FAILED) {
+        LOG_ERROR(LOG_SDRAM, "SDRAM backing memory mmap failed. Aborting.");
+        abort();
+    }
+    p_v_backing_mem = (uint8_t *)p_mem;
+    backing_fd = fd;
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::unmapBackingMem(void)
+{
+    if (p_v_backing_mem) {
+        munmap(p_v_backing_mem, s_size_byte);
+        p_v_backing_mem = nullptr;
+    }
+    if (backing_fd >= 0) {
+        close(backing_fd);
+        backing_fd = -1;
+    }
+}
+
+template<class Geometry>
+uint8_t *SDRAMModel<Geometry>::getBackingMemPtr(void)
+{
+    return p_v_backing_mem;
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::setBackingFile(const char *file, bool shared)
+{
+    int fd = open(file, shared ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if (fd < 0) {
+        LOG_ERROR(LOG_SDRAM, "Could not open SDRAM image %s. Aborting.", file);
+        abort();
+    }
+    struct stat st;
+    fstat(fd, &st);
+    if ((uint64_t)st.st_size < s_size_byte) {
+        if (shared) {
+            // Extended part reads as zero
+            if (ftruncate(fd, s_size_byte)) {
+                LOG_ERROR(LOG_SDRAM, "Could not resize SDRAM image %s. Aborting.", file);
+                abort();
+            }
+        }
+        else {
+            // Mapping past end of file SIGBUS-es, preload the short image into anonymous memory instead
+            LOG_INFO(LOG_SDRAM, "SDRAM image %s is %lld bytes, smaller than %u, copying", file, (long long)st.st_size, s_size_byte);
+            unmapBackingMem();
+            mapBackingMem(-1, false);
+            ssize_t n_read = read(fd, p_v_backing_mem, st.st_size);
+            close(fd);
+            assert(n_read == st.st_size);
+            return;
+        }
+    }
+    unmapBackingMem();
+    mapBackingMem(fd, shared);
+    LOG_INFO(LOG_SDRAM, "SDRAM backing memory mapped to %s (%s)", file, shared ? "shared" : "private");
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::signalAssertCheck(void)
+{
+    assert(i_clk   != nullptr);
+    assert(i_cke   != nullptr);
+    assert(i_cs_n  != nullptr);
+    assert(i_ras_n != nullptr);
+    assert(i_cas_n != nullptr);
+    assert(i_we_n  != nullptr);
+    assert(i_ba    != nullptr);
+    assert(i_addr  != nullptr);
+    assert(i_data  != nullptr);
+    assert(o_data  != nullptr);
+    this->signal_asserted = 1;
+}
+
+template<class Geometry>
+uint16_t SDRAMModel<Geometry>::get_burst_length(void)
+{
+    return this->v_burst_length;
+}
+
+template<class Geometry>
+bool SDRAMModel<Geometry>::eval(void)
+{
+    bool changed = false;
+    if (!this->signal_asserted)
+        this->signalAssertCheck();
+    // posedge
+    if (this->last_clk == 0 && *this->i_clk == 1) {
+        // o_data is the only output, only read path writes it
+        data_t last_data = *this->o_data;
+        this->cycle();
+        changed = (*this->o_data != last_data);
+    }
+    this->last_clk = *this->i_clk;
+    return changed;
+}
+
+
+// Idle = only counting down timers
+// Which is most of the time: 200us startup delay, waiting for tRC / tRP..., and idle between refreshes
+// Bank timings are stamps, they do not need to be stepped, only data bursts do
+template<class Geometry>
+unsigned long long SDRAMModel<Geometry>::getIdleCycles(void)
+{
+    if (!this->signal_asserted)
+        return 0;
+    // Only NOP / deselect keep the model idle, inputs are assumed to stay during the skip
+    if (!*this->i_cke)
+        return 0;
+    if (!*this->i_cs_n && !((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)))
+        return 0;
+    unsigned long long n_cycles;
+    switch (v_state) {
+        // Waiting for a command, timer just stays at 0 once done
+        case INIT_STARTUP_DELAY: {
+            n_cycles = ULLONG_MAX;
+            break;
+        }
+        // Leave the cycle where timer hits 0 to cycle(), state can change there
+        case INIT_PRECHARGE:
+        case INIT_REFRESH1:
+        case INIT_REFRESH2:
+        case INIT_MRS: {
+            n_cycles = (v_wait_timer > 1) ? v_wait_timer - 1 : 0;
+            break;
+        }
+        // Moving data if any burst is queued
+        default: {
+            n_cycles = v_burst_count ? 0 : ULLONG_MAX;
+        }
+    }
+    // Refresh interval must not run out during the skip, cycle() books it as debt
+    if (v_init_done) {
+        unsigned long long refresh_cycles = (v_refresh_timer > 1) ? v_refresh_timer - 1 : 0;
+        if (refresh_cycles < n_cycles)
+            n_cycles = refresh_cycles;
+    }
+    return n_cycles;
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::skipCycles(unsigned long long n_cycles)
+{
+    if (!n_cycles)
+        return;
+    assert(n_cycles <= this->getIdleCycles());
+    v_wait_timer = (v_wait_timer > n_cycles) ? v_wait_timer - n_cycles : 0;
+    v_cycle += n_cycles;
+    if (v_init_done) {
+        v_refresh_timer -= n_cycles;
+        v_stats.work_cycles += n_cycles;
+    }
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::dumpStats(void)
+{
+    uint64_t accesses = v_stats.reads + v_stats.writes;
+    LOG_INFO(LOG_SDRAM, "SDRAM STATISTICS:"
+            "\n\tCycles (after init): %llu"
+            "\n\tActivates          : %llu"
+            "\n\tReads / Writes     : %llu / %llu"
+            "\n\tPrecharges         : %llu (explicit)",
+            (unsigned long long)v_stats.work_cycles, (unsigned long long)v_stats.activates,
+            (unsigned long long)v_stats.reads, (unsigned long long)v_stats.writes,
+            (unsigned long long)v_stats.precharges
+        );
+    LOG_INFO(LOG_SDRAM, "SDRAM ROW STATISTICS:"
+            "\n\tRow hits     : %llu (%.2f%% of accesses)"
+            "\n\tRow misses   : %llu"
+            "\n\tRow conflicts: %llu"
+            "\n\tRow reopens  : %llu (would hit with open page)",
+            (unsigned long long)v_stats.row_hits, accesses ? (100.0 * v_stats.row_hits / accesses) : 0.0,
+            (unsigned long long)v_stats.row_misses, (unsigned long long)v_stats.row_conflicts,
+            (unsigned long long)v_stats.row_reopens
+        );
+    LOG_INFO(LOG_SDRAM, "SDRAM BUS STATISTICS:"
+            "\n\tRefreshes        : %llu, stalled %llu cycles, postponed up to %llu"
+            "\n\tBus busy cycles  : %llu (%.2f%%)"
+            "\n\tTiming violations: %llu",
+            (unsigned long long)v_stats.refreshes, (unsigned long long)v_stats.refresh_stall_cycles,
+            (unsigned long long)v_stats.max_refresh_debt,
+            (unsigned long long)v_stats.bus_busy_cycles,
+            v_stats.work_cycles ? (100.0 * v_stats.bus_busy_cycles / v_stats.work_cycles) : 0.0,
+            (unsigned long long)v_stats.timing_violations
+        );
+}
+
+#ifdef VRLT_SAVABLE
+template<class Geometry>
+bool SDRAMModel<Geometry>::isBackingPageZero(uint32_t page)
+{
+    const uint64_t *p_words = (const uint64_t *)(p_v_backing_mem + (uint64_t)page * s_backing_page_size);
+    for (uint32_t i = 0; i < s_backing_page_size / sizeof(uint64_t); i++)
+        if (p_words[i]) return false;
+    return true;
+}
+
+// Timings come from constructor, only save them to check against on restore
+// Banks, bursts and stats are plain structs, written as is
+template<class Geometry>
+void SDRAMModel<Geometry>::save(VerilatedSave &os)
+{
+    uint32_t size_byte = s_size_byte;
+    double   freq_mhz  = s_freq_mhz;
+    uint8_t  state     = v_state;
+    os << size_byte << freq_mhz;
+    os << v_cas_latency << v_burst_length << v_write_single;
+    os << v_init_refreshed << v_init_MRSed << v_init_done << state;
+    os << v_wait_timer << v_refresh_timer << v_refresh_debt;
+    os << v_cycle << v_refresh_cycle << v_activate_cycle;
+    os.write(v_banks, sizeof(v_banks));
+    os.write(v_bursts, sizeof(v_bursts));
+    os << v_burst_head << v_burst_count;
+    os.write(&v_stats, sizeof(v_stats));
+    os << last_clk;
+    // Sparse, only pages with data: count, then (page index, page) pairs
+    // reading untouched pages maps the shared zero page, does not allocate
+    uint32_t n_pages = 0;
+    for (uint32_t p = 0; p < s_size_byte / s_backing_page_size; p++)
+        if (!isBackingPageZero(p)) n_pages++;
+    os << n_pages;
+    for (uint32_t p = 0; p < s_size_byte / s_backing_page_size; p++) {
+        if (!isBackingPageZero(p)) {
+            os << p;
+            os.write(p_v_backing_mem + (uint64_t)p * s_backing_page_size, s_backing_page_size);
+        }
+    }
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::restore(VerilatedRestore &is)
+{
+    uint32_t size_byte;
+    double   freq_mhz;
+    uint8_t  state;
+    is >> size_byte >> freq_mhz;
+    if ((size_byte != s_size_byte) || (freq_mhz != s_freq_mhz)) {
+        LOG_ERROR(LOG_SDRAM, "SDRAM checkpoint mismatch: %u bytes @ %.2f MHz, expected %u bytes @ %.2f MHz",
+            size_byte, freq_mhz, s_size_byte, s_freq_mhz);
+        abort();
+    }
+    is >> v_cas_latency >> v_burst_length >> v_write_single;
+    is >> v_init_refreshed >> v_init_MRSed >> v_init_done >> state;
+    is >> v_wait_timer >> v_refresh_timer >> v_refresh_debt;
+    is >> v_cycle >> v_refresh_cycle >> v_activate_cycle;
+    is.read(v_banks, sizeof(v_banks));
+    is.read(v_bursts, sizeof(v_bursts));
+    is >> v_burst_head >> v_burst_count;
+    is.read(&v_stats, sizeof(v_stats));
+    is >> last_clk;
+    // Checkpoint holds every page with data, start from fresh anonymous memory. Clearing a file mapping
+    // in place would wipe a shared image file (setBackingFile), so that mapping is dropped
+    if (backing_fd >= 0)
+        LOG_INFO(LOG_SDRAM, "SDRAM checkpoint restore, backing memory no longer mapped to its image file");
+    unmapBackingMem();
+    mapBackingMem(-1, false);
+    uint32_t n_pages;
+    is >> n_pages;
+    for (uint32_t i = 0; i < n_pages; i++) {
+        uint32_t p;
+        is >> p;
+        assert(p < s_size_byte / s_backing_page_size);
+        is.read(p_v_backing_mem + (uint64_t)p * s_backing_page_size, s_backing_page_size);
+    }
+    v_state = (state_t)state;
+}
+#endif
+
+template<class Geometry>
+bool SDRAMModel<Geometry>::operator< (const IModel& comp) const
+{
+    return (this < &comp);
+}
+
+template<class Geometry>
+bool SDRAMModel<Geometry>::operator== (const IModel& comp) const
+{
+    return (this == &comp);
+}
+
+// Mode register set
+// BA0-1: Reserved
+// A10: Reserved
+// A9: Write burst length 0: burst, 1: single bit
+// A8-7: Test mode : 00: normal
+// A6-4: CAS latency: 010: 2, 011: 3
+// A3: BT: 0: sequential, 1: interleave
+// A2-0: Burst length: 32bits multiple
+//       000: 1
+//       001: 2
+//       010: 4
+//       011: 8
+//       111: Full Page (Sequential)
+template<class Geometry>
+void SDRAMModel<Geometry>::modeRegisterSet(void)
+{
+    v_cas_latency  = (*this->i_addr & 0x70) >> 4;
+    v_write_single = (*this->i_addr >> 9) & 0x1;
+    switch (*this->i_addr & 0x7) {
+        case 0: v_burst_length = 1; break;
+        case 1: v_burst_length = 2; break;
+        case 2: v_burst_length = 4; break;
+        case 3: v_burst_length = 8; break;
+        case 7: v_burst_length = s_page_size; break;
+        default: {
+            LOG_ERROR(LOG_SDRAM, "SDRAM MODE REGISTER SET: reserved burst length 0x%X. Aborting.", *this->i_addr & 0x7);
+            abort();
+        }
+    }
+    assert(!(*this->i_addr & 0x8)); // interleave unsupported
+    assert((v_cas_latency == 2) || (v_cas_latency == 3));
+    LOG_DEBUG(LOG_SDRAM, "SDRAM MODE REGISTER SET:"
+            "\n\tValue: 0x%08X"
+            "\n\tCas latency : %d"
+            "\n\tBurst length: %d%s"
+            "\n\tWrite burst : %s",
+            *this->i_addr, v_cas_latency, v_burst_length, (v_burst_length == s_page_size) ? " (full page)" : "",
+            v_write_single ? "single" : "burst"
+        );
+}
+
+template<class Geometry>
+uint64_t SDRAMModel<Geometry>::getTimingViolations(void)
+{
+    return v_stats.timing_violations;
+}
+
+template<class Geometry>
+uint64_t SDRAMModel<Geometry>::getRowHits(void)
+{
+    return v_stats.row_hits;
+}
+
+template<class Geometry>
+uint64_t SDRAMModel<Geometry>::getActivates(void)
+{
+    return v_stats.activates;
+}
+
+template<class Geometry>
+uint64_t SDRAMModel<Geometry>::getCycles(void)
+{
+    return v_cycle;
+}
+
+template<class Geometry>
+uint32_t SDRAMModel<Geometry>::getStartupWait(void)
+{
+    return (v_state == INIT_STARTUP_DELAY) ? v_wait_timer : 0;
+}
+
+template<class Geometry>
+bool SDRAMModel<Geometry>::isInitDone(void)
+{
+    return v_init_done;
+}
+
+template<class Geometry>
+void SDRAMModel<Geometry>::timingCheck(bool ok, const char *what, uint8_t bank)
+{
+    if (ok)
+        return;
+    v_stats.timing_violations++;
+    LOG_WARN(LOG_SDRAM, "SDRAM TIMING VIOLATION: %s, bank %d @ cycle %llu", what, bank, (unsigned long long)v_cycle);
+}
+
+// Auto precharge closes the bank on its own, apply it once its time has come
+template<class Geometry>
+void SDRAMModel<Geometry>::settleBanks(void)
+{
+    for (uint8_t b = 0; b < s_n_banks; b++) {
+        BankState &bank = v_banks[b];
+        if (bank.precharge_pending && (v_cycle >= bank.precharge_cycle)) {
+            bank.precharge_pending = 0;
+            bank.active = 0;
+        }
+    }
+}
+
+// All banks precharged and done with tRP, required by refresh and MRS
+template<class Geometry>
+bool SDRAMModel<Geometry>::banksIdle(void)
+{
+    for (uint8_t b = 0; b < s_n_banks; b++) {
+        const BankState &bank = v_banks[b];
+        if (bank.active || bank.precharge_pending)
+            return false;
+        if (v_cycle < bank.precharge_cycle + s_c_precharge_wait)
+            return false;
+    }
+    return true;
+}
+
+// Queue a burst for the read / write issued this cycle
+// Read data comes out CAS latency later, write data is taken from this cycle
+// Full page burst runs until cut (burst stop, precharge, another read / write), length is maxed
+template<class Geometry>
+void SDRAMModel<Geometry>::pushBurst(uint8_t write, uint8_t bank, uint32_t column, uint32_t length, uint8_t auto_precharge)
+{
+    Burst burst;
+    burst.start_cycle    = write ? v_cycle : v_cycle + v_cas_latency;
+    burst.length         = (length == s_page_size) ? UINT32_MAX : length;
+    burst.wrap           = length;
+    burst.beat           = 0;
+    burst.base           = ((uint32_t)bank << (s_row_bit_width + s_column_bit_width)) +
+                            (v_banks[bank].row << s_column_bit_width);
+    burst.column         = column;
+    burst.write          = write;
+    burst.bank           = bank;
+    burst.auto_precharge = auto_precharge;
+    // Bursts wrap inside the row, never cross it
+    assert(column < s_page_size);
+    // DQM is not driven, a write cutting into read data would fight the part on dq
+    if (write) {
+        for (uint8_t i = 0; i < v_burst_count; i++) {
+            const Burst &queued = v_bursts[(v_burst_head + i) % s_burst_queue_size];
+            if (!queued.write && (queued.beat < queued.length)) // read beats left, from this cycle on
+                timingCheck(false, "read -> write turnaround", bank);
+        }
+    }
+    // Interrupt whatever still has beats from here on
+    cutBursts(burst.start_cycle);
+    assert(v_burst_count < s_burst_queue_size);
+    v_bursts[(v_burst_head + v_burst_count) % s_burst_queue_size] = burst;
+    v_burst_count++;
+}
+
+// Drop every queued beat at or after from_cycle, of one bank only if bank >= 0
+template<class Geometry>
+void SDRAMModel<Geometry>::cutBursts(uint64_t from_cycle, int bank)
+{
+    for (uint8_t i = 0; i < v_burst_count; i++) {
+        Burst &burst = v_bursts[(v_burst_head + i) % s_burst_queue_size];
+        if ((bank >= 0) && (burst.bank != bank))
+            continue;
+        uint32_t length = (from_cycle > burst.start_cycle) ? (uint32_t)(from_cycle - burst.start_cycle) : 0;
+        if (length < burst.length) {
+            // Auto precharge burst cannot be interrupted
+            assert(!burst.auto_precharge);
+            burst.length = length;
+        }
+    }
+}
+
+// Move the beat of this cycle, if any
+template<class Geometry>
+void SDRAMModel<Geometry>::burstCycle(void)
+{
+    // Drop finished ones
+    while (v_burst_count && (v_bursts[v_burst_head].beat >= v_bursts[v_burst_head].length)) {
+        v_burst_head = (v_burst_head + 1) % s_burst_queue_size;
+        v_burst_count--;
+    }
+    if (!v_burst_count)
+        return;
+    Burst &burst = v_bursts[v_burst_head];
+    if (burst.start_cycle + burst.beat != v_cycle)
+        return;
+    // Sequential, wraps inside the burst length aligned block
+    uint32_t column = (burst.column - (burst.column % burst.wrap)) + ((burst.column + burst.beat) % burst.wrap);
+    uint32_t block  = burst.base + column;
+    if (burst.write) {
+        LOG_TRACE(LOG_SDRAM, "SDRAM WRITE: Writing block #%d with \"%.4s\", size %ld bytes",
+            block, (char*)this->i_data, sizeof(*this->i_data));
+        ((data_t *)p_v_backing_mem)[block] = *this->i_data;
+        v_banks[burst.bank].write_cycle = v_cycle;
+    }
+    else {
+        *this->o_data = ((data_t *)p_v_backing_mem)[block];
+        LOG_TRACE(LOG_SDRAM, "SDRAM READ: Reading block #%d results \"%.4s\", size %ld bytes",
+            block, (char*)this->o_data, sizeof(*this->o_data));
+    }
+    burst.beat++;
+    v_stats.bus_busy_cycles++;
+}
+
+// Work mode, every bank on its own
+// Protocol errors abort, timing errors are counted (see timingCheck)
+template<class Geometry>
+void SDRAMModel<Geometry>::workCycle(void)
+{
+    v_stats.work_cycles++;
+    settleBanks();
+    bool nop = (*this->i_cs_n) || ((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n));
+    if (!nop) {
+        uint8_t b = *this->i_ba;
+        BankState &bank = v_banks[b];
+        bool refreshing = (v_cycle < v_refresh_cycle + s_c_refresh_wait);
+        if ((!*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)) { // BankActive
+            assert(!bank.active && !bank.precharge_pending);
+            assert(!refreshing);
+            timingCheck(v_cycle >= bank.precharge_cycle + s_c_precharge_wait, "tRP", b);
+            timingCheck(v_cycle >= bank.activate_cycle + s_c_refresh_wait, "tRC", b);
+            timingCheck(v_cycle >= v_activate_cycle + s_c_rrd_wait, "tRRD", b);
+            uint32_t row = *this->i_addr;
+            if (!bank.last_row_valid)
+                v_stats.row_misses++;
+            else if (bank.row != row)
+                v_stats.row_conflicts++;
+            else
+                v_stats.row_reopens++;
+            v_stats.activates++;
+            bank.active         = 1;
+            bank.row_used       = 0;
+            bank.last_row_valid = 1;
+            bank.row            = row;
+            bank.activate_cycle = v_cycle;
+            v_activate_cycle    = v_cycle;
+        }
+        else if ((*this->i_ras_n) && (!*this->i_cas_n)) { // READ / WRITE
+            uint8_t write = !*this->i_we_n;
+            uint8_t auto_precharge = (*this->i_addr & 0x400) ? 1 : 0;
+            assert(bank.active && !bank.precharge_pending);
+            timingCheck(v_cycle >= bank.activate_cycle + s_c_active_wait, "tRCD", b);
+            if (bank.row_used)
+                v_stats.row_hits++;
+            bank.row_used = 1;
+            if (write) v_stats.writes++;
+            else v_stats.reads++;
+            uint32_t length = (write && v_write_single) ? 1 : v_burst_length;
+            // No auto precharge in full page mode, burst has no end
+            assert(!(auto_precharge && (length == s_page_size)));
+            pushBurst(write, b, *this->i_addr & s_column_mask, length, auto_precharge);
+            if (auto_precharge) {
+                // Precharge starts after the last read beat is out of the array / write recovery after the last beat,
+                // but never before tRAS
+                uint64_t start = write ? v_cycle + length - 1 + s_c_wr_wait : v_cycle + length;
+                if (start < bank.activate_cycle + s_c_ras_wait)
+                    start = bank.activate_cycle + s_c_ras_wait;
+                bank.precharge_pending = 1;
+                bank.precharge_cycle   = start;
+            }
+        }
+        else if ((!*this->i_ras_n) && (*this->i_cas_n) && (!*this->i_we_n)) { // Precharge
+            uint8_t all = (*this->i_addr & 0x400) ? 1 : 0;
+            for (uint8_t i = 0; i < s_n_banks; i++) {
+                if (!all && (i != b))
+                    continue;
+                BankState &target = v_banks[i];
+                // Precharging a bank with auto precharge in flight is illegal, idle bank is a NOP
+                assert(!target.precharge_pending);
+                if (!target.active)
+                    continue;
+                timingCheck(v_cycle >= target.activate_cycle + s_c_ras_wait, "tRAS", i);
+                timingCheck(v_cycle >= target.write_cycle + s_c_wr_wait, "tWR", i);
+                // Precharge also ends a running burst of the bank (E.G. full page), read data after CAS latency
+                cutBursts(v_cycle + v_cas_latency, i);
+                target.active          = 0;
+                target.precharge_cycle = v_cycle;
+                v_stats.precharges++;
+            }
+        }
+        else if ((!*this->i_ras_n) && (!*this->i_cas_n) && (*this->i_we_n)) { // AutoRefresh
+            assert(banksIdle());
+            timingCheck(!refreshing, "tRC (refresh)", b);
+            v_refresh_cycle = v_cycle;
+            // Pays back one late interval, early ones are not banked
+            if (v_refresh_debt)
+                v_refresh_debt--;
+            // Rows are all closed, next access to each bank is a miss
+            for (uint8_t i = 0; i < s_n_banks; i++)
+                v_banks[i].last_row_valid = 0;
+            v_stats.refreshes++;
+            v_stats.refresh_stall_cycles += s_c_refresh_wait;
+        }
+        else if ((!*this->i_ras_n) && (!*this->i_cas_n) && (!*this->i_we_n)) { // MRS
+            assert(banksIdle() && !refreshing && !v_burst_count);
+            modeRegisterSet();
+        }
+        else { // Burst stop, cuts the last burst: read data stops after CAS latency, write data right away
+            if (v_burst_count) {
+                const Burst &burst = v_bursts[(v_burst_head + v_burst_count - 1) % s_burst_queue_size];
+                cutBursts(burst.write ? v_cycle : v_cycle + v_cas_latency);
+            }
+        }
+    }
+    // Data beat of this cycle, after commands so a write issued now lands its first beat now
+    burstCycle();
+}
+
+// Call every tick, after main verilator eval
+template<class Geometry>
+void SDRAMModel<Geometry>::cycle(void)
+{
+    assert(*this->i_cke);
+    v_cycle++;
+    if (v_wait_timer > 0) v_wait_timer--;
+    // Watch refresh counter after init done, abort if not getting refreshed
+    if (v_init_done && (--v_refresh_timer == 0)) {
+        v_refresh_timer = s_c_max_refresh_interval;
+        v_refresh_debt++;
+        if (v_refresh_debt > v_stats.max_refresh_debt)
+            v_stats.max_refresh_debt = v_refresh_debt;
+        assert(v_refresh_debt <= s_max_refresh_postpone);
+    }
+    if (v_state == WORK) {
+        workCycle();
+        return;
+    }
+    if (!*this->i_cs_n) {
+        switch (v_state) {
+            case INIT_STARTUP_DELAY: {
+                if (!v_wait_timer) {
+                    if ((!*this->i_ras_n) && (*this->i_cas_n) && (!*this->i_we_n) && (*this->i_addr & 0x400)) {  // Precharge all
+                        v_state = INIT_PRECHARGE;
+                        v_wait_timer = s_c_precharge_wait;
+                    }
+                    else {
+                        assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                    }
+                }
+                break;
+            }
+            case INIT_PRECHARGE: {
+                if (!v_wait_timer) {
+                    // Either refresh or mode register set
+                    if ((!*this->i_ras_n) && (!*this->i_cas_n) && (*this->i_we_n)) { // Auto refresh
+                        v_state = INIT_REFRESH1;
+                        v_wait_timer = s_c_refresh_wait;
+                    }
+                    else if ((!*this->i_ras_n) && (!*this->i_cas_n) && (!*this->i_we_n)) { // MRS
+                        modeRegisterSet();
+                        v_state = INIT_MRS;
+                        v_wait_timer = s_c_load_mode_wait;
+                    }
+                    else {
+                       assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                    }
+                }
+                else {
+                    assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                }
+                break;
+            }
+            case INIT_REFRESH1: {
+                if (!v_wait_timer && ((!*this->i_ras_n) && (!*this->i_cas_n) && (*this->i_we_n))) {
+                    v_state = INIT_REFRESH2;
+                    v_wait_timer = s_c_refresh_wait;
+                }
+                else {
+                    assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                }
+                break;
+            }
+            case INIT_REFRESH2: {
+                if (!v_wait_timer) {
+                    v_init_refreshed = 1;
+                    if (v_init_MRSed) {
+                        // Change to new work state
+                        v_state = WORK;
+                        v_refresh_timer = s_c_max_refresh_interval; // also set in constructor
+                        v_init_done = 1;
+                        LOG_INFO(LOG_SDRAM, "SDRAM STARTUP COMPLETE!");
+                    }
+                    else if ((!*this->i_ras_n) && (!*this->i_cas_n) && (!*this->i_we_n)) { //MRS
+                        modeRegisterSet();
+                        v_state = INIT_MRS;
+                        v_wait_timer = s_c_load_mode_wait;
+                    }
+                    else {
+                        assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                    }
+                }
+                else {
+                    assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                }
+                break;
+            }
+            case INIT_MRS: {
+                if (!v_wait_timer) {
+                    v_init_MRSed = 1;
+                    if (v_init_refreshed) {
+                        // Change to new work state
+                        v_state = WORK;
+                        // Set here because refresh timer should be full after init done
+                        v_refresh_timer = s_c_max_refresh_interval; // also set in constructor
+                        v_init_done = 1;
+                        LOG_INFO(LOG_SDRAM, "SDRAM STARTUP COMPLETE!");
+                    }
+                    else if ((!*this->i_ras_n) && (!*this->i_cas_n) && (*this->i_we_n)) { // Auto refresh
+                        v_state = INIT_REFRESH1;
+                        v_wait_timer = s_c_refresh_wait;
+                    }
+                    else {
+                        assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                    }
+                }
+                else {
+                    assert((*this->i_ras_n) && (*this->i_cas_n) && (*this->i_we_n)); // NOP
+                }
+                break;
+            }
+            default: {
+                abort();
+            }
+        }
+    }
+}
+
+// ==================================================
+// The part on the board
+typedef SDRAMModel<EM638325Geometry> SDRAM;
+
 #endif
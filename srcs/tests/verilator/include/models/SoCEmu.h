@@ -0,0 +1,225 @@
+/* Functional model of the whole SoC around the RV32I ISS, no verilator, for firmware bring-up (tools/socemu)
+ * Memory map from config.h / addr.h:
+ *  - ROM  @ ROM_START_ADDR, read only
+ *  - RAM  @ RAM_START_ADDR, RAM_SIZE (BRAM or SDRAM build)
+ *  - HDMI @ 0x40000000, 1 bpp 640x480 framebuffer + status regs. Mapped even when HDMI_EN is off in the RTL
+ *  - GPIO @ GPIO_START_ADDR, in / out regs with the GPIOWB byte order
+ *  - Perf counters @ PERF_START_ADDR
+ * Time: CPI 1 at SOCEMU_CPU_MHZ, cycles = instrs. Only the HDMI status regs and the perf counters look at it
+ */
+
+#ifndef SOCEMU_H
+#define SOCEMU_H
+
+#include <cstdint>
+#include <cstdio>
+
+#include "../config.h"
+#include "../log.h"
+#include "../memImage.h"
+#include "RV32ISim.h"
+
+// Board CPU clock (Top.sv), pixel clock is 25 MHz
+#define SOCEMU_CPU_MHZ       40
+#define SOCEMU_PIXEL_MHZ     25
+// HDMIController480pWB, HDMISigGen 640x480p60 timings
+#define SOCEMU_HDMI_START_ADDR 0x40000000
+#define SOCEMU_HDMI_FB_SIZE    38400 // 640 * 480 / 8
+#define SOCEMU_HDMI_H_RES      640
+#define SOCEMU_HDMI_V_RES      480
+#define SOCEMU_HDMI_H_TOTAL    800   // 16 + 96 + 48 blanking
+#define SOCEMU_HDMI_V_TOTAL    525   // 10 + 2 + 33 blanking
+
+class SoCEmu : public IMMIO
+{
+private:
+    RV32ISim *p_iss;
+    uint8_t  *p_fb;
+    // GPIOWB byte regs, pins = {reg[3], reg[2], reg[1], reg[0]}, word access reg[0] = data[31:24]
+    uint8_t  gpio_in[4];
+    uint8_t  gpio_out[4];
+    bool     perf_run;
+    uint32_t perf_count;   // at the last ctrl write
+    uint64_t perf_start;   // instret at the last ctrl write
+
+    uint32_t perfCount();
+    void hdmiPosition(int &sx, int &sy);
+    uint32_t hdmiStatus();
+    uint32_t gpioRead(const uint8_t *p_regs, unsigned int offset, unsigned int size);
+
+public:
+    SoCEmu();
+    ~SoCEmu();
+    bool loadImage(const MemImage &image);
+    // Until max_instrs or the ISS stops (hang loop, fault...)
+    RV32ISim::Status run(uint64_t max_instrs);
+    RV32ISim *getISSPtr() { return p_iss; }
+    void setGPIOIn(uint32_t pins);
+    uint32_t getGPIOOut();
+    // 1 bpp binary PBM, pixel x = bit x % 8 of byte x / 8 (HDMIController480pWB shifts words out LSB first)
+    bool dumpFramebuffer(const char *p_file);
+
+    uint32_t read(uint32_t addr, unsigned int size);
+    void write(uint32_t addr, unsigned int size, uint32_t data);
+};
+
+// ==================================================
+
+inline SoCEmu::SoCEmu()
+{
+    this->p_iss = new RV32ISim(ROM_START_ADDR);
+    this->p_iss->addRegion(ROM_START_ADDR, ROM_SIZE, false);
+    this->p_iss->addRegion(RAM_START_ADDR, RAM_SIZE, true);
+    // Plain memory for the ISS, status regs behind it go to read() / write()
+    this->p_fb = this->p_iss->addRegion(SOCEMU_HDMI_START_ADDR, SOCEMU_HDMI_FB_SIZE, true);
+    this->p_iss->setMMIO(this);
+    for (int i = 0; i < 4; i++) {
+        this->gpio_in[i]  = 0;
+        this->gpio_out[i] = 0;
+    }
+    this->perf_run   = true;
+    this->perf_count = 0;
+    this->perf_start = 0;
+}
+
+inline SoCEmu::~SoCEmu()
+{
+    delete this->p_iss;
+}
+
+inline bool SoCEmu::loadImage(const MemImage &image)
+{
+    return this->p_iss->loadImage(image);
+}
+
+inline RV32ISim::Status SoCEmu::run(uint64_t max_instrs)
+{
+    return this->p_iss->run(max_instrs);
+}
+
+inline void SoCEmu::setGPIOIn(uint32_t pins)
+{
+    for (int i = 0; i < 4; i++)
+        this->gpio_in[i] = pins >> (i * 8);
+}
+
+inline uint32_t SoCEmu::getGPIOOut()
+{
+    return this->gpio_out[0] | (this->gpio_out[1] << 8) | (this->gpio_out[2] << 16) | ((uint32_t)this->gpio_out[3] << 24);
+}
+
+inline uint32_t SoCEmu::perfCount()
+{
+    return this->perf_count + (this->perf_run ? (uint32_t)(this->p_iss->getInstret() - this->perf_start) : 0);
+}
+
+// HDMISigGen counters, x / y start in the blanking before the active area (negative)
+inline void SoCEmu::hdmiPosition(int &sx, int &sy)
+{
+    uint64_t pixel = this->p_iss->getInstret() * SOCEMU_PIXEL_MHZ / SOCEMU_CPU_MHZ;
+    uint64_t pos   = pixel % (SOCEMU_HDMI_H_TOTAL * SOCEMU_HDMI_V_TOTAL);
+    sx = (int)(pos % SOCEMU_HDMI_H_TOTAL) - (SOCEMU_HDMI_H_TOTAL - SOCEMU_HDMI_H_RES);
+    sy = (int)(pos / SOCEMU_HDMI_H_TOTAL) - (SOCEMU_HDMI_V_TOTAL - SOCEMU_HDMI_V_RES);
+}
+
+// {hsync, vsync, de, frame, line}, syncs active low
+inline uint32_t SoCEmu::hdmiStatus()
+{
+    int sx, sy;
+    this->hdmiPosition(sx, sy);
+    int h_sta = SOCEMU_HDMI_H_RES - SOCEMU_HDMI_H_TOTAL, v_sta = SOCEMU_HDMI_V_RES - SOCEMU_HDMI_V_TOTAL;
+    bool hsync = !((sx > h_sta + 16) && (sx <= h_sta + 16 + 96));
+    bool vsync = !((sy > v_sta + 10) && (sy <= v_sta + 10 + 2));
+    bool de    = (sx >= 0) && (sy >= 0);
+    bool frame = (sx == h_sta) && (sy == v_sta);
+    bool line  = (sx == h_sta);
+    return (hsync << 4) | (vsync << 3) | (de << 2) | (frame << 1) | line;
+}
+
+// GPIOWB: byte = reg[offset], half = {reg[offset], reg[offset + 1]}, word = {reg[0] .. reg[3]}
+inline uint32_t SoCEmu::gpioRead(const uint8_t *p_regs, unsigned int offset, unsigned int size)
+{
+    if (size == 1)
+        return p_regs[offset];
+    if (size == 2)
+        return (p_regs[offset] << 8) | p_regs[offset + 1];
+    return ((uint32_t)p_regs[0] << 24) | (p_regs[1] << 16) | (p_regs[2] << 8) | p_regs[3];
+}
+
+inline uint32_t SoCEmu::read(uint32_t addr, unsigned int size)
+{
+    unsigned int shift = (addr & 0x3) * 8;
+    if ((addr & ~0x7u) == GPIO_START_ADDR)
+        return this->gpioRead((addr & 0x4) ? this->gpio_out : this->gpio_in, addr & 0x3, size);
+    if ((addr >= PERF_START_ADDR) && (addr < PERF_START_ADDR + 4 * (PERF_N_COUNTERS + 1))) {
+        unsigned int idx = (addr - PERF_START_ADDR) >> 2;
+        uint32_t data = 0;
+        if (idx == 0)
+            data = this->perf_run;
+        else if (idx == 1 || idx == 2) // PERF_CYCLES, PERF_INSTRET
+            data = this->perfCount();
+        return data >> shift;
+    }
+    if ((addr & ~0x7u) == SOCEMU_HDMI_START_ADDR + SOCEMU_HDMI_FB_SIZE) {
+        if (addr & 0x4) {
+            int sx, sy;
+            this->hdmiPosition(sx, sy);
+            return (((uint32_t)(uint16_t)sx << 16) | (uint16_t)sy) >> shift;
+        }
+        return this->hdmiStatus() >> shift;
+    }
+    LOG_WARN(LOG_ISS, "Read from unmapped 0x%08X @ pc 0x%08X", addr, this->p_iss->getPC());
+    return 0;
+}
+
+inline void SoCEmu::write(uint32_t addr, unsigned int size, uint32_t data)
+{
+    if ((addr & ~0x3u) == GPIO_START_ADDR + 4) {
+        uint32_t prev = this->getGPIOOut();
+        unsigned int offset = addr & 0x3;
+        if (size == 1)
+            this->gpio_out[offset] = data;
+        else if (size == 2) {
+            this->gpio_out[offset]     = data >> 8;
+            this->gpio_out[offset + 1] = data;
+        }
+        else {
+            for (int i = 0; i < 4; i++)
+                this->gpio_out[i] = data >> ((3 - i) * 8);
+        }
+        if (this->getGPIOOut() != prev)
+            LOG_INFO(LOG_ISS, "GPIO out 0x%08X -> 0x%08X @ %llu instrs", prev, this->getGPIOOut(),
+                     (unsigned long long)this->p_iss->getInstret());
+        return;
+    }
+    if (addr == PERF_START_ADDR) {
+        // Bits as PerfCountersWB.sv: 0 start, 1 clear, 2 stop
+        this->perf_count = (data & 0x2) ? 0 : this->perfCount();
+        this->perf_start = this->p_iss->getInstret();
+        this->perf_run   = (data & 0x4) ? false : ((data & 0x1) ? true : this->perf_run);
+        return;
+    }
+    LOG_WARN(LOG_ISS, "Write 0x%08X to unmapped / read only 0x%08X @ pc 0x%08X", data, addr, this->p_iss->getPC());
+}
+
+inline bool SoCEmu::dumpFramebuffer(const char *p_file)
+{
+    FILE *fp = fopen(p_file, "wb");
+    if (!fp) {
+        LOG_ERROR(LOG_ISS, "Could not open %s", p_file);
+        return false;
+    }
+    fprintf(fp, "P4\n%d %d\n", SOCEMU_HDMI_H_RES, SOCEMU_HDMI_V_RES);
+    // PBM is MSB first and 1 = black, HDMI pixel 1 = white
+    for (int i = 0; i < SOCEMU_HDMI_FB_SIZE; i++) {
+        uint8_t byte = this->p_fb[i], out = 0;
+        for (int b = 0; b < 8; b++)
+            out |= ((byte >> b) & 0x1) << (7 - b);
+        fputc(~out & 0xff, fp);
+    }
+    fclose(fp);
+    LOG_INFO(LOG_ISS, "Framebuffer written to %s", p_file);
+    return true;
+}
+
+#endif
@@ -1,13 +1,33 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+// Checkpointing needs model verilated with --savable, see Makefile VRLTSAVABLE
+#ifdef VRLT_SAVABLE
+#include <verilated_save.h>
+#endif
+
 class IModel
 {
 public:
     // NOTE: eval can be called multiple time per clock edge, so its best to 
     // create a function called cycle and using eval only to detect clock edge,
     // then only on clock edge cycle is called
-    virtual void eval() = 0;
+    // Return true if any output was written with a new value, testbench uses this
+    // to skip re-evaluating modules when nothing they read has changed
+    virtual bool eval() = 0;
+    // Fast forward support, see TestBench::fastForward
+    // Number of upcoming posedges the model can take without doing anything observable
+    // (no output change, no state change other than counting down), assuming its inputs
+    // stay as they are now. 0 means it cannot be skipped
+    virtual unsigned long long getIdleCycles() { return 0; }
+    // Take n_cycles posedges at once, n_cycles <= getIdleCycles()
+    virtual void skipCycles(unsigned long long /* n_cycles */) {}
+#ifdef VRLT_SAVABLE
+    // Checkpoint, write / read everything needed to continue from this exact point,
+    // configuration (constructor params) is expected to be the same
+    virtual void save(VerilatedSave &os) = 0;
+    virtual void restore(VerilatedRestore &is) = 0;
+#endif
     virtual bool operator< (const IModel& comp) const = 0;
     virtual bool operator== (const IModel& comp) const = 0;
     // REQUIREMENT FOR IOs: MUST be pointers
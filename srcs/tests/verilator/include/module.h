@@ -3,9 +3,12 @@
 
 #include <memory>
 #include <verilated.h>
-#include <verilated_vcd_c.h>
+#ifdef VRLT_SAVABLE
+#include <verilated_save.h>
+#endif
 
-#include "debug.h"
+#include "tracer.h"
+#include "log.h"
 #include "clockDomain.h"
 
 // Verilator access submodule signal
@@ -15,11 +18,18 @@ class IModule {
 public:
     // Return pointer to verilator UUT
 	virtual void *getUUTPtr(void) = 0;
-    virtual void trace(VerilatedVcdC* tfp, int levels, int options = 0) = 0;
+    // Verilator hierarchical name, as given in constructor
+    virtual const char *getName(void) = 0;
+    virtual void trace(VerilatedTracer* tfp, int levels, int options = 0) = 0;
     // eval_step & eval_end_step, refer to Verilator's doc for multiple design in a single context
     // https://verilator.org/guide/latest/connecting.html#wrappers-and-model-evaluation-loop
     virtual void evalStep(void) = 0;
     virtual void evalEndStep(void) = 0;
+#ifdef VRLT_SAVABLE
+    // Whole model state, needs --savable
+    virtual void save(VerilatedSave &os) = 0;
+    virtual void restore(VerilatedRestore &is) = 0;
+#endif
     virtual bool operator< (const IModule& comp) const = 0;
     virtual bool operator== (const IModule& comp) const = 0;
 };
@@ -34,11 +44,16 @@ public:
 	~Module(void);
 
 	void *getUUTPtr(void) override;
+    const char *getName(void) override;
 
-    void trace(VerilatedVcdC* tfp, int levels, int options = 0) override;
+    void trace(VerilatedTracer* tfp, int levels, int options = 0) override;
     
     virtual void evalStep(void) override;
     virtual void evalEndStep(void) override;
+#ifdef VRLT_SAVABLE
+    void save(VerilatedSave &os) override;
+    void restore(VerilatedRestore &is) override;
+#endif
 
     bool operator< (const IModule& comp) const override;
     bool operator== (const IModule& comp) const override;
@@ -69,7 +84,13 @@ void *Module<UUT>::getUUTPtr(void)
 }
 
 template <class UUT>
-void Module<UUT>::trace(VerilatedVcdC *tfp, int levels, int options)
+const char *Module<UUT>::getName(void)
+{
+    return this->p_uut->name();
+}
+
+template <class UUT>
+void Module<UUT>::trace(VerilatedTracer *tfp, int levels, int options)
 {
     this->p_uut->trace(tfp, levels, options);
 }
@@ -86,6 +107,20 @@ void Module<UUT>::evalEndStep(void)
     this->p_uut->eval_end_step();
 }
 
+#ifdef VRLT_SAVABLE
+template <class UUT>
+void Module<UUT>::save(VerilatedSave &os)
+{
+    os << *this->p_uut;
+}
+
+template <class UUT>
+void Module<UUT>::restore(VerilatedRestore &is)
+{
+    is >> *this->p_uut;
+}
+#endif
+
 template <class UUT>
 bool Module<UUT>::operator< (const IModule& comp) const
 {
@@ -0,0 +1,126 @@
+#include "retireTrace.h"
+
+RetireTraceWriter::RetireTraceWriter(const char *p_path, size_t buffer_len)
+{
+    this->buffer_len  = buffer_len;
+    this->buffer_used = 0;
+    this->last_cycle  = 0;
+    this->n_records   = 0;
+    this->p_buffer    = new RetireRecord[buffer_len];
+    this->fp = nullptr;
+    if (!p_path)
+        return;
+    this->fp = fopen(p_path, "wb");
+    if (!this->fp) {
+        LOG_ERROR(LOG_RETIRE, "Could not open retire trace %s", p_path);
+        return;
+    }
+    RetireTraceHeader header = {RETIRE_TRACE_MAGIC, RETIRE_TRACE_VERSION, sizeof(RetireRecord)};
+    fwrite(&header, sizeof(header), 1, this->fp);
+}
+
+RetireTraceWriter::~RetireTraceWriter()
+{
+    this->close();
+    delete[] this->p_buffer;
+}
+
+bool RetireTraceWriter::isOpen()
+{
+    return (this->fp != nullptr);
+}
+
+void RetireTraceWriter::addListener(IRetireListener *p_listener)
+{
+    this->v_listeners.push_back(p_listener);
+}
+
+void RetireTraceWriter::put(const RetireRecord &record)
+{
+    for (IRetireListener *p_listener : this->v_listeners)
+        p_listener->onRetire(record);
+    this->n_records++;
+    if (!this->fp)
+        return;
+    this->p_buffer[this->buffer_used++] = record;
+    if (this->buffer_used == this->buffer_len)
+        this->flush();
+}
+
+// Write out everything in front of the oldest pending load
+void RetireTraceWriter::drain()
+{
+    while (!this->q_pending.empty() && !(this->q_pending.front().flags & RETIRE_F_LATE)) {
+        this->put(this->q_pending.front());
+        this->q_pending.pop_front();
+    }
+}
+
+void RetireTraceWriter::retire(unsigned long long cycle, uint32_t pc, uint32_t instr, uint8_t rd, uint32_t wb,
+                               uint32_t addr, uint8_t flags)
+{
+    if (!this->fp && this->v_listeners.empty())
+        return;
+    RetireRecord record;
+    unsigned long long delta = cycle - this->last_cycle;
+    this->last_cycle = cycle;
+    record.pc     = pc;
+    record.instr  = instr;
+    record.wb     = wb;
+    record.addr   = addr;
+    record.rd     = rd;
+    record.flags  = flags;
+    record.cycles = (delta > 0xffff) ? 0xffff : (uint16_t)delta;
+    if (flags & RETIRE_F_LOAD)
+        record.flags |= RETIRE_F_LATE;
+    // Fast path, nothing to wait for
+    if (this->q_pending.empty() && !(record.flags & RETIRE_F_LATE))
+        this->put(record);
+    else
+        this->q_pending.push_back(record);
+}
+
+void RetireTraceWriter::loadReturn(uint8_t rd, uint32_t data)
+{
+    std::deque<RetireRecord>::iterator i_record;
+    for (i_record = this->q_pending.begin(); i_record < this->q_pending.end(); i_record++) {
+        if (i_record->flags & RETIRE_F_LATE) {
+            if (i_record->rd != rd)
+                LOG_WARN(LOG_RETIRE, "Load return for x%d, oldest pending load writes x%d @ 0x%08X", rd, i_record->rd, i_record->pc);
+            i_record->wb     = data;
+            i_record->flags &= ~RETIRE_F_LATE;
+            if (rd != 0)
+                i_record->flags |= RETIRE_F_WB;
+            this->drain();
+            return;
+        }
+    }
+    // Loads are queued in retire(), a value with no load waiting is one the trace would attribute wrong
+    LOG_WARN(LOG_RETIRE, "Load return for x%d (0x%08X) with no pending load, dropped", rd, data);
+}
+
+void RetireTraceWriter::flush()
+{
+    if (this->fp && this->buffer_used)
+        fwrite(this->p_buffer, sizeof(RetireRecord), this->buffer_used, this->fp);
+    this->buffer_used = 0;
+}
+
+void RetireTraceWriter::close()
+{
+    while (!this->q_pending.empty()) {
+        this->put(this->q_pending.front());
+        this->q_pending.pop_front();
+    }
+    if (!this->fp)
+        return;
+    this->flush();
+    fclose(this->fp);
+    this->fp = nullptr;
+    LOG_INFO(LOG_RETIRE, "Retire trace closed, %llu records", this->n_records);
+}
+
+unsigned long long RetireTraceWriter::getRecordCount()
+{
+    return this->n_records;
+}
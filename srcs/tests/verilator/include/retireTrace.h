@@ -0,0 +1,95 @@
+// Retire trace, one fixed size binary record per retired instr, in program order
+// Written by the CPU harness (+retire_trace=<file>), read back with tools/retireDecode
+// Replaces printing every cycle from the harness, console I/O was most of the run time
+
+#ifndef RETIRE_TRACE_H
+#define RETIRE_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "log.h"
+
+// ==================================================
+/* File layout, little endian (host order, only x86 / arm hosts here):
+ *  header : RetireTraceHeader
+ *  records: RetireRecord until EOF
+ */
+#define RETIRE_TRACE_MAGIC   0x54525652 // "RVRT"
+#define RETIRE_TRACE_VERSION 1
+
+// Record flags
+#define RETIRE_F_WB    0x01 // rd written with wb
+#define RETIRE_F_LOAD  0x02 // addr valid, wb is the loaded (extended) value
+#define RETIRE_F_STORE 0x04 // addr valid
+#define RETIRE_F_LATE  0x08 // load value never came back, wb invalid (trace closed before / bus error)
+
+struct RetireTraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+};
+
+// 20 bytes
+struct RetireRecord {
+    uint32_t pc;
+    uint32_t instr;
+    uint32_t wb;     // value written to rd
+    uint32_t addr;   // mem access addr, loads / stores
+    uint8_t  rd;
+    uint8_t  flags;
+    uint16_t cycles; // CPU cycles since previous record, saturated
+} __attribute__((packed));
+
+static_assert(sizeof(RetireRecord) == 20, "RetireRecord must stay packed, decoder reads it raw");
+
+// Gets every record in program order, loads with their value (E.G. cosim against the ISS)
+class IRetireListener
+{
+public:
+    virtual ~IRetireListener() {}
+    virtual void onRetire(const RetireRecord &record) = 0;
+};
+
+// ==================================================
+/* Buffered writer, records go into a memory buffer flushed with one fwrite when full
+ * Loads retire with their value pending (pipeline writes them back later through the LSU port),
+ * records behind one are held until it completes so the file stays in program order.
+ * p_path = nullptr: no file, records only go to listeners
+ */
+class RetireTraceWriter
+{
+private:
+    FILE *fp;
+    RetireRecord *p_buffer;
+    size_t buffer_len;   // in records
+    size_t buffer_used;
+    unsigned long long last_cycle;
+    unsigned long long n_records;
+    // Oldest pending load and everything after it, pending loads carry RETIRE_F_LATE until their value is in
+    std::deque<RetireRecord> q_pending;
+    std::vector<IRetireListener *> v_listeners;
+
+    void put(const RetireRecord &record);
+    void drain();
+
+public:
+    RetireTraceWriter(const char *p_path, size_t buffer_len = 65536);
+    ~RetireTraceWriter();
+    bool isOpen();
+    // Not owned
+    void addListener(IRetireListener *p_listener);
+    // Instr retired at cycle, load = value comes later with loadReturn()
+    void retire(unsigned long long cycle, uint32_t pc, uint32_t instr, uint8_t rd, uint32_t wb,
+                uint32_t addr, uint8_t flags);
+    // Late load writeback, completes the oldest pending load
+    void loadReturn(uint8_t rd, uint32_t data);
+    void flush();
+    // Flush everything still pending, loads with no value are marked RETIRE_F_LATE
+    void close();
+    unsigned long long getRecordCount();
+};
+
+#endif
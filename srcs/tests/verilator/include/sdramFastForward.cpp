@@ -0,0 +1,34 @@
+#include "sdramFastForward.h"
+
+#include <cstring>
+
+#include "verilated_syms.h"
+#include "log.h"
+
+#define SDRAM_INIT_COUNTER_VAR "_init_counter"
+#define SDRAM_INIT_INSTANCE    "SDRAMController"
+#define SDRAM_INIT_COUNTER_MAX 0xFFFF
+
+int sdramInitSkipAdd(VerilatedContext *p_context, unsigned long long n_cycles)
+{
+    int n_found = 0;
+    const VerilatedScopeNameMap *p_scopes = p_context->scopeNameMap();
+    for (VerilatedScopeNameMap::const_iterator it = p_scopes->begin(); it != p_scopes->end(); it++) {
+        // Scope names end with the instance name, it is SDRAMController in every module using it
+        size_t len = strlen(it->first);
+        size_t len_instance = strlen(SDRAM_INIT_INSTANCE);
+        if ((len < len_instance) || strcmp(it->first + len - len_instance, SDRAM_INIT_INSTANCE))
+            continue;
+        VerilatedVar *p_var = it->second->varFind(SDRAM_INIT_COUNTER_VAR);
+        if (!p_var)
+            continue;
+        // logic [15:0], SData in verilated code
+        SData *p_counter = (SData *)p_var->datap();
+        unsigned long long counter = *p_counter + n_cycles;
+        *p_counter = (counter > SDRAM_INIT_COUNTER_MAX) ? SDRAM_INIT_COUNTER_MAX : (SData)counter;
+        n_found++;
+    }
+    if (!n_found)
+        LOG_WARN(LOG_SDRAM, "No SDRAMController init counter found, power on delay not skipped");
+    return n_found;
+}
@@ -0,0 +1,35 @@
+// Skip the SDRAM power on delay (200us, 18k+ ram cycles at 90 MHz) in harnesses with SDRAMController.sv
+// The model alone skipping it is not enough, the controller counts the delay itself. The testbench is fast
+// forwarded over what is left of the model's delay, the skipped ram clock posedges are then added once to the
+// public init counter of every controller instance (_init_counter, found through the verilator scopes)
+// Call right after reset: modules are not evaluated during the skip (see TestBench::fastForward)
+
+#ifndef SDRAM_FAST_FORWARD_H
+#define SDRAM_FAST_FORWARD_H
+
+#include "testbench.h"
+#include "models/SDRAM.h"
+
+// Left of the model's delay, controller counter starts at reset release so it is a few cycles behind the
+// model, this keeps it from jumping over its first init command
+#define SDRAM_FAST_FORWARD_MARGIN 4
+
+// Add to the init counter of every SDRAMController in the context, return how many were found
+int sdramInitSkipAdd(VerilatedContext *p_context, unsigned long long n_cycles);
+
+// All models of the domain skip together, p_sdram is the one the skip is measured on
+// Return ram clock posedges skipped, 0 when past the delay already (E.G. after a checkpoint restore)
+template<class Geometry>
+unsigned long long sdramSkipStartup(TestBench *p_tb, ClockDomain *p_ram_domain, SDRAMModel<Geometry> *p_sdram)
+{
+    uint32_t wait = p_sdram->getStartupWait();
+    if (wait <= SDRAM_FAST_FORWARD_MARGIN)
+        return 0;
+    uint64_t start = p_sdram->getCycles();
+    p_tb->fastForward(p_ram_domain, wait - SDRAM_FAST_FORWARD_MARGIN);
+    unsigned long long n_skipped = p_sdram->getCycles() - start;
+    sdramInitSkipAdd(p_tb->getContextPtr(), n_skipped);
+    return n_skipped;
+}
+
+#endif
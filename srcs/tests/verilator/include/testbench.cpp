@@ -7,12 +7,33 @@ TestBench::TestBench(int argc, char **argv, unsigned long long runtime)
     p_context->traceEverOn(true);
 
     enable_trace = 0;
-    p_vcd_tracer = nullptr;
+    p_tracer = nullptr;
+    p_trace_start_trigger = nullptr;
+    p_trace_stop_trigger = nullptr;
+    trace_triggered = 1;
+    trace_last_toggle_ps = 0;
 
     // Hard limit @ ULLONG_MAX
     this->runtime_limit = (runtime == 0) ? ULLONG_MAX : runtime;
 
     testbench_clock_lock = 0;
+
+    p_worker_pool = nullptr;
+    const char *p_threads_arg = p_context->commandArgsPlusMatch("threads=");
+    if (p_threads_arg && p_threads_arg[0])
+        this->setThreads(strtoul(p_threads_arg + strlen("+threads="), nullptr, 10));
+
+    const char *p_trace_start_arg = p_context->commandArgsPlusMatch("trace_start=");
+    const char *p_trace_stop_arg  = p_context->commandArgsPlusMatch("trace_stop=");
+    if ((p_trace_start_arg && p_trace_start_arg[0]) || (p_trace_stop_arg && p_trace_stop_arg[0])) {
+        ITraceTrigger *start = nullptr;
+        ITraceTrigger *stop = nullptr;
+        if (p_trace_start_arg && p_trace_start_arg[0])
+            start = new TimeTraceTrigger(strtoull(p_trace_start_arg + strlen("+trace_start="), nullptr, 10));
+        if (p_trace_stop_arg && p_trace_stop_arg[0])
+            stop = new TimeTraceTrigger(strtoull(p_trace_stop_arg + strlen("+trace_stop="), nullptr, 10));
+        this->setTraceTriggers(start, stop);
+    }
 }
 
 TestBench::~TestBench(void)
@@ -37,7 +58,13 @@ TestBench::~TestBench(void)
         this->v_modules.erase(i_module);
     }
     
-    if(p_vcd_tracer) delete p_vcd_tracer;
+    if(p_worker_pool) delete p_worker_pool;
+    if(p_trace_start_trigger) delete p_trace_start_trigger;
+    if(p_trace_stop_trigger) delete p_trace_stop_trigger;
+    if(p_tracer) {
+        p_tracer->close();
+        delete p_tracer;
+    }
     if(p_context) delete p_context;
 }
 
@@ -46,9 +73,9 @@ VerilatedContext *TestBench::getContextPtr(void)
     return this->p_context;
 }
 
-VerilatedVcdC *TestBench::getTracerPtr(void)
+VerilatedTracer *TestBench::getTracerPtr(void)
 {
-    return this->p_vcd_tracer;
+    return this->p_tracer;
 }
 
 void TestBench::addClockDomain(ClockDomain *domain)
@@ -69,11 +96,11 @@ void TestBench::addModule(IModule *module)
     std::sort(this->v_modules.begin(), this->v_modules.end());
     this->v_modules.erase(unique(this->v_modules.begin(), this->v_modules.end()), this->v_modules.end());
     // register tracer if exist
-    if (this->p_vcd_tracer) {
+    if (this->p_tracer) {
         // Verilator does not allow calling trace after calling trace file open
         // so this behavior is not allowed
-        // module->trace(this->p_vcd_tracer, 0, 0);
-        DEBUG("THIS MODULE WILL NOT BE TRACED AFTER \'VerilatedVcdC::open()\'. Aborting.");
+        // module->trace(this->p_tracer, 0, 0);
+        LOG_ERROR(LOG_TB, "THIS MODULE WILL NOT BE TRACED AFTER \'tracer open()\'. Aborting.");
         abort();
     }
 }
@@ -81,46 +108,103 @@ void TestBench::addModule(IModule *module)
 void TestBench::addModel(IModel *model)
 {
     assert(model);
-    this->v_models.push_back(model);
-    // sort
-    std::sort(this->v_models.begin(), this->v_models.end());
-    this->v_models.erase(unique(this->v_models.begin(), this->v_models.end()), this->v_models.end());
+    // keep the order added, checkpoints rely on it
+    if (std::find(this->v_models.begin(), this->v_models.end(), model) == this->v_models.end())
+        this->v_models.push_back(model);
 }
 
-void TestBench::vcdTraceSet(const char* vcdfile)
+void TestBench::setThreads(unsigned int n_threads)
+{
+    assert(!testbench_clock_lock);
+    if (this->p_worker_pool) {
+        delete this->p_worker_pool;
+        this->p_worker_pool = nullptr;
+    }
+    // Workers spin between edges, sharing a core with them is a lot slower than single threaded
+    if (n_threads > std::thread::hardware_concurrency())
+        LOG_WARN(LOG_TB, "%u threads requested, only %u cores available", n_threads, std::thread::hardware_concurrency());
+    if (n_threads > 1)
+        this->p_worker_pool = new WorkerPool(n_threads);
+}
+
+void TestBench::traceSet(const char* tracefile)
 {
     // traceEverOn must be enabled
-    if (!vcdfile) return;
-    DEBUG("Set tracefile to: %s", vcdfile);
-    if (!this->p_vcd_tracer) {
-        this->p_vcd_tracer = new VerilatedVcdC();
+    if (!tracefile) return;
+    LOG_INFO(LOG_TB, "Set tracefile to: %s", tracefile);
+    if (!this->p_tracer) {
+        this->p_tracer = new VerilatedTracer();
         // Register to existing modules
         std::vector<IModule *>::iterator i_module;
         for (i_module = this->v_modules.begin(); i_module < this->v_modules.end(); i_module++) {
             IModule *module = *i_module;
-            module->trace(this->p_vcd_tracer, 0, 0);
+            module->trace(this->p_tracer, 0, 0);
         }
-        this->p_vcd_tracer->open(vcdfile);
+        this->p_tracer->open(tracefile);
     }
 }
 
-void TestBench::setTracing(unsigned char en, const char* vcdfile)
+void TestBench::setTracing(unsigned char en, const char* tracefile)
 {
-    if (!this->p_vcd_tracer) {
-        DEBUG("Tracer not initialized");
-        if (vcdfile == nullptr) return;
+    if (!this->p_tracer) {
+        LOG_WARN(LOG_TB, "Tracer not initialized");
+        if (tracefile == nullptr) return;
         else
-            this->vcdTraceSet(vcdfile);
+            this->traceSet(tracefile);
     }
     this->enable_trace = en;
 }
 
+void TestBench::setTraceTriggers(ITraceTrigger *start, ITraceTrigger *stop)
+{
+    if (this->p_trace_start_trigger) delete this->p_trace_start_trigger;
+    if (this->p_trace_stop_trigger) delete this->p_trace_stop_trigger;
+    this->p_trace_start_trigger = start;
+    this->p_trace_stop_trigger = stop;
+    // Wait for start, unless there is none
+    this->trace_triggered = (start == nullptr);
+    this->trace_last_toggle_ps = this->p_context->time();
+}
+
+void TestBench::traceTriggerCheck(void)
+{
+    unsigned long long time = this->p_context->time();
+    unsigned long long since = time - this->trace_last_toggle_ps;
+    if (!this->trace_triggered) {
+        if (this->p_trace_start_trigger && this->p_trace_start_trigger->check(time, since)) {
+            LOG_INFO(LOG_TB, "Trace start @ %llu ps", time);
+            this->trace_triggered = 1;
+            this->trace_last_toggle_ps = time;
+        }
+    }
+    else {
+        if (this->p_trace_stop_trigger && this->p_trace_stop_trigger->check(time, since)) {
+            LOG_INFO(LOG_TB, "Trace stop @ %llu ps", time);
+            this->trace_triggered = 0;
+            this->trace_last_toggle_ps = time;
+            // Let the window hit the disk, tracer buffers the rest
+            if (this->p_tracer)
+                this->p_tracer->flush();
+        }
+    }
+}
+
+void TestBench::moduleEvalStepJob(void *p_arg, unsigned int index)
+{
+    ((IModule **)p_arg)[index]->evalStep();
+}
+
 void TestBench::moduleEval(void)
 {
     std::vector<IModule *>::iterator i_module;
-    for (i_module = this->v_modules.begin(); i_module < this->v_modules.end(); i_module++) {
-        IModule *module = *i_module;
-        module->evalStep();
+    // Nothing to split with a single module
+    if (this->p_worker_pool && (this->v_modules.size() > 1))
+        this->p_worker_pool->run(moduleEvalStepJob, this->v_modules.data(), this->v_modules.size());
+    else {
+        for (i_module = this->v_modules.begin(); i_module < this->v_modules.end(); i_module++) {
+            IModule *module = *i_module;
+            module->evalStep();
+        }
     }
     for (i_module = v_modules.begin(); i_module < v_modules.end(); i_module++) {
         IModule *module = *i_module;
@@ -128,54 +212,54 @@ void TestBench::moduleEval(void)
     }
 }
 
-void TestBench::modelEval(void)
+bool TestBench::modelEval(void)
 {
+    bool changed = false;
     std::vector<IModel *>::iterator i_model;
     for (i_model = this->v_models.begin(); i_model < this->v_models.end(); i_model++) {
         IModel *model = *i_model;
-        model->eval();
+        // no short circuit, every model must see every edge
+        changed |= model->eval();
     }
+    return changed;
 }
 
 void TestBench::eval(void)
 {
     // Set the lock if this is the first call to eval
     // No more clock signal after this
+    // Domains are fixed from here so build the edge schedule
     if (!testbench_clock_lock) {
         testbench_clock_lock = 1;
+        this->scheduler.build(this->v_domains, this->p_context->time());
+        // Known once models exist, --threads models share the context thread pool
+        if (this->p_worker_pool && (this->p_context->threads() > 1)) {
+            LOG_WARN(LOG_TB, "Modules verilated with --threads %u, harness threads disabled", this->p_context->threads());
+            delete this->p_worker_pool;
+            this->p_worker_pool = nullptr;
+        }
     }
 
     // First call evals to evaluate first clock position at time 0
     // Module eval first incase models need output
     this->moduleEval();
-    // 
-    this->modelEval();
-    // Call again to settle any logic by models
-    this->moduleEval();
+    // Call again to settle any logic by models, only when they actually drove something new,
+    // most edges are from domains where models are idle, so this saves a full module eval
+    if (this->modelEval())
+        this->moduleEval();
     // this->modelEval(); // This is not needed, probably
     // Dump - Officialy dump traces at this moment 
-    if (p_vcd_tracer && enable_trace) {
-        p_vcd_tracer->dump(this->p_context->time());
-        p_vcd_tracer->flush();
-    }
-
-    unsigned long long ttne = 0;
-    std::vector<ClockDomain *> v_next_domains;
-    std::vector<ClockDomain *>::iterator i_domain;
-
-    // Slow, PoC only
-    for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++) {
-        unsigned long long ttne_tmp = (*i_domain)->timeToNextEdge(this->p_context->time());
-        // ttne cannot be 0 given a single eval;
-        if ((ttne == 0) || (ttne_tmp < ttne))
-            ttne = ttne_tmp;
+    // No flush here, tracer buffers and writes in blocks, flushed on trace stop / close
+    if (p_tracer) {
+        this->traceTriggerCheck();
+        if (enable_trace && trace_triggered)
+            p_tracer->dump(this->p_context->time());
     }
 
-    for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++) {
-        unsigned long long ttne_tmp = (*i_domain)->timeToNextEdge(this->p_context->time());
-        if (ttne_tmp == ttne) 
-            v_next_domains.push_back(*i_domain);
-    }
+    unsigned long long ttne;
+    ClockDomain * const *p_next_domains;
+    unsigned int n_next_domains;
+    ttne = this->scheduler.nextEdges(this->p_context->time(), &p_next_domains, &n_next_domains);
 
     /* While it may look like the last step and the first step are identical since they both leave the clock at zero, they are not the same.
      * Between these two steps, co-simulation logic might change inputs to the design. 
@@ -187,9 +271,180 @@ void TestBench::eval(void)
     this->p_context->timeInc(ttne);
     // Set output value for clk signals from chosen domains, the rest stays
     // Next call to eval will evaluate at this time value
-    for (i_domain = v_next_domains.begin(); i_domain < v_next_domains.end(); i_domain++)
-        (*i_domain)->updateNewClockEdge(this->p_context->time());
+    for (unsigned int i = 0; i < n_next_domains; i++)
+        p_next_domains[i]->updateNewClockEdge(this->p_context->time());
+}
+
+unsigned long long TestBench::fastForwardSkipCount(ClockDomain *domain, unsigned long long target_time_ps)
+{
+    unsigned long long current_time = this->p_context->time();
+    unsigned long long n = domain->countPosedges(current_time, target_time_ps);
+    // Edge at current time is already set but not evaluated, models compare against their
+    // last seen clock (before current time), so if the clock at target is a posedge to them
+    // they will take that one by themselves
+    if (domain->getClockSignalValueAt(target_time_ps) && !domain->getClockSignalValueAt(current_time - 1))
+        n--;
+    return n;
+}
+
+unsigned long long TestBench::fastForward(ClockDomain *domain, unsigned long long max_cycles)
+{
+    std::vector<ClockDomain *>::iterator i_domain;
+    std::vector<IModel *>::iterator i_model;
+
+    assert(domain);
+    // Current time must be past the first eval
+    assert(testbench_clock_lock && (this->p_context->time() > 0));
+
+    // Models not assigned to a domain cannot be accounted for
+    size_t n_domain_models = 0;
+    for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++)
+        n_domain_models += (*i_domain)->getModels().size();
+    if (n_domain_models != this->v_models.size()) {
+        LOG_WARN(LOG_TB, "Fast forward needs all models added to a clock domain");
+        return 0;
+    }
+
+    // Shrink the jump until every model can take it
+    unsigned long long current_time = this->p_context->time();
+    unsigned long long n_cycles = max_cycles;
+    bool fits = false;
+    while (n_cycles && !fits) {
+        fits = true;
+        unsigned long long target_time = current_time + n_cycles * domain->getPeriodPs();
+        for (i_domain = this->v_domains.begin(); fits && (i_domain < this->v_domains.end()); i_domain++) {
+            unsigned long long n_skip = this->fastForwardSkipCount(*i_domain, target_time);
+            std::vector<IModel *> &v_domain_models = (*i_domain)->getModels();
+            for (i_model = v_domain_models.begin(); fits && (i_model < v_domain_models.end()); i_model++) {
+                unsigned long long n_idle = (*i_model)->getIdleCycles();
+                if (n_skip > n_idle) {
+                    fits = false;
+                    // Scale down, at least by 1
+                    unsigned long long n_scaled = (unsigned long long)((double)n_cycles * n_idle / n_skip);
+                    n_cycles = (n_scaled < n_cycles) ? n_scaled : n_cycles - 1;
+                }
+            }
+        }
+    }
+    if (!n_cycles)
+        return 0;
+
+    // Jump
+    unsigned long long target_time = current_time + n_cycles * domain->getPeriodPs();
+    for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++) {
+        unsigned long long n_skip = this->fastForwardSkipCount(*i_domain, target_time);
+        std::vector<IModel *> &v_domain_models = (*i_domain)->getModels();
+        for (i_model = v_domain_models.begin(); i_model < v_domain_models.end(); i_model++)
+            (*i_model)->skipCycles(n_skip);
+    }
+    this->p_context->time(target_time);
+    for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++)
+        (*i_domain)->resync(target_time);
+    this->scheduler.build(this->v_domains, target_time);
+    LOG_INFO(LOG_TB, "Fast forwarded %llu cycles of %.2f MHz domain, %llu ps -> %llu ps",
+          n_cycles, domain->getFreqMhz(), current_time, target_time);
+    return n_cycles;
+}
+
+#ifdef VRLT_SAVABLE
+void TestBench::save(const char *file)
+{
+    std::vector<ClockDomain *>::iterator i_domain;
+    std::vector<IModule *>::iterator i_module;
+    std::vector<IModel *>::iterator i_model;
+
+    VerilatedSave os;
+    os.open(file);
+    if (!os.isOpen()) {
+        LOG_ERROR(LOG_TB, "Could not open checkpoint file %s", file);
+        abort();
+    }
+    uint64_t time = this->p_context->time();
+    os << time;
+    // Domains only for checking
+    uint32_t n_domains = this->v_domains.size();
+    os << n_domains;
+    for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++) {
+        double freq = (*i_domain)->getFreqMhz();
+        double phase = (*i_domain)->getPhaseDeg();
+        os << freq << phase;
+    }
+    uint32_t n_modules = this->v_modules.size();
+    os << n_modules;
+    for (i_module = this->v_modules.begin(); i_module < this->v_modules.end(); i_module++) {
+        std::string name = (*i_module)->getName();
+        os << name;
+        (*i_module)->save(os);
+    }
+    uint32_t n_models = this->v_models.size();
+    os << n_models;
+    for (i_model = this->v_models.begin(); i_model < this->v_models.end(); i_model++)
+        (*i_model)->save(os);
+    os.close();
+    LOG_INFO(LOG_TB, "Checkpoint saved to %s @ %llu ps", file, (unsigned long long)time);
+}
+
+void TestBench::restore(const char *file)
+{
+    std::vector<ClockDomain *>::iterator i_domain;
+    std::vector<IModule *>::iterator i_module;
+    std::vector<IModel *>::iterator i_model;
+
+    VerilatedRestore is;
+    is.open(file);
+    if (!is.isOpen()) {
+        LOG_ERROR(LOG_TB, "Could not open checkpoint file %s", file);
+        abort();
+    }
+    uint64_t time;
+    is >> time;
+    uint32_t n_domains;
+    is >> n_domains;
+    assert(n_domains == this->v_domains.size());
+    for (uint32_t i = 0; i < n_domains; i++) {
+        double freq, phase;
+        is >> freq >> phase;
+        bool found = false;
+        for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++)
+            if (((*i_domain)->getFreqMhz() == freq) && ((*i_domain)->getPhaseDeg() == phase))
+                found = true;
+        if (!found) {
+            LOG_ERROR(LOG_TB, "Checkpoint clock domain %.2f MHz, %.2f deg not in testbench. Aborting.", freq, phase);
+            abort();
+        }
+    }
+    uint32_t n_modules;
+    is >> n_modules;
+    assert(n_modules == this->v_modules.size());
+    for (uint32_t i = 0; i < n_modules; i++) {
+        std::string name;
+        is >> name;
+        IModule *module = nullptr;
+        for (i_module = this->v_modules.begin(); i_module < this->v_modules.end(); i_module++)
+            if (name == (*i_module)->getName())
+                module = *i_module;
+        if (!module) {
+            LOG_ERROR(LOG_TB, "Checkpoint module %s not in testbench. Aborting.", name.c_str());
+            abort();
+        }
+        module->restore(is);
+    }
+    uint32_t n_models;
+    is >> n_models;
+    assert(n_models == this->v_models.size());
+    for (i_model = this->v_models.begin(); i_model < this->v_models.end(); i_model++)
+        (*i_model)->restore(is);
+    is.close();
+
+    // Clocks are a function of time
+    this->p_context->time(time);
+    for (i_domain = this->v_domains.begin(); i_domain < this->v_domains.end(); i_domain++)
+        (*i_domain)->resync(time);
+    if (testbench_clock_lock)
+        this->scheduler.build(this->v_domains, time);
+    LOG_INFO(LOG_TB, "Checkpoint restored from %s @ %llu ps", file, (unsigned long long)time);
 }
+#endif
 
 void TestBench::evalUntilClockEdge(ClockDomain *sampler, unsigned char desired_edge)
 {
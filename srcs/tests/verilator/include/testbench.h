@@ -2,27 +2,42 @@
 #define TESTBENCH_H
 
 #include <climits>
+#include <cstdlib>
+#include <cstring>
 
 #include <vector>
 #include <iterator>
 #include <verilated.h>
-#include <verilated_vcd_c.h>
 
+#include "tracer.h"
+#include "clockScheduler.h"
+#include "workerPool.h"
 #include "module.h"
 #include "models/model.h"
-#include "debug.h"
+#include "log.h"
 
 class TestBench {
 protected:
     // All the modules inside this testbench share the same sense of time (therefore sharing context)
+    // Safe with modules evaluated on the worker pool, see setThreads
     VerilatedContext* p_context;
     // Tracer
     unsigned char enable_trace;
-	VerilatedVcdC *p_vcd_tracer;
+	VerilatedTracer *p_tracer;
+    // Optional triggers to turn tracing on / off, owned by testbench
+    ITraceTrigger *p_trace_start_trigger;
+    ITraceTrigger *p_trace_stop_trigger;
+    // Trigger window state, trace is dumped when enable_trace && trace_triggered
+    unsigned char trace_triggered;
+    unsigned long long trace_last_toggle_ps;
     // Multiple clock domain share the same context. DOES NOT support phase shift
     std::vector<ClockDomain *> v_domains;
     std::vector<IModule *> v_modules;
     std::vector<IModel *> v_models;
+    // Precomputed clock edges, built on clock lock
+    ClockScheduler scheduler;
+    // Optional threads for module eval, nullptr when single threaded
+    WorkerPool *p_worker_pool;
     // Runtime, this is used to check in isDone
     unsigned long long runtime_limit;
     // Flags
@@ -30,13 +45,18 @@ protected:
     unsigned char testbench_clock_lock;
     // Funcs
     void moduleEval(void);
-    void modelEval(void);
+    void traceTriggerCheck(void);
+    // Posedges a model in domain will miss if time jumps from current to target_time_ps
+    unsigned long long fastForwardSkipCount(ClockDomain *domain, unsigned long long target_time_ps);
+    static void moduleEvalStepJob(void *p_arg, unsigned int index);
+    // Return true if any model changed its outputs
+    bool modelEval(void);
 public:
 	TestBench(int argc, char **argv, unsigned long long runtime = 0);
 	~TestBench(void);
 
     VerilatedContext *getContextPtr(void);
-    VerilatedVcdC *getTracerPtr(void);   
+    VerilatedTracer *getTracerPtr(void);   
 
     // All added clock module started with a posedge,
     // consider that time 0 is the point that all clock signal align
@@ -44,13 +64,27 @@ public:
     void addClockDomain(ClockDomain *domain);
     void addModule(IModule *module);
     void addModel(IModel *model);
+    // Evaluate modules on n threads (caller included), 0 or 1 to disable. Also set by plusarg +threads=<n>
+    // Only evalStep is run in parallel, each module is its own model so they do not share state,
+    // evalEndStep, models and tracing stay on the caller thread. Must be set before first eval
+    // Modules keep the one shared context, a trace file only takes models of a single context. What an
+    // evalStep touches in it: time (read only, written between runs, the pool barrier orders it), $finish /
+    // $stop / $fatal (set under the context mutex), $display (stdio lock), $random (thread local) and DPI
+    // scope (thread local). Models verilated with --threads share the context thread pool too, that one is
+    // not made for concurrent evals: the pool is dropped at first eval then (see eval)
+    void setThreads(unsigned int n_threads);
 
-    void vcdTraceSet(const char* vcdfile);
+    // File extension should match format, use TRACE_FILE_EXT
+    void traceSet(const char* tracefile);
     // Won't work without tracer set, so set them first
-    void setTracing(unsigned char en, const char* vcdfile = nullptr);
+    void setTracing(unsigned char en, const char* tracefile = nullptr);
+    // Turn tracing on when start fires, off when stop fires, either can be nullptr. Testbench takes ownership
+    // E.G. trace 10us from when PC hits 0x10000100:
+    //     setTraceTriggers(new SignalTraceTrigger<IData>(&pc, 0x10000100), new TimeTraceTrigger(10000000, true));
+    // Time window: plusargs +trace_start=<ps> +trace_stop=<ps> set this up in constructor
+    void setTraceTriggers(ITraceTrigger *start, ITraceTrigger *stop = nullptr);
     
-    /* Iterate through clock domains to see which will tick next 
-     * Currently using vector, might change to unordered_map, unique value
+    /* Ask the scheduler which clock domains will tick next, see clockScheduler.h
      * Module eval scheme:
      * - Given multiple clock domains, find the minimum amount of time to next clock edge, what edge does not mater
      *   and it also does not matter if multiple edge happend at the same time since we are going to eval all module anyway
@@ -59,7 +93,24 @@ public:
      *   might not be registered at all before we change it again.
      */
     virtual void eval(void);
-    // TODO: THREADING SUPPORT FOR EACH DOMAIN
+    /* Fast forward: jump time by up to max_cycles periods of domain without evaluating anything
+     * - Every model must be added to a clock domain with ClockDomain::addModel, they are asked how many
+     *   of their own cycles they can skip (getIdleCycles), the jump is cut down to fit all of them.
+     * - Modules are NOT evaluated in between, they just see their clock at the new time, so only use it
+     *   when modules are known to be idle / waiting, E.G.: SDRAM startup delay in model only tests.
+     * - Call between evals, not before the first one.
+     * Return number of domain cycles skipped, 0 if nothing can be skipped
+     */
+    unsigned long long fastForward(ClockDomain *domain, unsigned long long max_cycles);
+#ifdef VRLT_SAVABLE
+    /* Checkpoint: time, every module (Verilator state), every model, to a file
+     * Restore into a testbench set up the exact same way (same domains, modules by name, models in
+     * the same order added), call between evals. Clock domains are recalculated from time.
+     * Tracer / triggers are not part of it. Needs modules verilated with --savable (make VRLTSAVABLE=1)
+     */
+    void save(const char *file);
+    void restore(const char *file);
+#endif
     // Eval until the selected clock domain signal reach desired clock edge
     virtual void evalUntilClockEdge(ClockDomain *sampler, unsigned char desired_edge);
 	virtual bool isDone(void);
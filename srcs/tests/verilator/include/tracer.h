@@ -0,0 +1,73 @@
+// Tracer selection and trace triggers
+// Trace format is picked at verilate time (make vrlt_test VRLTTRACE=fst -> --trace-fst),
+// verilated.mk passes VM_TRACE_FST so the harness follows without code change.
+// FST is compressed and written in blocks, much smaller & faster than VCD for long runs
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <verilated.h>
+
+#if VM_TRACE_FST
+#include <verilated_fst_c.h>
+typedef VerilatedFstC VerilatedTracer;
+#define TRACE_FILE_EXT ".fst"
+#else
+#include <verilated_vcd_c.h>
+typedef VerilatedVcdC VerilatedTracer;
+#define TRACE_FILE_EXT ".vcd"
+#endif
+
+// ==================================================
+/* Trace triggers, checked by testbench every eval after modules settled, before dumping
+ * Start trigger is checked while tracing is off, stop trigger while it is on,
+ * so a start / stop pair can capture multiple windows (E.G. every time a PC is hit)
+ * since_ps is the time since tracing last turned on / off
+ */
+class ITraceTrigger
+{
+public:
+    virtual ~ITraceTrigger() {}
+    virtual bool check(unsigned long long time_ps, unsigned long long since_ps) = 0;
+};
+
+// Fire once at an absolute time, or every time a delay has passed since last trace state change if relative
+class TimeTraceTrigger : public ITraceTrigger
+{
+private:
+    unsigned long long t_ps;
+    bool relative;
+    bool fired;
+
+public:
+    TimeTraceTrigger(unsigned long long t_ps, bool relative = false) : t_ps(t_ps), relative(relative), fired(false) {}
+    bool check(unsigned long long time_ps, unsigned long long since_ps) override
+    {
+        if (this->relative)
+            return (since_ps >= this->t_ps);
+        if (this->fired || (time_ps < this->t_ps))
+            return false;
+        this->fired = true;
+        return true;
+    }
+};
+
+// Fire when (signal & mask) == value, signal is any verilator signal (CData, SData, IData, QData)
+// tagged /* verilator public */ if not a top IO, E.G. PC from DataPipeline e_pc
+template<class T>
+class SignalTraceTrigger : public ITraceTrigger
+{
+private:
+    const T *p_signal;
+    T value;
+    T mask;
+
+public:
+    SignalTraceTrigger(const T *p_signal, T value, T mask = ~(T)0) : p_signal(p_signal), value(value), mask(mask) {}
+    bool check(unsigned long long, unsigned long long) override
+    {
+        return ((*this->p_signal & this->mask) == this->value);
+    }
+};
+
+#endif
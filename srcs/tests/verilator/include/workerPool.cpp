@@ -0,0 +1,123 @@
+#include "workerPool.h"
+
+// Spins before giving the core back to the scheduler while waiting
+#define WORKER_POOL_SPIN_LIMIT 4096
+// Yields after that before a worker parks, edges of a running sim come well within it
+#define WORKER_POOL_YIELD_LIMIT 64
+
+WorkerPool::WorkerPool(unsigned int n_threads)
+{
+    assert(n_threads > 0);
+    this->generation = 0;
+    this->next_index = 0;
+    this->n_finished = 0;
+    this->stop       = false;
+    this->n_parked   = 0;
+    this->p_job      = nullptr;
+    this->p_job_arg  = nullptr;
+    this->job_count  = 0;
+    for (unsigned int i = 1; i < n_threads; i++)
+        this->v_threads.emplace_back(&WorkerPool::workerLoop, this);
+    LOG_INFO(LOG_CLOCK, "Worker pool started with %u threads", n_threads);
+}
+
+WorkerPool::~WorkerPool(void)
+{
+    this->stop.store(true, std::memory_order_release);
+    // wake everyone up so they can see stop
+    this->generation.fetch_add(1, std::memory_order_seq_cst);
+    this->wake();
+    for (size_t i = 0; i < this->v_threads.size(); i++)
+        this->v_threads[i].join();
+}
+
+unsigned int WorkerPool::getThreadCount(void)
+{
+    return this->v_threads.size() + 1;
+}
+
+unsigned int WorkerPool::getParkedCount(void)
+{
+    return this->n_parked.load(std::memory_order_relaxed);
+}
+
+// Generation bumped (seq_cst) before: a worker either sees it before waiting or is
+// counted in n_parked here, the lock keeps the notify out of its check-then-wait
+void WorkerPool::wake(void)
+{
+    if (this->n_parked.load(std::memory_order_seq_cst) == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(this->park_lock);
+    }
+    this->park_cond.notify_all();
+}
+
+void WorkerPool::work(void)
+{
+    while (true) {
+        unsigned int index = this->next_index.fetch_add(1, std::memory_order_relaxed);
+        if (index >= this->job_count)
+            break;
+        this->p_job(this->p_job_arg, index);
+    }
+}
+
+void WorkerPool::workerLoop(void)
+{
+    unsigned long long served = 0;
+    while (true) {
+        unsigned int spins = 0, yields = 0;
+        unsigned long long current;
+        while ((current = this->generation.load(std::memory_order_acquire)) == served) {
+            if (++spins <= WORKER_POOL_SPIN_LIMIT)
+                continue;
+            spins = 0;
+            if (++yields <= WORKER_POOL_YIELD_LIMIT) {
+                std::this_thread::yield();
+                continue;
+            }
+            // Idle for a while (harness busy between runs), park
+            std::unique_lock<std::mutex> lock(this->park_lock);
+            this->n_parked.fetch_add(1, std::memory_order_seq_cst);
+            this->park_cond.wait(lock, [this, served] {
+                return this->generation.load(std::memory_order_seq_cst) != served;
+            });
+            this->n_parked.fetch_sub(1, std::memory_order_relaxed);
+            yields = 0;
+        }
+        served = current;
+        if (this->stop.load(std::memory_order_acquire))
+            return;
+        this->work();
+        this->n_finished.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void WorkerPool::run(job_func_t job, void *p_arg, unsigned int count)
+{
+    // No worker, nothing to sync
+    if (this->v_threads.empty()) {
+        for (unsigned int i = 0; i < count; i++)
+            job(p_arg, i);
+        return;
+    }
+    // All workers are parked here since the last run waited for them
+    this->p_job      = job;
+    this->p_job_arg  = p_arg;
+    this->job_count  = count;
+    this->next_index.store(0, std::memory_order_relaxed);
+    this->n_finished.store(0, std::memory_order_relaxed);
+    this->generation.fetch_add(1, std::memory_order_seq_cst);
+    this->wake();
+    // Help out
+    this->work();
+    // Barrier
+    unsigned int spins = 0;
+    while (this->n_finished.load(std::memory_order_acquire) != this->v_threads.size()) {
+        if (++spins > WORKER_POOL_SPIN_LIMIT) {
+            std::this_thread::yield();
+            spins = 0;
+        }
+    }
+}
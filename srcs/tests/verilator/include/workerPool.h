@@ -0,0 +1,61 @@
+// Persistent worker threads for evaluating independent modules in parallel
+// Creating threads / waking them with condition variables per edge costs more than
+// evaluating a small module, so workers stay alive and spin on a generation counter for
+// a short while, then yield, then park on a condition variable until the next run().
+// run() only takes the lock when someone is parked. Every run() ends with a barrier:
+// all workers must check in before it returns. bench/WorkerPool.cpp measures it.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include <cassert>
+
+#include "log.h"
+
+class WorkerPool
+{
+public:
+    // Job callback, index is in [0, count) and each index is run exactly once per run()
+    typedef void (*job_func_t)(void *p_arg, unsigned int index);
+
+private:
+    std::vector<std::thread> v_threads;
+    // Bumped by run() to wake workers, workers keep the last one they served
+    std::atomic<unsigned long long> generation;
+    // Next job index to grab, shared by workers and the caller
+    std::atomic<unsigned int> next_index;
+    // Number of workers done with current generation, the barrier
+    std::atomic<unsigned int> n_finished;
+    std::atomic<bool> stop;
+    // Parked workers wait here for a new generation
+    std::mutex park_lock;
+    std::condition_variable park_cond;
+    std::atomic<unsigned int> n_parked;
+    // Current job, only written by run() while all workers are parked
+    job_func_t p_job;
+    void *p_job_arg;
+    unsigned int job_count;
+
+    void workerLoop(void);
+    void work(void);
+    void wake(void);
+
+public:
+    // n_threads counts the calling thread, so n_threads - 1 workers are created
+    WorkerPool(unsigned int n_threads);
+    ~WorkerPool(void);
+    unsigned int getThreadCount(void);
+    // Workers parked right now, for tests
+    unsigned int getParkedCount(void);
+    // Run job for every index in [0, count), caller thread also takes jobs
+    // Returns only after every worker has finished (barrier)
+    void run(job_func_t job, void *p_arg, unsigned int count);
+};
+
+#endif
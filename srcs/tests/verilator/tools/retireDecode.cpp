@@ -0,0 +1,212 @@
+// Retire trace decoder, reads what the CPU harness writes with +retire_trace=<file>
+// Plain c++, no verilator needed. Build: make vrlt_tools
+// Usage: retireDecode <trace> [-s] [-e <rom.elf>]
+//  default: one line per instr, cycle pc instr disasm, then rd / mem access
+//  -s     : summary only (instrs, cycles, CPI, loads / stores, slowest pcs)
+//  -e     : symbols from the firmware ELF, a <symbol> line each time the pc enters another one,
+//           summary gets <symbol+offset> on pcs and cycles per symbol
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include "../include/memImage.h"
+#include "../include/retireTrace.h"
+
+// ========================================================
+// Support functions
+
+static const char *s_reg_names[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+static int32_t immI(uint32_t instr) { return (int32_t)instr >> 20; }
+static int32_t immS(uint32_t instr) { return ((int32_t)(instr & 0xfe000000) >> 20) | ((instr >> 7) & 0x1f); }
+static int32_t immB(uint32_t instr)
+{
+    return ((int32_t)(instr & 0x80000000) >> 19) | ((instr & 0x80) << 4) | ((instr >> 20) & 0x7e0) | ((instr >> 7) & 0x1e);
+}
+static int32_t immJ(uint32_t instr)
+{
+    return ((int32_t)(instr & 0x80000000) >> 11) | (instr & 0xff000) | ((instr >> 9) & 0x800) | ((instr >> 20) & 0x7fe);
+}
+
+// RV32I only, same as the core
+void disasm(uint32_t pc, uint32_t instr, char *str, size_t len)
+{
+    uint32_t opcode = instr & 0x7f;
+    uint32_t funct3 = (instr >> 12) & 0x7;
+    uint32_t funct7 = instr >> 25;
+    const char *rd  = s_reg_names[(instr >> 7) & 0x1f];
+    const char *rs1 = s_reg_names[(instr >> 15) & 0x1f];
+    const char *rs2 = s_reg_names[(instr >> 20) & 0x1f];
+    static const char *s_branch[8] = {"beq", "bne", "?", "?", "blt", "bge", "bltu", "bgeu"};
+    static const char *s_load[8]   = {"lb", "lh", "lw", "?", "lbu", "lhu", "?", "?"};
+    static const char *s_store[8]  = {"sb", "sh", "sw", "?", "?", "?", "?", "?"};
+    static const char *s_alui[8]   = {"addi", "slli", "slti", "sltiu", "xori", "srli", "ori", "andi"};
+    static const char *s_alu[8]    = {"add", "sll", "slt", "sltu", "xor", "srl", "or", "and"};
+
+    switch (opcode) {
+        case 0x37: snprintf(str, len, "lui     %s, 0x%x", rd, instr >> 12); break;
+        case 0x17: snprintf(str, len, "auipc   %s, 0x%x", rd, instr >> 12); break;
+        case 0x6f: snprintf(str, len, "jal     %s, 0x%08x", rd, pc + immJ(instr)); break;
+        case 0x67: snprintf(str, len, "jalr    %s, %d(%s)", rd, immI(instr), rs1); break;
+        case 0x63: snprintf(str, len, "%-7s %s, %s, 0x%08x", s_branch[funct3], rs1, rs2, pc + immB(instr)); break;
+        case 0x03: snprintf(str, len, "%-7s %s, %d(%s)", s_load[funct3], rd, immI(instr), rs1); break;
+        case 0x23: snprintf(str, len, "%-7s %s, %d(%s)", s_store[funct3], rs2, immS(instr), rs1); break;
+        case 0x13:
+            if (funct3 == 0x1 || funct3 == 0x5)
+                snprintf(str, len, "%-7s %s, %s, %d", (funct3 == 0x5 && (funct7 & 0x20)) ? "srai" : s_alui[funct3],
+                         rd, rs1, (instr >> 20) & 0x1f);
+            else
+                snprintf(str, len, "%-7s %s, %s, %d", s_alui[funct3], rd, rs1, immI(instr));
+            break;
+        case 0x33:
+            if (funct7 & 0x20)
+                snprintf(str, len, "%-7s %s, %s, %s", (funct3 == 0x0) ? "sub" : "sra", rd, rs1, rs2);
+            else
+                snprintf(str, len, "%-7s %s, %s, %s", s_alu[funct3], rd, rs1, rs2);
+            break;
+        case 0x0f: snprintf(str, len, "fence"); break;
+        case 0x73: snprintf(str, len, (instr >> 20) ? "ebreak" : "ecall"); break;
+        default:   snprintf(str, len, "unknown"); break;
+    }
+}
+
+// "<name+0x10>", "" without symbols
+static const char *symbolName(const MemImage &image, uint32_t pc, char *str, size_t len)
+{
+    uint32_t offset = 0;
+    const char *p_symbol = image.symbolize(pc, offset);
+    if (!p_symbol)
+        return "";
+    if (offset)
+        snprintf(str, len, "<%s+0x%x>", p_symbol, offset);
+    else
+        snprintf(str, len, "<%s>", p_symbol);
+    return str;
+}
+
+// ========================================================
+
+int main(int argc, char **argv)
+{
+    bool summary = false;
+    const char *p_elf_file = nullptr;
+    int i_arg = 2;
+    for (; i_arg < argc; i_arg++) {
+        if (!strcmp(argv[i_arg], "-s"))
+            summary = true;
+        else if (!strcmp(argv[i_arg], "-e") && (i_arg + 1 < argc))
+            p_elf_file = argv[++i_arg];
+        else
+            break;
+    }
+    if ((argc < 2) || (i_arg < argc)) {
+        fprintf(stderr, "Usage: %s <trace> [-s] [-e <rom.elf>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    MemImage image;
+    if (p_elf_file && !image.loadELF(p_elf_file))
+        return EXIT_FAILURE;
+
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    RetireTraceHeader header;
+    if ((fread(&header, sizeof(header), 1, fp) != 1) || (header.magic != RETIRE_TRACE_MAGIC)) {
+        fprintf(stderr, "%s is not a retire trace\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if ((header.version != RETIRE_TRACE_VERSION) || (header.record_size != sizeof(RetireRecord))) {
+        fprintf(stderr, "Trace version %d, record %d bytes, decoder expects version %d, %zu bytes\n",
+                header.version, header.record_size, RETIRE_TRACE_VERSION, sizeof(RetireRecord));
+        return EXIT_FAILURE;
+    }
+
+    // Read in chunks, same buffer size as the writer
+    std::vector<RetireRecord> v_records(65536);
+    unsigned long long cycle = 0, n_instrs = 0, n_loads = 0, n_stores = 0, n_late = 0;
+    // Cycles spent per pc (cycles since the previous retire), summary only
+    std::map<uint32_t, unsigned long long> m_pc_cycles;
+    char str[64], sym[96];
+    // Symbol of the previous instr, a new header line when it changes
+    const char *p_prev_symbol = nullptr;
+    size_t n;
+    while ((n = fread(v_records.data(), sizeof(RetireRecord), v_records.size(), fp)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const RetireRecord &r = v_records[i];
+            cycle += r.cycles;
+            n_instrs++;
+            if (r.flags & RETIRE_F_LOAD)
+                n_loads++;
+            if (r.flags & RETIRE_F_STORE)
+                n_stores++;
+            if (r.flags & RETIRE_F_LATE)
+                n_late++;
+            if (summary) {
+                m_pc_cycles[r.pc] += r.cycles;
+                continue;
+            }
+            if (image.getSymbolCount()) {
+                uint32_t offset;
+                const char *p_symbol = image.symbolize(r.pc, offset);
+                if (p_symbol != p_prev_symbol)
+                    printf("<%s>:\n", p_symbol ? p_symbol : "?");
+                p_prev_symbol = p_symbol;
+            }
+            disasm(r.pc, r.instr, str, sizeof(str));
+            printf("%10llu  %08x  %08x  %-28s", cycle, r.pc, r.instr, str);
+            if (r.flags & RETIRE_F_WB)
+                printf("  %s=0x%08x", s_reg_names[r.rd & 0x1f], r.wb);
+            if (r.flags & RETIRE_F_LATE)
+                printf("  %s=?", s_reg_names[r.rd & 0x1f]);
+            if (r.flags & (RETIRE_F_LOAD | RETIRE_F_STORE))
+                printf("  %s[0x%08x]", (r.flags & RETIRE_F_LOAD) ? "ld" : "st", r.addr);
+            printf("\n");
+        }
+    }
+    fclose(fp);
+
+    if (summary) {
+        printf("Instrs  %llu\n", n_instrs);
+        printf("Cycles  %llu (until last retire)\n", cycle);
+        printf("CPI     %.3f\n", n_instrs ? (double)cycle / n_instrs : 0.0);
+        printf("Loads   %llu, stores %llu, loads without value %llu\n", n_loads, n_stores, n_late);
+        // Top 10 pcs by cycles
+        std::vector<std::pair<uint32_t, unsigned long long>> v_pcs(m_pc_cycles.begin(), m_pc_cycles.end());
+        std::sort(v_pcs.begin(), v_pcs.end(),
+                  [](const std::pair<uint32_t, unsigned long long> &a, const std::pair<uint32_t, unsigned long long> &b) {
+                      return a.second > b.second;
+                  });
+        printf("Top pcs by cycles:\n");
+        for (size_t i = 0; i < v_pcs.size() && i < 10; i++)
+            printf("  %08x  %10llu (%5.1f%%)  %s\n", v_pcs[i].first, v_pcs[i].second,
+                   cycle ? 100.0 * v_pcs[i].second / cycle : 0.0, symbolName(image, v_pcs[i].first, sym, sizeof(sym)));
+        if (image.getSymbolCount()) {
+            // Same cycles grouped by symbol, "?" for pcs outside any
+            std::map<std::string, unsigned long long> m_symbol_cycles;
+            for (const std::pair<const uint32_t, unsigned long long> &pc_cycles : m_pc_cycles) {
+                uint32_t offset;
+                const char *p_symbol = image.symbolize(pc_cycles.first, offset);
+                m_symbol_cycles[p_symbol ? p_symbol : "?"] += pc_cycles.second;
+            }
+            std::vector<std::pair<std::string, unsigned long long>> v_symbols(m_symbol_cycles.begin(), m_symbol_cycles.end());
+            std::sort(v_symbols.begin(), v_symbols.end(),
+                      [](const std::pair<std::string, unsigned long long> &a, const std::pair<std::string, unsigned long long> &b) {
+                          return a.second > b.second;
+                      });
+            printf("Top symbols by cycles:\n");
+            for (size_t i = 0; i < v_symbols.size() && i < 10; i++)
+                printf("  %-24s  %10llu (%5.1f%%)\n", v_symbols[i].first.c_str(), v_symbols[i].second,
+                       cycle ? 100.0 * v_symbols[i].second / cycle : 0.0);
+        }
+    }
+    return EXIT_SUCCESS;
+}
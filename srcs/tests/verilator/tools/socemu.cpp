@@ -0,0 +1,136 @@
+// Runs firmware on the functional SoC model (include/models/SoCEmu.h): ISS + ROM, RAM, GPIO, HDMI, perf counters
+// Plain c++, no verilator, no timing. Build: make vrlt_tools
+// Usage: socemu [<rom.elf | rom.txt>] [-s <sdram.txt>] [-n <max instrs>] [-g <gpio in>] [-f <fb.pbm>] [-t <retire trace>]
+//  No rom file: ROMFILE / SDRAMFILE from env, same as the CPU harness
+//  ELF: .data / .bss go straight to RAM (reset.c skips its copy), the stop pc is printed with its symbol
+//  Stops at the firmware hang loop (jal zero, 0), ecall / ebreak, a fault, after max instrs or on ctrl-c
+//  -g sets the GPIO in pins (hex), GPIO out changes are printed
+//  -f writes the HDMI framebuffer when stopping, E.G. hdmi_test never returns, run it with -n 50000000
+//  -t writes the same retire trace as the CPU harness (+retire_trace), cycles = instrs
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../include/log.h"
+#include "../include/memImage.h"
+#include "../include/retireTrace.h"
+#include "../include/models/SoCEmu.h"
+
+// Instrs per run() call, ctrl-c is checked in between
+#define SOCEMU_CHUNK 1000000
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void sigint_handler(int)
+{
+    s_stop = 1;
+}
+
+static bool stopped(RV32ISim::Status status)
+{
+    return (status != RV32ISim::ISS_OK) || s_stop;
+}
+
+// ========================================================
+
+int main(int argc, char **argv)
+{
+    MemImage image;
+    const char *p_rom_file   = nullptr;
+    const char *p_sdram_file = nullptr;
+    const char *p_fb_file    = nullptr;
+    const char *p_trace_file = nullptr;
+    uint64_t max_instrs = UINT64_MAX;
+    uint32_t gpio_in    = 0;
+    int i = 1;
+    if ((argc > 1) && (argv[1][0] != '-'))
+        p_rom_file = argv[i++];
+    for (; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-s"))
+            p_sdram_file = argv[i + 1];
+        else if (!strcmp(argv[i], "-n"))
+            max_instrs = strtoull(argv[i + 1], nullptr, 0);
+        else if (!strcmp(argv[i], "-g"))
+            gpio_in = strtoul(argv[i + 1], nullptr, 16);
+        else if (!strcmp(argv[i], "-f"))
+            p_fb_file = argv[i + 1];
+        else if (!strcmp(argv[i], "-t"))
+            p_trace_file = argv[i + 1];
+        else
+            break;
+    }
+    if (i < argc) {
+        fprintf(stderr, "Usage: %s [<rom.elf | rom.txt>] [-s <sdram.txt>] [-n <max instrs>] [-g <gpio in>] [-f <fb.pbm>] [-t <retire trace>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (p_rom_file) {
+        if (!image.loadFile(p_rom_file, ROM_START_ADDR))
+            return EXIT_FAILURE;
+#ifndef BRAM_AS_RAM
+        if (p_sdram_file && !image.loadHex(p_sdram_file, SDRAM_TEXT_START_ADDR))
+            return EXIT_FAILURE;
+#else
+        if (p_sdram_file)
+            LOG_WARN(LOG_ISS, "BRAM as RAM build, %s ignored", p_sdram_file);
+#endif
+    }
+    else if (!image.loadFromEnv())
+        return EXIT_FAILURE;
+    image.markDataPreloaded();
+
+    SoCEmu soc;
+    RV32ISim *p_iss = soc.getISSPtr();
+    if (!soc.loadImage(image))
+        return EXIT_FAILURE;
+    soc.setGPIOIn(gpio_in);
+    signal(SIGINT, sigint_handler);
+
+    RV32ISim::Status status = RV32ISim::ISS_OK;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (p_trace_file) {
+        // Traced: one step at a time
+        RetireTraceWriter trace(p_trace_file);
+        if (!trace.isOpen())
+            return EXIT_FAILURE;
+        RV32ISim::StepInfo info;
+        while (!stopped(status) && (p_iss->getInstret() < max_instrs)) {
+            status = p_iss->step(&info);
+            if (status == RV32ISim::ISS_ILLEGAL || status == RV32ISim::ISS_FETCH_FAULT)
+                break;
+            uint8_t flags = info.load ? RETIRE_F_LOAD : info.store ? RETIRE_F_STORE : (info.rd ? RETIRE_F_WB : 0);
+            trace.retire(p_iss->getInstret(), info.pc, info.instr, info.rd, info.wb, info.addr, flags);
+            if (info.load)
+                trace.loadReturn(info.rd, info.wb);
+        }
+    }
+    else {
+        while (!stopped(status) && (p_iss->getInstret() < max_instrs)) {
+            uint64_t left = max_instrs - p_iss->getInstret();
+            status = soc.run((left < SOCEMU_CHUNK) ? left : SOCEMU_CHUNK);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned long long instret = p_iss->getInstret();
+    uint32_t offset = 0;
+    const char *p_symbol = image.symbolize(p_iss->getPC(), offset);
+    // Bare pc when there is no symbol for it
+    char symbol[128] = "";
+    if (p_symbol)
+        snprintf(symbol, sizeof(symbol), " <%s+0x%X>", p_symbol, offset);
+    LOG_INFO(LOG_ISS, "Stopped: %s @ pc 0x%08X%s, %llu instrs in %.3f s (%.1f MIPS, %.3f s at %d MHz CPI 1)",
+             s_stop ? "ctrl-c" : (status == RV32ISim::ISS_OK) ? "max instrs" : RV32ISim::statusName(status),
+             p_iss->getPC(), symbol, instret, seconds, seconds > 0 ? instret / seconds / 1e6 : 0.0,
+             instret / (SOCEMU_CPU_MHZ * 1e6), SOCEMU_CPU_MHZ);
+    LOG_INFO(LOG_ISS, "GPIO out 0x%08X", soc.getGPIOOut());
+    for (int r = 0; r < 32; r += 4)
+        LOG_INFO(LOG_ISS, "x%-2d 0x%08X  x%-2d 0x%08X  x%-2d 0x%08X  x%-2d 0x%08X", r, p_iss->getReg(r), r + 1,
+                 p_iss->getReg(r + 1), r + 2, p_iss->getReg(r + 2), r + 3, p_iss->getReg(r + 3));
+    if (p_fb_file)
+        soc.dumpFramebuffer(p_fb_file);
+    return (status == RV32ISim::ISS_ILLEGAL || status == RV32ISim::ISS_FETCH_FAULT) ? EXIT_FAILURE : EXIT_SUCCESS;
+}